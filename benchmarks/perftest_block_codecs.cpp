@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <random>
+
+#include "spdlog/spdlog.h"
+
+#include "codec/block_codec_registry.hpp"
+#include "codec/simdbp_wide.hpp"
+#include "codec/simdpfor.hpp"
+#include "util/cpu_features.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using namespace pisa;
+
+namespace {
+
+constexpr std::size_t num_blocks = 1 << 10;
+constexpr std::size_t runs = 1 << 8;
+
+/**
+ * Encodes `num_blocks` full blocks of random values below `universe` and reports the average
+ * size and decoding time per integer. With `outliers`, one value in 32 is drawn from a 16 times
+ * larger universe, which is where codecs with exceptions pay off.
+ */
+void perftest(
+    BlockCodec const& codec, std::string_view label, std::uint32_t universe, bool outliers
+) {
+    std::mt19937 rng(1729);
+    std::uniform_int_distribution<std::uint32_t> dist(0, universe - 1);
+    std::uniform_int_distribution<std::uint32_t> outlier_dist(0, 16 * universe - 1);
+    std::bernoulli_distribution is_outlier(outliers ? 1.0 / 32 : 0.0);
+    std::size_t block_size = codec.block_size();
+    std::vector<std::uint32_t> values(block_size);
+    std::vector<std::uint8_t> encoded;
+    for (std::size_t block = 0; block < num_blocks; ++block) {
+        std::generate(values.begin(), values.end(), [&] {
+            return is_outlier(rng) ? outlier_dist(rng) : dist(rng);
+        });
+        codec.encode(values.data(), std::uint32_t(-1), block_size, encoded);
+    }
+    double bits = 8.0 * encoded.size() / (num_blocks * block_size);
+    // Some codecs (e.g., QMX) may read past the end of the last block.
+    encoded.resize(encoded.size() + 64);
+
+    double tick = get_time_usecs();
+    for (std::size_t run = 0; run < runs; ++run) {
+        std::uint8_t const* in = encoded.data();
+        for (std::size_t block = 0; block < num_blocks; ++block) {
+            in = codec.decode(in, values.data(), std::uint32_t(-1), block_size);
+            do_not_optimize_away(values[0]);
+        }
+    }
+    double time = (get_time_usecs() - tick) * 1000 / (runs * num_blocks * block_size);
+    spdlog::info(
+        "{}; u = {}; outliers = {}; bits per int = {:.2f}; time per int = {:.3f} ns",
+        label,
+        universe,
+        outliers,
+        bits,
+        time
+    );
+}
+
+/** Runs `perftest` with the kernels of each SIMD level supported by the codec and the CPU. */
+template <typename Codec>
+void perftest_simd_levels(std::uint32_t universe, bool outliers) {
+    for (auto level: supported_simd_levels()) {
+        if (level <= Codec::max_simd_level) {
+            perftest(
+                Codec(level),
+                fmt::format("{} ({})", Codec::name, to_string(level)),
+                universe,
+                outliers
+            );
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    for (std::uint32_t universe = 2; universe <= (1U << 20); universe *= 32) {
+        for (bool outliers: {false, true}) {
+            for (auto name: get_block_codec_names()) {
+                if (name == SimdBp256BlockCodec::name || name == SimdBp512BlockCodec::name
+                    || name == SimdPFor128BlockCodec::name || name == SimdPFor256BlockCodec::name) {
+                    continue;
+                }
+                perftest(*get_block_codec(name), name, universe, outliers);
+            }
+            perftest_simd_levels<SimdBp256BlockCodec>(universe, outliers);
+            perftest_simd_levels<SimdBp512BlockCodec>(universe, outliers);
+            perftest_simd_levels<SimdPFor128BlockCodec>(universe, outliers);
+            perftest_simd_levels<SimdPFor256BlockCodec>(universe, outliers);
+        }
+    }
+}
@@ -4,6 +4,7 @@
 #include "spdlog/spdlog.h"
 
 #include "codec/block_codecs.hpp"
+#include "codec/interpolative_coding.hpp"
 #include "util/do_not_optimize_away.hpp"
 #include "util/util.hpp"
 
@@ -14,7 +15,8 @@ int main() {
 
     std::vector<uint32_t> values(size);
     std::vector<uint8_t> encoded;
-    for (int u = 2; u <= 1024; u *= 2) {
+    for (int u = 1; u <= 1024; u *= 2) {
+        // With u = 1, all values are 0, and so are runs of values with small u.
         std::generate(values.begin(), values.end(), [&]() { return (uint32_t)rand() % u; });
         encoded.clear();
         uint32_t sum_of_values = std::accumulate(values.begin(), values.end(), 0);
@@ -25,8 +27,16 @@ int main() {
             interpolative_block::decode(encoded.data(), values.data(), sum_of_values, values.size());
             do_not_optimize_away(values[0]);
         }
-
         double time = (get_time_usecs() - tick) / runs * 1000;
-        spdlog::info("u = {}; time = {}", u, time);
+
+        tick = get_time_usecs();
+        for (size_t run = 0; run < runs; ++run) {
+            bit_reader br(encoded.data());
+            br.read_interpolative_recursive(values.data(), size - 1, 0, sum_of_values);
+            do_not_optimize_away(values[0]);
+        }
+        double recursive_time = (get_time_usecs() - tick) / runs * 1000;
+
+        spdlog::info("u = {}; time = {}; recursive time = {}", u, time, recursive_time);
     }
 }
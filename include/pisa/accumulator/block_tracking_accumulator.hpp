@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "partial_score_accumulator.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/**
+ * Block-tracking accumulator partitions the score array into blocks of `block_size` scores
+ * (by default, 16 floats, i.e., one cache line), and keeps a bitmap of blocks that have been
+ * touched since the last reset. Both `reset()` and `collect()` only visit the touched blocks,
+ * which makes them proportional to the number of documents matching the query rather than the
+ * number of documents in the collection. When collecting, all scores in a block are compared
+ * against the current top-k threshold with SIMD instructions, and only the candidates that pass
+ * the test are inserted into the queue.
+ */
+template <std::size_t block_size = 16>
+class BlockTrackingAccumulator {
+    static_assert(
+        block_size > 0 && block_size % 8 == 0 && block_size <= 32,
+        "block size must be a multiple of 8 not greater than 32"
+    );
+
+    static constexpr std::size_t bits_in_word = 64;
+
+    struct alignas(64) Block {
+        std::array<float, block_size> scores{};
+    };
+
+  public:
+    explicit BlockTrackingAccumulator(std::size_t size)
+        : m_size(size),
+          m_blocks(ceil_div(size, block_size)),
+          m_touched(ceil_div(m_blocks.size(), bits_in_word)) {
+        static_assert(PartialScoreAccumulator<decltype(*this)>);
+    }
+
+    void reset() {
+        for (std::size_t word_idx = 0; word_idx < m_touched.size(); ++word_idx) {
+            for_each_bit(m_touched[word_idx], [&](auto bit) {
+                m_blocks[word_idx * bits_in_word + bit].scores.fill(0.0);
+            });
+            m_touched[word_idx] = 0;
+        }
+    }
+
+    void accumulate(std::size_t document, float score) {
+        auto const block = document / block_size;
+        m_touched[block / bits_in_word] |= std::uint64_t{1} << (block % bits_in_word);
+        m_blocks[block].scores[document % block_size] += score;
+    }
+
+    void collect(topk_queue& topk) {
+        for (std::size_t word_idx = 0; word_idx < m_touched.size(); ++word_idx) {
+            for_each_bit(m_touched[word_idx], [&](auto bit) {
+                auto const block = word_idx * bits_in_word + bit;
+                auto const& scores = m_blocks[block].scores;
+                auto candidates = above_threshold(scores, topk.effective_threshold());
+                for_each_bit(candidates, [&](auto pos) {
+                    topk.insert(scores[pos], block * block_size + pos);
+                });
+            });
+        }
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+
+  private:
+    template <typename Word, typename Fn>
+    static void for_each_bit(Word word, Fn fn) {
+        while (word != 0) {
+            fn(static_cast<std::size_t>(__builtin_ctzll(word)));
+            word &= word - 1;
+        }
+    }
+
+    /**
+     * Returns a mask with the n-th bit set if the n-th score is strictly greater than `threshold`.
+     */
+    [[nodiscard]] static auto
+    above_threshold(std::array<float, block_size> const& scores, float threshold) -> std::uint32_t {
+        std::uint32_t mask = 0;
+#if defined(__AVX__)
+        auto const thresholds = _mm256_set1_ps(threshold);
+        for (std::size_t pos = 0; pos < block_size; pos += 8) {
+            auto cmp = _mm256_cmp_ps(_mm256_load_ps(&scores[pos]), thresholds, _CMP_GT_OQ);
+            mask |= static_cast<std::uint32_t>(_mm256_movemask_ps(cmp)) << pos;
+        }
+#else
+        auto const thresholds = _mm_set1_ps(threshold);
+        for (std::size_t pos = 0; pos < block_size; pos += 4) {
+            auto cmp = _mm_cmpgt_ps(_mm_load_ps(&scores[pos]), thresholds);
+            mask |= static_cast<std::uint32_t>(_mm_movemask_ps(cmp)) << pos;
+        }
+#endif
+        return mask;
+    }
+
+    std::size_t m_size;
+    std::vector<Block> m_blocks;
+    std::vector<std::uint64_t> m_touched;
+};
+
+}  // namespace pisa
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "partial_score_accumulator.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/**
+ * Integer accumulator stores scores as unsigned integers of type `Counter` (either 16 or 32 bits).
+ * It is intended for quantized indexes, in which all partial scores are small integers, and
+ * accumulating them as such halves (in case of 16-bit counters) the memory footprint compared to
+ * floating point accumulators. Sums that do not fit in `Counter` saturate at its maximum value.
+ * Any fractional part of a partial score (e.g., when query terms are weighted) is truncated.
+ *
+ * Same as `BlockTrackingAccumulator`, the counters are partitioned into cache-line blocks, and
+ * only the blocks touched by the current query are visited on reset and when collecting the
+ * results, which is done by comparing entire blocks against the top-k threshold with integer SIMD
+ * instructions.
+ */
+template <typename Counter>
+class IntegerAccumulator {
+    static_assert(
+        std::is_same_v<Counter, std::uint16_t> || std::is_same_v<Counter, std::uint32_t>,
+        "counter must be a 16 or 32 bit unsigned integer"
+    );
+
+    static constexpr std::size_t block_size = 64 / sizeof(Counter);
+    static constexpr std::size_t bits_in_word = 64;
+    static constexpr std::uint64_t max_value = std::numeric_limits<Counter>::max();
+
+    struct alignas(64) Block {
+        std::array<Counter, block_size> scores{};
+    };
+
+  public:
+    explicit IntegerAccumulator(std::size_t size)
+        : m_size(size),
+          m_blocks(ceil_div(size, block_size)),
+          m_touched(ceil_div(m_blocks.size(), bits_in_word)) {
+        static_assert(PartialScoreAccumulator<decltype(*this)>);
+    }
+
+    void reset() {
+        for (std::size_t word_idx = 0; word_idx < m_touched.size(); ++word_idx) {
+            for_each_bit(m_touched[word_idx], [&](auto bit) {
+                m_blocks[word_idx * bits_in_word + bit].scores.fill(0);
+            });
+            m_touched[word_idx] = 0;
+        }
+    }
+
+    void accumulate(std::size_t document, float score) {
+        auto const block = document / block_size;
+        m_touched[block / bits_in_word] |= std::uint64_t{1} << (block % bits_in_word);
+        auto& counter = m_blocks[block].scores[document % block_size];
+        auto sum = static_cast<std::uint64_t>(counter) + static_cast<std::uint64_t>(score);
+        counter = static_cast<Counter>(std::min(sum, max_value));
+    }
+
+    void collect(topk_queue& topk) {
+        for (std::size_t word_idx = 0; word_idx < m_touched.size(); ++word_idx) {
+            for_each_bit(m_touched[word_idx], [&](auto bit) {
+                // Integer scores greater than `floor(threshold)` are exactly those greater than
+                // `threshold`, and no score can be greater than the maximum counter value.
+                auto threshold = std::max(std::floor(topk.effective_threshold()), 0.0F);
+                if (threshold >= static_cast<float>(max_value)) {
+                    return;
+                }
+                auto const block = word_idx * bits_in_word + bit;
+                auto const& scores = m_blocks[block].scores;
+                auto candidates = above_threshold(scores, static_cast<Counter>(threshold));
+                for_each_bit(candidates, [&](auto pos) {
+                    topk.insert(static_cast<float>(scores[pos]), block * block_size + pos);
+                });
+            });
+        }
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+
+  private:
+    template <typename Word, typename Fn>
+    static void for_each_bit(Word word, Fn fn) {
+        while (word != 0) {
+            fn(static_cast<std::size_t>(__builtin_ctzll(word)));
+            word &= word - 1;
+        }
+    }
+
+    /**
+     * Returns a mask with the n-th bit set if the n-th score is strictly greater than `threshold`.
+     *
+     * SIMD comparisons are signed, so both sides are shifted by flipping the sign bit first.
+     */
+    [[nodiscard]] static auto
+    above_threshold(std::array<Counter, block_size> const& scores, Counter threshold)
+        -> std::uint32_t {
+        std::uint32_t mask = 0;
+        auto const* data = scores.data();
+        if constexpr (std::is_same_v<Counter, std::uint16_t>) {
+#if defined(__AVX2__)
+            auto const sign = _mm256_set1_epi16(std::numeric_limits<std::int16_t>::min());
+            auto const thresholds = _mm256_xor_si256(_mm256_set1_epi16(threshold), sign);
+            for (std::size_t pos = 0; pos < block_size; pos += 16) {
+                auto values = _mm256_load_si256(reinterpret_cast<__m256i const*>(data + pos));
+                auto cmp = _mm256_cmpgt_epi16(_mm256_xor_si256(values, sign), thresholds);
+                // Packing to bytes interleaves the 128-bit lanes, which the permutation undoes.
+                auto bytes = _mm256_permute4x64_epi64(
+                    _mm256_packs_epi16(cmp, _mm256_setzero_si256()), 0b11011000
+                );
+                mask |= (static_cast<std::uint32_t>(_mm256_movemask_epi8(bytes)) & 0xFFFF) << pos;
+            }
+#else
+            auto const sign = _mm_set1_epi16(std::numeric_limits<std::int16_t>::min());
+            auto const thresholds = _mm_xor_si128(_mm_set1_epi16(threshold), sign);
+            for (std::size_t pos = 0; pos < block_size; pos += 16) {
+                auto lo = _mm_load_si128(reinterpret_cast<__m128i const*>(data + pos));
+                auto hi = _mm_load_si128(reinterpret_cast<__m128i const*>(data + pos + 8));
+                auto cmp_lo = _mm_cmpgt_epi16(_mm_xor_si128(lo, sign), thresholds);
+                auto cmp_hi = _mm_cmpgt_epi16(_mm_xor_si128(hi, sign), thresholds);
+                auto bytes = _mm_packs_epi16(cmp_lo, cmp_hi);
+                mask |= static_cast<std::uint32_t>(_mm_movemask_epi8(bytes)) << pos;
+            }
+#endif
+        } else {
+#if defined(__AVX2__)
+            auto const sign = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::min());
+            auto const thresholds = _mm256_xor_si256(_mm256_set1_epi32(threshold), sign);
+            for (std::size_t pos = 0; pos < block_size; pos += 8) {
+                auto values = _mm256_load_si256(reinterpret_cast<__m256i const*>(data + pos));
+                auto cmp = _mm256_cmpgt_epi32(_mm256_xor_si256(values, sign), thresholds);
+                mask |= static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(cmp)))
+                    << pos;
+            }
+#else
+            auto const sign = _mm_set1_epi32(std::numeric_limits<std::int32_t>::min());
+            auto const thresholds = _mm_xor_si128(_mm_set1_epi32(threshold), sign);
+            for (std::size_t pos = 0; pos < block_size; pos += 4) {
+                auto values = _mm_load_si128(reinterpret_cast<__m128i const*>(data + pos));
+                auto cmp = _mm_cmpgt_epi32(_mm_xor_si128(values, sign), thresholds);
+                mask |= static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(cmp))) << pos;
+            }
+#endif
+        }
+        return mask;
+    }
+
+    std::size_t m_size;
+    std::vector<Block> m_blocks;
+    std::vector<std::uint64_t> m_touched;
+};
+
+}  // namespace pisa
@@ -1,14 +1,19 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <memory>
+#include <numeric>
 #include <stdexcept>
 #include <type_traits>
+#include <vector>
 
 #include "fmt/format.h"
 #include "mio/mmap.hpp"
 #include "spdlog/spdlog.h"
 
+#include "codec/block_codecs.hpp"
 #include "util/util.hpp"
 
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
@@ -17,6 +22,65 @@
 
 namespace pisa {
 
+/** Layout of the sequences of a binary collection file. */
+enum class BinaryCollectionFormat : std::uint8_t {
+    /** Each sequence is its length followed by its values, all as 32-bit integers. */
+    Raw = 0,
+    /** Sequences are VByte-encoded, and indexed by an offset table; see `vbyte_collection`. */
+    VByte = 1,
+};
+
+/**
+ * A VByte binary collection file consists of:
+ * - the 8 bytes `PISABCV1` and the number of sequences as a 64-bit integer;
+ * - the sequences, each a VByte-encoded header `2 * length + delta` followed by its `length`
+ *   VByte-encoded values, which are the differences between consecutive values if `delta` is 1,
+ *   and the values themselves otherwise;
+ * - zero bytes up to a multiple of 8 bytes;
+ * - the byte offset of each sequence from the start of the file, and the end of the last sequence,
+ *   as 64-bit integers.
+ *
+ * A raw file starting with the same 8 bytes would have a first sequence of 1095977296 values
+ * starting with 827736898, which is not the first sequence of any collection PISA writes.
+ */
+namespace vbyte_collection {
+
+    inline constexpr std::uint64_t magic = 0x3156434241534950;  // "PISABCV1"
+    inline constexpr std::size_t header_size = 2 * sizeof(std::uint64_t);
+
+    /** Longest sequence that can be encoded, such that its header fits in 32 bits. */
+    inline constexpr std::size_t max_length = (std::size_t(1) << 31U) - 1;
+
+    /** Returns whether the file contents start like a VByte binary collection. */
+    [[nodiscard]] inline auto is_vbyte(char const* data, std::size_t size) -> bool {
+        if (size < header_size) {
+            return false;
+        }
+        std::uint64_t head = 0;
+        std::memcpy(&head, data, sizeof(head));
+        return head == magic;
+    }
+
+    /** Decodes the sequence starting at `in` into `out`, replacing its contents. */
+    inline void decode(std::uint8_t const* in, std::vector<std::uint32_t>& out) {
+        std::uint32_t header = 0;
+        in = TightVariableByte::decode(in, &header, 1);
+        out.resize(header >> 1U);
+        TightVariableByte::decode(in, out.data(), out.size());
+        if ((header & 1U) != 0U) {
+            std::partial_sum(out.begin(), out.end(), out.begin());
+        }
+    }
+
+}  // namespace vbyte_collection
+
+/**
+ * Collection of sequences of 32-bit integers, read from a file in any `BinaryCollectionFormat`.
+ *
+ * Raw files are accessed in place, while the sequences of VByte files are decoded one at a time
+ * into buffers shared by the copies of a sequence, which can therefore outlive the iterator that
+ * produced them. VByte files cannot be opened for writing.
+ */
 template <typename Source = mio::mmap_source>
 class base_binary_collection {
   public:
@@ -33,6 +97,12 @@ class base_binary_collection {
         }
         m_data = reinterpret_cast<pointer>(m_file.data());
         m_data_size = m_file.size() / sizeof(m_data[0]);
+        m_end = m_data_size;
+        if (vbyte_collection::is_vbyte(
+                reinterpret_cast<char const*>(m_file.data()), m_file.size()
+            )) {
+            open_vbyte(filename);
+        }
 
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
         // Indicates that the application expects to access this address range in a sequential
@@ -47,6 +117,10 @@ class base_binary_collection {
     class sequence {
       public:
         sequence(pointer begin, pointer end) : m_begin(begin), m_end(end) {}
+        explicit sequence(std::shared_ptr<std::vector<posting_type>> buffer)
+            : m_begin(buffer->data()),
+              m_end(buffer->data() + buffer->size()),
+              m_buffer(std::move(buffer)) {}
         sequence() : m_begin(nullptr), m_end(nullptr) {}
 
         posting_type const& operator[](size_t p) const { return *(m_begin + p); }
@@ -63,6 +137,7 @@ class base_binary_collection {
       private:
         pointer m_begin;
         pointer m_end;
+        std::shared_ptr<std::vector<posting_type>> m_buffer{};
     };
 
     using const_sequence = sequence;
@@ -77,11 +152,27 @@ class base_binary_collection {
         base_iterator<sequence>>::type;
 
     iterator begin() { return iterator(this, 0); }
-    iterator end() { return iterator(this, m_data_size); }
+    iterator end() { return iterator(this, m_end); }
     const_iterator begin() const { return const_iterator(this, 0); }
-    const_iterator end() const { return const_iterator(this, m_data_size); }
+    const_iterator end() const { return const_iterator(this, m_end); }
     const_iterator cbegin() const { return const_iterator(this, 0); }
-    const_iterator cend() const { return const_iterator(this, m_data_size); }
+    const_iterator cend() const { return const_iterator(this, m_end); }
+
+    [[nodiscard]] auto format() const noexcept -> BinaryCollectionFormat {
+        return m_offsets == nullptr ? BinaryCollectionFormat::Raw : BinaryCollectionFormat::VByte;
+    }
+
+    /** Returns the number of sequences, which takes reading all sequence lengths of raw files. */
+    [[nodiscard]] auto size() const -> std::size_t {
+        if (m_offsets != nullptr) {
+            return m_end;
+        }
+        std::size_t count = 0;
+        for (std::size_t pos = 0; pos < m_data_size; pos += m_data[pos] + 1) {
+            ++count;
+        }
+        return count;
+    }
 
     template <typename S>
     class base_iterator {
@@ -116,7 +207,11 @@ class base_binary_collection {
         friend class base_binary_collection;
 
         base_iterator(base_binary_collection const* coll, size_t pos)
-            : m_data(coll->m_data), m_data_size(coll->m_data_size), m_pos(pos) {
+            : m_data(coll->m_data),
+              m_data_size(coll->m_end),
+              m_bytes(reinterpret_cast<std::uint8_t const*>(coll->m_file.data())),
+              m_offsets(coll->m_offsets),
+              m_pos(pos) {
             read();
         }
 
@@ -125,6 +220,13 @@ class base_binary_collection {
             if (m_pos == m_data_size) {
                 return;
             }
+            if (m_offsets != nullptr) {
+                auto buffer = std::make_shared<std::vector<posting_type>>();
+                vbyte_collection::decode(m_bytes + m_offsets[m_pos], *buffer);
+                m_next_pos = m_pos + 1;
+                m_cur_seq = S(std::move(buffer));
+                return;
+            }
 
             size_t n = 0;
             size_t pos = m_pos;
@@ -138,14 +240,40 @@ class base_binary_collection {
         }
 
         typename base_binary_collection::pointer const m_data;
-        size_t m_data_size = 0, m_pos = 0, m_next_pos = 0;
+        size_t m_data_size = 0;
+        std::uint8_t const* m_bytes = nullptr;
+        std::uint64_t const* m_offsets = nullptr;
+        size_t m_pos = 0, m_next_pos = 0;
         S m_cur_seq;
     };
 
   private:
+    void open_vbyte(const char* filename) {
+        if constexpr (not std::is_same_v<Source, mio::mmap_source>) {
+            throw std::runtime_error(
+                fmt::format("VByte binary collection {} cannot be modified", filename)
+            );
+        }
+        auto const* bytes = reinterpret_cast<std::uint8_t const*>(m_file.data());
+        std::uint64_t count = 0;
+        std::memcpy(&count, bytes + sizeof(vbyte_collection::magic), sizeof(count));
+        std::size_t table_size = (count + 1) * sizeof(std::uint64_t);
+        if (count >= m_file.size() || m_file.size() < vbyte_collection::header_size + table_size) {
+            throw std::runtime_error(
+                fmt::format("VByte binary collection {} is truncated", filename)
+            );
+        }
+        m_offsets = reinterpret_cast<std::uint64_t const*>(bytes + m_file.size() - table_size);
+        m_end = count;
+    }
+
     Source m_file;
     typename base_binary_collection::pointer m_data;
     size_t m_data_size;
+    /** Offsets of the sequences of a VByte file, or `nullptr` for raw files. */
+    std::uint64_t const* m_offsets = nullptr;
+    /** Position of the end iterator: a number of integers for raw files, of sequences otherwise. */
+    size_t m_end = 0;
 };
 
 using binary_collection = base_binary_collection<>;
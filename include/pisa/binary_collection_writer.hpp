@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "spilled_vector.hpp"
+
+namespace pisa {
+
+/**
+ * Writes sequences of 32-bit integers to a file in the given `BinaryCollectionFormat`, to be read
+ * back with `binary_collection`.
+ *
+ * The offsets of the sequences of a VByte file are appended to a temporary file next to it until
+ * the file is closed, so that the memory used does not grow with the number of sequences.
+ */
+class BinaryCollectionWriter {
+  public:
+    explicit BinaryCollectionWriter(
+        std::string const& filename, BinaryCollectionFormat format = BinaryCollectionFormat::Raw
+    );
+    BinaryCollectionWriter(BinaryCollectionWriter const&) = delete;
+    BinaryCollectionWriter(BinaryCollectionWriter&&) = delete;
+    BinaryCollectionWriter& operator=(BinaryCollectionWriter const&) = delete;
+    BinaryCollectionWriter& operator=(BinaryCollectionWriter&&) = delete;
+
+    /** Closes the file if `close` has not been called. */
+    ~BinaryCollectionWriter();
+
+    /**
+     * Appends a sequence.
+     *
+     * \throws std::length_error   Thrown if a sequence of a VByte file is longer than
+     *                             `vbyte_collection::max_length`.
+     */
+    void write(std::span<std::uint32_t const> sequence);
+
+    /** Appends a sequence of a single value. */
+    void write(std::uint32_t value);
+
+    /** Writes what remains of the file, i.e., the offset table of VByte files, and closes it. */
+    void close();
+
+  private:
+    BinaryCollectionFormat m_format;
+    std::ofstream m_output;
+    std::optional<SpilledVector<std::uint64_t>> m_offsets{};
+    std::uint64_t m_position = 0;
+    std::vector<std::uint32_t> m_values{};
+    std::vector<std::uint8_t> m_encoded{};
+};
+
+}  // namespace pisa
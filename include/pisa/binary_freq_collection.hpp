@@ -29,7 +29,7 @@ class binary_freq_collection {
 
     iterator end() const { return iterator(m_docs.end(), m_freqs.end()); }
 
-    size_t size() const { return std::distance(begin(), end()); }
+    size_t size() const { return m_freqs.size(); }
 
     uint64_t num_docs() const { return m_num_docs; }
 
@@ -261,6 +261,12 @@ class bit_vector {
             while (skipped + (w = broadword::popcount(buf)) <= k) {
                 skipped += w;
                 m_position += 64;
+                // A window cannot contain the target if fewer ones are left to skip than its
+                // bits; this also guarantees that the window is within the bit vector.
+                while (k - skipped >= broadword::window_bits) {
+                    skipped += broadword::popcount_window(m_data + m_position / 64);
+                    m_position += broadword::window_bits;
+                }
                 buf = m_data[m_position / 64];
             }
             assert(buf);
@@ -278,6 +284,10 @@ class bit_vector {
             while (skipped + (w = broadword::popcount(buf)) <= k) {
                 skipped += w;
                 position += 64;
+                while (k - skipped >= broadword::window_bits) {
+                    skipped += broadword::popcount_window(m_data + position / 64);
+                    position += broadword::window_bits;
+                }
                 buf = m_data[position / 64];
             }
             assert(buf);
@@ -295,6 +305,11 @@ class bit_vector {
             while (skipped + (w = broadword::popcount(buf)) <= k) {
                 skipped += w;
                 m_position += 64;
+                while (k - skipped >= broadword::window_bits) {
+                    skipped += broadword::window_bits
+                        - broadword::popcount_window(m_data + m_position / 64);
+                    m_position += broadword::window_bits;
+                }
                 buf = ~m_data[m_position / 64];
             }
             assert(buf);
@@ -23,9 +23,11 @@ class bit_vector_builder {
 
     explicit bit_vector_builder(uint64_t size = 0, bool init = false);
     bit_vector_builder(bit_vector_builder const&) = delete;
-    bit_vector_builder(bit_vector_builder&&) = delete;
     bit_vector_builder& operator=(bit_vector_builder const&) = delete;
-    bit_vector_builder& operator=(bit_vector_builder&&) = delete;
+
+    /// Moving keeps the data buffer, so the current word remains valid.
+    bit_vector_builder(bit_vector_builder&& other) noexcept;
+    bit_vector_builder& operator=(bit_vector_builder&& other) noexcept;
     ~bit_vector_builder() = default;
 
     /// Reserves memory for the given number of bits.
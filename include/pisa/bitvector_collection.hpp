@@ -1,9 +1,13 @@
 #pragma once
 
+#include <filesystem>
+#include <fstream>
+
 #include "bit_vector.hpp"
 #include "bit_vector_builder.hpp"
 
 #include "codec/compact_elias_fano.hpp"
+#include "mappable/mapper.hpp"
 
 namespace pisa {
 
@@ -17,7 +21,7 @@ class bitvector_collection {
             m_endpoints.push_back(0);
         }
 
-        void append(bit_vector_builder& bvb) {
+        void append(bit_vector_builder const& bvb) {
             m_bitvectors.append(bvb);
             m_endpoints.push_back(m_bitvectors.size());
         }
@@ -43,6 +47,102 @@ class bitvector_collection {
         bit_vector_builder m_bitvectors;
     };
 
+    /**
+     * Builds a collection on disk.
+     *
+     * Appended bit vectors are spilled to a temporary file whenever enough whole words are
+     * buffered, so that only the endpoints and less than a word of the last vector are kept in
+     * memory. `write` then writes the collection in the layout of `mapper::freeze`.
+     */
+    class stream_builder {
+      public:
+        static constexpr std::uint64_t default_spill_bits = std::uint64_t(1) << 26U;
+
+        /**
+         * Constructs a builder spilling to `tmp_file` once at least `spill_bits` bits are
+         * buffered.
+         */
+        stream_builder(
+            global_parameters const& params,
+            std::filesystem::path tmp_file,
+            std::uint64_t spill_bits = default_spill_bits
+        )
+            : m_params(params),
+              m_tmp_file(std::move(tmp_file)),
+              m_output(m_tmp_file, std::ios::binary),
+              m_spill_bits(spill_bits) {
+            m_output.exceptions(std::ios::badbit | std::ios::failbit);
+            m_endpoints.push_back(0);
+        }
+
+        void append(bit_vector_builder const& bvb) {
+            m_buffer.append(bvb);
+            m_endpoints.push_back(m_spilled_words * 64 + m_buffer.size());
+            if (m_buffer.size() >= m_spill_bits) {
+                spill();
+            }
+        }
+
+        /** Writes the collection and removes the temporary file. */
+        void write(mapper::detail::freeze_visitor& freezer, std::ofstream& os) {
+            // padding is necessary to not read after buffer
+            m_buffer.append_bits(0, 64);
+            std::uint64_t bits = m_spilled_words * 64 + m_buffer.size();
+            auto& words = m_buffer.move_bits();
+            m_output.write(
+                reinterpret_cast<char const*>(words.data()),
+                static_cast<std::streamsize>(words.size() * sizeof(std::uint64_t))
+            );
+            std::uint64_t num_words = m_spilled_words + words.size();
+            m_output.close();
+
+            std::size_t size = m_endpoints.size() - 1;
+            freezer(size, "m_size");
+            bit_vector_builder bvb;
+            compact_elias_fano::write(bvb, m_endpoints.begin(), bits, size, m_params);
+            // padding is necessary to not read after buffer
+            bvb.append_bits(0, 64);
+            bit_vector endpoints(&bvb);
+            freezer(endpoints, "m_endpoints");
+
+            // Bit vector of the concatenated lists, written as `bit_vector::map` would.
+            auto bits_size = static_cast<std::size_t>(bits);
+            freezer(bits_size, "m_size");
+            freezer(num_words, "size");
+            std::ifstream is(m_tmp_file, std::ios::binary);
+            is.exceptions(std::ios::badbit);
+            os << is.rdbuf();
+            is.close();
+            std::filesystem::remove(m_tmp_file);
+        }
+
+      private:
+        /** Writes the whole words of the buffer, keeping the bits of its last partial word. */
+        void spill() {
+            auto tail_bits = m_buffer.size() % 64;
+            auto& words = m_buffer.move_bits();
+            auto whole_words = words.size() - (tail_bits != 0 ? 1 : 0);
+            m_output.write(
+                reinterpret_cast<char const*>(words.data()),
+                static_cast<std::streamsize>(whole_words * sizeof(std::uint64_t))
+            );
+            m_spilled_words += whole_words;
+            bit_vector_builder tail;
+            if (tail_bits != 0) {
+                tail.append_bits(words.back(), tail_bits);
+            }
+            m_buffer.swap(tail);
+        }
+
+        global_parameters m_params;
+        std::filesystem::path m_tmp_file;
+        std::ofstream m_output;
+        std::uint64_t m_spill_bits;
+        std::vector<uint64_t> m_endpoints;
+        bit_vector_builder m_buffer;
+        std::uint64_t m_spilled_words = 0;
+    };
+
     size_t size() const { return m_size; }
 
     bit_vector const& bits() const { return m_bitvectors; }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <fmt/format.h>
+#include <immintrin.h>
 #include <optional>
 #include <spdlog/spdlog.h>
 
@@ -9,6 +12,7 @@
 #include "codec/block_codec.hpp"
 #include "codec/block_codecs.hpp"
 #include "concepts/posting_cursor.hpp"
+#include "cursor/posting_block.hpp"
 #include "global_parameters.hpp"
 #include "mappable/mappable_vector.hpp"
 #include "mappable/mapper.hpp"
@@ -32,6 +36,18 @@ enum Profiling : bool { On, Off };
 
 /**
  * Cursor for a block-encoded posting list.
+ *
+ * Document IDs are decoded into absolute values for an entire block at once, which lets
+ * `next_geq` search within the block with SIMD comparisons instead of summing the gaps one by one.
+ *
+ * Blocks whose frequencies are all the same, e.g., all ones, are flagged in a bitmap following the
+ * block endpoints, and store the frequency once instead of a codec-encoded block.
+ *
+ * All blocks but the last one hold the block size of the codec, except in lists concatenated by
+ * `index::block::PostingListConcatenator`, which keeps the partial blocks of the concatenated
+ * lists. Such lists start with a zero, which is never the size of a list, followed by their size,
+ * their number of blocks, and after the block endpoints, the number of postings preceding each
+ * block but the first one.
  */
 template <Profiling profiling = Profiling::Off>
 class BlockInvertedIndexCursor {
@@ -43,23 +59,36 @@ class BlockInvertedIndexCursor {
         [[maybe_unused]] std::uint32_t term_id
     )
         : m_base(TightVariableByte::decode(data, &m_n, 1)),
-          m_blocks(ceil_div(m_n, block_codec->block_size())),
-          m_block_maxs(m_base),
-          m_block_endpoints(m_block_maxs + 4 * m_blocks),
-          m_blocks_data(m_block_endpoints + 4 * (m_blocks - 1)),
           m_universe(universe),
           m_block_codec(block_codec),
           m_block_size(block_codec->block_size()) {
+        bool partial_blocks = m_n == 0;
+        if (partial_blocks) {
+            m_base = TightVariableByte::decode(m_base, &m_n, 1);
+            m_base = TightVariableByte::decode(m_base, &m_blocks, 1);
+        } else {
+            m_blocks = ceil_div(m_n, m_block_size);
+        }
+        m_block_maxs = m_base;
+        m_block_endpoints = m_block_maxs + 4 * m_blocks;
+        m_block_flags = m_block_endpoints + 4 * (m_blocks - 1);
+        if (partial_blocks) {
+            m_block_starts = m_block_flags;
+            m_block_flags += 4 * (m_blocks - 1);
+        }
+        m_blocks_data = m_block_flags + ceil_div(m_blocks, 8);
         static_assert((
             concepts::FrequencyPostingCursor<BlockInvertedIndexCursor>
             && concepts::SortedPostingCursor<BlockInvertedIndexCursor>
+            && concepts::BlockPostingCursor<BlockInvertedIndexCursor>
         ));
 
         if constexpr (profiling == Profiling::On) {
             m_profiler = block_profiler::open_list(term_id, m_blocks);
         }
 
-        m_docs_buf.resize(m_block_size);
+        // Padded so that the search in `next_geq` can always load entire SIMD registers.
+        m_docs_buf.resize(ceil_div(m_block_size, 8) * 8);
         m_freqs_buf.resize(m_block_size);
         reset();
     }
@@ -75,7 +104,7 @@ class BlockInvertedIndexCursor {
             }
             decode_docs_block(m_cur_block + 1);
         } else {
-            m_cur_docid += m_docs_buf[m_pos_in_block] + 1;
+            m_cur_docid = m_docs_buf[m_pos_in_block];
         }
     }
 
@@ -102,21 +131,27 @@ class BlockInvertedIndexCursor {
             decode_docs_block(block);
         }
 
-        while (docid() < lower_bound) {
-            m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+        if (docid() < lower_bound) {
+            m_pos_in_block = find_geq_in_block(static_cast<std::uint32_t>(lower_bound));
             assert(m_pos_in_block < m_cur_block_size);
+            m_cur_docid = m_docs_buf[m_pos_in_block];
         }
     }
 
     void PISA_ALWAYSINLINE move(uint64_t pos) {
         assert(pos >= position());
         uint64_t block = pos / m_block_size;
+        if (m_block_starts != nullptr) [[unlikely]] {
+            block = m_cur_block;
+            while (block + 1 < m_blocks && block_start(block + 1) <= pos) {
+                ++block;
+            }
+        }
         if (block != m_cur_block) [[unlikely]] {
             decode_docs_block(block);
         }
-        while (position() < pos) {
-            m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
-        }
+        m_pos_in_block = pos - block_start(block);
+        m_cur_docid = m_docs_buf[m_pos_in_block];
     }
 
     uint64_t docid() const { return m_cur_docid; }
@@ -130,7 +165,40 @@ class BlockInvertedIndexCursor {
 
     uint64_t PISA_ALWAYSINLINE value() { return freq(); }
 
-    uint64_t position() const { return m_cur_block * m_block_size + m_pos_in_block; }
+    /**
+     * Returns the postings from the current position to the end of the current block.
+     *
+     * Frequencies are materialized the first time this is called for a block, and the returned
+     * spans are valid until the cursor moves to another block.
+     */
+    PostingBlock PISA_ALWAYSINLINE current_block() {
+        if (m_cur_docid >= m_universe) {
+            return {};
+        }
+        if (!m_block_materialized) {
+            materialize_block();
+        }
+        auto len = m_cur_block_size - m_pos_in_block;
+        return PostingBlock{
+            std::span<std::uint32_t const>(m_docs_buf.data() + m_pos_in_block, len),
+            std::span<std::uint32_t const>(m_block_freqs.data() + m_pos_in_block, len)
+        };
+    }
+
+    /**
+     * Moves to the first posting of the next block, or to the end of the list if the current
+     * block is the last one.
+     */
+    void PISA_ALWAYSINLINE next_block() {
+        if (m_cur_block + 1 == m_blocks) {
+            m_pos_in_block = m_cur_block_size;
+            m_cur_docid = m_universe;
+            return;
+        }
+        decode_docs_block(m_cur_block + 1);
+    }
+
+    uint64_t position() const { return block_start(m_cur_block) + m_pos_in_block; }
 
     uint64_t size() const noexcept { return m_n; }
 
@@ -140,17 +208,16 @@ class BlockInvertedIndexCursor {
         // XXX rewrite in terms of get_blocks()
         uint64_t bytes = 0;
         uint8_t const* ptr = m_blocks_data;
-        static const uint64_t block_size = m_block_size;
+        uint64_t const block_size = m_block_size;
         std::vector<uint32_t> buf(block_size);
         for (size_t b = 0; b < m_blocks; ++b) {
-            uint32_t cur_block_size =
-                ((b + 1) * block_size <= size()) ? block_size : (size() % block_size);
+            uint32_t cur_block_size = block_length(b);
 
             uint32_t cur_base = (b != 0U ? block_max(b - 1) : uint32_t(-1)) + 1;
             uint8_t const* freq_ptr = m_block_codec->decode(
                 ptr, buf.data(), block_max(b) - cur_base - (cur_block_size - 1), cur_block_size
             );
-            ptr = m_block_codec->decode(freq_ptr, buf.data(), uint32_t(-1), cur_block_size);
+            ptr = skip_freqs_block(b, freq_ptr, buf.data(), cur_block_size);
             bytes += ptr - freq_ptr;
         }
 
@@ -165,6 +232,7 @@ class BlockInvertedIndexCursor {
         uint8_t const* docs_begin;
         uint8_t const* freqs_begin;
         uint8_t const* end;
+        bool constant_freqs;
         BlockCodec const* block_codec;
 
         void append_docs_block(std::vector<uint8_t>& out) const {
@@ -182,7 +250,13 @@ class BlockInvertedIndexCursor {
 
         void decode_freqs(std::vector<uint32_t>& out) const {
             out.resize(size);
-            block_codec->decode(freqs_begin, out.data(), uint32_t(-1), size);
+            if (constant_freqs) {
+                std::uint32_t value;
+                TightVariableByte::decode(freqs_begin, &value, 1);
+                std::fill(out.begin(), out.end(), value);
+            } else {
+                block_codec->decode(freqs_begin, out.data(), uint32_t(-1), size);
+            }
         }
     };
 
@@ -190,12 +264,11 @@ class BlockInvertedIndexCursor {
         std::vector<block_data> blocks;
 
         uint8_t const* ptr = m_blocks_data;
-        static const uint64_t block_size = m_block_size;
+        uint64_t const block_size = m_block_size;
         std::vector<uint32_t> buf(block_size);
         for (size_t b = 0; b < m_blocks; ++b) {
             blocks.emplace_back();
-            uint32_t cur_block_size =
-                ((b + 1) * block_size <= size()) ? block_size : (size() % block_size);
+            uint32_t cur_block_size = block_length(b);
 
             uint32_t cur_base = (b != 0U ? block_max(b - 1) : uint32_t(-1)) + 1;
             uint32_t gaps_universe = block_max(b) - cur_base - (cur_block_size - 1);
@@ -210,7 +283,8 @@ class BlockInvertedIndexCursor {
             uint8_t const* freq_ptr =
                 m_block_codec->decode(ptr, buf.data(), gaps_universe, cur_block_size);
             blocks.back().freqs_begin = freq_ptr;
-            ptr = m_block_codec->decode(freq_ptr, buf.data(), uint32_t(-1), cur_block_size);
+            blocks.back().constant_freqs = constant_freqs(b);
+            ptr = skip_freqs_block(b, freq_ptr, buf.data(), cur_block_size);
             blocks.back().end = ptr;
         }
 
@@ -221,24 +295,94 @@ class BlockInvertedIndexCursor {
   private:
     uint32_t block_max(uint32_t block) const { return ((uint32_t const*)m_block_maxs)[block]; }
 
+    /** Returns the number of postings preceding the given block. */
+    [[nodiscard]] auto block_start(uint64_t block) const -> uint64_t {
+        if (m_block_starts != nullptr) [[unlikely]] {
+            return block != 0U ? ((uint32_t const*)m_block_starts)[block - 1] : 0;
+        }
+        return block * m_block_size;
+    }
+
+    /** Returns the number of postings of the given block. */
+    [[nodiscard]] auto block_length(uint64_t block) const -> uint32_t {
+        if (m_block_starts != nullptr) [[unlikely]] {
+            auto end = block + 1 < m_blocks ? block_start(block + 1) : m_n;
+            return end - block_start(block);
+        }
+        return ((block + 1) * m_block_size <= size()) ? m_block_size : (size() % m_block_size);
+    }
+
+    [[nodiscard]] auto constant_freqs(uint32_t block) const -> bool {
+        return ((m_block_flags[block / 8] >> (block % 8)) & 1U) != 0;
+    }
+
+    /** Decodes the frequencies of the given block into `buf`, and returns the end of the block. */
+    auto skip_freqs_block(uint32_t block, uint8_t const* in, uint32_t* buf, uint32_t size) const
+        -> uint8_t const* {
+        if (constant_freqs(block)) {
+            return TightVariableByte::decode(in, buf, 1);
+        }
+        return m_block_codec->decode(in, buf, uint32_t(-1), size);
+    }
+
+    /**
+     * Returns the first position in the current block, starting from the current one, at which
+     * the document ID is at least `lower_bound`. The current block must contain such a document.
+     */
+    [[nodiscard]] PISA_ALWAYSINLINE auto find_geq_in_block(std::uint32_t lower_bound) const
+        -> std::uint32_t {
+        std::uint32_t const* docids = m_docs_buf.data();
+        // Positions preceding the current one in the same group hold smaller IDs than the
+        // current, so they never match, and the buffer is padded to a multiple of 8.
+#if defined(__AVX2__)
+        auto const bound = _mm256_set1_epi32(static_cast<int>(lower_bound));
+        for (std::uint32_t pos = m_pos_in_block & ~7U;; pos += 8) {
+            auto values = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(docids + pos));
+            auto geq = _mm256_cmpeq_epi32(_mm256_max_epu32(values, bound), values);
+            auto mask = static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(geq)));
+            if (mask != 0) {
+                return pos + std::countr_zero(mask);
+            }
+        }
+#elif defined(__SSE4_1__)
+        auto const bound = _mm_set1_epi32(static_cast<int>(lower_bound));
+        for (std::uint32_t pos = m_pos_in_block & ~3U;; pos += 4) {
+            auto values = _mm_loadu_si128(reinterpret_cast<__m128i const*>(docids + pos));
+            auto geq = _mm_cmpeq_epi32(_mm_max_epu32(values, bound), values);
+            auto mask = static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(geq)));
+            if (mask != 0) {
+                return pos + std::countr_zero(mask);
+            }
+        }
+#else
+        std::uint32_t pos = m_pos_in_block;
+        while (docids[pos] < lower_bound) {
+            ++pos;
+        }
+        return pos;
+#endif
+    }
+
     void PISA_NOINLINE decode_docs_block(uint64_t block) {
-        static const uint64_t block_size = m_block_size;
         uint32_t endpoint = block != 0U ? ((uint32_t const*)m_block_endpoints)[block - 1] : 0;
         uint8_t const* block_data = m_blocks_data + endpoint;
-        m_cur_block_size = ((block + 1) * block_size <= size()) ? block_size : (size() % block_size);
+        m_cur_block_size = block_length(block);
         uint32_t cur_base = (block != 0U ? block_max(block - 1) : uint32_t(-1)) + 1;
         m_cur_block_max = block_max(block);
-        m_freqs_block_data = m_block_codec->decode(
-            block_data, m_docs_buf.data(), m_cur_block_max - cur_base - (m_cur_block_size - 1), m_cur_block_size
+        m_freqs_block_data = m_block_codec->decode_docids(
+            block_data,
+            m_docs_buf.data(),
+            m_cur_block_max - cur_base - (m_cur_block_size - 1),
+            m_cur_block_size,
+            cur_base
         );
         intrinsics::prefetch(m_freqs_block_data);
 
-        m_docs_buf[0] += cur_base;
-
         m_cur_block = block;
         m_pos_in_block = 0;
         m_cur_docid = m_docs_buf[0];
         m_freqs_decoded = false;
+        m_block_materialized = false;
 
         if constexpr (profiling == Profiling::On) {
             ++m_profiler[2 * m_cur_block];
@@ -246,10 +390,17 @@ class BlockInvertedIndexCursor {
     }
 
     void PISA_NOINLINE decode_freqs_block() {
-        uint8_t const* next_block = m_block_codec->decode(
-            m_freqs_block_data, m_freqs_buf.data(), uint32_t(-1), m_cur_block_size
-        );
-        intrinsics::prefetch(next_block);
+        if (constant_freqs(m_cur_block)) {
+            // No need to call the codec, nor to prefetch: the next block directly follows.
+            std::uint32_t value;
+            TightVariableByte::decode(m_freqs_block_data, &value, 1);
+            std::fill_n(m_freqs_buf.data(), m_cur_block_size, value);
+        } else {
+            uint8_t const* next_block = m_block_codec->decode(
+                m_freqs_block_data, m_freqs_buf.data(), uint32_t(-1), m_cur_block_size
+            );
+            intrinsics::prefetch(next_block);
+        }
         m_freqs_decoded = true;
 
         if constexpr (profiling == Profiling::On) {
@@ -257,11 +408,28 @@ class BlockInvertedIndexCursor {
         }
     }
 
+    void PISA_NOINLINE materialize_block() {
+        if (!m_freqs_decoded) {
+            decode_freqs_block();
+        }
+        // Allocated lazily so that cursors not using the block interface pay nothing.
+        if (m_block_freqs.size() < m_block_size) {
+            m_block_freqs.resize(m_block_size);
+        }
+        for (uint32_t pos = 0; pos < m_cur_block_size; ++pos) {
+            m_block_freqs[pos] = m_freqs_buf[pos] + 1;
+        }
+        m_block_materialized = true;
+    }
+
     uint32_t m_n{0};
     uint8_t const* m_base;
     uint32_t m_blocks;
     uint8_t const* m_block_maxs;
     uint8_t const* m_block_endpoints;
+    /** Number of postings preceding each block but the first, or null if all blocks are full. */
+    uint8_t const* m_block_starts{nullptr};
+    uint8_t const* m_block_flags;
     uint8_t const* m_blocks_data;
     uint64_t m_universe;
 
@@ -273,9 +441,11 @@ class BlockInvertedIndexCursor {
 
     uint8_t const* m_freqs_block_data{nullptr};
     bool m_freqs_decoded{false};
+    bool m_block_materialized{false};
 
     std::vector<uint32_t> m_docs_buf;
     std::vector<uint32_t> m_freqs_buf;
+    std::vector<uint32_t> m_block_freqs;
     BlockCodec const* m_block_codec;
     std::size_t m_block_size;
     block_profiler::counter_type* m_profiler = nullptr;
@@ -288,6 +458,8 @@ struct SizeStats {
 };
 
 class BlockInvertedIndex {
+    std::uint32_t m_magic{format_magic};
+    std::uint32_t m_version{format_version};
     global_parameters m_params;
     std::size_t m_size{0};
     std::size_t m_num_docs{0};
@@ -307,12 +479,28 @@ class BlockInvertedIndex {
   public:
     using document_enumerator = BlockInvertedIndexCursor<>;
 
+    /** The bytes "PBLK", written at the beginning of the file. */
+    static constexpr std::uint32_t format_magic = 0x4b4c4250;
+
+    /**
+     * Version of the layout of the file and of the posting lists, written after the magic number.
+     * Version 1 is the first one with a header, and the first one with the flags of blocks of
+     * constant frequencies; indexes written before have neither, and must be built again. Version
+     * 2 adds lists with partial blocks before the last one; version 1 indexes are still read.
+     */
+    static constexpr std::uint32_t format_version = 2;
+
+    /**
+     * \throws std::runtime_error   Thrown if the source does not start with the magic number and
+     *                              the version of the format, e.g., for indexes written by older
+     *                              versions.
+     */
     BlockInvertedIndex(MemorySource source, BlockCodecPtr block_codec);
 
     template <typename Visitor>
     void map(Visitor& visit) {
-        visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
-            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+        visit(m_magic, "m_magic")(m_version, "m_version")(m_params, "m_params")(m_size, "m_size")(
+            m_num_docs, "m_num_docs")(m_endpoints, "m_endpoints")(m_lists, "m_lists");
     }
 
     [[nodiscard]] auto operator[](std::size_t term_id) const -> BlockInvertedIndexCursor<>;
@@ -352,6 +540,70 @@ namespace index::block {
         std::uint32_t const* freqs
     );
 
+    /**
+     * Logs the number of blocks and bytes encoded with each candidate of a `block_mixed` codec so
+     * far, and prints them in a stats line. Does nothing for other codecs.
+     */
+    void report_codec_mix(BlockCodec const& codec);
+
+    /**
+     * Concatenates posting lists over consecutive ranges of documents into a single list, encoded
+     * as by `write_posting_list`.
+     *
+     * Documents are encoded as gaps from the last document of the previous block, so the full
+     * blocks of the appended lists are copied byte for byte: only the documents of the first block
+     * of each list are encoded again, from the new base. The partial last blocks of the lists are
+     * decoded, and their postings are encoded together with the following ones until they fill a
+     * block, or until the next full block, which leaves a partial block before it. The list is
+     * then written with the sizes of its blocks, see `BlockInvertedIndexCursor`.
+     */
+    class PostingListConcatenator {
+      public:
+        explicit PostingListConcatenator(BlockCodec const* codec);
+
+        /**
+         * Appends the postings of `list`, whose document IDs are shifted by `offset`. They must
+         * follow the documents appended before.
+         */
+        void append(BlockInvertedIndexCursor<> list, std::uint32_t offset);
+
+        /**
+         * Writes the concatenated list to `out`.
+         *
+         * \throws std::invalid_argument   Thrown if no postings were appended.
+         */
+        void finish(std::vector<std::uint8_t>& out);
+
+        /** Number of blocks copied byte for byte from the appended lists. */
+        [[nodiscard]] auto copied_blocks() const noexcept -> std::size_t { return m_copied; }
+
+        /**
+         * Number of blocks encoded again, including full blocks whose document IDs are encoded
+         * again from a new base while their frequencies are copied.
+         */
+        [[nodiscard]] auto encoded_blocks() const noexcept -> std::size_t { return m_encoded; }
+
+      private:
+        void flush_pending();
+        void encode_block(std::uint32_t const* docs, std::uint32_t const* freqs, std::size_t size);
+        void end_block(std::uint32_t max, std::size_t size, bool constant_freqs);
+
+        BlockCodec const* m_codec;
+        std::uint64_t m_size = 0;
+        std::int64_t m_last_doc = -1;
+        std::vector<std::uint32_t> m_block_maxs{};
+        std::vector<std::uint32_t> m_block_endpoints{};
+        /** Number of postings preceding each block. */
+        std::vector<std::uint32_t> m_block_starts{};
+        std::vector<bool> m_constant_freqs{};
+        std::vector<std::uint8_t> m_blocks_data{};
+        /** Postings of partial blocks: absolute document IDs, and frequencies minus one. */
+        std::vector<std::uint32_t> m_pending_docs{};
+        std::vector<std::uint32_t> m_pending_freqs{};
+        std::size_t m_copied = 0;
+        std::size_t m_encoded = 0;
+    };
+
     class PostingAccumulator {
       protected:
         BlockCodecPtr m_block_codec;
@@ -370,6 +622,9 @@ namespace index::block {
             std::size_t n, std::uint32_t const* docs, std::uint32_t const* freqs
         ) = 0;
 
+        /** Appends a posting list encoded with `write_posting_list` as the next term. */
+        virtual void append_posting_list(std::vector<std::uint8_t> const& encoded) = 0;
+
         virtual void finish() = 0;
 
         void write(
@@ -394,6 +649,8 @@ namespace index::block {
             std::uint64_t n, std::uint32_t const* docs, std::uint32_t const* freqs
         ) override;
 
+        void append_posting_list(std::vector<std::uint8_t> const& encoded) override;
+
         void finish() override;
     };
 
@@ -414,6 +671,8 @@ namespace index::block {
             std::uint64_t n, std::uint32_t const* docs, std::uint32_t const* freqs
         ) override;
 
+        void append_posting_list(std::vector<std::uint8_t> const& encoded) override;
+
         void finish() override;
     };
 
@@ -425,6 +684,7 @@ class BlockIndexBuilder {
     BlockCodecPtr m_block_codec;
     ScorerParams m_scorer_params;
     std::optional<QuantizingScorer> m_quantizing_scorer;
+    std::optional<std::vector<std::uint64_t>> m_term_accesses;
     bool m_check = false;
     bool m_in_memory = false;
 
@@ -436,6 +696,12 @@ class BlockIndexBuilder {
     auto check(bool check) -> BlockIndexBuilder&;
     auto in_memory(bool in_mem) -> BlockIndexBuilder&;
 
+    /**
+     * Sets the number of accesses to each term, e.g., in a query log. This is only supported by
+     * `block_mixed`: the time weight of each list is multiplied by the accesses to its term.
+     */
+    auto term_accesses(std::vector<std::uint64_t> accesses) -> BlockIndexBuilder&;
+
     template <typename WandData>
     auto quantize(Size bits, WandData const& wdata) -> BlockIndexBuilder& {
         LinearQuantizer quantizer(wdata.index_max_term_weight(), bits.as_int());
@@ -467,6 +733,45 @@ class BlockIndexBuilder {
         }
     }
 
+    /**
+     * Encodes a posting list with the given codec, quantizing its scores if requested. Unlike
+     * `accumulate_posting_list`, this does not modify any state, and lists can be encoded
+     * concurrently.
+     *
+     * \throws std::invalid_argument   Thrown if the list is empty.
+     */
+    template <typename Documents, typename Frequencies>
+    [[nodiscard]] auto encode_posting_list(
+        BlockCodec const* codec,
+        Documents const& documents,
+        Frequencies const& frequencies,
+        std::uint32_t term_id
+    ) const -> std::vector<std::uint8_t> {
+        std::size_t size = documents.size();
+        if (size == 0) {
+            throw std::invalid_argument("List must be nonempty");
+        }
+        std::vector<std::uint8_t> encoded;
+        if (m_quantizing_scorer.has_value()) {
+            auto term_scorer = m_quantizing_scorer->term_scorer(term_id);
+            std::vector<std::uint32_t> quants;
+            quants.reserve(size);
+            for (size_t pos = 0; pos < size; ++pos) {
+                std::uint32_t doc = *(documents.begin() + pos);
+                std::uint32_t freq = *(frequencies.begin() + pos);
+                quants.push_back(term_scorer(doc, freq));
+            }
+            index::block::write_posting_list(
+                codec, encoded, size, documents.begin(), quants.data()
+            );
+        } else {
+            index::block::write_posting_list(
+                codec, encoded, size, documents.begin(), frequencies.begin()
+            );
+        }
+        return encoded;
+    }
+
     void build(binary_freq_collection const& input, std::string const& index_path);
 };
 
@@ -5,6 +5,8 @@
 #include <string_view>
 #include <vector>
 
+#include "codec/prefix_sum.hpp"
+
 namespace pisa {
 
 /**
@@ -30,6 +32,27 @@ class BlockCodec {
         std::uint8_t const* in, std::uint32_t* out, std::uint32_t sum_of_values, std::size_t n
     ) const = 0;
 
+    /**
+     * Decodes a block of `n` document ID gaps and writes the absolute document IDs to
+     * pre-allocated memory.
+     *
+     * The gaps are expected to be encoded as in block posting lists: the first value is relative
+     * to `base`, and the following ones are the differences between consecutive IDs minus one.
+     * The default implementation calls `decode` and computes the prefix sum in a separate pass;
+     * codecs can override it to compute the prefix sum while decoding.
+     */
+    virtual std::uint8_t const* decode_docids(
+        std::uint8_t const* in,
+        std::uint32_t* out,
+        std::uint32_t sum_of_values,
+        std::size_t n,
+        std::uint32_t base
+    ) const {
+        auto const* next = decode(in, out, sum_of_values, n);
+        docid_prefix_sum(out, n, base);
+        return next;
+    }
+
     /**
      * Returns the block size of the encoding.
      *
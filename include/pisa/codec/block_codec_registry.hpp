@@ -45,6 +45,6 @@ struct BlockCodecRegistry {
 /**
  * Lists the names of all known block codecs.
  */
-[[nodiscard]] constexpr auto get_block_codec_names() -> std::span<std::string_view const>;
+[[nodiscard]] auto get_block_codec_names() -> std::span<std::string_view const>;
 
 }  // namespace pisa
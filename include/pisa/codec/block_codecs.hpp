@@ -113,11 +113,13 @@ class TightVariableByte {
 
 struct interpolative_block {
     static constexpr std::uint64_t block_size = 128;
+    /** Longest list that can be encoded, for codecs with larger blocks falling back to this one. */
+    static constexpr std::uint64_t max_block_size = 512;
 
     static void
     encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out) {
-        assert(n <= block_size);
-        thread_local std::array<std::uint32_t, block_size> inbuf{};
+        assert(n <= max_block_size);
+        thread_local std::array<std::uint32_t, max_block_size> inbuf{};
         thread_local std::vector<uint32_t> outbuf;  // TODO: Can we use array? How long does it need
                                                     // to be?
         inbuf[0] = *in;
@@ -138,7 +140,7 @@ struct interpolative_block {
 
     static uint8_t const* PISA_NOINLINE
     decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) {
-        assert(n <= block_size);
+        assert(n <= max_block_size);
         if (sum_of_values == std::numeric_limits<std::uint32_t>::max()) {
             in = TightVariableByte::decode(in, &sum_of_values, 1);
         }
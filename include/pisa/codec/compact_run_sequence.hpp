@@ -0,0 +1,231 @@
+#pragma once
+
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "bit_vector_builder.hpp"
+#include "codec/compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/**
+ * Run-length encoding of a strictly increasing sequence.
+ *
+ * The sequence is split into maximal runs of consecutive values. The number of runs is stored in
+ * `ceil_log2(n + 1)` bits, followed by two Elias-Fano sequences: the first value of each run, and
+ * the position of the first element of each run. Unlike the other encodings, the size depends on
+ * the values and not only on `universe` and `n`, so `bitsize` takes the number of runs, which can
+ * be computed with `count_runs`.
+ */
+struct compact_run_sequence {
+    struct offsets {
+        offsets() = default;
+
+        offsets(
+            uint64_t base_offset,
+            uint64_t universe,
+            uint64_t n,
+            uint64_t runs,
+            global_parameters const& params
+        )
+            : universe(universe),
+              n(n),
+              runs(runs),
+              starts_offset(base_offset + runs_bits(n)),
+              begins_offset(starts_offset + compact_elias_fano::bitsize(params, universe, runs)),
+              end(begins_offset + compact_elias_fano::bitsize(params, n, runs)) {}
+
+        uint64_t universe{0};
+        uint64_t n{0};
+        uint64_t runs{0};
+
+        uint64_t starts_offset{0};
+        uint64_t begins_offset{0};
+        uint64_t end{0};
+    };
+
+    static uint64_t runs_bits(uint64_t n) { return ceil_log2(n + 1); }
+
+    template <typename Iterator>
+    static uint64_t count_runs(Iterator begin, uint64_t n) {
+        uint64_t runs = 0;
+        uint64_t last = 0;
+        for (uint64_t i = 0; i < n; ++i, ++begin) {
+            uint64_t v = *begin;
+            if (i == 0 || v != last + 1) {
+                runs += 1;
+            }
+            last = v;
+        }
+        return runs;
+    }
+
+    static PISA_FLATTEN_FUNC uint64_t
+    bitsize(global_parameters const& params, uint64_t universe, uint64_t n, uint64_t runs) {
+        return offsets(0, universe, n, runs, params).end;
+    }
+
+    template <typename Iterator>
+    static void write(
+        bit_vector_builder& bvb,
+        Iterator begin,
+        uint64_t universe,
+        uint64_t n,
+        global_parameters const& params
+    ) {
+        std::vector<uint64_t> starts;
+        std::vector<uint64_t> begins;
+        uint64_t last = 0;
+        for (uint64_t i = 0; i < n; ++i, ++begin) {
+            uint64_t v = *begin;
+            if (i && v <= last) {
+                throw std::runtime_error("Sequence is not strictly increasing");
+            }
+            assert(v < universe);
+            if (i == 0 || v != last + 1) {
+                starts.push_back(v);
+                begins.push_back(i);
+            }
+            last = v;
+        }
+
+        bvb.append_bits(starts.size(), runs_bits(n));
+        compact_elias_fano::write(bvb, starts.begin(), universe, starts.size(), params);
+        compact_elias_fano::write(bvb, begins.begin(), n, begins.size(), params);
+    }
+
+    class enumerator {
+      public:
+        using value_type = std::pair<uint64_t, uint64_t>;  // (position, value)
+
+        enumerator() = default;
+
+        enumerator(
+            bit_vector const& bv,
+            uint64_t offset,
+            uint64_t universe,
+            uint64_t n,
+            global_parameters const& params
+        )
+            : m_of(offset,
+                   universe,
+                   n,
+                   bv.get_word56(offset) & ((uint64_t(1) << runs_bits(n)) - 1),
+                   params),
+              m_starts(bv, m_of.starts_offset, universe, m_of.runs, params),
+              m_begins(bv, m_of.begins_offset, n, m_of.runs, params),
+              m_run(m_of.runs),
+              m_run_begin(n),
+              m_run_end(n),
+              m_position(n),
+              m_value(universe) {}
+
+        value_type move(uint64_t position) {
+            assert(position <= size());
+            m_position = position;
+            if (position >= m_run_begin && position < m_run_end) [[likely]] {
+                m_value = m_run_value + (position - m_run_begin);
+                return value();
+            }
+            if (position == size()) [[unlikely]] {
+                m_value = m_of.universe;
+                return value();
+            }
+            // The first element of the run is the last one not greater than `position`.
+            load_run(m_begins.next_geq(position + 1).first - 1);
+            m_value = m_run_value + (position - m_run_begin);
+            return value();
+        }
+
+        value_type next_geq(uint64_t lower_bound) {
+            if (lower_bound >= m_run_value && lower_bound < run_end_value()) [[likely]] {
+                m_position = m_run_begin + (lower_bound - m_run_value);
+                m_value = lower_bound;
+                return value();
+            }
+            return slow_next_geq(lower_bound);
+        }
+
+        value_type next() {
+            m_position += 1;
+            assert(m_position <= size());
+            if (m_position < m_run_end) [[likely]] {
+                m_value += 1;
+            } else if (m_position < size()) {
+                load_run(m_run + 1);
+                m_value = m_run_value;
+            } else {
+                m_value = m_of.universe;
+            }
+            return value();
+        }
+
+        uint64_t size() const { return m_of.n; }
+
+        uint64_t prev_value() const {
+            if (m_position == 0) {
+                return 0;
+            }
+            uint64_t prev_pos = m_position - 1;
+            if (prev_pos >= m_run_begin && prev_pos < m_run_end) {
+                return m_run_value + (prev_pos - m_run_begin);
+            }
+            auto begins = m_begins;
+            auto starts = m_starts;
+            uint64_t run = begins.next_geq(prev_pos + 1).first - 1;
+            return starts.move(run).second + (prev_pos - begins.move(run).second);
+        }
+
+      private:
+        value_type PISA_NOINLINE slow_next_geq(uint64_t lower_bound) {
+            if (lower_bound >= m_of.universe) [[unlikely]] {
+                return move(size());
+            }
+            uint64_t run = m_starts.next_geq(lower_bound + 1).first;
+            if (run > 0) {
+                load_run(run - 1);
+                if (lower_bound < run_end_value()) {
+                    m_position = m_run_begin + (lower_bound - m_run_value);
+                    m_value = lower_bound;
+                    return value();
+                }
+            }
+            // `lower_bound` falls in the gap before run `run`.
+            if (run == m_of.runs) {
+                return move(size());
+            }
+            load_run(run);
+            m_position = m_run_begin;
+            m_value = m_run_value;
+            return value();
+        }
+
+        void load_run(uint64_t run) {
+            assert(run < m_of.runs);
+            m_run = run;
+            m_run_value = m_starts.move(run).second;
+            m_run_begin = m_begins.move(run).second;
+            m_run_end = run + 1 < m_of.runs ? m_begins.next().second : size();
+        }
+
+        uint64_t run_end_value() const { return m_run_value + (m_run_end - m_run_begin); }
+
+        inline value_type value() const { return value_type(m_position, m_value); }
+
+        offsets m_of;
+        compact_elias_fano::enumerator m_starts;
+        compact_elias_fano::enumerator m_begins;
+
+        uint64_t m_run{0};
+        uint64_t m_run_value{0};
+        uint64_t m_run_begin{0};
+        uint64_t m_run_end{0};
+
+        uint64_t m_position{0};
+        uint64_t m_value{0};
+    };
+};
+
+}  // namespace pisa
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 
 #include "util/broadword.hpp"
+#include "util/compiler_attribute.hpp"
 
 namespace pisa {
 
@@ -67,6 +72,15 @@ class bit_writer {
     uint32_t* m_cur_word;
 };
 
+/**
+ * Reader of the bits written by `bit_writer`.
+ *
+ * Bits are buffered in a 64-bit word, refilled with a single unaligned load of 8 bytes. Encoded
+ * blocks carry no length and are not padded, so such a load may read past the end of the encoded
+ * data; it is only done if the 8 bytes are in the same memory page as the next byte to read, which
+ * is always valid, and otherwise the bytes are loaded one at a time. The bits read past the end
+ * are never consumed.
+ */
 class bit_reader {
   public:
     explicit bit_reader(std::uint8_t const* in) : m_in(in), m_avail(0), m_buf(0), m_pos(0) {}
@@ -77,38 +91,97 @@ class bit_reader {
         if (len == 0U) {
             return 0;
         }
-
-        while (m_avail < len) {
-            m_buf |= static_cast<std::uint64_t>(*m_in++) << m_avail;
-            m_avail += 8;
-        }
-
+        fill(len);
         uint32_t val = m_buf & ((uint64_t(1) << len) - 1);
-        m_buf >>= len;
-        m_avail -= len;
-        m_pos += len;
-
+        consume(len);
         return val;
     }
 
-    uint32_t read_int(uint32_t u) {
+    /**
+     * Reads a value in `[0, u)` written in minimal binary coding with `bit_writer::write_int`.
+     *
+     * Whether the code is short or long is close to random, so both are computed from the same
+     * buffered bits, and the right one is selected without branching.
+     */
+    PISA_ALWAYSINLINE uint32_t read_int(uint32_t u) {
         assert(u > 0);
         auto b = broadword::msb(u);
         uint64_t m = (uint64_t(1) << (b + 1)) - u;
 
-        uint32_t val = read(b);
-        if (val >= m) {
-            val = (val << 1) + read(1) - m;
+        // The next byte can only be loaded if it is needed by the short code as well.
+        if (m_avail <= b && (m_avail == b || !refill())) [[unlikely]] {
+            return read_int_slow(b, m);
         }
+        uint64_t val = m_buf & ((uint64_t(1) << b) - 1);
+        uint64_t is_long = val >= m ? 1 : 0;
+        uint64_t long_val = (val << 1) + ((m_buf >> b) & 1U) - m;
+        val = is_long != 0U ? long_val : val;
+        consume(b + is_long);
 
         assert(val < u);
         return val;
     }
 
+    /**
+     * Decodes `n` non-decreasing values in `[low, high]` written with
+     * `bit_writer::write_interpolative`.
+     *
+     * The recursion of the encoder is replaced by a loop, visiting the ranges in the same order:
+     * the left half of each range is decoded right away, and the right half is pushed to an
+     * explicit stack. Ranges of up to 3 values are decoded directly, and a range with
+     * `low == high` is encoded with no bits at all, so it is filled without being split down to
+     * single values; this is the common case of runs of equal values, such as frequencies of 1.
+     */
     void read_interpolative(uint32_t* out, size_t n, uint32_t low, uint32_t high) {
         assert(low <= high);
         assert(n > 0);
 
+        struct range {
+            uint32_t* out;
+            size_t n;
+            uint32_t low;
+            uint32_t high;
+        };
+        // There is at most one pending right half for each level of the implicit tree.
+        std::array<range, 64> stack;
+        size_t top = 0;
+        while (true) {
+            if (low == high) {
+                std::fill_n(out, n, low);
+            } else if (n <= 3) {
+                uint32_t val = low + read_int(high - low + 1);
+                out[n / 2] = val;
+                if (n >= 2) {
+                    out[0] = low + read_int(val - low + 1);
+                }
+                if (n == 3) {
+                    out[2] = val + read_int(high - val + 1);
+                }
+            } else {
+                size_t h = n / 2;
+                uint32_t val = low + read_int(high - low + 1);
+                out[h] = val;
+                stack[top++] = range{out + h + 1, n - h - 1, val, high};
+                n = h;
+                high = val;
+                continue;
+            }
+            if (top == 0) {
+                break;
+            }
+            --top;
+            out = stack[top].out;
+            n = stack[top].n;
+            low = stack[top].low;
+            high = stack[top].high;
+        }
+    }
+
+    /** Recursive version of `read_interpolative`, kept as a reference for tests and benchmarks. */
+    void read_interpolative_recursive(uint32_t* out, size_t n, uint32_t low, uint32_t high) {
+        assert(low <= high);
+        assert(n > 0);
+
         size_t h = n / 2;
         uint32_t val = low + read_int(high - low + 1);
         out[h] = val;
@@ -118,14 +191,65 @@ class bit_reader {
         }
         // the two ifs are a bit ugly but it is faster than postponing them
         if (h != 0U) {
-            read_interpolative(out, h, low, val);
+            read_interpolative_recursive(out, h, low, val);
         }
         if ((n - h - 1) != 0U) {
-            read_interpolative(out + h + 1, n - h - 1, val, high);
+            read_interpolative_recursive(out + h + 1, n - h - 1, val, high);
         }
     }
 
   private:
+    static constexpr std::uintptr_t page_size = 4096;
+
+    /** Makes sure that at least `len` bits are buffered, with `len <= 32`. */
+    PISA_ALWAYSINLINE void fill(uint32_t len) {
+        if (m_avail >= len || refill()) [[likely]] {
+            return;
+        }
+        while (m_avail < len) {
+            m_buf |= static_cast<std::uint64_t>(*m_in++) << m_avail;
+            m_avail += 8;
+        }
+    }
+
+    /**
+     * Fills the buffer to at least 56 bits with a single load, unless the load could cross the end
+     * of the memory page, in which case nothing is done and `false` is returned. The next byte must
+     * be part of the encoded data.
+     */
+    PISA_ALWAYSINLINE bool refill() {
+        if ((reinterpret_cast<std::uintptr_t>(m_in) % page_size) > page_size - 8) [[unlikely]] {
+            return false;
+        }
+        // Only whole bytes are consumed from the word.
+        m_buf |= load_word(m_in) << m_avail;
+        m_in += (63 - m_avail) / 8;
+        m_avail |= 56;
+        return true;
+    }
+
+    /** Reads a minimal binary code, loading only the bytes it needs. */
+    PISA_NOINLINE uint32_t read_int_slow(uint32_t b, uint64_t m) {
+        uint32_t val = read(b);
+        if (val >= m) {
+            val = (val << 1) + read(1) - m;
+        }
+        return val;
+    }
+
+    /** Loads 8 bytes, of which only the first one is known to be part of the encoded data. */
+    PISA_NO_SANITIZE_ADDRESS static std::uint64_t load_word(std::uint8_t const* in) {
+        std::uint64_t word;
+        std::memcpy(&word, in, sizeof(word));
+        return word;
+    }
+
+    PISA_ALWAYSINLINE void consume(uint32_t len) {
+        m_buf >>= len;
+        m_avail -= len;
+        m_pos += len;
+    }
+
     std::uint8_t const* m_in;
     uint32_t m_avail;
     uint64_t m_buf;
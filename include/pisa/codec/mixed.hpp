@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "codec/block_codec.hpp"
+#include "codec/interpolative.hpp"
+#include "codec/optpfor.hpp"
+#include "codec/simdbp.hpp"
+#include "codec/streamvbyte.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/**
+ * Default decoding time of a codec in nanoseconds per integer.
+ *
+ * These are only meant to rank the codecs when trading space for decoding speed, and follow the
+ * measurements of Mallia et al., "An Experimental Study of Index Compression and DAAT Query
+ * Processing Methods" (ECIR 2019). Since they depend on the machine, `BasicMixedBlockCodec` takes
+ * the times to use as a parameter.
+ */
+template <typename Codec>
+inline constexpr double decode_ns_per_int = 1.0;
+
+template <>
+inline constexpr double decode_ns_per_int<SimdBpBlockCodec> = 0.25;
+template <>
+inline constexpr double decode_ns_per_int<StreamVByteBlockCodec> = 0.3;
+template <>
+inline constexpr double decode_ns_per_int<OptPForBlockCodec> = 0.7;
+template <>
+inline constexpr double decode_ns_per_int<InterpolativeBlockCodec> = 3.5;
+
+/**
+ * Codec choosing the best of `Candidates` for each block.
+ *
+ * Each block is encoded with all the candidates, and the one minimizing
+ * `bits + time_weight * decoding_ns` is written, preceded by a byte with its index. The time
+ * weight is the number of bits one is willing to spend to save one nanosecond of decoding: with
+ * 0, the smallest encoding is always chosen, and the larger it is, the more the faster codecs are
+ * preferred. The decoding time of a block is its size times the decoding time per integer of the
+ * candidate, which defaults to `decode_ns_per_int`. Decoding reads the tag and calls the chosen
+ * codec directly, without virtual calls.
+ *
+ * All candidates must have the same block size.
+ */
+template <typename... Candidates>
+class BasicMixedBlockCodec: public BlockCodec {
+    static_assert(sizeof...(Candidates) > 0 && sizeof...(Candidates) <= 256);
+
+  public:
+    constexpr static std::string_view name = "block_mixed";
+    constexpr static double default_time_weight = 1.0;
+    constexpr static std::array<std::string_view, sizeof...(Candidates)> candidate_names{
+        Candidates::name...
+    };
+    constexpr static std::array<double, sizeof...(Candidates)> default_decode_ns{
+        decode_ns_per_int<Candidates>...
+    };
+
+    /**
+     * Constructs a codec with the given time weight and decoding times, in nanoseconds per
+     * integer, of the candidates in order.
+     *
+     * \throws std::invalid_argument   Thrown if a decoding time is negative.
+     */
+    explicit BasicMixedBlockCodec(
+        double time_weight = default_time_weight,
+        std::array<double, sizeof...(Candidates)> decode_ns = default_decode_ns
+    )
+        : m_time_weight(time_weight), m_decode_ns(decode_ns) {
+        if (std::any_of(m_decode_ns.begin(), m_decode_ns.end(), [](double t) { return t < 0; })) {
+            throw std::invalid_argument("decoding times must be non-negative");
+        }
+        auto block_size = std::get<0>(m_candidates).block_size();
+        std::apply(
+            [&](auto const&... codec) {
+                if (((codec.block_size() != block_size) || ...)) {
+                    throw std::invalid_argument("mixed codecs must have the same block size");
+                }
+            },
+            m_candidates
+        );
+    }
+
+    virtual ~BasicMixedBlockCodec() = default;
+
+    void encode(
+        uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out
+    ) const override {
+        encode(in, sum_of_values, n, out, m_time_weight);
+    }
+
+    /**
+     * Encodes a block with the given time weight instead of the one of the codec, e.g., to favor
+     * fast codecs on the most accessed lists.
+     */
+    void encode(
+        uint32_t const* in,
+        uint32_t sum_of_values,
+        size_t n,
+        std::vector<uint8_t>& out,
+        double time_weight
+    ) const {
+        thread_local std::array<std::vector<std::uint8_t>, sizeof...(Candidates)> buffers;
+        std::size_t best = 0;
+        double best_cost = std::numeric_limits<double>::max();
+        for_each_candidate([&](std::size_t idx, auto const& codec) {
+            buffers[idx].clear();
+            codec.encode(in, sum_of_values, n, buffers[idx]);
+            double decoding_ns = m_decode_ns[idx] * n;
+            double cost = 8.0 * buffers[idx].size() + time_weight * decoding_ns;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = idx;
+            }
+        });
+        out.push_back(static_cast<std::uint8_t>(best));
+        out.insert(out.end(), buffers[best].begin(), buffers[best].end());
+        m_blocks[best].fetch_add(1, std::memory_order_relaxed);
+        m_bytes[best].fetch_add(buffers[best].size() + 1, std::memory_order_relaxed);
+    }
+
+    uint8_t const*
+    decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) const override {
+        return visit_candidate(*in, [&](auto const& codec) {
+            return codec.decode(in + 1, out, sum_of_values, n);
+        });
+    }
+
+    uint8_t const* decode_docids(
+        uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n, uint32_t base
+    ) const override {
+        return visit_candidate(*in, [&](auto const& codec) {
+            return codec.decode_docids(in + 1, out, sum_of_values, n, base);
+        });
+    }
+
+    auto block_size() const noexcept -> std::size_t override {
+        return std::get<0>(m_candidates).block_size();
+    }
+    auto get_name() const noexcept -> std::string_view override { return name; }
+
+    [[nodiscard]] auto time_weight() const noexcept -> double { return m_time_weight; }
+
+    /** Returns the decoding time of each candidate, in nanoseconds per integer. */
+    [[nodiscard]] auto decode_ns() const noexcept
+        -> std::array<double, sizeof...(Candidates)> const& {
+        return m_decode_ns;
+    }
+
+    /** Returns the number of blocks encoded so far with each candidate. */
+    [[nodiscard]] auto block_counts() const -> std::array<std::uint64_t, sizeof...(Candidates)> {
+        std::array<std::uint64_t, sizeof...(Candidates)> counts{};
+        for (std::size_t idx = 0; idx < counts.size(); ++idx) {
+            counts[idx] = m_blocks[idx].load(std::memory_order_relaxed);
+        }
+        return counts;
+    }
+
+    /** Returns the number of bytes, including tags, encoded so far with each candidate. */
+    [[nodiscard]] auto byte_counts() const -> std::array<std::uint64_t, sizeof...(Candidates)> {
+        std::array<std::uint64_t, sizeof...(Candidates)> counts{};
+        for (std::size_t idx = 0; idx < counts.size(); ++idx) {
+            counts[idx] = m_bytes[idx].load(std::memory_order_relaxed);
+        }
+        return counts;
+    }
+
+  private:
+    template <typename Fn>
+    void for_each_candidate(Fn&& fn) const {
+        [&]<std::size_t... idx>(std::index_sequence<idx...>) {
+            (fn(idx, std::get<idx>(m_candidates)), ...);
+        }(std::index_sequence_for<Candidates...>{});
+    }
+
+    template <typename Fn>
+    PISA_ALWAYSINLINE auto visit_candidate(std::uint8_t tag, Fn&& fn) const -> std::uint8_t const* {
+        std::uint8_t const* next = nullptr;
+        [&]<std::size_t... idx>(std::index_sequence<idx...>) {
+            ((tag == idx ? (next = fn(std::get<idx>(m_candidates)), true) : false) || ...);
+        }(std::index_sequence_for<Candidates...>{});
+        return next;
+    }
+
+    double m_time_weight;
+    std::array<double, sizeof...(Candidates)> m_decode_ns;
+    std::tuple<Candidates...> m_candidates;
+    mutable std::array<std::atomic<std::uint64_t>, sizeof...(Candidates)> m_blocks{};
+    mutable std::array<std::atomic<std::uint64_t>, sizeof...(Candidates)> m_bytes{};
+};
+
+using MixedBlockCodec = BasicMixedBlockCodec<
+    SimdBpBlockCodec,
+    StreamVByteBlockCodec,
+    OptPForBlockCodec,
+    InterpolativeBlockCodec>;
+
+}  // namespace pisa
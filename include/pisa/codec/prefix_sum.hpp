@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <immintrin.h>
+
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/**
+ * Computes in place the document IDs of four consecutive postings from their d-gaps.
+ *
+ * Gaps are encoded as in block posting lists, i.e., as the difference between consecutive IDs
+ * minus one. `prev` holds the document ID preceding the four postings broadcast to all lanes,
+ * and the last of the computed IDs is returned in the same form, to be passed to the next call.
+ */
+PISA_ALWAYSINLINE __m128i docid_prefix_sum4(std::uint32_t* values, __m128i prev) {
+    auto* ptr = reinterpret_cast<__m128i*>(values);
+    __m128i sums = _mm_add_epi32(_mm_loadu_si128(ptr), _mm_set1_epi32(1));
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+    sums = _mm_add_epi32(sums, prev);
+    _mm_storeu_si128(ptr, sums);
+    return _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+/**
+ * Transforms in place `n` d-gaps of a block posting list into absolute document IDs, such that
+ * `values[0] = base + values[0]` and `values[i] = values[i - 1] + values[i] + 1`.
+ */
+inline void docid_prefix_sum(std::uint32_t* values, std::size_t n, std::uint32_t base) {
+    // Unsigned overflow makes `base - 1` work for `base == 0`: the first gap gets `+ 1` as well.
+    __m128i prev = _mm_set1_epi32(static_cast<int>(base - 1));
+    std::size_t pos = 0;
+    for (; pos + 4 <= n; pos += 4) {
+        prev = docid_prefix_sum4(values + pos, prev);
+    }
+    std::uint32_t docid = pos > 0 ? values[pos - 1] : base - 1;
+    for (; pos < n; ++pos) {
+        docid += values[pos] + 1;
+        values[pos] = docid;
+    }
+}
+
+/**
+ * Adds its position to each of the `n` values.
+ *
+ * Codecs providing a plain delta decoder compute `values[i] = base + sum of gaps up to i`; this
+ * completes them to the document IDs of a block posting list, whose gaps are stored minus one.
+ */
+inline void add_positions(std::uint32_t* values, std::size_t n) {
+    __m128i positions = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i const step = _mm_set1_epi32(4);
+    std::size_t pos = 0;
+    for (; pos + 4 <= n; pos += 4) {
+        auto* ptr = reinterpret_cast<__m128i*>(values + pos);
+        _mm_storeu_si128(ptr, _mm_add_epi32(_mm_loadu_si128(ptr), positions));
+        positions = _mm_add_epi32(positions, step);
+    }
+    for (; pos < n; ++pos) {
+        values[pos] += static_cast<std::uint32_t>(pos);
+    }
+}
+
+}  // namespace pisa
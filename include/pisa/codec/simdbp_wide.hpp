@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "codec/block_codec.hpp"
+#include "util/cpu_features.hpp"
+
+namespace pisa {
+
+namespace simdbp_wide {
+
+    /**
+     * Unpacks a block of `32 * lanes` integers, packed with the bit width the function was
+     * selected for.
+     */
+    using UnpackFn = void (*)(std::uint32_t const* in, std::uint32_t* out);
+
+    /** Returns the SSE4 kernel unpacking integers of `bits` bits interleaved in `lanes` lanes. */
+    template <std::size_t lanes>
+    [[nodiscard]] auto sse4_unpacker(std::uint32_t bits) -> UnpackFn;
+
+    /** Returns the AVX2 kernel unpacking integers of `bits` bits interleaved in `lanes` lanes. */
+    template <std::size_t lanes>
+    [[nodiscard]] auto avx2_unpacker(std::uint32_t bits) -> UnpackFn;
+
+    /** Returns the AVX-512 kernel unpacking integers of `bits` bits interleaved in 16 lanes. */
+    template <std::size_t lanes>
+    [[nodiscard]] auto avx512_unpacker(std::uint32_t bits) -> UnpackFn;
+
+    /**
+     * Returns the kernel of the given SIMD level unpacking integers of `bits` bits interleaved in
+     * `lanes` lanes. Throws `std::invalid_argument` if the registers of that level are wider than
+     * `lanes` integers.
+     */
+    template <std::size_t lanes>
+    [[nodiscard]] auto select_unpacker(SimdLevel level, std::uint32_t bits) -> UnpackFn;
+
+    /**
+     * Packs `32 * lanes` integers, each fitting in `bits` bits, into `bits * lanes` words of `out`,
+     * in the layout expected by the unpacking kernels.
+     */
+    template <std::size_t lanes>
+    void pack(std::uint32_t const* in, std::uint32_t bits, std::uint32_t* out);
+
+}  // namespace simdbp_wide
+
+/**
+ * SIMD-BP coding with blocks sized for registers wider than 128 bits.
+ *
+ * As in SIMD-BP128, each block is packed with the bit width of its largest value, but the values
+ * are interleaved in `lanes` 32-bit lanes instead of 4: 8 lanes (256 integers per block) fill an
+ * AVX2 register, and 16 lanes (512 integers) fill an AVX-512 register.
+ *
+ * The encoded format does not depend on the CPU. The decoding kernels for all SIMD levels are
+ * compiled into the library, and the codec uses the one for the highest level supported by the
+ * CPU at runtime, unless a level is passed to the constructor explicitly.
+ */
+template <std::size_t lanes>
+class SimdBpWideBlockCodec: public BlockCodec {
+    static_assert(lanes == 8 || lanes == 16, "only AVX2 and AVX-512 widths are supported");
+    static constexpr std::uint64_t m_block_size = 32 * lanes;
+
+  public:
+    constexpr static std::string_view name = lanes == 8 ? "block_simdbp256" : "block_simdbp512";
+
+    /** The highest level for which a kernel of this width is worth using. */
+    constexpr static SimdLevel max_simd_level = lanes == 8 ? SimdLevel::Avx2 : SimdLevel::Avx512;
+
+    SimdBpWideBlockCodec();
+
+    /**
+     * Constructs a codec decoding with the kernels of the given SIMD level, which must be
+     * supported by the CPU. Levels above `max_simd_level` are capped.
+     */
+    explicit SimdBpWideBlockCodec(SimdLevel level);
+
+    virtual ~SimdBpWideBlockCodec() = default;
+
+    void encode(
+        uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out
+    ) const override;
+    uint8_t const*
+    decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) const override;
+    auto block_size() const noexcept -> std::size_t override { return m_block_size; }
+    auto get_name() const noexcept -> std::string_view override { return name; }
+
+    /** Returns the SIMD level of the kernels used for decoding. */
+    [[nodiscard]] auto simd_level() const noexcept -> SimdLevel { return m_simd_level; }
+
+  private:
+    SimdLevel m_simd_level;
+    std::array<simdbp_wide::UnpackFn, 33> m_unpackers{};
+};
+
+using SimdBp256BlockCodec = SimdBpWideBlockCodec<8>;
+using SimdBp512BlockCodec = SimdBpWideBlockCodec<16>;
+
+extern template class SimdBpWideBlockCodec<8>;
+extern template class SimdBpWideBlockCodec<16>;
+
+}  // namespace pisa
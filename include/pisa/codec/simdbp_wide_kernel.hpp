@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "util/compiler_attribute.hpp"
+
+/**
+ * Generic bit-unpacking kernel of `SimdBpWideBlockCodec`.
+ *
+ * This header is included only by the translation units compiled for a specific instruction set
+ * (`src/codec/simdbp_wide_*.cpp`). Each of them instantiates the kernel with its own `Ops` type,
+ * defined in an anonymous namespace. The kernel itself lives in an anonymous namespace too, and
+ * this header does not include `codec/simdbp_wide.hpp` or any header defining non-template inline
+ * functions, so that no function compiled for a wider instruction set can be picked by the linker
+ * in place of the baseline definition used by the rest of the library.
+ */
+namespace pisa::simdbp_wide {
+
+/** Same as the declaration in `codec/simdbp_wide.hpp`. */
+using UnpackFn = void (*)(std::uint32_t const* in, std::uint32_t* out);
+
+namespace {
+
+    /**
+     * Unpacks the `row`-th value of each lane of a group of `Ops::width` lanes.
+     *
+     * The values of a lane are packed one after another into the consecutive 32-bit words of the
+     * lane, and the `i`-th word of lane `j` is stored at position `i * lanes + j`.
+     */
+    template <typename Ops, std::size_t lanes, std::uint32_t bits, std::uint32_t row>
+    PISA_ALWAYSINLINE void unpack_row(std::uint32_t const* in, std::uint32_t* out) {
+        constexpr std::uint32_t offset = row * bits;
+        constexpr std::uint32_t word = offset / 32;
+        constexpr std::uint32_t shift = offset % 32;
+        typename Ops::vector value;
+        if constexpr (bits == 0) {
+            value = Ops::zero();
+        } else {
+            value = Ops::template shift_right<shift>(Ops::load(in + word * lanes));
+            if constexpr (shift + bits > 32) {
+                auto next = Ops::load(in + (word + 1) * lanes);
+                auto high = Ops::template shift_left<32 - shift>(next);
+                value = Ops::bit_or(value, high);
+            }
+            if constexpr (bits < 32) {
+                value = Ops::bit_and(value, Ops::set1((std::uint32_t{1} << bits) - 1));
+            }
+        }
+        Ops::store(out + row * lanes, value);
+    }
+
+    template <typename Ops, std::size_t lanes, std::uint32_t bits, std::uint32_t... rows>
+    PISA_ALWAYSINLINE void unpack_rows(
+        std::uint32_t const* in, std::uint32_t* out, std::integer_sequence<std::uint32_t, rows...>
+    ) {
+        (unpack_row<Ops, lanes, bits, rows>(in, out), ...);
+    }
+
+    template <typename Ops, std::size_t lanes, std::uint32_t bits>
+    void unpack(std::uint32_t const* in, std::uint32_t* out) {
+        static_assert(lanes % Ops::width == 0);
+        for (std::size_t group = 0; group < lanes; group += Ops::width) {
+            unpack_rows<Ops, lanes, bits>(
+                in + group, out + group, std::make_integer_sequence<std::uint32_t, 32>{}
+            );
+        }
+    }
+
+    template <typename Ops, std::size_t lanes, std::uint32_t... widths>
+    [[nodiscard]] auto select_kernel(
+        std::uint32_t bits, std::integer_sequence<std::uint32_t, widths...>
+    ) -> UnpackFn {
+        static constexpr UnpackFn kernels[] = {&unpack<Ops, lanes, widths>...};
+        return kernels[bits];
+    }
+
+    /** Returns the kernel for the given bit width, fully unrolled for each of the 33 widths. */
+    template <typename Ops, std::size_t lanes>
+    [[nodiscard]] auto unpacker(std::uint32_t bits) -> UnpackFn {
+        return select_kernel<Ops, lanes>(bits, std::make_integer_sequence<std::uint32_t, 33>{});
+    }
+
+}  // namespace
+
+}  // namespace pisa::simdbp_wide
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "codec/block_codec.hpp"
+#include "codec/simdbp_wide.hpp"
+#include "util/cpu_features.hpp"
+
+namespace pisa {
+
+/**
+ * SIMD-PFor coding: SIMD-BP with exceptions, in the spirit of SIMD-FastPFor.
+ *
+ * Each block is bit-packed as in SIMD-BP, with the values interleaved in `lanes` 32-bit lanes, but
+ * the bit width is the one minimizing the size of the block instead of the width of its largest
+ * value. The values that do not fit are exceptions: their positions and their high bits are stored
+ * after the packed values, and patched in after the block is unpacked. On blocks with a few large
+ * values, the size gets close to that of OptPFor, while most of the decoding is done by the SIMD-BP
+ * kernels.
+ *
+ * With 4 lanes, blocks have 128 integers and are decoded with SSE4. With 8 lanes, blocks have 256
+ * integers and are decoded with AVX2 when the CPU supports it, unless a level is passed to the
+ * constructor explicitly. The encoded format does not depend on the CPU.
+ *
+ * Daniel Lemire and Leonid Boytsov. 2015. Decoding billions of integers per second through
+ * vectorization. Software: Practice and Experience 45(1), 1-29.
+ */
+template <std::size_t lanes>
+class SimdPForBlockCodec: public BlockCodec {
+    static_assert(lanes == 4 || lanes == 8, "only SSE4 and AVX2 widths are supported");
+    static constexpr std::uint64_t m_block_size = 32 * lanes;
+
+  public:
+    constexpr static std::string_view name = lanes == 4 ? "block_simdpfor" : "block_simdpfor256";
+
+    /** The highest level for which a kernel of this width is worth using. */
+    constexpr static SimdLevel max_simd_level = lanes == 4 ? SimdLevel::Sse4 : SimdLevel::Avx2;
+
+    /** Exceptions are counted and located with a byte each. */
+    constexpr static std::size_t max_exceptions = 255;
+
+    SimdPForBlockCodec();
+
+    /**
+     * Constructs a codec decoding with the kernels of the given SIMD level, which must be
+     * supported by the CPU. Levels above `max_simd_level` are capped.
+     */
+    explicit SimdPForBlockCodec(SimdLevel level);
+
+    virtual ~SimdPForBlockCodec() = default;
+
+    void encode(
+        uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out
+    ) const override;
+    uint8_t const*
+    decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) const override;
+    auto block_size() const noexcept -> std::size_t override { return m_block_size; }
+    auto get_name() const noexcept -> std::string_view override { return name; }
+
+    /** Returns the SIMD level of the kernels used for decoding. */
+    [[nodiscard]] auto simd_level() const noexcept -> SimdLevel { return m_simd_level; }
+
+  private:
+    SimdLevel m_simd_level;
+    std::array<simdbp_wide::UnpackFn, 33> m_unpackers{};
+};
+
+using SimdPFor128BlockCodec = SimdPForBlockCodec<4>;
+using SimdPFor256BlockCodec = SimdPForBlockCodec<8>;
+
+extern template class SimdPForBlockCodec<4>;
+extern template class SimdPForBlockCodec<8>;
+
+}  // namespace pisa
@@ -39,6 +39,9 @@ class StreamVByteBlockCodec: public BlockCodec {
     ) const override;
     uint8_t const*
     decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) const override;
+    uint8_t const* decode_docids(
+        uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n, uint32_t base
+    ) const override;
     auto block_size() const noexcept -> std::size_t override { return m_block_size; }
     auto get_name() const noexcept -> std::string_view override { return name; }
 };
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "codec/block_codec.hpp"
+#include "codec/prefix_sum.hpp"
 #include "memory.hpp"
 
 namespace pisa {
@@ -173,6 +174,28 @@ class VarIntGB {
         return in - initin;
     }
 
+    /**
+     * Decodes `n` d-gaps of a block posting list and writes the absolute document IDs, as in
+     * `docid_prefix_sum`. The prefix sum of each group of four values is computed in SIMD
+     * registers right after the group is decoded.
+     */
+    size_t decodeDocIdArray(const uint8_t* in, const size_t n, uint32_t* out, uint32_t base) {
+        static_assert(!delta, "gaps must be decoded without delta");
+        const uint8_t* initin = in;
+        __m128i prev = _mm_set1_epi32(static_cast<int>(base - 1));
+        size_t k = 0;
+        for (; k + 3 < n; k += 4) {
+            in = decodeGroupVarInt(in, out + k);
+            prev = docid_prefix_sum4(out + k, prev);
+        }
+        if (k < n) {
+            uint32_t next_base = k > 0 ? out[k - 1] + 1 : base;
+            in += decodeArray(in, n - k, out + k);
+            docid_prefix_sum(out + k, n - k, next_base);
+        }
+        return in - initin;
+    }
+
   protected:
     const uint8_t* decodeGroupVarInt(const uint8_t* in, uint32_t* out) {
         const uint32_t sel = *in++;
@@ -249,6 +272,9 @@ class VarintGbBlockCodec: public BlockCodec {
     ) const override;
     uint8_t const*
     decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) const override;
+    uint8_t const* decode_docids(
+        uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n, uint32_t base
+    ) const override;
     auto block_size() const noexcept -> std::size_t override { return m_block_size; }
     auto get_name() const noexcept -> std::string_view override { return name; }
 };
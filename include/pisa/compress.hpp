@@ -1,13 +1,38 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <optional>
 #include <string>
+#include <vector>
 
+#include "invert.hpp"
 #include "scorer/scorer.hpp"
 #include "type_safe.hpp"
+#include "wand_utils.hpp"
 
 namespace pisa {
 
+/** Options of the `block_mixed` encoding. */
+struct MixedEncodingOptions {
+    /** Bits of space worth one nanosecond of decoding, see `BasicMixedBlockCodec`. */
+    std::optional<double> time_weight = std::nullopt;
+
+    /**
+     * Number of queries of a query log accessing each term. If set, the time weight of each
+     * posting list is multiplied by the number of accesses to its term: lists that are never
+     * accessed are encoded as compactly as possible, while the most accessed ones favor fast
+     * codecs. Terms beyond the end of the vector are not accessed.
+     */
+    std::optional<std::vector<std::uint64_t>> term_accesses = std::nullopt;
+
+    /**
+     * Decoding time of each candidate codec of `block_mixed`, in nanoseconds per integer and in
+     * the order of `MixedBlockCodec::candidate_names`. Defaults to `decode_ns_per_int`.
+     */
+    std::optional<std::vector<double>> decode_ns = std::nullopt;
+};
+
 void compress(
     std::string const& input_basename,
     std::optional<std::string> const& wand_data_filename,
@@ -15,8 +40,125 @@ void compress(
     std::string const& output_filename,
     ScorerParams const& scorer_params,
     std::optional<Size> quantization_bits,
+    MixedEncodingOptions const& mixed_options,
     bool check,
     bool in_memory
 );
 
+/** Options of the wand data built along with an index, see `create_wand_data`. */
+struct WandDataOptions {
+    std::string output;
+    BlockSize block_size;
+    ScorerParams scorer_params;
+    bool range = false;
+    bool compress = false;
+    std::optional<Size> quantization_bits = std::nullopt;
+};
+
+/**
+ * Inverts a forward index and compresses the inverted index in a single pass.
+ *
+ * The forward index is inverted in batches written next to the output, as `invert` does, and the
+ * posting lists are merged from the batches one at a time and passed straight to the index
+ * builder, and to the wand data builder if `wand_options` is given, instead of writing the
+ * uncompressed inverted index first. The time spent in each stage and its throughput in postings
+ * per second are logged.
+ *
+ * Quantized indexes are not supported, since the scores can only be quantized once the maximum
+ * score of the whole index is known.
+ */
+void invert_and_compress(
+    std::string const& forward_index_basename,
+    std::string const& index_encoding,
+    std::string const& output_filename,
+    invert::InvertParams const& invert_params,
+    std::optional<WandDataOptions> const& wand_options
+);
+
+/** Statistics of the documents and terms of an index, needed to build its wand data. */
+struct IndexStatistics {
+    /** Sizes of all documents, in order. */
+    std::vector<std::uint32_t> document_sizes{};
+    /** Number of postings of each term. */
+    std::vector<std::uint32_t> term_posting_counts{};
+    /** Number of occurrences of each term. */
+    std::vector<std::uint32_t> term_occurrence_counts{};
+};
+
+/**
+ * Compresses posting lists that are not read from a collection, e.g., lists merged from several
+ * indexes, along with their wand data if `wand_options` is given.
+ *
+ * The lists are given in term order by `next_list`, which returns `std::nullopt` after the last
+ * one, and are encoded concurrently as in `invert_and_compress`. The statistics must cover all
+ * documents and terms, and are known beforehand.
+ */
+void compress_posting_lists(
+    std::function<std::optional<invert::PostingList>()> next_list,
+    IndexStatistics const& statistics,
+    std::string const& index_encoding,
+    std::string const& output_filename,
+    std::optional<WandDataOptions> const& wand_options
+);
+
+/**
+ * Merges the posting lists of indexes over consecutive ranges of documents, given in document
+ * order, along with their wand data if `wand_options` is given.
+ *
+ * The merged list of a term is the concatenation of the lists of the terms mapped to it by
+ * `term_mappings`, which maps the terms of each index, in increasing order, to the terms of the
+ * merged index. Block-encoded lists are concatenated block by block, copying all full blocks and
+ * encoding only partial blocks again, see `index::block::PostingListConcatenator`, while lists of
+ * other encodings are decoded and encoded again. The statistics of the merged index must cover all
+ * documents and terms.
+ *
+ * If the uncompressed wand data of the indexes are given in `input_wand_data`, built with the
+ * options of `wand_options` and without dropping terms, and the scores do not depend on the
+ * statistics, i.e., with the `quantized` scorer and neither compressed nor quantized wand data,
+ * the block-max scores of the merged lists are copied from them. Otherwise, they are computed from
+ * the decoded postings. The numbers of copied blocks and block-max lists are logged.
+ */
+void merge_posting_lists(
+    std::vector<std::string> const& index_filenames,
+    std::vector<std::vector<std::uint32_t>> const& term_mappings,
+    IndexStatistics const& statistics,
+    std::string const& index_encoding,
+    std::string const& output_filename,
+    std::optional<WandDataOptions> const& wand_options,
+    std::vector<std::string> const& input_wand_data = {}
+);
+
+/** Options of `transcode_index`. */
+struct TranscodeOptions {
+    /**
+     * Permutation of the documents, mapping the ID of each document of the input index to its ID
+     * in the output index, as read by `read_mapping`.
+     */
+    std::optional<std::vector<std::uint32_t>> mapping = std::nullopt;
+    /** Uncompressed wand data of the input index, needed to build the wand data of the output. */
+    std::optional<std::string> input_wand_data = std::nullopt;
+    std::optional<WandDataOptions> wand_options = std::nullopt;
+    /** Whether to check the postings of the output index against the ones of the input. */
+    bool check = false;
+};
+
+/**
+ * Encodes an index again with another encoding, without going through an uncompressed collection.
+ *
+ * The posting lists of the input index, of any encoding supported by `run_for_index`, are decoded
+ * through its cursors and encoded with the streaming builder of the output encoding. Lists are
+ * decoded and encoded concurrently, in chunks of consecutive terms, as in `invert_and_compress`.
+ * If a mapping is given, the documents of each list are renumbered and sorted again. The wand
+ * data of the output are computed from the statistics of the input wand data, with the document
+ * sizes permuted by the mapping. If terms were dropped when building the input wand data, the term
+ * statistics are counted from the posting lists instead.
+ */
+void transcode_index(
+    std::string const& input_filename,
+    std::string const& input_encoding,
+    std::string const& output_filename,
+    std::string const& output_encoding,
+    TranscodeOptions const& options
+);
+
 }  // namespace pisa
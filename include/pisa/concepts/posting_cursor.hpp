@@ -18,6 +18,7 @@
 
 #include <concepts>
 #include <cstdint>
+#include <span>
 
 #include "container.hpp"
 #include "type_alias.hpp"
@@ -69,6 +70,32 @@ concept SortedPostingCursor = PostingCursor<C>
     cursor.next_geq(docid);
 };
 
+/**
+ * A sorted posting cursor that exposes entire decoded blocks of postings.
+ */
+template <typename C>
+concept BlockPostingCursor = FrequencyPostingCursor<C> && SortedPostingCursor<C>
+&& requires(C cursor) {
+    /**
+     * Returns the absolute document IDs and frequencies from the current position to the end
+     * of the current block. The returned block is empty once the cursor is exhausted.
+     */
+    { cursor.current_block().docids } -> std::convertible_to<std::span<std::uint32_t const>>;
+    { cursor.current_block().freqs } -> std::convertible_to<std::span<std::uint32_t const>>;
+    /** Moves the cursor to the first posting of the next block, or to the end of the list. */
+    cursor.next_block();
+};
+
+/**
+ * A block posting cursor that can score an entire block of postings at once.
+ */
+template <typename C>
+concept BlockScoredPostingCursor = BlockPostingCursor<C>
+&& requires(C cursor, decltype(cursor.current_block()) block) {
+    /** Returns the scores of the postings in the given block of this cursor. */
+    { cursor.score_block(block) } -> std::convertible_to<std::span<float const>>;
+};
+
 /**
  * A posting cursor with max score.
  */
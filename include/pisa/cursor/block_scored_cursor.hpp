@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+#include "concepts/posting_cursor.hpp"
+#include "cursor/posting_block.hpp"
+#include "query.hpp"
+#include "scorer/index_scorer.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/**
+ * Cursor scoring entire blocks of postings at once with a block term scorer.
+ *
+ * Unlike `ScoredCursor`, it does not score single postings; it is meant for block-at-a-time
+ * algorithms, which iterate over the blocks returned by `current_block()`.
+ */
+template <typename Cursor>
+    requires(concepts::BlockPostingCursor<Cursor>)
+class BlockScoredCursor {
+  public:
+    using base_cursor_type = Cursor;
+
+    BlockScoredCursor(Cursor cursor, BlockTermScorer block_scorer, float weight)
+        : m_base_cursor(std::move(cursor)),
+          m_weight(weight),
+          m_block_scorer(std::move(block_scorer)) {
+        static_assert(concepts::BlockScoredPostingCursor<BlockScoredCursor>);
+    }
+    BlockScoredCursor(BlockScoredCursor const&) = delete;
+    BlockScoredCursor(BlockScoredCursor&&) = default;
+    BlockScoredCursor& operator=(BlockScoredCursor const&) = delete;
+    BlockScoredCursor& operator=(BlockScoredCursor&&) = default;
+    ~BlockScoredCursor() = default;
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto weight() const noexcept -> float { return m_weight; }
+    [[nodiscard]] PISA_ALWAYSINLINE auto docid() const -> std::uint32_t {
+        return m_base_cursor.docid();
+    }
+    [[nodiscard]] PISA_ALWAYSINLINE auto freq() -> std::uint32_t { return m_base_cursor.freq(); }
+    void PISA_ALWAYSINLINE next() { m_base_cursor.next(); }
+    void PISA_ALWAYSINLINE next_geq(std::uint32_t docid) { m_base_cursor.next_geq(docid); }
+    [[nodiscard]] PISA_ALWAYSINLINE auto size() const noexcept -> std::size_t {
+        return m_base_cursor.size();
+    }
+    [[nodiscard]] PISA_ALWAYSINLINE auto current_block() -> PostingBlock {
+        return m_base_cursor.current_block();
+    }
+    void PISA_ALWAYSINLINE next_block() { m_base_cursor.next_block(); }
+
+    /**
+     * Returns the scores of the postings in `block`, which must have been returned by
+     * `current_block()` of this cursor. The scores are valid until the next call.
+     */
+    [[nodiscard]] auto score_block(PostingBlock const& block) -> std::span<float const> {
+        if (m_scores.size() < block.size()) {
+            m_scores.resize(block.size());
+        }
+        auto scores = std::span<float>(m_scores.data(), block.size());
+        m_block_scorer(block.docids, block.freqs, scores);
+        if (m_weight != 1.0F) {
+            std::transform(scores.begin(), scores.end(), scores.begin(), [this](float score) {
+                return m_weight * score;
+            });
+        }
+        return scores;
+    }
+
+  private:
+    Cursor m_base_cursor;
+    float m_weight = 1.0;
+    BlockTermScorer m_block_scorer;
+    std::vector<float> m_scores;
+};
+
+template <typename Index, typename Scorer>
+[[nodiscard]] auto make_block_scored_cursors(
+    Index const& index, Scorer const& scorer, Query const& query, bool weighted = false
+) {
+    std::vector<BlockScoredCursor<typename Index::document_enumerator>> cursors;
+    cursors.reserve(query.terms().size());
+    std::transform(
+        query.terms().begin(),
+        query.terms().end(),
+        std::back_inserter(cursors),
+        [&](WeightedTerm const& term) {
+            return BlockScoredCursor<typename Index::document_enumerator>(
+                index[term.id], scorer.block_term_scorer(term.id), weighted ? term.weight : 1.0F
+            );
+        }
+    );
+    return cursors;
+}
+
+}  // namespace pisa
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+#include "concepts/posting_cursor.hpp"
+#include "document_filter.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/**
+ * Cursor skipping the documents excluded by a filter.
+ *
+ * It extends any sorted cursor, e.g., `MaxScoredCursor` or `BlockMaxScoredCursor`, so that it
+ * never stops at a filtered document: query algorithms never score them, and they never enter the
+ * top-k queue, without any change to the algorithms. Runs of filtered documents are skipped with
+ * `next_geq`, which skips entire blocks of postings. For block-max cursors, a block without any
+ * accepted document at or after the target of `block_max_next_geq` has a block-max score of zero,
+ * so that the algorithms skip the block instead of taking it as a candidate.
+ *
+ * The filter must not cover more documents than the index, since the cursor would otherwise be
+ * moved past the end of its list.
+ */
+template <typename Cursor>
+    requires(concepts::SortedPostingCursor<Cursor> && !concepts::BlockPostingCursor<Cursor>)
+class FilteredCursor: public Cursor {
+  public:
+    using base_cursor_type = Cursor;
+
+    FilteredCursor(Cursor cursor, DocumentFilter const& filter)
+        : Cursor(std::move(cursor)), m_filter(&filter) {
+        skip_filtered();
+    }
+    FilteredCursor(FilteredCursor const&) = delete;
+    FilteredCursor(FilteredCursor&&) = default;
+    FilteredCursor& operator=(FilteredCursor const&) = delete;
+    FilteredCursor& operator=(FilteredCursor&&) = default;
+    ~FilteredCursor() = default;
+
+    void PISA_ALWAYSINLINE next() {
+        Cursor::next();
+        skip_filtered();
+    }
+
+    void PISA_ALWAYSINLINE next_geq(std::uint32_t docid) {
+        Cursor::next_geq(docid);
+        skip_filtered();
+    }
+
+    void PISA_ALWAYSINLINE block_max_next_geq(std::uint32_t docid)
+        requires concepts::BlockMaxPostingCursor<Cursor>
+    {
+        Cursor::block_max_next_geq(docid);
+        m_block_filtered = m_filter->next_accepted(docid) > Cursor::block_max_docid();
+    }
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto block_max_score() -> float
+        requires concepts::BlockMaxPostingCursor<Cursor>
+    {
+        return m_block_filtered ? 0.0F : Cursor::block_max_score();
+    }
+
+  private:
+    void PISA_ALWAYSINLINE skip_filtered() {
+        while (m_filter->filtered(this->docid())) {
+            Cursor::next_geq(m_filter->next_accepted(this->docid()));
+        }
+    }
+
+    DocumentFilter const* m_filter;
+    bool m_block_filtered = false;
+};
+
+/** Wraps the cursors so that they skip the documents excluded by the filter. */
+template <typename Cursor>
+[[nodiscard]] auto filter_cursors(std::vector<Cursor> cursors, DocumentFilter const& filter) {
+    std::vector<FilteredCursor<Cursor>> filtered;
+    filtered.reserve(cursors.size());
+    for (auto& cursor: cursors) {
+        filtered.emplace_back(std::move(cursor), filter);
+    }
+    return filtered;
+}
+
+}  // namespace pisa
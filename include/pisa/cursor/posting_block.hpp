@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace pisa {
+
+/**
+ * Decoded postings of a posting list block, as returned by `current_block()` of block cursors.
+ *
+ * The spans point to the internal buffers of the cursor that returned them, and thus are valid
+ * only until the cursor moves to another block.
+ */
+struct PostingBlock {
+    /** Absolute document IDs in increasing order. */
+    std::span<std::uint32_t const> docids{};
+    /** Frequencies of the documents in `docids`. */
+    std::span<std::uint32_t const> freqs{};
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return docids.size(); }
+    [[nodiscard]] auto empty() const noexcept -> bool { return docids.empty(); }
+
+    /** Returns the block consisting of the first `count` postings of this block. */
+    [[nodiscard]] auto first(std::size_t count) const -> PostingBlock {
+        return PostingBlock{docids.first(count), freqs.first(count)};
+    }
+};
+
+}  // namespace pisa
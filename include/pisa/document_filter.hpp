@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "memory_source.hpp"
+#include "util/broadword.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/**
+ * Set of documents excluded from query results, e.g., deleted documents, or documents outside of
+ * a date range.
+ *
+ * It is a bitmap with a bit set for each filtered document. Documents beyond its size are never
+ * filtered, so a default-constructed filter filters nothing.
+ */
+class DocumentFilter {
+  public:
+    DocumentFilter() = default;
+
+    /** Maps a filter written with `write`. */
+    explicit DocumentFilter(MemorySource source);
+
+    /** Filters the documents in the ranges `[first, last)`, out of `num_docs` documents. */
+    DocumentFilter(
+        std::uint32_t num_docs, std::vector<std::pair<std::uint32_t, std::uint32_t>> const& ranges
+    );
+
+    DocumentFilter(DocumentFilter const&) = delete;
+    DocumentFilter(DocumentFilter&&) = delete;
+    DocumentFilter& operator=(DocumentFilter const&) = delete;
+    DocumentFilter& operator=(DocumentFilter&&) = delete;
+    ~DocumentFilter() = default;
+
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit(m_filtered, "m_filtered");
+    }
+
+    void write(std::string const& path);
+
+    /** Number of documents covered by the filter. */
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_filtered.size(); }
+
+    /** Number of filtered documents. */
+    [[nodiscard]] auto count() const -> std::size_t;
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto filtered(std::uint32_t docid) const -> bool {
+        return docid < m_filtered.size() && m_filtered[docid];
+    }
+
+    /**
+     * Returns the first document at or after `docid` that is not filtered. Whole words of 64
+     * filtered documents are skipped at once.
+     */
+    [[nodiscard]] auto next_accepted(std::uint32_t docid) const -> std::uint32_t {
+        auto size = m_filtered.size();
+        std::uint64_t pos = docid;
+        auto const& words = m_filtered.data();
+        while (pos < size) {
+            auto word = ~words[pos / 64] >> (pos % 64);
+            if (word != 0) {
+                return static_cast<std::uint32_t>(std::min(pos + broadword::lsb(word), size));
+            }
+            pos = (pos / 64 + 1) * 64;
+        }
+        return static_cast<std::uint32_t>(std::max<std::uint64_t>(docid, size));
+    }
+
+  private:
+    MemorySource m_source;
+    bit_vector m_filtered;
+};
+
+/**
+ * Reads the documents to filter, one entry per line: either a document ID, or two IDs `first last`
+ * standing for the range `[first, last)`.
+ *
+ * \throws std::invalid_argument    Thrown if a line is not a valid entry.
+ */
+[[nodiscard]] auto read_document_ranges(std::istream& is)
+    -> std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+
+}  // namespace pisa
@@ -1,16 +1,23 @@
 #pragma once
 
+#include <algorithm>
+#include <filesystem>
 #include <fmt/format.h>
+#include <fstream>
+#include <string>
 #include <string_view>
+#include <vector>
 #include <tbb/parallel_invoke.h>
 
 #include "bitvector_collection.hpp"
 #include "codec/integer_codes.hpp"
 #include "concepts/inverted_index.hpp"
 #include "concepts/posting_cursor.hpp"
+#include "cursor/posting_block.hpp"
 #include "global_parameters.hpp"
 #include "mappable/mapper.hpp"
 #include "memory_source.hpp"
+#include "temporary_directory.hpp"
 
 namespace pisa {
 
@@ -65,6 +72,14 @@ class freq_index {
               m_docs_sequences(params),
               m_freqs_sequences(params) {}
 
+        /**
+         * A posting list encoded by `encode_posting_list`, not yet part of the index.
+         */
+        struct encoded_posting_list {
+            bit_vector_builder docs;
+            bit_vector_builder freqs;
+        };
+
         /**
          * Records a new posting list.
          *
@@ -81,26 +96,48 @@ class freq_index {
         void add_posting_list(
             uint64_t n, DocsIterator docs_begin, FreqsIterator freqs_begin, uint64_t occurrences
         ) {
+            auto list = encode_posting_list(n, docs_begin, freqs_begin, occurrences);
+            append_posting_list(list);
+        }
+
+        /**
+         * Encodes a posting list without adding it to the index.
+         *
+         * This does not modify the builder, and can be called concurrently from many threads,
+         * as long as the encoded lists are appended in term order with `append_posting_list`.
+         *
+         * \throws std::invalid_argument   Thrown if `n == 0`.
+         */
+        template <typename DocsIterator, typename FreqsIterator>
+        [[nodiscard]] auto encode_posting_list(
+            uint64_t n, DocsIterator docs_begin, FreqsIterator freqs_begin, uint64_t occurrences
+        ) const -> encoded_posting_list {
             if (!n) {
                 throw std::invalid_argument("List must be nonempty");
             }
 
+            encoded_posting_list list;
             tbb::parallel_invoke(
                 [&] {
-                    bit_vector_builder docs_bits;
-                    write_gamma_nonzero(docs_bits, occurrences);
+                    write_gamma_nonzero(list.docs, occurrences);
                     if (occurrences > 1) {
-                        docs_bits.append_bits(n, ceil_log2(occurrences + 1));
+                        list.docs.append_bits(n, ceil_log2(occurrences + 1));
                     }
-                    DocsSequence::write(docs_bits, docs_begin, m_num_docs, n, m_params);
-                    m_docs_sequences.append(docs_bits);
+                    DocsSequence::write(list.docs, docs_begin, m_num_docs, n, m_params);
                 },
                 [&] {
-                    bit_vector_builder freqs_bits;
-                    FreqsSequence::write(freqs_bits, freqs_begin, occurrences + 1, n, m_params);
-                    m_freqs_sequences.append(freqs_bits);
+                    FreqsSequence::write(list.freqs, freqs_begin, occurrences + 1, n, m_params);
                 }
             );
+            return list;
+        }
+
+        /**
+         * Adds a posting list encoded with `encode_posting_list` as the next term.
+         */
+        void append_posting_list(encoded_posting_list const& list) {
+            m_docs_sequences.append(list.docs);
+            m_freqs_sequences.append(list.freqs);
         }
 
         /**
@@ -123,6 +160,81 @@ class freq_index {
         bitvector_collection::builder m_freqs_sequences;
     };
 
+    /**
+     * Streaming index builder.
+     *
+     * Encoded posting lists are spilled to temporary files as they are added, and only their
+     * endpoints are kept in memory, so the memory used does not depend on the size of the
+     * collection. The index written by `build` is the same as the one `builder` would produce.
+     */
+    class stream_builder {
+      public:
+        using encoded_posting_list = typename builder::encoded_posting_list;
+
+        /**
+         * Constructs a builder for an index containing the given number of documents, with
+         * temporary files in a new directory under `tmp_root`.
+         */
+        stream_builder(
+            uint64_t num_docs,
+            global_parameters const& params,
+            std::filesystem::path const& tmp_root = std::filesystem::temp_directory_path()
+        )
+            : m_params(params),
+              m_num_docs(num_docs),
+              m_encoder(num_docs, params),
+              m_tmp(tmp_root),
+              m_docs_sequences(params, m_tmp.path() / "docs"),
+              m_freqs_sequences(params, m_tmp.path() / "freqs") {}
+
+        /**
+         * Records a new posting list, see `builder::add_posting_list`.
+         *
+         * \throws std::invalid_argument   Thrown if `n == 0`.
+         */
+        template <typename DocsIterator, typename FreqsIterator>
+        void add_posting_list(
+            uint64_t n, DocsIterator docs_begin, FreqsIterator freqs_begin, uint64_t occurrences
+        ) {
+            auto list = encode_posting_list(n, docs_begin, freqs_begin, occurrences);
+            append_posting_list(list);
+        }
+
+        /** Encodes a posting list without adding it, see `builder::encode_posting_list`. */
+        template <typename DocsIterator, typename FreqsIterator>
+        [[nodiscard]] auto encode_posting_list(
+            uint64_t n, DocsIterator docs_begin, FreqsIterator freqs_begin, uint64_t occurrences
+        ) const -> encoded_posting_list {
+            return m_encoder.encode_posting_list(n, docs_begin, freqs_begin, occurrences);
+        }
+
+        /** Adds a posting list encoded with `encode_posting_list` as the next term. */
+        void append_posting_list(encoded_posting_list const& list) {
+            m_docs_sequences.append(list.docs);
+            m_freqs_sequences.append(list.freqs);
+        }
+
+        /**
+         * Writes the index to the given file, in the layout of `mapper::freeze`.
+         */
+        void build(std::string const& index_path) {
+            std::ofstream os(index_path, std::ios::binary);
+            os.exceptions(std::ios::badbit | std::ios::failbit);
+            mapper::detail::freeze_visitor freezer(os, 0);
+            freezer(m_params, "m_params")(m_num_docs, "m_num_docs");
+            m_docs_sequences.write(freezer, os);
+            m_freqs_sequences.write(freezer, os);
+        }
+
+      private:
+        global_parameters m_params;
+        uint64_t m_num_docs = 0;
+        builder m_encoder;
+        TemporaryDirectory m_tmp;
+        bitvector_collection::stream_builder m_docs_sequences;
+        bitvector_collection::stream_builder m_freqs_sequences;
+    };
+
     /**
      * \returns  The size of the index, i.e., the number of terms (posting lists).
      */
@@ -135,6 +247,12 @@ class freq_index {
 
     class document_enumerator {
       public:
+        /**
+         * Sequences are not encoded in blocks, so the block interface partitions the list into
+         * consecutive chunks of this many postings.
+         */
+        static constexpr std::uint64_t block_size = 128;
+
         void reset() {
             m_cur_pos = 0;
             m_cur_docid = m_docs_enum.move(0).second;
@@ -164,6 +282,39 @@ class freq_index {
 
         uint64_t PISA_FLATTEN_FUNC value() { return freq(); }
 
+        /**
+         * Decodes the postings from the current position to the end of the current chunk of
+         * `block_size` postings. The returned spans are valid until the next call.
+         */
+        PostingBlock PISA_FLATTEN_FUNC current_block() {
+            auto len = block_end() - m_cur_pos;
+            if (len == 0) {
+                return {};
+            }
+            // Allocated lazily so that cursors not using the block interface pay nothing.
+            if (m_block_docids.empty()) {
+                m_block_docids.resize(block_size);
+                m_block_freqs.resize(block_size);
+            }
+            auto docs_enum = m_docs_enum;
+            m_block_docids[0] = m_cur_docid;
+            for (uint64_t pos = 1; pos < len; ++pos) {
+                m_block_docids[pos] = docs_enum.next().second;
+            }
+            for (uint64_t pos = 0; pos < len; ++pos) {
+                m_block_freqs[pos] = m_freqs_enum.move(m_cur_pos + pos).second;
+            }
+            return PostingBlock{
+                std::span<std::uint32_t const>(m_block_docids.data(), len),
+                std::span<std::uint32_t const>(m_block_freqs.data(), len)
+            };
+        }
+
+        /**
+         * Moves to the first posting of the next chunk, or to the end of the list.
+         */
+        void PISA_FLATTEN_FUNC next_block() { move(block_end()); }
+
         uint64_t position() const { return m_cur_pos; }
 
         uint64_t size() const noexcept { return m_docs_enum.size(); }
@@ -182,14 +333,21 @@ class freq_index {
             static_assert((
                 concepts::FrequencyPostingCursor<document_enumerator>
                 && concepts::SortedPostingCursor<document_enumerator>
+                && concepts::BlockPostingCursor<document_enumerator>
             ));
             reset();
         }
 
+        [[nodiscard]] uint64_t block_end() const {
+            return std::min((m_cur_pos / block_size + 1) * block_size, size());
+        }
+
         uint64_t m_cur_pos{0};
         uint64_t m_cur_docid{0};
         typename DocsSequence::enumerator m_docs_enum;
         typename FreqsSequence::enumerator m_freqs_enum;
+        std::vector<std::uint32_t> m_block_docids;
+        std::vector<std::uint32_t> m_block_freqs;
     };
 
     /**
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <type_traits>
+
 #include "block_inverted_index.hpp"
 #include "codec/block_codec_registry.hpp"
 #include "freq_index.hpp"
+#include "sequence/hybrid_sequence.hpp"
 #include "sequence/partitioned_sequence.hpp"
 #include "sequence/positive_sequence.hpp"
 #include "sequence/uniform_partitioned_sequence.hpp"
@@ -19,6 +22,9 @@ using pefuniform_index =
 using pefopt_index =
     freq_index<partitioned_sequence<>, positive_sequence<partitioned_sequence<strict_sequence>>>;
 
+using hybrid_index =
+    freq_index<partitioned_sequence<hybrid_sequence>, positive_sequence<partitioned_sequence<strict_sequence>>>;
+
 template <typename Fn>
 void run_for_index(std::string_view encoding, MemorySource source, Fn&& fn) {
     if (encoding == "ef") {
@@ -29,8 +35,14 @@ void run_for_index(std::string_view encoding, MemorySource source, Fn&& fn) {
         fn(pefuniform_index(std::move(source)));
     } else if (encoding == "pefopt") {
         fn(pefopt_index(std::move(source)));
+    } else if (encoding == "hybrid") {
+        fn(hybrid_index(std::move(source)));
     } else if (encoding.rfind("block_", 0) == 0) {
-        fn(BlockInvertedIndex(std::move(source), get_block_codec(encoding)));
+        auto block_codec = get_block_codec(encoding);
+        if (block_codec == nullptr) {
+            throw std::invalid_argument(fmt::format("invalid encoding: {}", encoding));
+        }
+        fn(BlockInvertedIndex(std::move(source), std::move(block_codec)));
     } else {
         throw std::invalid_argument(fmt::format("invalid encoding: {}", encoding));
     }
@@ -51,9 +63,37 @@ void resolve_freq_index_type(std::string_view encoding, Fn&& fn) {
         fn(IndexTraits<pefuniform_index>{});
     } else if (encoding == "pefopt") {
         fn(IndexTraits<pefopt_index>{});
+    } else if (encoding == "hybrid") {
+        fn(IndexTraits<hybrid_index>{});
     } else {
         throw std::invalid_argument(fmt::format("invalid encoding: {}", encoding));
     }
 }
 
+/**
+ * Resolves the index type of any encoding, including `BlockInvertedIndex` for all block
+ * encodings. Indexes of the resolved type are opened with `open_index`.
+ */
+template <typename Fn>
+void resolve_index_type(std::string_view encoding, Fn&& fn) {
+    if (encoding.rfind("block_", 0) == 0) {
+        if (get_block_codec(encoding) == nullptr) {
+            throw std::invalid_argument(fmt::format("invalid encoding: {}", encoding));
+        }
+        fn(IndexTraits<BlockInvertedIndex>{});
+    } else {
+        resolve_freq_index_type(encoding, std::forward<Fn>(fn));
+    }
+}
+
+/** Opens an index of a type resolved by `resolve_index_type` for the given encoding. */
+template <typename Index>
+[[nodiscard]] auto open_index(std::string_view encoding, MemorySource source) -> Index {
+    if constexpr (std::is_same_v<Index, BlockInvertedIndex>) {
+        return BlockInvertedIndex(std::move(source), get_block_codec(encoding));
+    } else {
+        return Index(std::move(source));
+    }
+}
+
 }  // namespace pisa
@@ -2,12 +2,15 @@
 
 #include <optional>
 #include <span>
+#include <string>
+#include <unordered_map>
 #include <thread>
 #include <vector>
 
 #include <range/v3/view/iota.hpp>
 #include <tbb/blocked_range.h>
 
+#include "binary_collection.hpp"
 #include "type_safe.hpp"
 
 namespace pisa { namespace invert {
@@ -64,14 +67,112 @@ namespace pisa { namespace invert {
     auto invert_range(DocumentRange documents, Document_Id first_document_id, size_t threads)
         -> Inverted_Index;
 
+    /// Inverted index of a limited range of documents stored in flat arrays, in the compressed
+    /// sparse row (CSR) layout: the postings of term `t` are at `[offsets[t], offsets[t + 1])`
+    /// in `documents` and `frequencies`, in increasing document order.
+    struct FlatInvertedIndex {
+        /// Offsets of the posting lists, with one more element than there are terms.
+        std::vector<std::uint64_t> offsets{};
+        /// Documents of all posting lists, one list after the other.
+        std::vector<Document_Id> documents{};
+        /// Frequencies of all posting lists. This is aligned with `documents`.
+        std::vector<Frequency> frequencies{};
+        /// List of document sizes for all documents in the range.
+        std::vector<std::uint32_t> document_sizes{};
+    };
+
+    /// Creates an in-memory inverted index for a single document range, sorting its postings by
+    /// term with a parallel radix sort instead of accumulating them in hash maps.
+    ///
+    /// \throws std::out_of_range   Thrown if a document contains a term not less than
+    ///                             `term_count`.
+    auto invert_range_flat(
+        DocumentRange documents,
+        Document_Id first_document_id,
+        std::uint32_t term_count,
+        size_t threads
+    ) -> FlatInvertedIndex;
+
+    /// Approximate number of bytes taken by `invert_range_flat` for each term occurrence.
+    inline constexpr std::size_t flat_inversion_bytes_per_occurrence = 24;
+
+    /// Approximate number of bytes taken by `invert_range_flat` for each document, besides its
+    /// term occurrences.
+    inline constexpr std::size_t flat_inversion_bytes_per_document = 20;
+
     /// Parameters for inverting process.
     struct InvertParams {
         std::size_t batch_size = 100'000;
         std::size_t num_threads = std::thread::hardware_concurrency() + 1;
         std::optional<std::uint32_t> term_count = std::nullopt;
+        /// If set, batches are inverted with `invert_range_flat`, and hold as many documents as
+        /// fit in this many bytes instead of `batch_size` documents.
+        std::optional<std::size_t> memory_budget = std::nullopt;
+        /// Format of the batches and of the inverted index.
+        BinaryCollectionFormat collection_format = BinaryCollectionFormat::Raw;
+    };
+
+    /// Summary of the batches written by `build_batches`.
+    struct Batches {
+        /// Number of batches.
+        std::uint32_t count = 0;
+        /// Number of distinct terms in the forward index.
+        std::uint32_t term_count = 0;
+        /// Sizes of all documents, in order.
+        std::vector<std::uint32_t> document_sizes{};
+        /// Number of postings of each term over all batches.
+        std::vector<std::uint32_t> term_posting_counts{};
+        /// Number of occurrences of each term over all batches.
+        std::vector<std::uint32_t> term_occurrence_counts{};
     };
 
-    /// Creates an inverted index (simple, uncompressed binary format) from a forward index.
+    /// Inverts a forward index in batches of `params.batch_size` documents, each written to
+    /// `{output_basename}.batch.{n}` as a binary collection in `params.collection_format`.
+    ///
+    /// If `params.memory_budget` is set, each batch instead holds as many documents as
+    /// `invert_range_flat` can invert within the budget, and at least one.
+    ///
+    /// If `params.term_count` is not set, the number of terms is read from the term lexicon
+    /// `{input_basename}.termlex`.
+    ///
+    /// \throws std::invalid_argument   Thrown if the memory budget cannot even hold the term
+    ///                                 offsets of a batch.
+    [[nodiscard]] auto build_batches(
+        std::string const& input_basename, std::string const& output_basename, InvertParams params
+    ) -> Batches;
+
+    /// A posting list owning its documents and frequencies.
+    struct PostingList {
+        std::vector<std::uint32_t> docs{};
+        std::vector<std::uint32_t> freqs{};
+    };
+
+    /// Reads the posting lists of the batches written by `build_batches` in term order, each list
+    /// being the concatenation of the lists of its term in all batches.
+    class BatchReader {
+      public:
+        BatchReader(std::string const& output_basename, Batches const& batches);
+
+        /// Returns the posting list of the next term, or `std::nullopt` after the last term.
+        ///
+        /// \throws std::runtime_error   Thrown if the list is empty, or if its documents and
+        ///                              frequencies have different lengths.
+        [[nodiscard]] auto next() -> std::optional<PostingList>;
+
+      private:
+        std::vector<binary_collection> m_doc_collections;
+        std::vector<binary_collection> m_freq_collections;
+        std::vector<binary_collection::const_iterator> m_doc_iterators;
+        std::vector<binary_collection::const_iterator> m_freq_iterators;
+        std::uint32_t m_term_count;
+        std::uint32_t m_term_id = 0;
+    };
+
+    /// Removes the files of the batches written by `build_batches`.
+    void remove_batches(std::string const& output_basename, std::uint32_t batch_count);
+
+    /// Creates an inverted index (binary collection in `params.collection_format`) from a
+    /// forward index.
     void invert_forward_index(
         std::string const& input_basename, std::string const& output_basename, InvertParams params
     );
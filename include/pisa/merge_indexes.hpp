@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "compress.hpp"
+#include "term_map.hpp"
+
+namespace pisa {
+
+/**
+ * Merges sorted lexicons into `merged`, and returns the mapping of the term IDs of each lexicon
+ * to the IDs of the merged one.
+ */
+[[nodiscard]] auto merge_lexicons(
+    std::deque<LexiconMap> const& lexicons, std::vector<std::string>& merged
+) -> std::vector<std::vector<std::uint32_t>>;
+
+/** Writes the titles of the documents of all lexicons, in order. */
+void concatenate_lexicons(std::deque<LexiconMap> const& lexicons, std::string const& output);
+
+/**
+ * Returns the statistics of the index `{basename}.index` of `term_count` terms, numbered as in its
+ * term lexicon. They are read from its wand data `{basename}.wand`, unless terms were dropped when
+ * building them, in which case the term statistics are read from the posting lists.
+ */
+[[nodiscard]] auto read_statistics(
+    std::string const& basename, std::string const& index_encoding, std::size_t term_count
+) -> IndexStatistics;
+
+/**
+ * Returns the document and term statistics of the concatenation of indexes, where
+ * `term_mappings` maps the terms of each index to the merged terms.
+ */
+[[nodiscard]] auto merge_statistics(
+    std::deque<IndexStatistics> const& statistics,
+    std::vector<std::vector<std::uint32_t>> const& term_mappings,
+    std::size_t term_count
+) -> IndexStatistics;
+
+/**
+ * Merges indexes over consecutive ranges of documents, given by their basenames in document
+ * order, into a single index, without going through an uncompressed collection.
+ *
+ * Each index consists of `{basename}.index`, `{basename}.wand`, which must be uncompressed wand
+ * data, and the term lexicon `{basename}.termlex`, and the merged index of the same files, written
+ * with `output_basename`. The terms are mapped through the lexicons, so the indexes need not share
+ * their terms, e.g., shards. If all indexes have a document lexicon `{basename}.doclex`, their
+ * documents are also concatenated into the merged one. The output of `wand_options` is ignored.
+ *
+ * The statistics of each index are read with `read_statistics`. See `merge_posting_lists` for how
+ * posting lists and their block-max scores are merged.
+ */
+void merge_indexes(
+    std::vector<std::string> const& input_basenames,
+    std::string const& output_basename,
+    std::string const& index_encoding,
+    WandDataOptions wand_options
+);
+
+}  // namespace pisa
@@ -3,6 +3,7 @@
 #include "util/util.hpp"
 #include <algorithm>
 #include <iterator>
+#include <type_traits>
 #include <vector>
 
 namespace pisa {
@@ -24,6 +25,8 @@ struct optimal_partition {
         posting_t end = 0;  // end-th position is not in the current window
         posting_t min_p = 0;  // element that preceed the first element of the window
         posting_t max_p = 0;
+        // number of elements of the window that do not follow their predecessor by one
+        uint64_t breaks = 0;
 
         cost_t cost_upper_bound;  // The maximum cost for this window
 
@@ -38,13 +41,23 @@ struct optimal_partition {
 
         uint64_t size() const { return end - start; }
 
+        // number of maximal runs of consecutive values in the window
+        uint64_t runs() const { return size() > 0 ? breaks + 1 : 0; }
+
         void advance_start() {
-            min_p = *start_it + 1;
+            posting_t first = *start_it;
+            min_p = first + 1;
             ++start;
             ++start_it;
+            if (start < end && *start_it != first + 1) {
+                --breaks;
+            }
         }
 
         void advance_end() {
+            if (end > start && *end_it != max_p + 1) {
+                ++breaks;
+            }
             max_p = *end_it;
             ++end;
             ++end_it;
@@ -53,6 +66,12 @@ struct optimal_partition {
 
     optimal_partition() = default;
 
+    /**
+     * Computes the partition of minimum cost. `cost_fun(universe, size)` returns the cost of a
+     * partition; if it can also be called as `cost_fun(universe, size, runs)`, it is passed the
+     * number of runs of consecutive values in the partition too, for encodings whose size depends
+     * on it.
+     */
     template <typename ForwardIterator, typename CostFunction>
     optimal_partition(
         ForwardIterator begin,
@@ -63,13 +82,29 @@ struct optimal_partition {
         double eps1,
         double eps2
     ) {
-        cost_t single_block_cost = cost_fun(universe - base, size);
+        constexpr bool counts_runs =
+            std::is_invocable_v<CostFunction, uint64_t, uint64_t, uint64_t>;
+        auto cost = [&](uint64_t universe, uint64_t size, uint64_t runs) -> cost_t {
+            if constexpr (counts_runs) {
+                return cost_fun(universe, size, runs);
+            } else {
+                return cost_fun(universe, size);
+            }
+        };
+
+        cost_window<ForwardIterator> single_block(begin, base, 0);
+        if constexpr (counts_runs) {
+            while (single_block.size() < size) {
+                single_block.advance_end();
+            }
+        }
+        cost_t single_block_cost = cost(universe - base, size, single_block.runs());
         std::vector<cost_t> min_cost(size + 1, single_block_cost);
         min_cost[0] = 0;
 
         // create the required window: one for each power of approx_factor
         std::vector<cost_window<ForwardIterator>> windows;
-        cost_t cost_lb = cost_fun(1, 1);  // minimum cost
+        cost_t cost_lb = cost(1, 1, 1);  // minimum cost
         cost_t cost_bound = cost_lb;
         while (eps1 == 0 || cost_bound < cost_lb / eps1) {
             windows.emplace_back(begin, base, cost_bound);
@@ -90,7 +125,7 @@ struct optimal_partition {
 
                 cost_t window_cost;
                 while (true) {
-                    window_cost = cost_fun(window.universe(), window.size());
+                    window_cost = cost(window.universe(), window.size(), window.runs());
                     if ((min_cost[i] + window_cost < min_cost[window.end])) {
                         min_cost[window.end] = min_cost[i] + window_cost;
                         path[window.end] = i;
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tbb/parallel_pipeline.h>
+#include <tbb/task_arena.h>
+
+#include "binary_freq_collection.hpp"
+
+namespace pisa {
+
+/** Bounds the work and memory of `encode_posting_lists`. */
+struct PostingListPipelineParams {
+    /** Lists are read in chunks of consecutive terms with at least this many postings. */
+    std::size_t chunk_postings = 1U << 20U;
+
+    /** Maximum number of chunks in flight; 0 stands for twice the number of worker threads. */
+    std::size_t max_chunks = 0;
+};
+
+/** Number of postings of a list passed to `encode_posting_lists`. */
+template <typename List>
+[[nodiscard]] auto posting_count(List const& list) -> std::size_t {
+    if constexpr (requires { list.posting_count(); }) {
+        return list.posting_count();
+    } else {
+        return list.docs.size();
+    }
+}
+
+/**
+ * Encodes posting lists concurrently, and consumes them in the order they are read.
+ *
+ * Lists are read by calling `next_list()`, which returns the list of the next term, or
+ * `std::nullopt` after the last one. Each list must have `docs` and `freqs` ranges, or a
+ * `posting_count()` member if it is only decoded by `encode`, and must not refer to storage
+ * invalidated by the following calls, since it is kept until it is consumed.
+ * Lists are read in chunks of consecutive terms, and chunks are encoded in parallel by calling
+ * `encode(term_id, list)` on each of their lists, so `encode` must be safe to call from several
+ * threads at once. The encoded lists are then passed to `append(term_id, list, encoded)` one at a
+ * time and in term order. At most `max_chunks` chunks are in flight, which bounds the memory held
+ * by lists waiting for their turn when a long list holds back the ones after it.
+ */
+template <typename NextList, typename Encode, typename Append>
+    requires std::invocable<NextList&>
+void encode_posting_lists(
+    NextList&& next_list,
+    Encode&& encode,
+    Append&& append,
+    PostingListPipelineParams params = {}
+) {
+    using List = typename std::invoke_result_t<NextList&>::value_type;
+    using Encoded = std::invoke_result_t<Encode&, std::size_t, List const&>;
+    struct Chunk {
+        std::size_t first_term = 0;
+        std::vector<List> lists{};
+        std::vector<Encoded> encoded{};
+    };
+
+    std::size_t max_chunks = params.max_chunks;
+    if (max_chunks == 0) {
+        max_chunks = 2 * static_cast<std::size_t>(tbb::this_task_arena::max_concurrency());
+    }
+
+    std::optional<List> list = next_list();
+    std::size_t next_term = 0;
+    tbb::parallel_pipeline(
+        max_chunks,
+        tbb::make_filter<void, Chunk>(
+            tbb::filter_mode::serial_in_order,
+            [&](tbb::flow_control& fc) -> Chunk {
+                if (!list.has_value()) {
+                    fc.stop();
+                    return {};
+                }
+                Chunk chunk{next_term};
+                std::size_t postings = 0;
+                while (list.has_value() && postings < params.chunk_postings) {
+                    postings += posting_count(*list);
+                    chunk.lists.push_back(std::move(*list));
+                    list = next_list();
+                }
+                next_term += chunk.lists.size();
+                return chunk;
+            }
+        ) & tbb::make_filter<Chunk, Chunk>(
+            tbb::filter_mode::parallel,
+            [&](Chunk chunk) {
+                chunk.encoded.reserve(chunk.lists.size());
+                for (std::size_t idx = 0; idx < chunk.lists.size(); ++idx) {
+                    chunk.encoded.push_back(encode(chunk.first_term + idx, chunk.lists[idx]));
+                }
+                return chunk;
+            }
+        ) & tbb::make_filter<Chunk, void>(
+            tbb::filter_mode::serial_in_order,
+            [&](Chunk chunk) {
+                for (std::size_t idx = 0; idx < chunk.encoded.size(); ++idx) {
+                    append(
+                        chunk.first_term + idx, chunk.lists[idx], std::move(chunk.encoded[idx])
+                    );
+                }
+            }
+        )
+    );
+}
+
+/** Encodes the posting lists of a collection concurrently, and consumes them in term order. */
+template <typename Encode, typename Append>
+void encode_posting_lists(
+    binary_freq_collection const& input,
+    Encode&& encode,
+    Append&& append,
+    PostingListPipelineParams params = {}
+) {
+    auto it = input.begin();
+    auto end = input.end();
+    encode_posting_lists(
+        [&]() -> std::optional<binary_freq_collection::sequence> {
+            if (it == end) {
+                return std::nullopt;
+            }
+            auto list = *it;
+            ++it;
+            return list;
+        },
+        std::forward<Encode>(encode),
+        std::forward<Append>(append),
+        params
+    );
+}
+
+}  // namespace pisa
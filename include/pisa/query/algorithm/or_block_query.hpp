@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+#include "concepts/posting_cursor.hpp"
+#include "util/do_not_optimize_away.hpp"
+
+namespace pisa {
+
+/**
+ * Counts the documents matching at least one query term, processing postings a block at a time.
+ *
+ * Returns the same results as `or_query`. The document space is traversed in windows of
+ * `window_size` documents: the decoded blocks of each cursor mark their documents in a window
+ * bitmap, and the matching documents are counted at the end of each window.
+ */
+template <bool with_freqs>
+struct or_block_query {
+    static constexpr std::uint64_t window_size = 4096;
+
+    template <typename CursorRange>
+        requires(concepts::BlockPostingCursor<typename std::decay_t<CursorRange>::value_type>)
+    uint64_t operator()(CursorRange&& cursors, uint64_t max_docid) const {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        if (cursors.empty()) {
+            return 0;
+        }
+
+        auto min_docid = [&] {
+            return std::min_element(
+                       cursors.begin(),
+                       cursors.end(),
+                       [](Cursor const& lhs, Cursor const& rhs) {
+                           return lhs.docid() < rhs.docid();
+                       }
+            )->docid();
+        };
+
+        uint64_t results = 0;
+        std::array<std::uint64_t, window_size / 64> matched{};
+        uint64_t window_begin = min_docid();
+        while (window_begin < max_docid) {
+            uint64_t window_end = std::min(window_begin + window_size, max_docid);
+            for (auto& cursor: cursors) {
+                while (cursor.docid() < window_end) {
+                    auto block = cursor.current_block();
+                    auto count = static_cast<std::size_t>(
+                        std::lower_bound(block.docids.begin(), block.docids.end(), window_end)
+                        - block.docids.begin()
+                    );
+                    for (std::size_t pos = 0; pos < count; ++pos) {
+                        auto offset = block.docids[pos] - window_begin;
+                        matched[offset / 64] |= std::uint64_t{1} << (offset % 64);
+                    }
+                    if constexpr (with_freqs) {  // NOLINT(readability-braces-around-statements)
+                        for (std::size_t pos = 0; pos < count; ++pos) {
+                            do_not_optimize_away(block.freqs[pos]);
+                        }
+                    }
+                    if (count == block.size()) {
+                        cursor.next_block();
+                    } else {
+                        cursor.next_geq(window_end);
+                    }
+                }
+            }
+            for (auto& word: matched) {
+                results += std::popcount(word);
+                word = 0;
+            }
+            window_begin = min_docid();
+        }
+
+        return results;
+    }
+};
+
+}  // namespace pisa
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "concepts/posting_cursor.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/**
+ * Top-k disjunctive retrieval processing postings a block at a time.
+ *
+ * Returns the same results as `ranked_or_query`, but instead of moving all cursors one posting
+ * at a time, it traverses the document space in windows of `window_size` documents. Within a
+ * window, each cursor scores its decoded blocks at once with a block scorer, and the scores are
+ * added to a small dense accumulator. At the end of the window, the accumulated scores are
+ * compared against the top-k threshold with SIMD instructions.
+ */
+struct ranked_or_block_query {
+    static constexpr std::uint64_t window_size = 4096;
+
+    explicit ranked_or_block_query(topk_queue& topk) : m_topk(topk) {}
+
+    template <typename CursorRange>
+        requires(concepts::BlockScoredPostingCursor<pisa::val_t<CursorRange>>)
+    void operator()(CursorRange&& cursors, uint64_t max_docid) {
+        if (cursors.empty()) {
+            return;
+        }
+        m_scores.assign(window_size, 0.0F);
+        m_matched.fill(0);
+
+        uint64_t window_begin = min_docid(cursors);
+        while (window_begin < max_docid) {
+            uint64_t window_end = std::min(window_begin + window_size, max_docid);
+            for (auto& cursor: cursors) {
+                while (cursor.docid() < window_end) {
+                    auto block = cursor.current_block();
+                    auto count = static_cast<std::size_t>(
+                        std::lower_bound(block.docids.begin(), block.docids.end(), window_end)
+                        - block.docids.begin()
+                    );
+                    auto window_block = block.first(count);
+                    auto scores = cursor.score_block(window_block);
+                    for (std::size_t pos = 0; pos < count; ++pos) {
+                        auto offset = window_block.docids[pos] - window_begin;
+                        m_scores[offset] += scores[pos];
+                        m_matched[offset / 64] |= std::uint64_t{1} << (offset % 64);
+                    }
+                    if (count == block.size()) {
+                        cursor.next_block();
+                    } else {
+                        cursor.next_geq(window_end);
+                    }
+                }
+            }
+            collect(window_begin);
+            window_begin = min_docid(cursors);
+        }
+    }
+
+    std::vector<typename topk_queue::entry_type> const& topk() const { return m_topk.topk(); }
+
+  private:
+    template <typename CursorRange>
+    [[nodiscard]] static auto min_docid(CursorRange const& cursors) -> uint64_t {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        return std::min_element(
+                   cursors.begin(),
+                   cursors.end(),
+                   [](Cursor const& lhs, Cursor const& rhs) { return lhs.docid() < rhs.docid(); }
+        )->docid();
+    }
+
+    /**
+     * Inserts the matched documents of the window into the queue, and clears the window.
+     *
+     * Only the documents whose scores are above the current threshold are inserted, which
+     * is checked for 8 documents at a time.
+     */
+    void collect(uint64_t window_begin) {
+        for (std::size_t word_idx = 0; word_idx < m_matched.size(); ++word_idx) {
+            auto matched = m_matched[word_idx];
+            if (matched == 0) {
+                continue;
+            }
+            auto* scores = &m_scores[word_idx * 64];
+            std::uint64_t candidates = 0;
+#if defined(__AVX__)
+            auto const thresholds = _mm256_set1_ps(m_topk.effective_threshold());
+            for (std::size_t pos = 0; pos < 64; pos += 8) {
+                auto cmp = _mm256_cmp_ps(_mm256_loadu_ps(scores + pos), thresholds, _CMP_GT_OQ);
+                candidates |= static_cast<std::uint64_t>(_mm256_movemask_ps(cmp)) << pos;
+            }
+#else
+            auto const thresholds = _mm_set1_ps(m_topk.effective_threshold());
+            for (std::size_t pos = 0; pos < 64; pos += 4) {
+                auto cmp = _mm_cmpgt_ps(_mm_loadu_ps(scores + pos), thresholds);
+                candidates |= static_cast<std::uint64_t>(_mm_movemask_ps(cmp)) << pos;
+            }
+#endif
+            candidates &= matched;
+            while (candidates != 0) {
+                auto pos = static_cast<std::size_t>(__builtin_ctzll(candidates));
+                m_topk.insert(scores[pos], window_begin + word_idx * 64 + pos);
+                candidates &= candidates - 1;
+            }
+            std::fill(scores, scores + 64, 0.0F);
+            m_matched[word_idx] = 0;
+        }
+    }
+
+    topk_queue& m_topk;
+    std::vector<float> m_scores;
+    std::array<std::uint64_t, window_size / 64> m_matched{};
+};
+
+}  // namespace pisa
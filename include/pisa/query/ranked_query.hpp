@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "accumulator/block_tracking_accumulator.hpp"
+#include "accumulator/integer_accumulator.hpp"
+#include "accumulator/lazy_accumulator.hpp"
+#include "accumulator/simple_accumulator.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/block_scored_cursor.hpp"
+#include "cursor/filtered_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "document_filter.hpp"
+#include "query.hpp"
+#include "query/algorithm/block_max_maxscore_query.hpp"
+#include "query/algorithm/block_max_ranked_and_query.hpp"
+#include "query/algorithm/block_max_wand_query.hpp"
+#include "query/algorithm/maxscore_query.hpp"
+#include "query/algorithm/ranked_and_query.hpp"
+#include "query/algorithm/ranked_or_block_query.hpp"
+#include "query/algorithm/ranked_or_query.hpp"
+#include "query/algorithm/ranked_or_taat_query.hpp"
+#include "query/algorithm/wand_query.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/** Processes a query, adding its results to a top-k queue. */
+using RankedQueryFunction = std::function<void(Query const&, topk_queue&)>;
+
+/**
+ * Returns a function making query functions that process queries over `index` with the ranked
+ * algorithm named `query_type`, e.g., `block_max_wand` or `ranked_or_taat`.
+ *
+ * Each query function owns its state, such as the accumulator of term-at-a-time algorithms, so a
+ * query function must not be called by several threads at once, but each thread can make its own.
+ * If `filter` is not null, the cursors are wrapped so that they skip the documents it excludes;
+ * otherwise, the cursors are passed to the algorithms as they are.
+ *
+ * \throws std::invalid_argument    Thrown if the algorithm is unknown, or if it does not support
+ *                                  document filters and `filter` is not null.
+ */
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto ranked_query_functions(
+    std::string const& query_type,
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    bool weighted,
+    DocumentFilter const* filter
+) -> std::function<RankedQueryFunction()> {
+    auto run = [filter](auto&& algorithm, auto cursors, auto&&... args) {
+        if (filter != nullptr) {
+            algorithm(filter_cursors(std::move(cursors), *filter), args...);
+        } else {
+            algorithm(std::move(cursors), args...);
+        }
+    };
+    auto num_docs = index.num_docs();
+
+    if (query_type == "wand") {
+        return [=, &index, &wdata, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &wdata, &scorer](Query const& query, topk_queue& topk) {
+                run(
+                    wand_query(topk),
+                    make_max_scored_cursors(index, wdata, scorer, query, weighted),
+                    num_docs
+                );
+            };
+        };
+    }
+    if (query_type == "block_max_wand") {
+        return [=, &index, &wdata, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &wdata, &scorer](Query const& query, topk_queue& topk) {
+                run(
+                    block_max_wand_query(topk),
+                    make_block_max_scored_cursors(index, wdata, scorer, query, weighted),
+                    num_docs
+                );
+            };
+        };
+    }
+    if (query_type == "block_max_maxscore") {
+        return [=, &index, &wdata, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &wdata, &scorer](Query const& query, topk_queue& topk) {
+                run(
+                    block_max_maxscore_query(topk),
+                    make_block_max_scored_cursors(index, wdata, scorer, query, weighted),
+                    num_docs
+                );
+            };
+        };
+    }
+    if (query_type == "block_max_ranked_and") {
+        return [=, &index, &wdata, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &wdata, &scorer](Query const& query, topk_queue& topk) {
+                run(
+                    block_max_ranked_and_query(topk),
+                    make_block_max_scored_cursors(index, wdata, scorer, query, weighted),
+                    num_docs
+                );
+            };
+        };
+    }
+    if (query_type == "ranked_and") {
+        return [=, &index, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &scorer](Query const& query, topk_queue& topk) {
+                run(
+                    ranked_and_query(topk),
+                    make_scored_cursors(index, scorer, query, weighted),
+                    num_docs
+                );
+            };
+        };
+    }
+    if (query_type == "ranked_or") {
+        return [=, &index, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &scorer](Query const& query, topk_queue& topk) {
+                run(
+                    ranked_or_query(topk),
+                    make_scored_cursors(index, scorer, query, weighted),
+                    num_docs
+                );
+            };
+        };
+    }
+    if (query_type == "ranked_or_block") {
+        if (filter != nullptr) {
+            throw std::invalid_argument(
+                fmt::format("query type {} does not support document filters", query_type)
+            );
+        }
+        return [=, &index, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &scorer](Query const& query, topk_queue& topk) {
+                ranked_or_block_query ranked_or_q(topk);
+                ranked_or_q(make_block_scored_cursors(index, scorer, query, weighted), num_docs);
+            };
+        };
+    }
+    if (query_type == "maxscore") {
+        return [=, &index, &wdata, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &wdata, &scorer](Query const& query, topk_queue& topk) {
+                run(
+                    maxscore_query(topk),
+                    make_max_scored_cursors(index, wdata, scorer, query, weighted),
+                    num_docs
+                );
+            };
+        };
+    }
+
+    auto taat = [=, &index, &scorer](auto make_accumulator) {
+        return [=, &index, &scorer]() -> RankedQueryFunction {
+            return [=, &index, &scorer, accumulator = make_accumulator()](
+                       Query const& query, topk_queue& topk
+                   ) mutable {
+                run(
+                    ranked_or_taat_query(topk),
+                    make_scored_cursors(index, scorer, query, weighted),
+                    num_docs,
+                    accumulator
+                );
+            };
+        };
+    };
+    if (query_type == "ranked_or_taat") {
+        return taat([num_docs] { return SimpleAccumulator(num_docs); });
+    }
+    if (query_type == "ranked_or_taat_lazy") {
+        return taat([num_docs] { return LazyAccumulator<4>(num_docs); });
+    }
+    if (query_type == "ranked_or_taat_blocked") {
+        return taat([num_docs] { return BlockTrackingAccumulator<>(num_docs); });
+    }
+    if (query_type == "ranked_or_taat_quantized") {
+        return taat([num_docs] { return IntegerAccumulator<std::uint16_t>(num_docs); });
+    }
+    if (query_type == "ranked_or_taat_quantized32") {
+        return taat([num_docs] { return IntegerAccumulator<std::uint32_t>(num_docs); });
+    }
+    throw std::invalid_argument(fmt::format("unsupported query type: {}", query_type));
+}
+
+}  // namespace pisa
@@ -10,6 +10,7 @@
 
 #include <spdlog/spdlog.h>
 
+#include "binary_collection_writer.hpp"
 #include "binary_freq_collection.hpp"
 #include "payload_vector.hpp"
 #include "recursive_graph_bisection.hpp"
@@ -31,6 +32,7 @@ struct RecursiveGraphBisectionOptions {
     std::size_t min_length;
     bool compress_fwd;
     bool print_args;
+    BinaryCollectionFormat collection_format = BinaryCollectionFormat::Raw;
 };
 
 namespace detail {
@@ -109,7 +111,9 @@ namespace detail {
         auto mapping = get_mapping(documents);
         fwd.clear();
         documents.clear();
-        reorder_inverted_index(options.input_basename, *options.output_basename, mapping);
+        reorder_inverted_index(
+            options.input_basename, *options.output_basename, mapping, options.collection_format
+        );
 
         if (options.document_lexicon) {
             auto doc_buffer = Payload_Vector_Buffer::from_file(*options.document_lexicon);
@@ -132,21 +136,24 @@ struct ReorderOptions {
     std::string output_basename;
     std::optional<std::string> document_lexicon;
     std::optional<std::string> reordered_document_lexicon;
+    BinaryCollectionFormat collection_format = BinaryCollectionFormat::Raw;
 };
 
 inline auto reorder_postings(
     binary_freq_collection const& input,
     std::string_view output_basename,
-    std::span<std::uint32_t const> mapping
+    std::span<std::uint32_t const> mapping,
+    BinaryCollectionFormat format = BinaryCollectionFormat::Raw
 ) {
     pisa::progress progress("Reassigning IDs in posting lists", input.size());
 
-    std::ofstream output_docs(fmt::format("{}.docs", output_basename));
-    std::ofstream output_freqs(fmt::format("{}.freqs", output_basename));
-    emit(output_docs, 1);
-    emit(output_docs, input.num_docs());
+    BinaryCollectionWriter output_docs(fmt::format("{}.docs", output_basename), format);
+    BinaryCollectionWriter output_freqs(fmt::format("{}.freqs", output_basename), format);
+    output_docs.write(static_cast<std::uint32_t>(input.num_docs()));
 
     std::vector<std::pair<std::uint32_t, std::uint32_t>> posting_list;
+    std::vector<std::uint32_t> docs;
+    std::vector<std::uint32_t> freqs;
     for (const auto& seq: input) {
         for (size_t i = 0; i < seq.docs.size(); ++i) {
             posting_list.emplace_back(pisa::at(mapping, seq.docs.begin()[i]), seq.freqs.begin()[i]);
@@ -154,15 +161,17 @@ inline auto reorder_postings(
 
         std::sort(posting_list.begin(), posting_list.end());
 
-        emit(output_docs, posting_list.size());
-        emit(output_freqs, posting_list.size());
         for (const auto& posting: posting_list) {
-            emit(output_docs, posting.first);
-            emit(output_freqs, posting.second);
+            docs.push_back(posting.first);
+            freqs.push_back(posting.second);
         }
+        output_docs.write(std::span<std::uint32_t const>(docs));
+        output_freqs.write(std::span<std::uint32_t const>(freqs));
 
         progress.update(1);
         posting_list.clear();
+        docs.clear();
+        freqs.clear();
     }
 }
 
@@ -188,7 +197,8 @@ inline auto reorder_sizes(
     binary_collection const& input_sizes,
     std::uint64_t num_docs,
     std::span<std::uint32_t const> mapping,
-    std::string_view output_basename
+    std::string_view output_basename,
+    BinaryCollectionFormat format = BinaryCollectionFormat::Raw
 ) {
     pisa::progress progress("Reordering document sizes", num_docs);
     auto sizes = *input_sizes.begin();
@@ -206,9 +216,8 @@ inline auto reorder_sizes(
         progress.update(1);
     }
 
-    std::ofstream output_sizes(fmt::format("{}.sizes", output_basename));
-    emit(output_sizes, new_sizes.size());
-    emit(output_sizes, new_sizes.data(), num_docs);
+    BinaryCollectionWriter output_sizes(fmt::format("{}.sizes", output_basename), format);
+    output_sizes.write(std::span<std::uint32_t const>(new_sizes));
 }
 
 inline void reorder_from_mapping(
@@ -218,8 +227,10 @@ inline void reorder_from_mapping(
     std::span<std::uint32_t const> mapping
 ) {
     auto num_docs = input_collection.num_docs();
-    reorder_sizes(input_sizes, num_docs, mapping, options.output_basename);
-    reorder_postings(input_collection, options.output_basename, mapping);
+    reorder_sizes(
+        input_sizes, num_docs, mapping, options.output_basename, options.collection_format
+    );
+    reorder_postings(input_collection, options.output_basename, mapping, options.collection_format);
     if (options.document_lexicon) {
         reorder_lexicon(*options.document_lexicon, *options.reordered_document_lexicon, mapping);
     }
@@ -266,24 +277,34 @@ inline auto reorder_by_feature(ReorderOptions options, std::string const& featur
     return 0;
 }
 
+/// Reads a document order file, where each line maps a document ID to its new ID, and returns
+/// the new ID of each document. Each document must be mapped exactly once.
+inline auto read_mapping(std::string const& mapping_file) -> std::vector<std::uint32_t> {
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> entries;
+    std::ifstream is(mapping_file);
+    uint32_t prev_id, new_id;
+    while (is >> prev_id >> new_id) {
+        entries.emplace_back(prev_id, new_id);
+    }
+    std::vector<std::uint32_t> mapping(entries.size());
+    std::vector<bool> mapped(entries.size(), false);
+    for (auto [docid, mapped_docid]: entries) {
+        if (docid >= mapping.size() || mapped[docid]) {
+            throw std::invalid_argument(fmt::format("Invalid document order file: {}", mapping_file));
+        }
+        mapping[docid] = mapped_docid;
+        mapped[docid] = true;
+    }
+    return mapping;
+}
+
 inline auto reorder_from_mapping(ReorderOptions options, std::string mapping_file) -> int {
     spdlog::info("Reading mapping");
     binary_freq_collection input_collection(options.input_basename.c_str());
-    auto const mapping = [&] {
-        std::vector<std::uint32_t> mapping(input_collection.num_docs());
-
-        std::ifstream is(mapping_file);
-        uint32_t prev_id, new_id;
-        size_t count = 0;
-        while (is >> prev_id >> new_id) {
-            mapping[prev_id] = new_id;
-            ++count;
-        }
-        if (mapping.size() != count) {
-            throw std::invalid_argument(fmt::format("Invalid document order file: {}", mapping_file));
-        }
-        return mapping;
-    }();
+    auto const mapping = read_mapping(mapping_file);
+    if (mapping.size() != input_collection.num_docs()) {
+        throw std::invalid_argument(fmt::format("Invalid document order file: {}", mapping_file));
+    }
     binary_collection input_sizes(fmt::format("{}.sizes", options.input_basename).c_str());
     reorder_from_mapping(input_collection, input_sizes, options, mapping);
     return 0;
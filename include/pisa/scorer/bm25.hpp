@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 
 #include "index_scorer.hpp"
 
@@ -43,6 +45,21 @@ struct bm25: public WandIndexScorer<Wand> {
         return s;
     }
 
+    BlockTermScorer block_term_scorer(uint64_t term_id) const override {
+        auto term_len = this->m_wdata.term_posting_count(term_id);
+        auto term_weight = query_term_weight(term_len, this->m_wdata.num_docs());
+        return [&, term_weight](
+                   std::span<std::uint32_t const> docids,
+                   std::span<std::uint32_t const> freqs,
+                   std::span<float> scores
+               ) {
+            for (std::size_t pos = 0; pos < docids.size(); ++pos) {
+                scores[pos] = term_weight
+                    * doc_term_weight(freqs[pos], this->m_wdata.norm_len(docids[pos]));
+            }
+        };
+    }
+
   private:
     float m_b;
     float m_k1;
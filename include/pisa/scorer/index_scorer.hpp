@@ -1,12 +1,24 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <span>
 
 namespace pisa {
 
 using TermScorer = std::function<float(uint32_t, uint32_t)>;
 
+/**
+ * Scores a block of postings at once: the score of the posting with document ID `docids[i]`
+ * and frequency `freqs[i]` is written to `scores[i]`.
+ */
+using BlockTermScorer = std::function<void(
+    std::span<std::uint32_t const> docids,
+    std::span<std::uint32_t const> freqs,
+    std::span<float> scores
+)>;
+
 /** Index scorer construct scorers for terms in the index. */
 class IndexScorer {
   public:
@@ -17,6 +29,25 @@ class IndexScorer {
     IndexScorer& operator=(IndexScorer&&) noexcept = delete;
     virtual ~IndexScorer() = default;
     virtual TermScorer term_scorer(std::uint64_t term_id) const = 0;
+
+    /**
+     * Constructs a scorer for entire blocks of postings of the given term.
+     *
+     * The default implementation calls the term scorer for each posting. Scorers should override
+     * it with a loop that does not go through a function call per posting, so that the compiler
+     * can vectorize it.
+     */
+    virtual BlockTermScorer block_term_scorer(std::uint64_t term_id) const {
+        return [scorer = term_scorer(term_id)](
+                   std::span<std::uint32_t const> docids,
+                   std::span<std::uint32_t const> freqs,
+                   std::span<float> scores
+               ) {
+            for (std::size_t pos = 0; pos < docids.size(); ++pos) {
+                scores[pos] = scorer(docids[pos], freqs[pos]);
+            }
+        };
+    }
 };
 
 /** Index scorer using WAND metadata for scoring. */
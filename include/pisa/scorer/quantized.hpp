@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <span>
 #include <utility>
 
 #include "index_scorer.hpp"
@@ -16,6 +18,14 @@ struct quantized: public WandIndexScorer<Wand> {
     TermScorer term_scorer([[maybe_unused]] uint64_t term_id) const {
         return []([[maybe_unused]] uint32_t doc, uint32_t freq) { return freq; };
     }
+
+    BlockTermScorer block_term_scorer([[maybe_unused]] uint64_t term_id) const override {
+        return [](std::span<std::uint32_t const> /* docids */,
+                  std::span<std::uint32_t const> freqs,
+                  std::span<float> scores) {
+            std::copy(freqs.begin(), freqs.end(), scores.begin());
+        };
+    }
 };
 
 /**
@@ -0,0 +1,493 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <tbb/parallel_for.h>
+
+#include "binary_freq_collection.hpp"
+#include "compress.hpp"
+#include "index_types.hpp"
+#include "invert.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "memory_source.hpp"
+#include "query.hpp"
+#include "scorer/scorer.hpp"
+#include "term_map.hpp"
+#include "topk_queue.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+#include "wand_utils.hpp"
+
+namespace pisa {
+
+/**
+ * An immutable index of consecutive documents, along with its wand data and lexicons.
+ *
+ * The files of a segment are `{name}.index`, `{name}.wand`, `{name}.termlex`, and `{name}.doclex`
+ * in the directory of its manifest, and `{name}.blockmax` once it has been opened for queries, see
+ * `SegmentedIndex`.
+ */
+struct SegmentInfo {
+    std::string name;
+    std::uint32_t num_docs = 0;
+    /** Number of merges the documents of the segment went through. */
+    std::uint32_t level = 0;
+};
+
+/** Returns the path of the file of the segment with the given extension, e.g., `.index`. */
+[[nodiscard]] auto segment_path(
+    std::filesystem::path const& manifest, std::string_view name, std::string_view extension
+) -> std::string;
+
+/**
+ * List of the live segments of an index, in document order.
+ *
+ * Documents have global IDs: the documents of a segment are numbered from the number of documents
+ * in the segments preceding it. All segments share the encoding of the index, but each one has
+ * its own term lexicon, holding only the terms of its documents, so term IDs are local to a
+ * segment, as they are to a shard.
+ *
+ * The manifest is a text file, which is only ever replaced as a whole, so readers see either the
+ * segments before or after an update. Readers map the files of the segments with
+ * `open_segments`, so that a merge cannot remove them in the meantime.
+ */
+class SegmentManifest {
+  public:
+    explicit SegmentManifest(std::string encoding);
+
+    /**
+     * Reads a manifest.
+     *
+     * \throws io::NoSuchFile        Thrown if the file does not exist.
+     * \throws std::runtime_error    Thrown if the file is not a valid manifest.
+     */
+    [[nodiscard]] static auto read(std::filesystem::path const& path) -> SegmentManifest;
+
+    /** Writes the manifest to a temporary file, and renames it to `path`. */
+    void write(std::filesystem::path const& path) const;
+
+    /**
+     * Reads the manifest, applies `update` to it, and writes it back, while holding an exclusive
+     * lock on `{path}.lock`, so that updates from several processes, e.g., adding a segment while
+     * a merge runs in the background, are not lost. Returns the updated manifest.
+     */
+    static auto update(
+        std::filesystem::path const& path, std::function<void(SegmentManifest&)> const& update
+    ) -> SegmentManifest;
+
+    /**
+     * Reads the manifest, and calls `open` with it while holding a shared lock on `{path}.lock`.
+     *
+     * A merge removes the files of the merged segments once it has replaced them in the manifest,
+     * which takes an exclusive lock, so the files of the segments read here are not removed
+     * before `open` has mapped them; once mapped, they stay readable until they are unmapped.
+     */
+    static void open_segments(
+        std::filesystem::path const& path, std::function<void(SegmentManifest const&)> const& open
+    );
+
+    [[nodiscard]] auto encoding() const noexcept -> std::string const&;
+    [[nodiscard]] auto segments() const noexcept -> std::vector<SegmentInfo> const&;
+
+    /** Total number of documents in all segments. */
+    [[nodiscard]] auto num_docs() const noexcept -> std::uint64_t;
+
+    /** Global ID of the first document of each segment. */
+    [[nodiscard]] auto document_offsets() const -> std::vector<std::uint32_t>;
+
+    /** Returns a name that was never given to a segment of this index. */
+    [[nodiscard]] auto new_segment_name() -> std::string;
+
+    /** Adds a segment after the others. */
+    void append(SegmentInfo segment);
+
+    /**
+     * Replaces the consecutive segments with the given names by `merged`.
+     *
+     * \throws std::invalid_argument    Thrown if the segments are not found in this order, e.g.,
+     *                                  if they were merged by another process.
+     */
+    void replace(std::vector<std::string> const& names, SegmentInfo merged);
+
+  private:
+    std::string m_encoding;
+    std::uint64_t m_generation = 0;
+    std::vector<SegmentInfo> m_segments{};
+};
+
+/**
+ * Tiered merge policy, as in log-structured merge trees.
+ *
+ * New segments have level 0, and whenever `fanout` consecutive segments have the same level, they
+ * are merged into a segment of the next level. Each document is thus merged once per level, and
+ * the number of segments grows logarithmically with the number of documents.
+ */
+struct TieredMergePolicy {
+    std::size_t fanout = 10;
+
+    /**
+     * Returns the range `[first, last)` of the segments to merge next, if any: the oldest
+     * `fanout` consecutive segments of the lowest level having that many.
+     *
+     * \throws std::invalid_argument    Thrown if the fanout is lower than 2.
+     */
+    [[nodiscard]] auto select(std::vector<SegmentInfo> const& segments) const
+        -> std::optional<std::pair<std::size_t, std::size_t>>;
+};
+
+/**
+ * Inverts a forward index into a new segment, with `invert_and_compress`, and appends it to the
+ * index. The wand data is written to the file of the segment instead of `wand_options.output`,
+ * and the lexicons `{forward_index_basename}.termlex` and `.doclex` are copied next to it.
+ *
+ * Segments only support uncompressed wand data, without quantization.
+ */
+auto add_segment(
+    std::filesystem::path const& manifest_path,
+    std::string const& forward_index_basename,
+    invert::InvertParams const& invert_params,
+    WandDataOptions wand_options
+) -> SegmentInfo;
+
+/**
+ * Merges the consecutive segments `[first, last)` of the index into a segment of the next level,
+ * replaces them in the manifest, and removes their files. Returns the merged segment.
+ *
+ * The term lexicons of the segments are merged, and the posting lists of each term are read and
+ * concatenated with their document IDs shifted, and encoded straight into the merged segment,
+ * without writing an uncompressed collection. The statistics of the wand data are taken from the
+ * wand data of the segments, so the forward indexes are not needed either.
+ */
+auto merge_segments(
+    std::filesystem::path const& manifest_path,
+    std::size_t first,
+    std::size_t last,
+    WandDataOptions wand_options
+) -> SegmentInfo;
+
+/**
+ * Merges the segments selected by the policy until it selects none, and returns the number of
+ * merges. Merges only happen when this is called, e.g., after adding segments; since the
+ * manifest is read again before each merge, this can run in another process while segments are
+ * added or queried.
+ */
+auto merge_segments(
+    std::filesystem::path const& manifest_path,
+    TieredMergePolicy const& policy,
+    WandDataOptions const& wand_options
+) -> std::size_t;
+
+/** Returns the query of the terms found in the lexicon; the others are ignored. */
+[[nodiscard]] auto
+lexicon_query(std::vector<std::string> const& terms, LexiconMap const& lexicon) -> Query;
+
+/**
+ * Wand data of a segment, with the statistics of all segments.
+ *
+ * The sizes of the documents are read from the wand data of the segment, but the number of
+ * documents, their average size, and the statistics of the terms are those of the whole index, so
+ * that a document has the same score as in the index of all documents, whatever segment it is in.
+ * The maximum scores of the lists and of their blocks depend on these statistics, so they are
+ * computed again from the postings of the segment by `compute_block_max_scores`, and written along
+ * with a key of the statistics they were computed with, so that they are only computed again
+ * once the statistics change.
+ */
+class SegmentWandData {
+  public:
+    using wand_data_enumerator = wand_data_raw::enumerator;
+
+    /** Maps the uncompressed wand data of the segment. */
+    explicit SegmentWandData(MemorySource source);
+
+    /** Wand data of the segment, with its own statistics. */
+    [[nodiscard]] auto segment() const noexcept -> wand_data<wand_data_raw> const& {
+        return m_segment;
+    }
+
+    /**
+     * Sets the statistics of the whole index, where the counts of the terms are given by their
+     * IDs in the segment.
+     */
+    void set_collection_statistics(
+        std::uint64_t num_docs,
+        std::uint64_t collection_len,
+        std::vector<std::uint32_t> term_occurrence_counts,
+        std::vector<std::uint32_t> term_posting_counts
+    );
+
+    /**
+     * Returns the key of the block-max scores computed with the statistics set last, and with the
+     * given scorer and blocks: a hash of everything the scores depend on.
+     */
+    [[nodiscard]] auto
+    block_max_key(ScorerParams const& scorer_params, BlockSize block_size) const -> std::uint64_t;
+
+    /**
+     * Maps the block-max scores written to `path` by `write_block_max_scores`, if they have the
+     * given key. Returns `false`, leaving the scores unset, if they do not, or if the file does
+     * not exist.
+     */
+    auto map_block_max_scores(std::string const& path, std::uint64_t key) -> bool;
+
+    /** Writes the block-max scores with the given key, replacing the file `path` atomically. */
+    void write_block_max_scores(std::string const& path, std::uint64_t key);
+
+    /**
+     * Computes the maximum scores of the lists of the index of the segment, and of their blocks,
+     * with `scorer`, which must score with these wand data. Lists are decoded concurrently.
+     */
+    template <typename Index>
+    void compute_block_max_scores(
+        Index const& index, WandIndexScorer<SegmentWandData> const& scorer, BlockSize block_size
+    ) {
+        std::vector<BlockMaxList> lists(index.size());
+        tbb::parallel_for(std::size_t(0), index.size(), [&](std::size_t term_id) {
+            auto cursor = index[term_id];
+            std::vector<std::uint32_t> docs;
+            std::vector<std::uint32_t> freqs;
+            docs.reserve(cursor.size());
+            freqs.reserve(cursor.size());
+            for (; cursor.docid() < index.num_docs(); cursor.next()) {
+                docs.push_back(cursor.docid());
+                freqs.push_back(cursor.freq());
+            }
+            binary_freq_collection::sequence seq{
+                {docs.data(), docs.data() + docs.size()},
+                {freqs.data(), freqs.data() + freqs.size()}
+            };
+            lists[term_id] = wand_data_raw::compute_block_max_list(
+                seq, index.num_docs(), scorer.term_scorer(term_id), block_size
+            );
+        });
+        set_block_max_scores(std::move(lists));
+    }
+
+    [[nodiscard]] auto norm_len(std::uint64_t doc_id) const -> float {
+        return m_segment.doc_len(doc_id) / m_avg_len;
+    }
+    [[nodiscard]] auto doc_len(std::uint64_t doc_id) const -> std::size_t {
+        return m_segment.doc_len(doc_id);
+    }
+    [[nodiscard]] auto term_occurrence_count(std::uint64_t term_id) const -> std::size_t {
+        return m_term_occurrence_counts[term_id];
+    }
+    [[nodiscard]] auto term_posting_count(std::uint64_t term_id) const -> std::size_t {
+        return m_term_posting_counts[term_id];
+    }
+    [[nodiscard]] auto index_max_term_weight() const -> float {
+        return m_scores.index_max_term_weight;
+    }
+    [[nodiscard]] auto num_docs() const -> std::size_t { return m_num_docs; }
+    [[nodiscard]] auto avg_len() const -> float { return m_avg_len; }
+    [[nodiscard]] auto collection_len() const -> std::uint64_t { return m_collection_len; }
+    [[nodiscard]] auto max_term_weight(std::uint64_t term_id) const -> float {
+        return m_scores.max_term_weight[term_id];
+    }
+    [[nodiscard]] auto getenum(std::size_t term_id) const -> wand_data_enumerator {
+        auto const& blocks_start = m_scores.blocks_start;
+        return wand_data_enumerator(
+            blocks_start[term_id],
+            blocks_start[term_id + 1] - blocks_start[term_id],
+            m_scores.block_max_term_weight,
+            m_scores.block_docid
+        );
+    }
+
+  private:
+    void set_block_max_scores(std::vector<BlockMaxList> lists);
+
+    /** Block-max scores of the lists, in the layout of `mapper::freeze`. */
+    struct BlockMaxScores {
+        std::uint64_t key = 0;
+        mapper::mappable_vector<std::uint64_t> blocks_start;
+        mapper::mappable_vector<float> max_term_weight;
+        mapper::mappable_vector<float> block_max_term_weight;
+        mapper::mappable_vector<std::uint32_t> block_docid;
+        float index_max_term_weight = 0;
+
+        template <typename Visitor>
+        void map(Visitor& visit) {
+            visit(key, "key")(blocks_start, "blocks_start")(max_term_weight, "max_term_weight")(
+                block_max_term_weight, "block_max_term_weight"
+            )(block_docid, "block_docid")(index_max_term_weight, "index_max_term_weight");
+        }
+    };
+
+    wand_data<wand_data_raw> m_segment;
+    std::uint64_t m_num_docs = 0;
+    float m_avg_len = 0;
+    std::uint64_t m_collection_len = 0;
+    std::vector<std::uint32_t> m_term_occurrence_counts{};
+    std::vector<std::uint32_t> m_term_posting_counts{};
+    BlockMaxScores m_scores;
+    /** Mapped file of the scores, if they were not computed. */
+    std::optional<MemorySource> m_scores_source{};
+};
+
+/**
+ * The segments of an index, opened for ranked query processing.
+ *
+ * Documents are scored with the statistics of all segments, see `SegmentWandData`, so scores do
+ * not depend on the segment a document is in, and the results of a query are those of the index of
+ * all documents. The maximum scores of the lists, in blocks of the given size, depend on these
+ * statistics: opening the index maps the ones written by a previous opening with the same
+ * statistics, scorer, and blocks, and otherwise decodes the lists of the segment to compute them
+ * and writes them to `{name}.blockmax`. Adding or merging segments changes the statistics of all
+ * of them, so the first opening after it computes the scores of all segments, and the following
+ * ones decode nothing.
+ */
+template <typename Index>
+class SegmentedIndex {
+  public:
+    struct Segment {
+        Segment(
+            std::filesystem::path const& manifest_path,
+            std::string_view encoding,
+            std::string_view name,
+            std::uint32_t document_offset
+        )
+            : name(name),
+              index(open_index<Index>(
+                encoding, MemorySource::mapped_file(segment_path(manifest_path, name, ".index"))
+            )),
+              wdata(MemorySource::mapped_file(segment_path(manifest_path, name, ".wand"))),
+              terms(segment_path(manifest_path, name, ".termlex")),
+              documents(segment_path(manifest_path, name, ".doclex")),
+              document_offset(document_offset) {}
+
+        std::string name;
+        Index index;
+        SegmentWandData wdata;
+        std::unique_ptr<WandIndexScorer<SegmentWandData>> scorer{};
+        LexiconMap terms;
+        /** Titles of the documents, by local ID. */
+        LexiconMap documents;
+        /** Global ID of the first document of the segment. */
+        std::uint32_t document_offset;
+    };
+
+    SegmentedIndex(
+        std::filesystem::path const& manifest_path,
+        ScorerParams const& scorer_params,
+        BlockSize block_size
+    ) {
+        // The scores are written while holding the lock of the manifest, so that a merge does not
+        // remove a segment before they are written.
+        SegmentManifest::open_segments(manifest_path, [&](SegmentManifest const& manifest) {
+            auto offsets = manifest.document_offsets();
+            for (std::size_t idx = 0; idx < offsets.size(); ++idx) {
+                m_segments.emplace_back(
+                    manifest_path, manifest.encoding(), manifest.segments()[idx].name, offsets[idx]
+                );
+            }
+            m_num_docs = manifest.num_docs();
+            open_block_max_scores(manifest_path, scorer_params, block_size);
+        });
+    }
+
+    [[nodiscard]] auto segments() const noexcept -> std::deque<Segment> const& {
+        return m_segments;
+    }
+
+    [[nodiscard]] auto num_docs() const noexcept -> std::uint64_t { return m_num_docs; }
+
+    /** Returns the title of the document with the given global ID. */
+    [[nodiscard]] auto document(std::uint32_t docid) const -> std::string_view {
+        auto segment = std::upper_bound(
+            m_segments.begin(), m_segments.end(), docid, [](auto docid, auto const& segment) {
+                return docid < segment.document_offset;
+            }
+        );
+        if (segment == m_segments.begin() || docid >= m_num_docs) {
+            throw std::out_of_range(fmt::format("document {} out of {}", docid, m_num_docs));
+        }
+        --segment;
+        return segment->documents[docid - segment->document_offset];
+    }
+
+    /**
+     * Processes a query over all segments into `topk`, with the global IDs of the documents.
+     *
+     * The query is processed on one segment at a time by calling `run(segment, query, topk)`,
+     * with the terms mapped to the IDs of the segment, and a queue starting from the
+     * threshold reached so far, so that the results of the previous segments keep pruning the
+     * documents of the following ones. Its results are then added to `topk`.
+     */
+    template <typename Run>
+    void query(std::vector<std::string> const& terms, topk_queue& topk, Run&& run) const {
+        for (auto const& segment: m_segments) {
+            auto segment_query = lexicon_query(terms, segment.terms);
+            if (segment_query.terms().empty()) {
+                continue;
+            }
+            topk_queue segment_topk(topk.capacity(), topk.effective_threshold());
+            run(segment, segment_query, segment_topk);
+            segment_topk.finalize();
+            for (auto const& [score, docid]: segment_topk.topk()) {
+                topk.insert(score, docid + segment.document_offset);
+            }
+        }
+    }
+
+  private:
+    /**
+     * Sets the statistics of all segments in their wand data, and maps or computes the maximum
+     * scores of their lists.
+     */
+    void open_block_max_scores(
+        std::filesystem::path const& manifest_path,
+        ScorerParams const& scorer_params,
+        BlockSize block_size
+    ) {
+        // Terms are matched across segments by their text, since each segment has its own IDs.
+        std::uint64_t collection_len = 0;
+        std::unordered_map<std::string_view, std::pair<std::uint32_t, std::uint32_t>> term_counts;
+        for (auto const& segment: m_segments) {
+            auto const& wdata = segment.wdata.segment();
+            collection_len += wdata.collection_len();
+            for (std::uint32_t term_id = 0; term_id < segment.terms.size(); ++term_id) {
+                auto& [occurrences, postings] = term_counts[segment.terms[term_id]];
+                occurrences += wdata.term_occurrence_count(term_id);
+                postings += wdata.term_posting_count(term_id);
+            }
+        }
+        for (auto& segment: m_segments) {
+            std::vector<std::uint32_t> occurrences(segment.terms.size());
+            std::vector<std::uint32_t> postings(segment.terms.size());
+            for (std::uint32_t term_id = 0; term_id < segment.terms.size(); ++term_id) {
+                std::tie(occurrences[term_id], postings[term_id]) =
+                    term_counts.at(segment.terms[term_id]);
+            }
+            segment.wdata.set_collection_statistics(
+                m_num_docs, collection_len, std::move(occurrences), std::move(postings)
+            );
+            segment.scorer = scorer::from_params(scorer_params, segment.wdata);
+            auto path = segment_path(manifest_path, segment.name, ".blockmax");
+            auto key = segment.wdata.block_max_key(scorer_params, block_size);
+            if (!segment.wdata.map_block_max_scores(path, key)) {
+                segment.wdata.compute_block_max_scores(segment.index, *segment.scorer, block_size);
+                segment.wdata.write_block_max_scores(path, key);
+            }
+        }
+    }
+
+    // Segments are never moved, since their scorers refer to their wand data.
+    std::deque<Segment> m_segments{};
+    std::uint64_t m_num_docs = 0;
+};
+
+}  // namespace pisa
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <variant>
+
+#include "codec/all_ones_sequence.hpp"
+#include "codec/compact_elias_fano.hpp"
+#include "codec/compact_ranked_bitvector.hpp"
+#include "codec/compact_run_sequence.hpp"
+#include "global_parameters.hpp"
+
+namespace pisa {
+
+/**
+ * Sequence choosing the smallest of a packed-gap (Elias-Fano), bitmap (ranked bitvector) and
+ * run-length container, in the spirit of Roaring bitmaps.
+ *
+ * It extends `indexed_sequence` with the run container, which is only worth it for very dense
+ * sequences, such as the partitions of the posting lists of stopword-class terms. Since the cost
+ * of the run container depends on the values, `bitsize(params, universe, n)` only accounts for the
+ * other containers, and is thus an upper bound of the actual size; the exact size is given by
+ * `bitsize(params, universe, n, runs)`, which `partitioned_sequence` uses to choose the partitions.
+ */
+struct hybrid_sequence {
+    enum index_type {
+        elias_fano = 0,
+        ranked_bitvector = 1,
+        runs = 2,
+        all_ones = 3,
+
+        index_types = 4
+    };
+
+    static const uint64_t type_bits = 2;  // all_ones is implicit
+
+    static PISA_FLATTEN_FUNC uint64_t
+    bitsize(global_parameters const& params, uint64_t universe, uint64_t n) {
+        uint64_t best_cost = all_ones_sequence::bitsize(params, universe, n);
+        best_cost =
+            std::min(best_cost, compact_elias_fano::bitsize(params, universe, n) + type_bits);
+        best_cost =
+            std::min(best_cost, compact_ranked_bitvector::bitsize(params, universe, n) + type_bits);
+        return best_cost;
+    }
+
+    static PISA_FLATTEN_FUNC uint64_t
+    bitsize(global_parameters const& params, uint64_t universe, uint64_t n, uint64_t runs) {
+        uint64_t best_cost = bitsize(params, universe, n);
+        if (best_cost == 0) {
+            return best_cost;
+        }
+        return std::min(
+            best_cost, compact_run_sequence::bitsize(params, universe, n, runs) + type_bits
+        );
+    }
+
+    template <typename Iterator>
+    static void write(
+        bit_vector_builder& bvb,
+        Iterator begin,
+        uint64_t universe,
+        uint64_t n,
+        global_parameters const& params
+    ) {
+        uint64_t best_cost = all_ones_sequence::bitsize(params, universe, n);
+        int best_type = all_ones;
+
+        if (best_cost) {
+            uint64_t ef_cost = compact_elias_fano::bitsize(params, universe, n) + type_bits;
+            if (ef_cost < best_cost) {
+                best_cost = ef_cost;
+                best_type = elias_fano;
+            }
+
+            uint64_t rb_cost = compact_ranked_bitvector::bitsize(params, universe, n) + type_bits;
+            if (rb_cost < best_cost) {
+                best_cost = rb_cost;
+                best_type = ranked_bitvector;
+            }
+
+            uint64_t num_runs = compact_run_sequence::count_runs(begin, n);
+            uint64_t runs_cost =
+                compact_run_sequence::bitsize(params, universe, n, num_runs) + type_bits;
+            if (runs_cost < best_cost) {
+                best_cost = runs_cost;
+                best_type = runs;
+            }
+
+            bvb.append_bits(best_type, type_bits);
+        }
+
+        switch (best_type) {
+        case elias_fano: compact_elias_fano::write(bvb, begin, universe, n, params); break;
+        case ranked_bitvector:
+            compact_ranked_bitvector::write(bvb, begin, universe, n, params);
+            break;
+        case runs: compact_run_sequence::write(bvb, begin, universe, n, params); break;
+        case all_ones: all_ones_sequence::write(bvb, begin, universe, n, params); break;
+        default: assert(false);
+        }
+    }
+
+    class enumerator {
+      public:
+        using value_type = std::pair<uint64_t, uint64_t>;  // (position, value)
+
+        enumerator() = default;
+
+        enumerator(
+            bit_vector const& bv,
+            uint64_t offset,
+            uint64_t universe,
+            uint64_t n,
+            global_parameters const& params
+        ) {
+            if (all_ones_sequence::bitsize(params, universe, n) == 0) {
+                m_type = all_ones;
+            } else {
+                m_type = index_type(bv.get_word56(offset) & ((uint64_t(1) << type_bits) - 1));
+            }
+
+            switch (m_type) {
+            case elias_fano:
+                m_enumerator =
+                    compact_elias_fano::enumerator(bv, offset + type_bits, universe, n, params);
+                break;
+            case ranked_bitvector:
+                m_enumerator =
+                    compact_ranked_bitvector::enumerator(bv, offset + type_bits, universe, n, params);
+                break;
+            case runs:
+                m_enumerator =
+                    compact_run_sequence::enumerator(bv, offset + type_bits, universe, n, params);
+                break;
+            case all_ones:
+                m_enumerator =
+                    all_ones_sequence::enumerator(bv, offset + type_bits, universe, n, params);
+                break;
+            default: throw std::invalid_argument("Unsupported type");
+            }
+        }
+
+        value_type move(uint64_t position) {
+            return std::visit([&position](auto&& e) { return e.move(position); }, m_enumerator);
+        }
+        value_type next_geq(uint64_t lower_bound) {
+            return std::visit(
+                [&lower_bound](auto&& e) { return e.next_geq(lower_bound); }, m_enumerator
+            );
+        }
+        value_type next() {
+            return std::visit([](auto&& e) { return e.next(); }, m_enumerator);
+        }
+
+        uint64_t size() const {
+            return std::visit([](auto&& e) { return e.size(); }, m_enumerator);
+        }
+
+        uint64_t prev_value() const {
+            return std::visit([](auto&& e) { return e.prev_value(); }, m_enumerator);
+        }
+
+        /** Returns the container the sequence is encoded with. */
+        index_type type() const { return m_type; }
+
+      private:
+        index_type m_type{};
+        std::variant<
+            compact_elias_fano::enumerator,
+            compact_ranked_bitvector::enumerator,
+            compact_run_sequence::enumerator,
+            all_ones_sequence::enumerator>
+            m_enumerator;
+    };
+};
+}  // namespace pisa
@@ -318,6 +318,13 @@ struct partitioned_sequence {
     };
 
   private:
+    // Whether the size of the base sequence also depends on its number of runs of consecutive
+    // values, which the partition optimizer then has to track.
+    static constexpr bool base_counts_runs =
+        requires(global_parameters const& params, uint64_t value) {
+            base_sequence_type::bitsize(params, value, value, value);
+        };
+
     template <typename Iterator>
     static std::vector<uint32_t> compute_partition(
         Iterator begin,
@@ -338,8 +345,11 @@ struct partitioned_sequence {
             return partition;
         }
 
-        auto cost_fun = [&](uint64_t universe, uint64_t n) {
-            return base_sequence_type::bitsize(params, universe, n) + fix_cost;
+        // Takes the number of runs of the partition only if the base sequence needs it.
+        auto cost_fun = [&](uint64_t universe, uint64_t n, auto... runs) -> uint64_t
+            requires(sizeof...(runs) == 0 || base_counts_runs)
+        {
+            return base_sequence_type::bitsize(params, universe, n, runs...) + fix_cost;
         };
 
         const size_t superblock_bound = eps3 != 0 ? size_t(fix_cost / eps3) : n;
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mappable/mapper.hpp"
+
+namespace pisa {
+
+/**
+ * Vector of trivially copyable values that are appended to a temporary file instead of being kept
+ * in memory, and written back in the layout of a frozen `mapper::mappable_vector`.
+ */
+template <typename T>
+class SpilledVector {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+  public:
+    /** Number of values read back from the file at a time. */
+    static constexpr std::size_t chunk_size = std::size_t(1) << 16U;
+
+    class reader {
+      public:
+        explicit reader(std::filesystem::path const& file) : m_input(file, std::ios::binary) {
+            m_input.exceptions(std::ios::badbit | std::ios::failbit);
+        }
+
+        /** Reads the next `n` values into `out`, replacing its contents. */
+        void read(std::size_t n, std::vector<T>& out) {
+            out.resize(n);
+            m_input.read(
+                reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(n * sizeof(T))
+            );
+        }
+
+      private:
+        std::ifstream m_input;
+    };
+
+    explicit SpilledVector(std::filesystem::path tmp_file)
+        : m_tmp_file(std::move(tmp_file)), m_output(m_tmp_file, std::ios::binary) {
+        m_output.exceptions(std::ios::badbit | std::ios::failbit);
+    }
+
+    void append(std::span<T const> values) {
+        m_output.write(
+            reinterpret_cast<char const*>(values.data()),
+            static_cast<std::streamsize>(values.size_bytes())
+        );
+        m_size += values.size();
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+
+    /** Stops appending, and returns a reader over the values from the first one. */
+    [[nodiscard]] auto read() -> reader {
+        close();
+        return reader(m_tmp_file);
+    }
+
+    /**
+     * Writes the values as `mapper::freeze` writes a vector, passing each one through `transform`
+     * first, and removes the temporary file.
+     */
+    template <typename Transform>
+    void write(mapper::detail::freeze_visitor& freezer, std::ofstream& os, Transform&& transform) {
+        auto input = read();
+        freezer(m_size, "size");
+        std::vector<T> chunk;
+        for (std::size_t pos = 0; pos < m_size; pos += chunk_size) {
+            input.read(std::min(chunk_size, m_size - pos), chunk);
+            for (auto& value: chunk) {
+                value = transform(value);
+            }
+            os.write(
+                reinterpret_cast<char const*>(chunk.data()),
+                static_cast<std::streamsize>(chunk.size() * sizeof(T))
+            );
+        }
+        remove();
+    }
+
+    /** Writes the values as `mapper::freeze` writes a vector, and removes the temporary file. */
+    void write(mapper::detail::freeze_visitor& freezer, std::ofstream& os) {
+        write(freezer, os, [](T value) { return value; });
+    }
+
+    /** Removes the temporary file. */
+    void remove() {
+        close();
+        std::filesystem::remove(m_tmp_file);
+    }
+
+  private:
+    void close() {
+        if (m_output.is_open()) {
+            m_output.close();
+        }
+    }
+
+    std::filesystem::path m_tmp_file;
+    std::ofstream m_output;
+    std::size_t m_size = 0;
+};
+
+}  // namespace pisa
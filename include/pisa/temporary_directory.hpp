@@ -34,4 +34,11 @@ struct TemporaryDirectory {
     bool cleanup_ = true;
 };
 
+/**
+ * Returns the directory under which the temporary files of building `output` are written: the
+ * directory of the output itself, which must have room for it anyway, unlike the system temp
+ * directory.
+ */
+[[nodiscard]] auto tmp_root_for(std::filesystem::path const& output) -> std::filesystem::path;
+
 };  // namespace pisa
@@ -60,6 +60,19 @@ namespace pisa { namespace broadword {
 #endif
     }
 
+    /** Number of bits counted at once by `popcount_window`. */
+    static const uint64_t window_bits = 256;
+
+    /**
+     * Returns the number of ones in the `window_bits` bits starting at `words`.
+     *
+     * The words are counted independently of each other, so that skipping long runs of bits
+     * does not need a compare and branch for every word.
+     */
+    inline uint64_t popcount_window(uint64_t const* words) {
+        return popcount(words[0]) + popcount(words[1]) + popcount(words[2]) + popcount(words[3]);
+    }
+
     inline uint64_t reverse_bytes(uint64_t x) {
         return intrinsics::byteswap64(x);
     }
@@ -74,6 +87,11 @@ namespace pisa { namespace broadword {
     inline uint64_t select_in_word(const uint64_t x, const uint64_t k) {
         assert(k < popcount(x));
 
+#if defined(__BMI2__) && defined(PISA_USE_PDEP)
+        // Deposits a single bit onto the k-th one of x. PDEP is microcoded on AMD CPUs before
+        // Zen 3, where it is much slower than the broadword fallback, hence the opt-in.
+        return static_cast<uint64_t>(__builtin_ctzll(_pdep_u64(uint64_t(1) << k, x)));
+#else
         uint64_t byte_sums = byte_counts(x) * ones_step_8;
 
         const uint64_t k_step_8 = k * ones_step_8;
@@ -85,6 +103,7 @@ namespace pisa { namespace broadword {
 #endif
         const uint64_t byte_rank = k - (((byte_sums << 8) >> place) & uint64_t(0xFF));
         return place + tables::select_in_byte[((x >> place) & 0xFF) | (byte_rank << 8)];
+#endif
     }
 
     inline uint64_t same_msb(uint64_t x, uint64_t y) {
@@ -23,4 +23,10 @@
     #define PISA_FLATTEN_FUNC __attribute__((always_inline, flatten))
 #else
     #define PISA_FLATTEN_FUNC PISA_ALWAYSINLINE
-#endif
\ No newline at end of file
+#endif
+// no address sanitizer, for loads that may deliberately read past the end of a buffer
+#if defined(__clang__) || defined(__GNUC__)
+    #define PISA_NO_SANITIZE_ADDRESS __attribute__((no_sanitize("address")))
+#else
+    #define PISA_NO_SANITIZE_ADDRESS
+#endif
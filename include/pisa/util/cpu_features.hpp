@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace pisa {
+
+/**
+ * SIMD instruction set levels for which kernels can be selected at runtime.
+ *
+ * The levels are ordered: each of them implies the support of the previous ones.
+ */
+enum class SimdLevel : std::uint8_t { Sse4 = 0, Avx2 = 1, Avx512 = 2 };
+
+[[nodiscard]] constexpr auto to_string(SimdLevel level) -> std::string_view {
+    switch (level) {
+    case SimdLevel::Sse4: return "sse4";
+    case SimdLevel::Avx2: return "avx2";
+    case SimdLevel::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+/**
+ * Returns the highest SIMD level supported by the CPU the program is running on.
+ *
+ * Contrary to checking predefined macros such as `__AVX2__`, this does not depend on the flags
+ * the program was compiled with. The CPU is queried once, and the result is cached.
+ */
+[[nodiscard]] inline auto detected_simd_level() -> SimdLevel {
+    static SimdLevel const level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") != 0) {
+            return SimdLevel::Avx512;
+        }
+        if (__builtin_cpu_supports("avx2") != 0) {
+            return SimdLevel::Avx2;
+        }
+        return SimdLevel::Sse4;
+    }();
+    return level;
+}
+
+/**
+ * Returns all SIMD levels supported by the current CPU, from the lowest to the highest.
+ */
+[[nodiscard]] inline auto supported_simd_levels() -> std::vector<SimdLevel> {
+    std::vector<SimdLevel> levels;
+    for (auto level: {SimdLevel::Sse4, SimdLevel::Avx2, SimdLevel::Avx512}) {
+        if (level <= detected_simd_level()) {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+}  // namespace pisa
@@ -5,6 +5,7 @@
 #include <span>
 #include <unordered_set>
 
+#include "binary_collection_writer.hpp"
 #include "binary_freq_collection.hpp"
 #include "util/progress.hpp"
 
@@ -77,7 +78,8 @@ void sample_inverted_index(
 inline void reorder_inverted_index(
     const std::string& input_basename,
     const std::string& output_basename,
-    const std::vector<uint32_t>& mapping
+    const std::vector<uint32_t>& mapping,
+    BinaryCollectionFormat format = BinaryCollectionFormat::Raw
 ) {
     std::ofstream output_mapping(output_basename + ".mapping");
     emit(output_mapping, mapping.data(), mapping.size());
@@ -91,21 +93,19 @@ inline void reorder_inverted_index(
         new_sizes[mapping[i]] = sizes.begin()[i];
     }
 
-    std::ofstream output_sizes(output_basename + ".sizes");
-    emit(output_sizes, sizes.size());
-    emit(output_sizes, new_sizes.data(), num_docs);
+    BinaryCollectionWriter output_sizes(output_basename + ".sizes", format);
+    output_sizes.write(std::span<uint32_t const>(new_sizes));
 
-    std::ofstream output_docs(output_basename + ".docs");
-    std::ofstream output_freqs(output_basename + ".freqs");
-    emit(output_docs, 1);
-    emit(output_docs, mapping.size());
+    BinaryCollectionWriter output_docs(output_basename + ".docs", format);
+    BinaryCollectionWriter output_freqs(output_basename + ".freqs", format);
+    output_docs.write(static_cast<uint32_t>(mapping.size()));
 
     binary_freq_collection input(input_basename.c_str());
 
     std::vector<std::pair<uint32_t, uint32_t>> pl;
-    pisa::progress reorder_progress(
-        "Reorder inverted index", std::distance(input.begin(), input.end())
-    );
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> freqs;
+    pisa::progress reorder_progress("Reorder inverted index", input.size());
 
     for (const auto& seq: input) {
         for (size_t i = 0; i < seq.docs.size(); ++i) {
@@ -114,14 +114,15 @@ inline void reorder_inverted_index(
 
         std::sort(pl.begin(), pl.end());
 
-        emit(output_docs, pl.size());
-        emit(output_freqs, pl.size());
-
         for (const auto& posting: pl) {
-            emit(output_docs, posting.first);
-            emit(output_freqs, posting.second);
+            docs.push_back(posting.first);
+            freqs.push_back(posting.second);
         }
+        output_docs.write(std::span<uint32_t const>(docs));
+        output_freqs.write(std::span<uint32_t const>(freqs));
         pl.clear();
+        docs.clear();
+        freqs.clear();
         reorder_progress.update(1);
     }
 }
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <numeric>
+#include <memory>
+#include <optional>
+#include <tuple>
 #include <unordered_set>
+#include <vector>
 
 #include "spdlog/spdlog.h"
 
@@ -11,11 +18,14 @@
 #include "mappable/mappable_vector.hpp"
 #include "mappable/mapper.hpp"
 #include "memory_source.hpp"
+#include "posting_list_pipeline.hpp"
+#include "temporary_directory.hpp"
 #include "type_safe.hpp"
 #include "util/progress.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_range.hpp"
 #include "wand_data_raw.hpp"
+#include "wand_utils.hpp"
 
 #include "linear_quantizer.hpp"
 #include "scorer/scorer.hpp"
@@ -42,76 +52,77 @@ class wand_data {
         BlockSize block_size,
         std::optional<Size> quantization_bits,
         std::unordered_set<size_t> const& terms_to_drop
-    )
-        : m_num_docs(num_docs) {
-        std::vector<uint32_t> doc_lens(num_docs);
-        std::vector<float> max_term_weight;
-        std::vector<uint32_t> term_occurrence_counts;
-        std::vector<uint32_t> term_posting_counts;
+    ) {
         global_parameters params;
-        spdlog::info("Reading sizes...");
-
-        for (size_t i = 0; i < num_docs; ++i) {
-            uint32_t len = *len_it++;
-            doc_lens[i] = len;
-            m_collection_len += len;
-        }
-
-        m_avg_len = float(m_collection_len / double(num_docs));
+        auto [doc_lens, term_occurrence_counts, term_posting_counts] =
+            read_statistics(len_it, num_docs, coll, terms_to_drop);
+        store_statistics(
+            std::move(doc_lens), std::move(term_occurrence_counts), std::move(term_posting_counts)
+        );
 
         typename block_wand_type::builder builder(coll, params, quantization_bits);
-
-        {
-            pisa::progress progress("Storing terms statistics", coll.size());
-            size_t term_id = 0;
-            for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
-                }
-
-                size_t term_occurrence_count = std::accumulate(seq.freqs.begin(), seq.freqs.end(), 0);
-                term_occurrence_counts.push_back(term_occurrence_count);
-                term_posting_counts.push_back(seq.docs.size());
-                term_id += 1;
-                progress.update(1);
-            }
-        }
-        m_doc_lens.steal(doc_lens);
-        m_term_occurrence_counts.steal(term_occurrence_counts);
-        m_term_posting_counts.steal(term_posting_counts);
-
         auto scorer = scorer::from_params(scorer_params, *this);
-        {
-            pisa::progress progress("Storing score upper bounds", coll.size());
-            size_t term_id = 0;
-            size_t new_term_id = 0;
-            for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
-                }
-                auto v = builder.add_sequence(
-                    seq, coll, doc_lens, m_avg_len, scorer->term_scorer(new_term_id), block_size
+        std::vector<float> max_term_weight;
+        compute_block_max_lists(
+            coll,
+            terms_to_drop,
+            [&](size_t term_id, binary_freq_collection::sequence const& seq) {
+                return block_wand_type::compute_block_max_list(
+                    seq, m_num_docs, scorer->term_scorer(term_id), block_size
                 );
+            },
+            [&](BlockMaxList list) {
+                auto v = builder.append_block_max_list(std::move(list));
                 max_term_weight.push_back(v);
                 m_index_max_term_weight = std::max(m_index_max_term_weight, v);
-                term_id += 1;
-                new_term_id += 1;
-                progress.update(1);
-            }
-            if (quantization_bits.has_value()) {
-                LinearQuantizer quantizer(m_index_max_term_weight, quantization_bits->as_int());
-                for (auto&& w: max_term_weight) {
-                    w = quantizer(w);
-                }
-                builder.quantize_block_max_term_weights(m_index_max_term_weight);
             }
+        );
+        store_max_term_weights(std::move(max_term_weight), quantization_bits);
+        if (quantization_bits.has_value()) {
+            builder.quantize_block_max_term_weights(m_index_max_term_weight);
         }
         builder.build(m_block_wand);
-        m_max_term_weight.steal(max_term_weight);
+    }
+
+    class stream_builder;
+
+    /**
+     * Computes the same data as the constructor, and writes it to `output` in the layout of
+     * `mapper::freeze`. The block-max data of the lists is spilled to a temporary directory
+     * created under `tmp_root` as it is computed, instead of being kept in memory.
+     */
+    template <typename LengthsIterator>
+    static void write(
+        std::string const& output,
+        LengthsIterator len_it,
+        uint64_t num_docs,
+        binary_freq_collection const& coll,
+        const ScorerParams& scorer_params,
+        BlockSize block_size,
+        std::optional<Size> quantization_bits,
+        std::unordered_set<size_t> const& terms_to_drop,
+        std::filesystem::path const& tmp_root = std::filesystem::temp_directory_path()
+    ) {
+        auto [doc_lens, term_occurrence_counts, term_posting_counts] =
+            read_statistics(len_it, num_docs, coll, terms_to_drop);
+        stream_builder builder(
+            std::move(doc_lens),
+            std::move(term_occurrence_counts),
+            std::move(term_posting_counts),
+            scorer_params,
+            block_size,
+            quantization_bits,
+            tmp_root
+        );
+        compute_block_max_lists(
+            coll,
+            terms_to_drop,
+            [&](size_t term_id, binary_freq_collection::sequence const& seq) {
+                return builder.compute_block_max_list(term_id, seq);
+            },
+            [&](BlockMaxList list) { builder.append_block_max_list(std::move(list)); }
+        );
+        builder.write(output);
     }
 
     float norm_len(uint64_t doc_id) const { return m_doc_lens[doc_id] / m_avg_len; }
@@ -128,6 +139,9 @@ class wand_data {
 
     size_t num_docs() const { return m_num_docs; }
 
+    /** Number of terms with statistics, which excludes the terms dropped when building. */
+    size_t num_terms() const { return m_term_posting_counts.size(); }
+
     float avg_len() const { return m_avg_len; }
 
     uint64_t collection_len() const { return m_collection_len; }
@@ -142,16 +156,124 @@ class wand_data {
 
     template <typename Visitor>
     void map(Visitor& visit) {
-        visit(m_block_wand, "m_block_wand")(m_doc_lens, "m_doc_lens")(
+        visit(m_block_wand, "m_block_wand");
+        map_statistics(visit);
+    }
 
-            m_term_occurrence_counts, "m_term_occurrence_counts")(
+  private:
+    /** Visits the members following the block-max data, which `write` produces separately. */
+    template <typename Visitor>
+    void map_statistics(Visitor& visit) {
+        visit(m_doc_lens, "m_doc_lens")(m_term_occurrence_counts, "m_term_occurrence_counts")(
             m_term_posting_counts, "m_term_posting_counts")(m_avg_len, "m_avg_len")(
             m_collection_len, "m_collection_len")(m_num_docs, "m_num_docs")(
             m_max_term_weight, "m_max_term_weight")(
             m_index_max_term_weight, "m_index_max_term_weight");
     }
 
-  private:
+    /**
+     * Reads the document lengths, and the number of occurrences and postings of each term that is
+     * not dropped. The lists are read concurrently, see `encode_posting_lists`.
+     */
+    template <typename LengthsIterator>
+    static auto read_statistics(
+        LengthsIterator len_it,
+        uint64_t num_docs,
+        binary_freq_collection const& coll,
+        std::unordered_set<size_t> const& terms_to_drop
+    ) -> std::tuple<std::vector<uint32_t>, std::vector<uint32_t>, std::vector<uint32_t>> {
+        std::vector<uint32_t> doc_lens(num_docs);
+        std::vector<uint32_t> term_occurrence_counts;
+        std::vector<uint32_t> term_posting_counts;
+        spdlog::info("Reading sizes...");
+
+        for (size_t i = 0; i < num_docs; ++i) {
+            doc_lens[i] = *len_it++;
+        }
+
+        pisa::progress progress("Storing terms statistics", coll.size());
+        encode_posting_lists(
+            coll,
+            [&](size_t term_id, binary_freq_collection::sequence const& seq) -> uint32_t {
+                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
+                    return 0;
+                }
+                return std::accumulate(seq.freqs.begin(), seq.freqs.end(), 0);
+            },
+            [&](size_t term_id, binary_freq_collection::sequence const& seq, uint32_t occurrences) {
+                if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+                    term_occurrence_counts.push_back(occurrences);
+                    term_posting_counts.push_back(seq.docs.size());
+                }
+                progress.update(1);
+            }
+        );
+        return {
+            std::move(doc_lens), std::move(term_occurrence_counts), std::move(term_posting_counts)
+        };
+    }
+
+    void store_statistics(
+        std::vector<uint32_t> doc_lens,
+        std::vector<uint32_t> term_occurrence_counts,
+        std::vector<uint32_t> term_posting_counts
+    ) {
+        m_num_docs = doc_lens.size();
+        m_collection_len = std::accumulate(doc_lens.begin(), doc_lens.end(), uint64_t(0));
+        m_avg_len = float(m_collection_len / double(m_num_docs));
+        m_doc_lens.steal(doc_lens);
+        m_term_occurrence_counts.steal(term_occurrence_counts);
+        m_term_posting_counts.steal(term_posting_counts);
+    }
+
+    /**
+     * Computes the block-max scores of the lists that are not dropped concurrently by calling
+     * `compute(term_id, seq)`, and passes them to `append` in term order, see
+     * `encode_posting_lists`. The terms that are kept are renumbered consecutively.
+     */
+    template <typename Compute, typename Append>
+    static void compute_block_max_lists(
+        binary_freq_collection const& coll,
+        std::unordered_set<size_t> const& terms_to_drop,
+        Compute&& compute,
+        Append&& append
+    ) {
+        std::vector<size_t> dropped(terms_to_drop.begin(), terms_to_drop.end());
+        std::sort(dropped.begin(), dropped.end());
+
+        pisa::progress progress("Storing score upper bounds", coll.size());
+        encode_posting_lists(
+            coll,
+            [&](size_t term_id,
+                binary_freq_collection::sequence const& seq) -> std::optional<BlockMaxList> {
+                auto pos = std::lower_bound(dropped.begin(), dropped.end(), term_id);
+                if (pos != dropped.end() && *pos == term_id) {
+                    return std::nullopt;
+                }
+                return compute(term_id - std::distance(dropped.begin(), pos), seq);
+            },
+            [&](size_t, binary_freq_collection::sequence const&, std::optional<BlockMaxList> list) {
+                if (list.has_value()) {
+                    append(std::move(*list));
+                }
+                progress.update(1);
+            }
+        );
+    }
+
+    /** Stores the maximum scores of the lists, quantized if quantization bits are given. */
+    void store_max_term_weights(
+        std::vector<float> max_term_weight, std::optional<Size> quantization_bits
+    ) {
+        if (quantization_bits.has_value()) {
+            LinearQuantizer quantizer(m_index_max_term_weight, quantization_bits->as_int());
+            for (auto&& w: max_term_weight) {
+                w = quantizer(w);
+            }
+        }
+        m_max_term_weight.steal(max_term_weight);
+    }
+
     uint64_t m_num_docs = 0;
     float m_avg_len = 0;
     uint64_t m_collection_len = 0;
@@ -164,6 +286,78 @@ class wand_data {
     MemorySource m_source;
 };
 
+/**
+ * Builds wand data from posting lists given one at a time in term order, and writes it as
+ * `wand_data::write` does, for lists that are not read from a collection, e.g., lists merged
+ * while inverting a forward index. The statistics of the documents and terms must be known
+ * beforehand. The block-max scores of the lists can be computed concurrently, but must be
+ * appended in term order; they are spilled to a temporary directory created under `tmp_root`.
+ */
+template <typename block_wand_type>
+class wand_data<block_wand_type>::stream_builder {
+  public:
+    stream_builder(
+        std::vector<uint32_t> doc_lens,
+        std::vector<uint32_t> term_occurrence_counts,
+        std::vector<uint32_t> term_posting_counts,
+        const ScorerParams& scorer_params,
+        BlockSize block_size,
+        std::optional<Size> quantization_bits,
+        std::filesystem::path const& tmp_root = std::filesystem::temp_directory_path()
+    )
+        : m_block_size(block_size),
+          m_quantization_bits(quantization_bits),
+          m_tmp(tmp_root),
+          m_builder(doc_lens.size(), global_parameters{}, quantization_bits, m_tmp.path()) {
+        m_data.store_statistics(
+            std::move(doc_lens), std::move(term_occurrence_counts), std::move(term_posting_counts)
+        );
+        m_scorer = scorer::from_params(scorer_params, m_data);
+    }
+
+    // The scorer refers to the statistics.
+    stream_builder(stream_builder const&) = delete;
+    stream_builder(stream_builder&&) = delete;
+    stream_builder& operator=(stream_builder const&) = delete;
+    stream_builder& operator=(stream_builder&&) = delete;
+    ~stream_builder() = default;
+
+    /** Computes the block-max scores of a list; safe to call from several threads at once. */
+    [[nodiscard]] auto
+    compute_block_max_list(size_t term_id, binary_freq_collection::sequence const& seq) const
+        -> BlockMaxList {
+        return block_wand_type::compute_block_max_list(
+            seq, m_data.m_num_docs, m_scorer->term_scorer(term_id), m_block_size
+        );
+    }
+
+    /** Adds the block-max scores of the next list. */
+    void append_block_max_list(BlockMaxList list) {
+        auto v = m_builder.append_block_max_list(std::move(list));
+        m_max_term_weight.push_back(v);
+        m_data.m_index_max_term_weight = std::max(m_data.m_index_max_term_weight, v);
+    }
+
+    /** Writes the wand data to `output` in the layout of `mapper::freeze`. */
+    void write(std::string const& output) {
+        m_data.store_max_term_weights(std::move(m_max_term_weight), m_quantization_bits);
+        std::ofstream os(output, std::ios::binary);
+        os.exceptions(std::ios::badbit | std::ios::failbit);
+        mapper::detail::freeze_visitor freezer(os, 0);
+        m_builder.write(freezer, os, m_data.m_index_max_term_weight);
+        m_data.map_statistics(freezer);
+    }
+
+  private:
+    wand_data m_data;
+    BlockSize m_block_size;
+    std::optional<Size> m_quantization_bits;
+    std::unique_ptr<WandIndexScorer<wand_data>> m_scorer;
+    TemporaryDirectory m_tmp;
+    typename block_wand_type::stream_builder m_builder;
+    std::vector<float> m_max_term_weight;
+};
+
 inline void create_wand_data(
     std::string const& output,
     std::string const& input_basename,
@@ -178,39 +372,43 @@ inline void create_wand_data(
     binary_collection sizes_coll((input_basename + ".sizes").c_str());
     binary_freq_collection coll(input_basename.c_str());
 
+    auto tmp_root = tmp_root_for(output);
     if (compress) {
-        wand_data<wand_data_compressed<>> wdata(
+        wand_data<wand_data_compressed<>>::write(
+            output,
             sizes_coll.begin()->begin(),
             coll.num_docs(),
             coll,
             scorer_params,
             block_size,
             quantization_bits,
-            dropped_term_ids
+            dropped_term_ids,
+            tmp_root
         );
-        mapper::freeze(wdata, output.c_str());
     } else if (range) {
-        wand_data<wand_data_range<128, 1024>> wdata(
+        wand_data<wand_data_range<128, 1024>>::write(
+            output,
             sizes_coll.begin()->begin(),
             coll.num_docs(),
             coll,
             scorer_params,
             block_size,
             quantization_bits,
-            dropped_term_ids
+            dropped_term_ids,
+            tmp_root
         );
-        mapper::freeze(wdata, output.c_str());
     } else {
-        wand_data<wand_data_raw> wdata(
+        wand_data<wand_data_raw>::write(
+            output,
             sizes_coll.begin()->begin(),
             coll.num_docs(),
             coll,
             scorer_params,
             block_size,
             quantization_bits,
-            dropped_term_ids
+            dropped_term_ids,
+            tmp_root
         );
-        mapper::freeze(wdata, output.c_str());
     }
 }
 
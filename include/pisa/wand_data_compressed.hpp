@@ -1,5 +1,8 @@
 #pragma once
 
+#include <filesystem>
+#include <fstream>
+#include <optional>
 #include <stdexcept>
 #include <variant>
 
@@ -12,6 +15,8 @@
 #include "ensure.hpp"
 #include "global_parameters.hpp"
 #include "linear_quantizer.hpp"
+#include "mappable/mapper.hpp"
+#include "spilled_vector.hpp"
 #include "type_safe.hpp"
 #include "wand_utils.hpp"
 
@@ -41,6 +46,14 @@ class uniform_score_compressor {
 
         template <typename Sequence = compact_elias_fano, typename DocsIterator>
         void add_posting_list(uint64_t n, DocsIterator docs_begin, DocsIterator score_begin) {
+            m_docs_sequences.append(encode_posting_list<Sequence>(n, docs_begin, score_begin));
+        }
+
+        /** Encodes the documents and score indexes of a list without adding it. */
+        template <typename Sequence = compact_elias_fano, typename DocsIterator>
+        [[nodiscard]] auto
+        encode_posting_list(uint64_t n, DocsIterator docs_begin, DocsIterator score_begin) const
+            -> bit_vector_builder {
             std::vector<uint64_t> temp;
             for (size_t pos = 0; pos < n; ++pos) {
                 uint64_t elem = *(docs_begin + pos);
@@ -66,7 +79,7 @@ class uniform_score_compressor {
             bit_vector_builder docs_bits;
             write_gamma_nonzero(docs_bits, n);
             Sequence::write(docs_bits, temp.begin(), m_num_docs, n, m_params);
-            m_docs_sequences.append(docs_bits);
+            return docs_bits;
         }
 
         void build(bitvector_collection& docs_sequences) { m_docs_sequences.build(docs_sequences); }
@@ -119,19 +132,17 @@ class wand_data_compressed {
             Scorer scorer,
             BlockSize block_size
         ) {
-            auto t = std::holds_alternative<FixedBlock>(block_size)
-                ? static_block_partition(seq, scorer, std::get<FixedBlock>(block_size).size)
-                : variable_block_partition(
-                      coll, seq, scorer, std::get<VariableBlock>(block_size).lambda
-                  );
+            return append_block_max_list(compute_block_max_list(seq, coll.num_docs(), scorer, block_size));
+        }
 
-            float max_score = *(std::max_element(t.second.begin(), t.second.end()));
-            max_term_weight.push_back(max_score);
-            total_elements += seq.docs.size();
-            total_blocks += t.first.size();
+        /** Adds the blocks of the next posting list, and returns its maximum score. */
+        float append_block_max_list(BlockMaxList list) {
+            max_term_weight.push_back(list.max_score);
+            total_elements += list.postings;
+            total_blocks += list.docids.size();
 
-            block_max_documents.push_back(std::move(t.first));
-            unquantized_block_max_scores.push_back(std::move(t.second));
+            block_max_documents.push_back(std::move(list.docids));
+            unquantized_block_max_scores.push_back(std::move(list.scores));
 
             return max_term_weight.back();
         }
@@ -168,6 +179,100 @@ class wand_data_compressed {
         typename uniform_score_compressor::builder compressor_builder;
     };
 
+    /**
+     * Builder writing the blocks to temporary files in `tmp_dir` as posting lists are added. The
+     * scores can only be quantized once the maximum score of the index is known, so the lists are
+     * compressed when the data is written, and spilled to another temporary file.
+     */
+    class stream_builder {
+      public:
+        stream_builder(
+            uint64_t num_docs,
+            global_parameters const& params,
+            std::optional<Size> quantization_bits,
+            std::filesystem::path tmp_dir
+        )
+            : m_params(params),
+              m_quantization_bits(
+                  unwrap(quantization_bits, "compressed wand data needs quantization bits")
+              ),
+              m_compressor(num_docs, params, m_quantization_bits),
+              m_tmp_dir(std::move(tmp_dir)),
+              m_block_max_documents(m_tmp_dir / "block_max_documents"),
+              m_block_max_scores(m_tmp_dir / "block_max_scores") {
+            spdlog::info("Storing max weight for each list and for each block...");
+            m_blocks_start.push_back(0);
+        }
+
+        /** Adds the blocks of the next posting list, and returns its maximum score. */
+        float append_block_max_list(BlockMaxList const& list) {
+            m_block_max_documents.append(list.docids);
+            m_block_max_scores.append(list.scores);
+            m_blocks_start.push_back(list.docids.size() + m_blocks_start.back());
+            m_total_elements += list.postings;
+            return list.max_score;
+        }
+
+        /**
+         * Compresses the lists with their scores quantized against the maximum score of the index,
+         * and writes the block-max data in the layout of `mapper::freeze`.
+         */
+        void write(
+            mapper::detail::freeze_visitor& freezer, std::ofstream& os, float index_max_term_weight
+        ) {
+            bitvector_collection::stream_builder docs_sequences(
+                m_params, m_tmp_dir / "docs_sequences"
+            );
+            auto documents = m_block_max_documents.read();
+            auto scores = m_block_max_scores.read();
+            std::vector<uint32_t> docs;
+            std::vector<float> unquantized_scores;
+            for (size_t list = 0; list + 1 < m_blocks_start.size(); ++list) {
+                auto n = m_blocks_start[list + 1] - m_blocks_start[list];
+                documents.read(n, docs);
+                scores.read(n, unquantized_scores);
+                auto quantized_scores =
+                    m_compressor.compress_data(unquantized_scores, index_max_term_weight);
+                docs_sequences.append(
+                    m_compressor.encode_posting_list(n, docs.begin(), quantized_scores.begin())
+                );
+            }
+            m_block_max_documents.remove();
+            m_block_max_scores.remove();
+
+            auto num_docs = m_compressor.num_docs();
+            freezer(m_params, "m_params")(num_docs, "m_num_docs");
+            docs_sequences.write(freezer, os);
+            freezer(m_quantization_bits, "m_quantization_bits");
+            spdlog::info(
+                "number of elements / number of blocks: {}",
+                (float)m_total_elements / (float)(m_blocks_start.back())
+            );
+        }
+
+      private:
+        global_parameters m_params;
+        Size m_quantization_bits;
+        typename uniform_score_compressor::builder m_compressor;
+        std::filesystem::path m_tmp_dir;
+        uint64_t m_total_elements = 0;
+        std::vector<uint64_t> m_blocks_start;
+        SpilledVector<uint32_t> m_block_max_documents;
+        SpilledVector<float> m_block_max_scores;
+    };
+
+    /** Computes the blocks of a posting list, independently of the other lists. */
+    template <typename Scorer>
+    static BlockMaxList compute_block_max_list(
+        binary_freq_collection::sequence const& seq,
+        [[maybe_unused]] uint64_t num_docs,
+        Scorer scorer,
+        BlockSize block_size
+    ) {
+        return block_max_partition(seq, scorer, block_size);
+    }
+
+
     class enumerator {
         friend class wand_data_compressed;
 
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
 #include "spdlog/spdlog.h"
 
 #include "binary_freq_collection.hpp"
 #include "global_parameters.hpp"
 #include "linear_quantizer.hpp"
 #include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "spilled_vector.hpp"
 #include "type_safe.hpp"
 #include "util/compiler_attribute.hpp"
 #include "util/util.hpp"
@@ -61,32 +67,27 @@ class wand_data_range {
         template <typename Scorer>
         float add_sequence(
             binary_freq_collection::sequence const& term_seq,
-            [[maybe_unused]] binary_freq_collection const& coll,
+            binary_freq_collection const& coll,
             [[maybe_unused]] std::vector<uint32_t> const& doc_lens,
             float avg_len,
             Scorer scorer,
-            [[maybe_unused]] BlockSize block_size
+            BlockSize block_size
         ) {
-            float max_score = 0.0F;
-
-            std::vector<float> b_max(blocks_num, 0.0F);
-            for (auto i = 0; i < term_seq.docs.size(); ++i) {
-                uint64_t docid = *(term_seq.docs.begin() + i);
-                uint64_t freq = *(term_seq.freqs.begin() + i);
-                float score = scorer(docid, freq);
-                max_score = std::max(max_score, score);
-                size_t pos = docid / range_size;
-                float& bm = b_max[pos];
-                bm = std::max(bm, score);
-            }
-            if (term_seq.docs.size() >= min_list_lenght) {
-                block_max_term_weight.insert(block_max_term_weight.end(), b_max.begin(), b_max.end());
-                blocks_start.push_back(b_max.size() + blocks_start.back());
-                total_elements += term_seq.docs.size();
-            } else {
-                blocks_start.push_back(blocks_start.back());
+            return append_block_max_list(
+                compute_block_max_list(term_seq, coll.num_docs(), scorer, block_size)
+            );
+        }
+
+        /** Adds the blocks of the next posting list, and returns its maximum score. */
+        float append_block_max_list(BlockMaxList const& list) {
+            block_max_term_weight.insert(
+                block_max_term_weight.end(), list.scores.begin(), list.scores.end()
+            );
+            blocks_start.push_back(list.scores.size() + blocks_start.back());
+            if (!list.scores.empty()) {
+                total_elements += list.postings;
             }
-            return max_score;
+            return list.max_score;
         }
 
         void quantize_block_max_term_weights(float index_max_term_weight) {
@@ -113,6 +114,98 @@ class wand_data_range {
         std::optional<Size> m_quantization_bits;
     };
 
+    /**
+     * Builder writing the blocks to a temporary file in `tmp_dir` as posting lists are added, so
+     * that only the block offsets of the lists are kept in memory.
+     */
+    class stream_builder {
+      public:
+        stream_builder(
+            uint64_t num_docs,
+            [[maybe_unused]] global_parameters const& params,
+            std::optional<Size> quantization_bits,
+            std::filesystem::path const& tmp_dir
+        )
+            : m_blocks_num(ceil_div(num_docs, range_size)),
+              m_quantization_bits(quantization_bits),
+              m_block_max_term_weight(tmp_dir / "block_max_term_weight") {
+            spdlog::info("Storing max weight for each list and for each block...");
+            m_blocks_start.push_back(0);
+        }
+
+        /** Adds the blocks of the next posting list, and returns its maximum score. */
+        float append_block_max_list(BlockMaxList const& list) {
+            m_block_max_term_weight.append(list.scores);
+            m_blocks_start.push_back(list.scores.size() + m_blocks_start.back());
+            if (!list.scores.empty()) {
+                m_total_elements += list.postings;
+            }
+            return list.max_score;
+        }
+
+        /**
+         * Writes the block-max data in the layout of `mapper::freeze`, quantizing the scores
+         * against the maximum score of the index if quantization bits were given.
+         */
+        void write(
+            mapper::detail::freeze_visitor& freezer, std::ofstream& os, float index_max_term_weight
+        ) {
+            auto total_blocks = m_block_max_term_weight.size();
+            mapper::mappable_vector<uint64_t> blocks_start;
+            blocks_start.steal(m_blocks_start);
+            freezer(m_blocks_num, "m_blocks_num")(blocks_start, "m_blocks_start");
+            if (m_quantization_bits.has_value()) {
+                LinearQuantizer quantizer(index_max_term_weight, m_quantization_bits->as_int());
+                m_block_max_term_weight.write(freezer, os, [&](float w) {
+                    return static_cast<float>(quantizer(w));
+                });
+            } else {
+                m_block_max_term_weight.write(freezer, os);
+            }
+            spdlog::info(
+                "number of elements / number of blocks: {}",
+                static_cast<float>(m_total_elements) / total_blocks
+            );
+        }
+
+      private:
+        uint64_t m_blocks_num;
+        std::optional<Size> m_quantization_bits;
+        uint64_t m_total_elements = 0;
+        std::vector<uint64_t> m_blocks_start;
+        SpilledVector<float> m_block_max_term_weight;
+    };
+
+    /**
+     * Computes the maximum score of each range of documents of a posting list, independently of
+     * the other lists. Lists shorter than `min_list_lenght` get no blocks, and their block-max
+     * scores are computed at query time instead.
+     */
+    template <typename Scorer>
+    static BlockMaxList compute_block_max_list(
+        binary_freq_collection::sequence const& term_seq,
+        uint64_t num_docs,
+        Scorer scorer,
+        [[maybe_unused]] BlockSize block_size
+    ) {
+        BlockMaxList list;
+        list.postings = term_seq.docs.size();
+        std::vector<float> b_max(ceil_div(num_docs, range_size), 0.0F);
+        for (auto i = 0; i < term_seq.docs.size(); ++i) {
+            uint64_t docid = *(term_seq.docs.begin() + i);
+            uint64_t freq = *(term_seq.freqs.begin() + i);
+            float score = scorer(docid, freq);
+            list.max_score = std::max(list.max_score, score);
+            size_t pos = docid / range_size;
+            float& bm = b_max[pos];
+            bm = std::max(bm, score);
+        }
+        if (term_seq.docs.size() >= min_list_lenght) {
+            list.scores = std::move(b_max);
+        }
+        return list;
+    }
+
     class enumerator {
         friend class wand_data_range;
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <filesystem>
+#include <fstream>
+#include <optional>
 #include <variant>
 
 #include <spdlog/spdlog.h>
@@ -8,6 +11,8 @@
 #include "global_parameters.hpp"
 #include "linear_quantizer.hpp"
 #include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "spilled_vector.hpp"
 #include "type_safe.hpp"
 #include "util/compiler_attribute.hpp"
 #include "wand_utils.hpp"
@@ -44,21 +49,20 @@ class wand_data_raw {
             Scorer scorer,
             BlockSize block_size
         ) {
-            auto t = std::holds_alternative<FixedBlock>(block_size)
-                ? static_block_partition(seq, scorer, std::get<FixedBlock>(block_size).size)
-                : variable_block_partition(
-                      coll, seq, scorer, std::get<VariableBlock>(block_size).lambda
-                  );
+            return append_block_max_list(compute_block_max_list(seq, coll.num_docs(), scorer, block_size));
+        }
 
+        /** Adds the blocks of the next posting list, and returns its maximum score. */
+        float append_block_max_list(BlockMaxList const& list) {
             block_max_term_weight.insert(
-                block_max_term_weight.end(), t.second.begin(), t.second.end()
+                block_max_term_weight.end(), list.scores.begin(), list.scores.end()
             );
-            block_docid.insert(block_docid.end(), t.first.begin(), t.first.end());
-            max_term_weight.push_back(*(std::max_element(t.second.begin(), t.second.end())));
-            blocks_start.push_back(t.first.size() + blocks_start.back());
+            block_docid.insert(block_docid.end(), list.docids.begin(), list.docids.end());
+            max_term_weight.push_back(list.max_score);
+            blocks_start.push_back(list.docids.size() + blocks_start.back());
 
-            total_elements += seq.docs.size();
-            total_blocks += t.first.size();
+            total_elements += list.postings;
+            total_blocks += list.docids.size();
             effective_list++;
             return max_term_weight.back();
         }
@@ -89,6 +93,80 @@ class wand_data_raw {
         std::vector<float> block_max_term_weight;
         std::vector<uint32_t> block_docid;
     };
+
+    /**
+     * Builder writing the blocks to temporary files in `tmp_dir` as posting lists are added, so
+     * that only the block offsets of the lists are kept in memory.
+     */
+    class stream_builder {
+      public:
+        stream_builder(
+            [[maybe_unused]] uint64_t num_docs,
+            [[maybe_unused]] global_parameters const& params,
+            std::optional<Size> quantization_bits,
+            std::filesystem::path const& tmp_dir
+        )
+            : m_quantization_bits(quantization_bits),
+              m_block_max_term_weight(tmp_dir / "block_max_term_weight"),
+              m_block_docid(tmp_dir / "block_docid") {
+            spdlog::info("Storing max weight for each list and for each block...");
+            m_blocks_start.push_back(0);
+        }
+
+        /** Adds the blocks of the next posting list, and returns its maximum score. */
+        float append_block_max_list(BlockMaxList const& list) {
+            m_block_max_term_weight.append(list.scores);
+            m_block_docid.append(list.docids);
+            m_blocks_start.push_back(list.docids.size() + m_blocks_start.back());
+            m_total_elements += list.postings;
+            return list.max_score;
+        }
+
+        /**
+         * Writes the block-max data in the layout of `mapper::freeze`, quantizing the scores
+         * against the maximum score of the index if quantization bits were given.
+         */
+        void write(
+            mapper::detail::freeze_visitor& freezer, std::ofstream& os, float index_max_term_weight
+        ) {
+            auto total_blocks = m_block_docid.size();
+            mapper::mappable_vector<uint64_t> blocks_start;
+            blocks_start.steal(m_blocks_start);
+            freezer(blocks_start, "m_blocks_start");
+            if (m_quantization_bits.has_value()) {
+                LinearQuantizer quantizer(index_max_term_weight, m_quantization_bits->as_int());
+                m_block_max_term_weight.write(freezer, os, [&](float w) {
+                    return static_cast<float>(quantizer(w));
+                });
+            } else {
+                m_block_max_term_weight.write(freezer, os);
+            }
+            m_block_docid.write(freezer, os);
+            spdlog::info(
+                "number of elements / number of blocks: {}",
+                static_cast<float>(m_total_elements) / static_cast<float>(total_blocks)
+            );
+        }
+
+      private:
+        std::optional<Size> m_quantization_bits;
+        uint64_t m_total_elements = 0;
+        std::vector<uint64_t> m_blocks_start;
+        SpilledVector<float> m_block_max_term_weight;
+        SpilledVector<uint32_t> m_block_docid;
+    };
+
+    /** Computes the blocks of a posting list, independently of the other lists. */
+    template <typename Scorer>
+    static BlockMaxList compute_block_max_list(
+        binary_freq_collection::sequence const& seq,
+        [[maybe_unused]] uint64_t num_docs,
+        Scorer scorer,
+        BlockSize block_size
+    ) {
+        return block_max_partition(seq, scorer, block_size);
+    }
+
     class enumerator {
         friend class wand_data_raw;
 
@@ -133,6 +211,14 @@ class wand_data_raw {
         );
     }
 
+    /** Appends the blocks of list `i` to `list`, with their last documents shifted by `offset`. */
+    void append_blocks(uint32_t i, uint32_t offset, BlockMaxList& list) const {
+        for (auto block = m_blocks_start[i]; block < m_blocks_start[i + 1]; ++block) {
+            list.docids.push_back(m_block_docid[block] + offset);
+            list.scores.push_back(m_block_max_term_weight[block]);
+        }
+    }
+
     template <typename Visitor>
     void map(Visitor& visit) {
         visit(m_blocks_start, "m_blocks_start")(m_block_max_term_weight, "m_block_max_term_weight")(
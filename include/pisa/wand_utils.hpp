@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include "binary_freq_collection.hpp"
 #include "score_opt_partition.hpp"
@@ -19,6 +22,21 @@ struct VariableBlock {
 
 using BlockSize = std::variant<FixedBlock, VariableBlock>;
 
+/**
+ * Block-max scores of a posting list, computed independently of the other lists so that lists can
+ * be processed concurrently and then appended to a block-max builder in term order.
+ */
+struct BlockMaxList {
+    /** The last document of each block; empty for fixed document ranges. */
+    std::vector<uint32_t> docids{};
+    /** The maximum score of each block. */
+    std::vector<float> scores{};
+    /** The number of postings of the list. */
+    uint64_t postings = 0;
+    /** The maximum score of the list. */
+    float max_score = 0;
+};
+
 template <typename Scorer>
 std::pair<std::vector<uint32_t>, std::vector<float>> static_block_partition(
     binary_freq_collection::sequence const& seq, Scorer scorer, const uint64_t block_size
@@ -54,7 +72,6 @@ std::pair<std::vector<uint32_t>, std::vector<float>> static_block_partition(
 
 template <typename Scorer>
 std::pair<std::vector<uint32_t>, std::vector<float>> variable_block_partition(
-    [[maybe_unused]] binary_freq_collection const& coll,
     binary_freq_collection::sequence const& seq,
     Scorer scorer,
     const float lambda,
@@ -82,4 +99,18 @@ std::pair<std::vector<uint32_t>, std::vector<float>> variable_block_partition(
     return std::make_pair(p.docids, p.max_values);
 }
 
+/** Partitions a posting list into blocks of the given size, see `BlockMaxList`. */
+template <typename Scorer>
+BlockMaxList block_max_partition(
+    binary_freq_collection::sequence const& seq,
+    Scorer scorer,
+    BlockSize block_size
+) {
+    auto [docids, scores] = std::holds_alternative<FixedBlock>(block_size)
+        ? static_block_partition(seq, scorer, std::get<FixedBlock>(block_size).size)
+        : variable_block_partition(seq, scorer, std::get<VariableBlock>(block_size).lambda);
+    float max_score = *std::max_element(scores.begin(), scores.end());
+    return BlockMaxList{std::move(docids), std::move(scores), seq.docs.size(), max_score};
+}
+
 }  // namespace pisa
@@ -0,0 +1,102 @@
+#include "binary_collection_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <stdexcept>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "codec/block_codecs.hpp"
+#include "util/inverted_index_utils.hpp"
+
+namespace pisa {
+
+BinaryCollectionWriter::BinaryCollectionWriter(
+    std::string const& filename, BinaryCollectionFormat format
+)
+    : m_format(format), m_output(filename, std::ios::binary) {
+    m_output.exceptions(std::ios::badbit | std::ios::failbit);
+    if (m_format == BinaryCollectionFormat::VByte) {
+        m_offsets.emplace(filename + ".offsets.tmp");
+        std::uint64_t header[] = {vbyte_collection::magic, 0};
+        m_output.write(reinterpret_cast<char const*>(header), sizeof(header));
+        m_position = sizeof(header);
+    }
+}
+
+BinaryCollectionWriter::~BinaryCollectionWriter() {
+    try {
+        close();
+    } catch (std::exception const& err) {
+        spdlog::error("Failed to close binary collection: {}", err.what());
+    }
+}
+
+void BinaryCollectionWriter::write(std::span<std::uint32_t const> sequence) {
+    if (m_format == BinaryCollectionFormat::Raw) {
+        write_sequence(m_output, sequence);
+        return;
+    }
+    if (sequence.size() > vbyte_collection::max_length) {
+        throw std::length_error(fmt::format(
+            "Sequence of length {} is too long for a VByte binary collection", sequence.size()
+        ));
+    }
+    bool delta = std::is_sorted(sequence.begin(), sequence.end());
+    auto header = static_cast<std::uint32_t>(2 * sequence.size() + (delta ? 1 : 0));
+    m_values.resize(sequence.size());
+    if (delta) {
+        std::adjacent_difference(sequence.begin(), sequence.end(), m_values.begin());
+    } else {
+        std::copy(sequence.begin(), sequence.end(), m_values.begin());
+    }
+    // A 32-bit value takes at most 5 bytes.
+    m_encoded.resize(5 * (sequence.size() + 1));
+    std::size_t header_bytes = 0;
+    std::size_t value_bytes = 0;
+    TightVariableByte::encode(&header, 1, m_encoded.data(), header_bytes);
+    TightVariableByte::encode(
+        m_values.data(), m_values.size(), m_encoded.data() + header_bytes, value_bytes
+    );
+    m_offsets->append(std::span<std::uint64_t const>(&m_position, 1));
+    m_output.write(
+        reinterpret_cast<char const*>(m_encoded.data()),
+        static_cast<std::streamsize>(header_bytes + value_bytes)
+    );
+    m_position += header_bytes + value_bytes;
+}
+
+void BinaryCollectionWriter::write(std::uint32_t value) {
+    write(std::span<std::uint32_t const>(&value, 1));
+}
+
+void BinaryCollectionWriter::close() {
+    if (not m_output.is_open()) {
+        return;
+    }
+    if (m_format == BinaryCollectionFormat::VByte) {
+        std::uint64_t count = m_offsets->size();
+        std::array<char, sizeof(std::uint64_t)> padding{};
+        auto padding_bytes = (sizeof(std::uint64_t) - m_position % sizeof(std::uint64_t))
+            % sizeof(std::uint64_t);
+        m_output.write(padding.data(), static_cast<std::streamsize>(padding_bytes));
+        auto input = m_offsets->read();
+        std::vector<std::uint64_t> offsets;
+        for (std::size_t pos = 0; pos < count; pos += SpilledVector<std::uint64_t>::chunk_size) {
+            input.read(std::min(SpilledVector<std::uint64_t>::chunk_size, count - pos), offsets);
+            m_output.write(
+                reinterpret_cast<char const*>(offsets.data()),
+                static_cast<std::streamsize>(offsets.size() * sizeof(std::uint64_t))
+            );
+        }
+        m_output.write(reinterpret_cast<char const*>(&m_position), sizeof(m_position));
+        m_output.seekp(sizeof(vbyte_collection::magic));
+        m_output.write(reinterpret_cast<char const*>(&count), sizeof(count));
+        m_offsets->remove();
+    }
+    m_output.close();
+}
+
+}  // namespace pisa
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <utility>
 
 namespace pisa {
 
@@ -16,6 +17,18 @@ bit_vector_builder::bit_vector_builder(uint64_t size, bool init) : m_size(size)
     }
 }
 
+bit_vector_builder::bit_vector_builder(bit_vector_builder&& other) noexcept
+    : m_bits(std::move(other.m_bits)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_cur_word(std::exchange(other.m_cur_word, nullptr)) {
+    other.m_bits.clear();
+}
+
+bit_vector_builder& bit_vector_builder::operator=(bit_vector_builder&& other) noexcept {
+    bit_vector_builder(std::move(other)).swap(*this);
+    return *this;
+}
+
 void bit_vector_builder::reserve(uint64_t size) {
     m_bits.reserve(detail::words_for(size));
 }
@@ -1,16 +1,88 @@
+#include <algorithm>
+#include <cstring>
+
 #include "block_inverted_index.hpp"
 #include "bit_vector_builder.hpp"
 #include "codec/compact_elias_fano.hpp"
+#include "codec/mixed.hpp"
 #include "mappable/mapper.hpp"
+#include "posting_list_pipeline.hpp"
 #include "util/index_build_utils.hpp"
 #include "util/progress.hpp"
 #include "util/verify_collection.hpp"
 
 namespace pisa {
 
+namespace {
+
+    /**
+     * Encodes blocks with a mixed codec, but with a time weight of its own, so that lists with
+     * different weights can be encoded concurrently.
+     */
+    class WeightedMixedCodec final: public BlockCodec {
+      public:
+        WeightedMixedCodec(MixedBlockCodec const* codec, double time_weight)
+            : m_codec(codec), m_time_weight(time_weight) {}
+
+        void encode(
+            uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out
+        ) const override {
+            m_codec->encode(in, sum_of_values, n, out, m_time_weight);
+        }
+        uint8_t const*
+        decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) const override {
+            return m_codec->decode(in, out, sum_of_values, n);
+        }
+        auto block_size() const noexcept -> std::size_t override { return m_codec->block_size(); }
+        auto get_name() const noexcept -> std::string_view override { return m_codec->get_name(); }
+
+      private:
+        MixedBlockCodec const* m_codec;
+        double m_time_weight;
+    };
+
+    /**
+     * Encodes a block of frequencies minus one, and returns whether they are all the same, in
+     * which case (most often all ones) the value is stored only once.
+     */
+    auto encode_freqs_block(
+        BlockCodec const* codec,
+        std::uint32_t const* freqs,
+        std::size_t size,
+        std::vector<std::uint8_t>& out
+    ) -> bool {
+        if (std::all_of(freqs, freqs + size, [&](auto f) { return f == freqs[0]; })) {
+            TightVariableByte::encode_single(freqs[0], out);
+            return true;
+        }
+        codec->encode(freqs, uint32_t(-1), size, out);
+        return false;
+    }
+
+}  // namespace
+
 BlockInvertedIndex::BlockInvertedIndex(MemorySource source, BlockCodecPtr block_codec)
     : m_source(std::move(source)), m_block_codec(std::move(block_codec)) {
     static_assert(concepts::SortedInvertedIndex<BlockInvertedIndex, BlockInvertedIndexCursor<>>);
+    // The header, which follows the freezing flags, is checked before mapping, since the sizes
+    // read from a file of another format are meaningless.
+    std::uint32_t magic = 0;
+    std::uint32_t version = 0;
+    std::size_t offset = sizeof(std::uint64_t);
+    if (m_source.size() >= offset + sizeof(magic) + sizeof(version)) {
+        std::memcpy(&magic, m_source.data() + offset, sizeof(magic));
+        std::memcpy(&version, m_source.data() + offset + sizeof(magic), sizeof(version));
+    }
+    if (magic != format_magic) {
+        throw std::runtime_error(
+            "not a block index, or a block index written by an older version: build it again"
+        );
+    }
+    if (version == 0 || version > format_version) {
+        throw std::runtime_error(fmt::format(
+            "unsupported block index version {}, expected at most {}", version, format_version
+        ));
+    }
     mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
 }
 
@@ -98,7 +170,8 @@ void index::block::write_posting_list(
     uint64_t blocks = ceil_div(n, block_size);
     size_t begin_block_maxs = out.size();
     size_t begin_block_endpoints = begin_block_maxs + 4 * blocks;
-    size_t begin_blocks = begin_block_endpoints + 4 * (blocks - 1);
+    size_t begin_block_flags = begin_block_endpoints + 4 * (blocks - 1);
+    size_t begin_blocks = begin_block_flags + ceil_div(blocks, 8);
     out.resize(begin_blocks);
 
     std::vector<uint32_t> docs_buf(block_size);
@@ -120,7 +193,9 @@ void index::block::write_posting_list(
         codec->encode(
             docs_buf.data(), last_doc - block_base - (cur_block_size - 1), cur_block_size, out
         );
-        codec->encode(freqs_buf.data(), uint32_t(-1), cur_block_size, out);
+        if (encode_freqs_block(codec, freqs_buf.data(), cur_block_size, out)) {
+            out[begin_block_flags + b / 8] |= std::uint8_t(1) << (b % 8);
+        }
         if (b != blocks - 1) {
             std::uint32_t endpoint = out.size() - begin_blocks;
             std::memcpy(out.data() + begin_block_endpoints + 4 * b, &endpoint, sizeof(endpoint));
@@ -129,6 +204,142 @@ void index::block::write_posting_list(
     }
 }
 
+void index::block::report_codec_mix(BlockCodec const& codec) {
+    auto const* mixed = dynamic_cast<MixedBlockCodec const*>(&codec);
+    if (mixed == nullptr) {
+        return;
+    }
+    auto blocks = mixed->block_counts();
+    auto bytes = mixed->byte_counts();
+    stats_line line;
+    line("type", mixed->get_name())("time_weight", mixed->time_weight());
+    for (std::size_t idx = 0; idx < blocks.size(); ++idx) {
+        auto codec_name = MixedBlockCodec::candidate_names[idx];
+        spdlog::info("{}: {} blocks, {} bytes", codec_name, blocks[idx], bytes[idx]);
+        line(fmt::format("{}_decode_ns", codec_name), mixed->decode_ns()[idx]);
+        line(fmt::format("{}_blocks", codec_name), blocks[idx]);
+        line(fmt::format("{}_bytes", codec_name), bytes[idx]);
+    }
+}
+
+index::block::PostingListConcatenator::PostingListConcatenator(BlockCodec const* codec)
+    : m_codec(codec) {}
+
+void index::block::PostingListConcatenator::append(
+    BlockInvertedIndexCursor<> list, std::uint32_t offset
+) {
+    std::size_t block_size = m_codec->block_size();
+    std::vector<std::uint32_t> gaps;
+    std::vector<std::uint32_t> freqs;
+    std::int64_t list_last_doc = -1;
+    for (auto const& block: list.get_blocks()) {
+        if (block.size == block_size) {
+            flush_pending();
+            auto shift = list_last_doc + offset - m_last_doc;
+            if (shift != 0) {
+                // Only the first gap depends on the base of the block.
+                block.decode_doc_gaps(gaps);
+                gaps[0] = static_cast<std::uint32_t>(gaps[0] + shift);
+                auto universe = block.max + offset - (m_last_doc + 1) - (block.size - 1);
+                m_codec->encode(gaps.data(), universe, block.size, m_blocks_data);
+                ++m_encoded;
+            } else {
+                block.append_docs_block(m_blocks_data);
+                ++m_copied;
+            }
+            block.append_freqs_block(m_blocks_data);
+            end_block(block.max + offset, block.size, block.constant_freqs);
+        } else {
+            block.decode_doc_gaps(gaps);
+            block.decode_freqs(freqs);
+            auto doc = list_last_doc;
+            for (std::size_t pos = 0; pos < block.size; ++pos) {
+                doc += gaps[pos] + 1;
+                m_pending_docs.push_back(static_cast<std::uint32_t>(doc + offset));
+                m_pending_freqs.push_back(freqs[pos]);
+            }
+            std::size_t encoded = 0;
+            for (; m_pending_docs.size() - encoded >= block_size; encoded += block_size) {
+                encode_block(&m_pending_docs[encoded], &m_pending_freqs[encoded], block_size);
+            }
+            m_pending_docs.erase(m_pending_docs.begin(), m_pending_docs.begin() + encoded);
+            m_pending_freqs.erase(m_pending_freqs.begin(), m_pending_freqs.begin() + encoded);
+        }
+        list_last_doc = block.max;
+    }
+}
+
+void index::block::PostingListConcatenator::flush_pending() {
+    if (!m_pending_docs.empty()) {
+        encode_block(m_pending_docs.data(), m_pending_freqs.data(), m_pending_docs.size());
+        m_pending_docs.clear();
+        m_pending_freqs.clear();
+    }
+}
+
+void index::block::PostingListConcatenator::encode_block(
+    std::uint32_t const* docs, std::uint32_t const* freqs, std::size_t size
+) {
+    std::vector<std::uint32_t> gaps(size);
+    auto last_doc = m_last_doc;
+    for (std::size_t pos = 0; pos < size; ++pos) {
+        gaps[pos] = docs[pos] - last_doc - 1;
+        last_doc = docs[pos];
+    }
+    m_codec->encode(gaps.data(), last_doc - (m_last_doc + 1) - (size - 1), size, m_blocks_data);
+    bool constant_freqs = encode_freqs_block(m_codec, freqs, size, m_blocks_data);
+    end_block(static_cast<std::uint32_t>(last_doc), size, constant_freqs);
+    ++m_encoded;
+}
+
+void index::block::PostingListConcatenator::end_block(
+    std::uint32_t max, std::size_t size, bool constant_freqs
+) {
+    m_block_starts.push_back(m_size);
+    m_size += size;
+    m_last_doc = max;
+    m_block_maxs.push_back(max);
+    m_block_endpoints.push_back(m_blocks_data.size());
+    m_constant_freqs.push_back(constant_freqs);
+}
+
+void index::block::PostingListConcatenator::finish(std::vector<std::uint8_t>& out) {
+    flush_pending();
+    if (m_size == 0) {
+        throw std::invalid_argument("List must be nonempty");
+    }
+    std::size_t blocks = m_block_maxs.size();
+    std::size_t block_size = m_codec->block_size();
+    bool full_blocks = true;
+    for (std::size_t b = 0; b < blocks; ++b) {
+        full_blocks = full_blocks && m_block_starts[b] == b * block_size;
+    }
+    if (!full_blocks) {
+        TightVariableByte::encode_single(0, out);
+    }
+    TightVariableByte::encode_single(m_size, out);
+    if (!full_blocks) {
+        TightVariableByte::encode_single(blocks, out);
+    }
+    auto append_words = [&](std::uint32_t const* words, std::size_t count) {
+        auto const* bytes = reinterpret_cast<std::uint8_t const*>(words);
+        out.insert(out.end(), bytes, bytes + 4 * count);
+    };
+    append_words(m_block_maxs.data(), blocks);
+    append_words(m_block_endpoints.data(), blocks - 1);
+    if (!full_blocks) {
+        append_words(m_block_starts.data() + 1, blocks - 1);
+    }
+    std::size_t begin_block_flags = out.size();
+    out.resize(begin_block_flags + ceil_div(blocks, 8), 0);
+    for (std::size_t b = 0; b < blocks; ++b) {
+        if (m_constant_freqs[b]) {
+            out[begin_block_flags + b / 8] |= std::uint8_t(1) << (b % 8);
+        }
+    }
+    out.insert(out.end(), m_blocks_data.begin(), m_blocks_data.end());
+}
+
 void index::block::PostingAccumulator::write(
     std::vector<uint8_t>& out, std::uint32_t n, std::uint32_t const* docs, std::uint32_t const* freqs
 ) {
@@ -148,6 +359,11 @@ auto BlockIndexBuilder::in_memory(bool in_mem) -> BlockIndexBuilder& {
     return *this;
 }
 
+auto BlockIndexBuilder::term_accesses(std::vector<std::uint64_t> accesses) -> BlockIndexBuilder& {
+    m_term_accesses = std::move(accesses);
+    return *this;
+}
+
 auto BlockIndexBuilder::resolve_accumulator(std::size_t num_docs, std::string const& index_path)
     -> std::unique_ptr<index::block::PostingAccumulator> {
     if (m_in_memory) {
@@ -164,19 +380,37 @@ void BlockIndexBuilder::build(binary_freq_collection const& input, std::string c
     spdlog::info("Processing {} documents", input.num_docs());
     double tick = get_time_usecs();
 
+    auto const* mixed = dynamic_cast<MixedBlockCodec const*>(m_block_codec.get());
+    if (m_term_accesses.has_value() && mixed == nullptr) {
+        throw std::invalid_argument(
+            fmt::format("term accesses are not supported by {}", m_block_codec->get_name())
+        );
+    }
+    double time_weight = mixed != nullptr ? mixed->time_weight() : 0.0;
+
     size_t postings = 0;
     {
         auto accumulator = resolve_accumulator(input.num_docs(), index_path);
 
         pisa::progress progress("Create index", input.size());
 
-        size_t term_id = 0;
-        for (auto const& plist: input) {
-            accumulate_posting_list(plist.docs, plist.freqs, term_id, accumulator.get());
-            progress.update(1);
-            postings += plist.docs.size();
-            term_id += 1;
-        }
+        encode_posting_lists(
+            input,
+            [&](std::size_t term_id, auto const& plist) {
+                if (m_term_accesses.has_value()) {
+                    auto accesses =
+                        term_id < m_term_accesses->size() ? (*m_term_accesses)[term_id] : 0;
+                    WeightedMixedCodec codec(mixed, time_weight * static_cast<double>(accesses));
+                    return encode_posting_list(&codec, plist.docs, plist.freqs, term_id);
+                }
+                return encode_posting_list(m_block_codec.get(), plist.docs, plist.freqs, term_id);
+            },
+            [&](std::size_t, auto const& plist, auto const& encoded) {
+                accumulator->append_posting_list(encoded);
+                progress.update(1);
+                postings += plist.docs.size();
+            }
+        );
         accumulator->finish();
     }
 
@@ -187,6 +421,8 @@ void BlockIndexBuilder::build(binary_freq_collection const& input, std::string c
         "construction_time", elapsed_secs
     );
 
+    index::block::report_codec_mix(*m_block_codec);
+
     if (m_check) {
         BlockInvertedIndex index(
             MemorySource::mapped_file(std::filesystem::path(index_path)), m_block_codec
@@ -215,6 +451,13 @@ void index::block::InMemoryPostingAccumulator::accumulate_posting_list(
     m_endpoints.push_back(m_lists.size());
 }
 
+void index::block::InMemoryPostingAccumulator::append_posting_list(
+    std::vector<std::uint8_t> const& encoded
+) {
+    m_lists.insert(m_lists.end(), encoded.begin(), encoded.end());
+    m_endpoints.push_back(m_lists.size());
+}
+
 void index::block::InMemoryPostingAccumulator::finish() {
     m_finished = true;
 
@@ -251,8 +494,14 @@ void index::block::StreamPostingAccumulator::accumulate_posting_list(
     }
     std::vector<std::uint8_t> buf;
     write(buf, n, docs, freqs);
-    m_postings_bytes_written += buf.size();
-    m_postings_output.write(reinterpret_cast<char const*>(buf.data()), buf.size());
+    append_posting_list(buf);
+}
+
+void index::block::StreamPostingAccumulator::append_posting_list(
+    std::vector<std::uint8_t> const& encoded
+) {
+    m_postings_bytes_written += encoded.size();
+    m_postings_output.write(reinterpret_cast<char const*>(encoded.data()), encoded.size());
     m_endpoints.push_back(m_postings_bytes_written);
 }
 
@@ -269,6 +518,10 @@ void index::block::StreamPostingAccumulator::finish() {
     std::cout << m_output_filename.c_str() << "\n";
     os.exceptions(std::ios::badbit | std::ios::failbit);
     mapper::detail::freeze_visitor freezer(os, 0);
+    std::uint32_t magic = BlockInvertedIndex::format_magic;
+    std::uint32_t version = BlockInvertedIndex::format_version;
+    freezer(magic, "m_magic");
+    freezer(version, "m_version");
     freezer(m_params, "m_params");
     std::size_t size = m_endpoints.size() - 1;
     freezer(size, "size");
@@ -9,9 +9,12 @@
 #include "codec/block_codec.hpp"
 #include "codec/interpolative.hpp"
 #include "codec/maskedvbyte.hpp"
+#include "codec/mixed.hpp"
 #include "codec/optpfor.hpp"
 #include "codec/qmx.hpp"
 #include "codec/simdbp.hpp"
+#include "codec/simdbp_wide.hpp"
+#include "codec/simdpfor.hpp"
 #include "codec/simple16.hpp"
 #include "codec/simple8b.hpp"
 #include "codec/streamvbyte.hpp"
@@ -23,9 +26,14 @@ namespace pisa {
 using BlockCodecs = BlockCodecRegistry<
     InterpolativeBlockCodec,
     MaskedVByteBlockCodec,
+    MixedBlockCodec,
     OptPForBlockCodec,
     QmxBlockCodec,
     SimdBpBlockCodec,
+    SimdBp256BlockCodec,
+    SimdBp512BlockCodec,
+    SimdPFor128BlockCodec,
+    SimdPFor256BlockCodec,
     Simple16BlockCodec,
     Simple8bBlockCodec,
     StreamVByteBlockCodec,
@@ -36,7 +44,7 @@ auto get_block_codec(std::string_view name) -> BlockCodecPtr {
     return BlockCodecs::get(name);
 }
 
-constexpr auto get_block_codec_names() -> std::span<std::string_view const> {
+auto get_block_codec_names() -> std::span<std::string_view const> {
     return std::span<std::string_view const>(&BlockCodecs::names[0], BlockCodecs::count());
 }
 
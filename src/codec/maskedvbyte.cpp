@@ -29,4 +29,18 @@ MaskedVByteBlockCodec::decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_
     return in + read;
 }
 
+uint8_t const* MaskedVByteBlockCodec::decode_docids(
+    uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n, uint32_t base
+) const {
+    assert(n <= m_block_size);
+    if (n < m_block_size) [[unlikely]] {
+        auto const* next = interpolative_block::decode(in, out, sum_of_values, n);
+        docid_prefix_sum(out, n, base);
+        return next;
+    }
+    auto read = masked_vbyte_decode_delta(in, out, n, base);
+    add_positions(out, n);
+    return in + read;
+}
+
 }  // namespace pisa
@@ -3,6 +3,7 @@
 
 extern "C" {
 #include "simdcomp/include/simdbitpacking.h"
+#include "simdcomp/include/simdintegratedbitpacking.h"
 }
 
 namespace pisa {
@@ -35,4 +36,21 @@ SimdBpBlockCodec::decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_value
     return in + b * sizeof(__m128i);
 }
 
+uint8_t const* SimdBpBlockCodec::decode_docids(
+    uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n, uint32_t base
+) const {
+    assert(n <= m_block_size);
+    if (n < m_block_size) [[unlikely]] {
+        auto const* next = interpolative_block::decode(in, out, sum_of_values, n);
+        docid_prefix_sum(out, n, base);
+        return next;
+    }
+    uint32_t b = *in++;
+    // Unpacks and computes the prefix sum in SIMD registers; only the positions need to be
+    // added, because the gaps are stored minus one.
+    simdunpackd1(base, (const __m128i*)in, out, b);
+    add_positions(out, n);
+    return in + b * sizeof(__m128i);
+}
+
 }  // namespace pisa
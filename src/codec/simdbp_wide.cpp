@@ -0,0 +1,113 @@
+#include "codec/simdbp_wide.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "codec/block_codecs.hpp"
+
+namespace pisa {
+
+namespace simdbp_wide {
+
+    template <std::size_t lanes>
+    auto select_unpacker(SimdLevel level, std::uint32_t bits) -> UnpackFn {
+        switch (level) {
+        case SimdLevel::Sse4: return sse4_unpacker<lanes>(bits);
+        case SimdLevel::Avx2:
+            if constexpr (lanes % 8 == 0) {
+                return avx2_unpacker<lanes>(bits);
+            }
+            break;
+        case SimdLevel::Avx512:
+            if constexpr (lanes % 16 == 0) {
+                return avx512_unpacker<lanes>(bits);
+            }
+            break;
+        }
+        throw std::invalid_argument(
+            fmt::format("no {} kernel for {} lanes", to_string(level), lanes)
+        );
+    }
+
+    template <std::size_t lanes>
+    void pack(std::uint32_t const* in, std::uint32_t bits, std::uint32_t* out) {
+        std::fill_n(out, bits * lanes, 0);
+        for (std::size_t pos = 0; pos < 32 * lanes && bits > 0; ++pos) {
+            std::size_t lane = pos % lanes;
+            std::size_t offset = (pos / lanes) * bits;
+            std::size_t word = offset / 32;
+            std::size_t shift = offset % 32;
+            out[word * lanes + lane] |= in[pos] << shift;
+            if (shift + bits > 32) {
+                out[(word + 1) * lanes + lane] |= in[pos] >> (32 - shift);
+            }
+        }
+    }
+
+    template auto select_unpacker<4>(SimdLevel level, std::uint32_t bits) -> UnpackFn;
+    template auto select_unpacker<8>(SimdLevel level, std::uint32_t bits) -> UnpackFn;
+    template auto select_unpacker<16>(SimdLevel level, std::uint32_t bits) -> UnpackFn;
+    template void pack<4>(std::uint32_t const* in, std::uint32_t bits, std::uint32_t* out);
+    template void pack<8>(std::uint32_t const* in, std::uint32_t bits, std::uint32_t* out);
+    template void pack<16>(std::uint32_t const* in, std::uint32_t bits, std::uint32_t* out);
+
+}  // namespace simdbp_wide
+
+template <std::size_t lanes>
+SimdBpWideBlockCodec<lanes>::SimdBpWideBlockCodec() : SimdBpWideBlockCodec(detected_simd_level()) {}
+
+template <std::size_t lanes>
+SimdBpWideBlockCodec<lanes>::SimdBpWideBlockCodec(SimdLevel level)
+    : m_simd_level(std::min(level, max_simd_level)) {
+    if (m_simd_level > detected_simd_level()) {
+        throw std::invalid_argument(
+            fmt::format("{} kernels are not supported by the CPU", to_string(m_simd_level))
+        );
+    }
+    for (std::uint32_t bits = 0; bits < m_unpackers.size(); ++bits) {
+        m_unpackers[bits] = simdbp_wide::select_unpacker<lanes>(m_simd_level, bits);
+    }
+}
+
+template <std::size_t lanes>
+void SimdBpWideBlockCodec<lanes>::encode(
+    uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out
+) const {
+    assert(n <= m_block_size);
+    if (n < m_block_size) {
+        interpolative_block::encode(in, sum_of_values, n, out);
+        return;
+    }
+    auto bits = static_cast<std::uint32_t>(
+        std::bit_width(std::accumulate(in, in + n, std::uint32_t{0}, std::bit_or<>{}))
+    );
+    thread_local std::array<std::uint32_t, m_block_size> words{};
+    simdbp_wide::pack<lanes>(in, bits, words.data());
+    out.push_back(static_cast<std::uint8_t>(bits));
+    auto const* bytes = reinterpret_cast<std::uint8_t const*>(words.data());
+    out.insert(out.end(), bytes, bytes + bits * lanes * sizeof(std::uint32_t));
+}
+
+template <std::size_t lanes>
+uint8_t const* SimdBpWideBlockCodec<lanes>::decode(
+    uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n
+) const {
+    assert(n <= m_block_size);
+    if (n < m_block_size) [[unlikely]] {
+        return interpolative_block::decode(in, out, sum_of_values, n);
+    }
+    std::uint32_t bits = *in++;
+    m_unpackers[bits](reinterpret_cast<std::uint32_t const*>(in), out);
+    return in + bits * lanes * sizeof(std::uint32_t);
+}
+
+template class SimdBpWideBlockCodec<8>;
+template class SimdBpWideBlockCodec<16>;
+
+}  // namespace pisa
@@ -0,0 +1,49 @@
+#include <immintrin.h>
+
+#include "codec/simdbp_wide_kernel.hpp"
+
+namespace pisa::simdbp_wide {
+
+namespace {
+
+    struct Avx2Ops {
+        using vector = __m256i;
+        static constexpr std::size_t width = 8;
+
+        static PISA_ALWAYSINLINE auto load(std::uint32_t const* in) -> vector {
+            return _mm256_loadu_si256(reinterpret_cast<vector const*>(in));
+        }
+        static PISA_ALWAYSINLINE void store(std::uint32_t* out, vector value) {
+            _mm256_storeu_si256(reinterpret_cast<vector*>(out), value);
+        }
+        static PISA_ALWAYSINLINE auto zero() -> vector { return _mm256_setzero_si256(); }
+        static PISA_ALWAYSINLINE auto set1(std::uint32_t value) -> vector {
+            return _mm256_set1_epi32(static_cast<int>(value));
+        }
+        template <int count>
+        static PISA_ALWAYSINLINE auto shift_right(vector value) -> vector {
+            return _mm256_srli_epi32(value, count);
+        }
+        template <int count>
+        static PISA_ALWAYSINLINE auto shift_left(vector value) -> vector {
+            return _mm256_slli_epi32(value, count);
+        }
+        static PISA_ALWAYSINLINE auto bit_or(vector lhs, vector rhs) -> vector {
+            return _mm256_or_si256(lhs, rhs);
+        }
+        static PISA_ALWAYSINLINE auto bit_and(vector lhs, vector rhs) -> vector {
+            return _mm256_and_si256(lhs, rhs);
+        }
+    };
+
+}  // namespace
+
+template <std::size_t lanes>
+auto avx2_unpacker(std::uint32_t bits) -> UnpackFn {
+    return unpacker<Avx2Ops, lanes>(bits);
+}
+
+template auto avx2_unpacker<8>(std::uint32_t bits) -> UnpackFn;
+template auto avx2_unpacker<16>(std::uint32_t bits) -> UnpackFn;
+
+}  // namespace pisa::simdbp_wide
@@ -0,0 +1,52 @@
+// GCC reports the `_mm512_undefined_epi32()` used by the shift intrinsics as uninitialized.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+
+#include "codec/simdbp_wide_kernel.hpp"
+
+namespace pisa::simdbp_wide {
+
+namespace {
+
+    struct Avx512Ops {
+        using vector = __m512i;
+        static constexpr std::size_t width = 16;
+
+        static PISA_ALWAYSINLINE auto load(std::uint32_t const* in) -> vector {
+            return _mm512_loadu_si512(reinterpret_cast<vector const*>(in));
+        }
+        static PISA_ALWAYSINLINE void store(std::uint32_t* out, vector value) {
+            _mm512_storeu_si512(reinterpret_cast<vector*>(out), value);
+        }
+        static PISA_ALWAYSINLINE auto zero() -> vector { return _mm512_setzero_si512(); }
+        static PISA_ALWAYSINLINE auto set1(std::uint32_t value) -> vector {
+            return _mm512_set1_epi32(static_cast<int>(value));
+        }
+        template <int count>
+        static PISA_ALWAYSINLINE auto shift_right(vector value) -> vector {
+            return _mm512_srli_epi32(value, count);
+        }
+        template <int count>
+        static PISA_ALWAYSINLINE auto shift_left(vector value) -> vector {
+            return _mm512_slli_epi32(value, count);
+        }
+        static PISA_ALWAYSINLINE auto bit_or(vector lhs, vector rhs) -> vector {
+            return _mm512_or_si512(lhs, rhs);
+        }
+        static PISA_ALWAYSINLINE auto bit_and(vector lhs, vector rhs) -> vector {
+            return _mm512_and_si512(lhs, rhs);
+        }
+    };
+
+}  // namespace
+
+template <std::size_t lanes>
+auto avx512_unpacker(std::uint32_t bits) -> UnpackFn {
+    return unpacker<Avx512Ops, lanes>(bits);
+}
+
+template auto avx512_unpacker<16>(std::uint32_t bits) -> UnpackFn;
+
+}  // namespace pisa::simdbp_wide
@@ -0,0 +1,50 @@
+#include <immintrin.h>
+
+#include "codec/simdbp_wide_kernel.hpp"
+
+namespace pisa::simdbp_wide {
+
+namespace {
+
+    struct Sse4Ops {
+        using vector = __m128i;
+        static constexpr std::size_t width = 4;
+
+        static PISA_ALWAYSINLINE auto load(std::uint32_t const* in) -> vector {
+            return _mm_loadu_si128(reinterpret_cast<vector const*>(in));
+        }
+        static PISA_ALWAYSINLINE void store(std::uint32_t* out, vector value) {
+            _mm_storeu_si128(reinterpret_cast<vector*>(out), value);
+        }
+        static PISA_ALWAYSINLINE auto zero() -> vector { return _mm_setzero_si128(); }
+        static PISA_ALWAYSINLINE auto set1(std::uint32_t value) -> vector {
+            return _mm_set1_epi32(static_cast<int>(value));
+        }
+        template <int count>
+        static PISA_ALWAYSINLINE auto shift_right(vector value) -> vector {
+            return _mm_srli_epi32(value, count);
+        }
+        template <int count>
+        static PISA_ALWAYSINLINE auto shift_left(vector value) -> vector {
+            return _mm_slli_epi32(value, count);
+        }
+        static PISA_ALWAYSINLINE auto bit_or(vector lhs, vector rhs) -> vector {
+            return _mm_or_si128(lhs, rhs);
+        }
+        static PISA_ALWAYSINLINE auto bit_and(vector lhs, vector rhs) -> vector {
+            return _mm_and_si128(lhs, rhs);
+        }
+    };
+
+}  // namespace
+
+template <std::size_t lanes>
+auto sse4_unpacker(std::uint32_t bits) -> UnpackFn {
+    return unpacker<Sse4Ops, lanes>(bits);
+}
+
+template auto sse4_unpacker<4>(std::uint32_t bits) -> UnpackFn;
+template auto sse4_unpacker<8>(std::uint32_t bits) -> UnpackFn;
+template auto sse4_unpacker<16>(std::uint32_t bits) -> UnpackFn;
+
+}  // namespace pisa::simdbp_wide
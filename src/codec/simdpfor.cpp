@@ -0,0 +1,181 @@
+#include "codec/simdpfor.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "codec/block_codecs.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+namespace {
+
+    /** Returns the number of bytes of the exception section, excluding its header. */
+    [[nodiscard]] auto exceptions_bytes(std::size_t count, std::uint32_t bits) -> std::size_t {
+        return count + 4 * ceil_div(count * bits, 32);
+    }
+
+    /**
+     * Writes the exceptions, given by their positions and the values shifted right by the bit
+     * width of the block: the width of the high bits, the positions, and the high bits packed into
+     * 32-bit words.
+     */
+    void write_exceptions(
+        std::vector<std::uint8_t> const& positions,
+        std::vector<std::uint32_t> const& high,
+        std::vector<std::uint8_t>& out
+    ) {
+        auto bits = static_cast<std::uint32_t>(
+            std::bit_width(*std::max_element(high.begin(), high.end()))
+        );
+        out.push_back(static_cast<std::uint8_t>(bits));
+        out.insert(out.end(), positions.begin(), positions.end());
+        std::vector<std::uint32_t> words(ceil_div(high.size() * bits, 32), 0);
+        for (std::size_t idx = 0; idx < high.size(); ++idx) {
+            std::size_t offset = idx * bits;
+            std::size_t word = offset / 32;
+            std::size_t shift = offset % 32;
+            words[word] |= high[idx] << shift;
+            if (shift + bits > 32) {
+                words[word + 1] |= high[idx] >> (32 - shift);
+            }
+        }
+        auto const* bytes = reinterpret_cast<std::uint8_t const*>(words.data());
+        out.insert(out.end(), bytes, bytes + words.size() * sizeof(std::uint32_t));
+    }
+
+    [[nodiscard]] auto read_word(std::uint8_t const* in, std::size_t word) -> std::uint32_t {
+        std::uint32_t value;
+        std::memcpy(&value, in + word * sizeof(value), sizeof(value));
+        return value;
+    }
+
+    /** Adds the high bits of the exceptions to the unpacked block, and returns the block end. */
+    auto patch_exceptions(
+        std::uint8_t const* in, std::uint32_t* out, std::uint32_t block_bits, std::size_t count
+    ) -> std::uint8_t const* {
+        std::uint32_t bits = *in++;
+        std::uint8_t const* positions = in;
+        std::uint8_t const* words = in + count;
+        std::uint32_t mask = bits < 32 ? (std::uint32_t{1} << bits) - 1 : ~std::uint32_t{0};
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            std::size_t offset = idx * bits;
+            std::size_t word = offset / 32;
+            std::size_t shift = offset % 32;
+            std::uint32_t high = read_word(words, word) >> shift;
+            if (shift + bits > 32) {
+                high |= read_word(words, word + 1) << (32 - shift);
+            }
+            out[positions[idx]] |= (high & mask) << block_bits;
+        }
+        return in + exceptions_bytes(count, bits);
+    }
+
+}  // namespace
+
+template <std::size_t lanes>
+SimdPForBlockCodec<lanes>::SimdPForBlockCodec() : SimdPForBlockCodec(detected_simd_level()) {}
+
+template <std::size_t lanes>
+SimdPForBlockCodec<lanes>::SimdPForBlockCodec(SimdLevel level)
+    : m_simd_level(std::min(level, max_simd_level)) {
+    if (m_simd_level > detected_simd_level()) {
+        throw std::invalid_argument(
+            fmt::format("{} kernels are not supported by the CPU", to_string(m_simd_level))
+        );
+    }
+    for (std::uint32_t bits = 0; bits < m_unpackers.size(); ++bits) {
+        m_unpackers[bits] = simdbp_wide::select_unpacker<lanes>(m_simd_level, bits);
+    }
+}
+
+template <std::size_t lanes>
+void SimdPForBlockCodec<lanes>::encode(
+    uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out
+) const {
+    assert(n <= m_block_size);
+    if (n < m_block_size) {
+        interpolative_block::encode(in, sum_of_values, n, out);
+        return;
+    }
+
+    std::array<std::size_t, 33> widths{};
+    for (std::size_t pos = 0; pos < n; ++pos) {
+        ++widths[std::bit_width(in[pos])];
+    }
+    std::uint32_t max_bits = 32;
+    while (max_bits > 0 && widths[max_bits] == 0) {
+        --max_bits;
+    }
+
+    // Lowering the bit width by one turns the values of the current width into exceptions.
+    std::uint32_t best_bits = max_bits;
+    std::size_t best_size = 4 * max_bits * lanes;
+    std::size_t exceptions = 0;
+    for (std::uint32_t bits = max_bits; bits > 0; --bits) {
+        exceptions += widths[bits];
+        if (exceptions > max_exceptions) {
+            break;
+        }
+        std::size_t size =
+            4 * (bits - 1) * lanes + 1 + exceptions_bytes(exceptions, max_bits - bits + 1);
+        if (size < best_size) {
+            best_size = size;
+            best_bits = bits - 1;
+        }
+    }
+
+    thread_local std::array<std::uint32_t, m_block_size> low{};
+    thread_local std::array<std::uint32_t, m_block_size> words{};
+    thread_local std::vector<std::uint8_t> positions;
+    thread_local std::vector<std::uint32_t> high;
+    positions.clear();
+    high.clear();
+    for (std::size_t pos = 0; pos < n; ++pos) {
+        if (best_bits < 32 && (in[pos] >> best_bits) != 0) {
+            positions.push_back(static_cast<std::uint8_t>(pos));
+            high.push_back(in[pos] >> best_bits);
+            low[pos] = in[pos] & ((std::uint32_t{1} << best_bits) - 1);
+        } else {
+            low[pos] = in[pos];
+        }
+    }
+    simdbp_wide::pack<lanes>(low.data(), best_bits, words.data());
+
+    out.push_back(static_cast<std::uint8_t>(best_bits));
+    out.push_back(static_cast<std::uint8_t>(positions.size()));
+    auto const* bytes = reinterpret_cast<std::uint8_t const*>(words.data());
+    out.insert(out.end(), bytes, bytes + best_bits * lanes * sizeof(std::uint32_t));
+    if (!positions.empty()) {
+        write_exceptions(positions, high, out);
+    }
+}
+
+template <std::size_t lanes>
+uint8_t const* SimdPForBlockCodec<lanes>::decode(
+    uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n
+) const {
+    assert(n <= m_block_size);
+    if (n < m_block_size) [[unlikely]] {
+        return interpolative_block::decode(in, out, sum_of_values, n);
+    }
+    std::uint32_t bits = in[0];
+    std::size_t exceptions = in[1];
+    in += 2;
+    m_unpackers[bits](reinterpret_cast<std::uint32_t const*>(in), out);
+    in += bits * lanes * sizeof(std::uint32_t);
+    if (exceptions == 0) [[likely]] {
+        return in;
+    }
+    return patch_exceptions(in, out, bits, exceptions);
+}
+
+template class SimdPForBlockCodec<4>;
+template class SimdPForBlockCodec<8>;
+
+}  // namespace pisa
@@ -2,6 +2,7 @@
 
 #include "codec/streamvbyte.hpp"
 #include "streamvbyte/include/streamvbyte.h"
+#include "streamvbyte/include/streamvbyte_delta.h"
 
 namespace pisa {
 
@@ -22,4 +23,13 @@ uint8_t const* StreamVByteBlockCodec::decode(
     return in + read;
 }
 
+uint8_t const* StreamVByteBlockCodec::decode_docids(
+    uint8_t const* in, uint32_t* out, uint32_t /* sum_of_values */, size_t n, uint32_t base
+) const {
+    assert(n <= m_block_size);
+    auto read = streamvbyte_delta_decode(in, out, n, base);
+    add_positions(out, n);
+    return in + read;
+}
+
 }  // namespace pisa
@@ -30,4 +30,18 @@ VarintGbBlockCodec::decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_val
     return read + in;
 }
 
+uint8_t const* VarintGbBlockCodec::decode_docids(
+    uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n, uint32_t base
+) const {
+    thread_local VarIntGB<false> varintgb_codec;
+    assert(n <= m_block_size);
+    if (n < m_block_size) [[unlikely]] {
+        auto const* next = interpolative_block::decode(in, out, sum_of_values, n);
+        docid_prefix_sum(out, n, base);
+        return next;
+    }
+    auto read = varintgb_codec.decodeDocIdArray(in, n, out, base);
+    return read + in;
+}
+
 }  // namespace pisa
@@ -1,5 +1,13 @@
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <numeric>
 #include <optional>
+#include <ranges>
 #include <string>
+#include <utility>
 
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
@@ -7,14 +15,20 @@
 #include "block_inverted_index.hpp"
 #include "codec/block_codec.hpp"
 #include "codec/block_codec_registry.hpp"
+#include "codec/mixed.hpp"
 #include "compress.hpp"
 #include "index_types.hpp"
 #include "linear_quantizer.hpp"
+#include "invert.hpp"
+#include "posting_list_pipeline.hpp"
+#include "temporary_directory.hpp"
 #include "type_safe.hpp"
 #include "util/index_build_utils.hpp"
 #include "util/progress.hpp"
 #include "util/verify_collection.hpp"
 #include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_range.hpp"
 #include "wand_data_raw.hpp"
 
 namespace pisa {
@@ -26,7 +40,8 @@ void dump_index_specific_stats(pisa::pefuniform_index const& coll, std::string c
     pisa::stats_line()("type", type)("log_partition_size", int(coll.params().log_partition_size));
 }
 
-void dump_index_specific_stats(pisa::pefopt_index const& coll, std::string const& type) {
+template <typename Collection>
+void dump_partitioned_index_stats(Collection const& coll, std::string const& type) {
     std::uint64_t length_threshold = 4096;
     double long_postings = 0;
     double docs_partitions = 0;
@@ -46,56 +61,86 @@ void dump_index_specific_stats(pisa::pefopt_index const& coll, std::string const
     );
 }
 
-template <typename CollectionType, typename Wand>
-void compress_index_streaming(
-    binary_freq_collection const& input,
-    pisa::global_parameters const& params,
-    std::string const& output_filename,
-    std::optional<QuantizingScorer> quantizing_scorer,
-    bool check
-) {
-    spdlog::info("Processing {} documents (streaming)", input.num_docs());
-    double tick = get_time_usecs();
+void dump_index_specific_stats(pisa::pefopt_index const& coll, std::string const& type) {
+    dump_partitioned_index_stats(coll, type);
+}
 
-    typename CollectionType::stream_builder builder(input.num_docs(), params);
-    {
-        pisa::progress progress("Create index", input.size());
+void dump_index_specific_stats(pisa::hybrid_index const& coll, std::string const& type) {
+    dump_partitioned_index_stats(coll, type);
+}
 
-        size_t term_id = 0;
-        if (quantizing_scorer) {
-            std::vector<std::uint64_t> quantized_scores;
-            for (auto const& plist: input) {
+/**
+ * Encodes the posting lists of `input` concurrently, including the partition optimization, and
+ * appends them to the builder in term order. Returns the number of postings.
+ */
+template <typename Builder>
+auto add_posting_lists(
+    binary_freq_collection const& input,
+    Builder& builder,
+    std::optional<QuantizingScorer> const& quantizing_scorer
+) -> std::size_t {
+    std::size_t postings = 0;
+    pisa::progress progress("Create index", input.size());
+    encode_posting_lists(
+        input,
+        [&](std::size_t term_id, auto const& plist) {
+            size_t size = plist.docs.size();
+            if (quantizing_scorer.has_value()) {
                 auto term_scorer = quantizing_scorer->term_scorer(term_id);
-                std::size_t size = plist.docs.size();
+                std::vector<uint64_t> quants;
+                quants.reserve(size);
                 for (size_t pos = 0; pos < size; ++pos) {
-                    auto doc = *(plist.docs.begin() + pos);
-                    auto freq = *(plist.freqs.begin() + pos);
-                    auto score = term_scorer(doc, freq);
-                    quantized_scores.push_back(score);
+                    uint64_t doc = *(plist.docs.begin() + pos);
+                    uint64_t freq = *(plist.freqs.begin() + pos);
+                    uint64_t quant_score = term_scorer(doc, freq);
+                    quants.push_back(quant_score);
                 }
-                auto sum = std::accumulate(
-                    quantized_scores.begin(), quantized_scores.end(), std::uint64_t(0)
+                assert(quants.size() == size);
+                uint64_t quants_sum = std::accumulate(quants.begin(), quants.end(), uint64_t(0));
+                return builder.encode_posting_list(
+                    size, plist.docs.begin(), quants.begin(), quants_sum
                 );
-                builder.add_posting_list(size, plist.docs.begin(), quantized_scores.begin(), sum);
-                term_id += 1;
-                quantized_scores.clear();
-                progress.update(1);
-            }
-        } else {
-            for (auto const& plist: input) {
-                size_t size = plist.docs.size();
-                uint64_t freqs_sum =
-                    std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
-                progress.update(1);
-                term_id += 1;
             }
+            uint64_t freqs_sum =
+                std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
+            return builder.encode_posting_list(
+                size, plist.docs.begin(), plist.freqs.begin(), freqs_sum
+            );
+        },
+        [&](std::size_t, auto const& plist, auto const& encoded) {
+            builder.append_posting_list(encoded);
+            progress.update(1);
+            postings += plist.docs.size();
         }
-    }
+    );
+    return postings;
+}
 
+template <typename CollectionType>
+void compress_index_streaming(
+    binary_freq_collection const& input,
+    pisa::global_parameters const& params,
+    std::string const& output_filename,
+    std::optional<QuantizingScorer> quantizing_scorer,
+    bool check,
+    std::string const& seq_type
+) {
+    double tick = get_time_usecs();
+    auto tmp_root = tmp_root_for(output_filename);
+    typename CollectionType::stream_builder builder(input.num_docs(), params, tmp_root);
+    auto postings = add_posting_lists(input, builder, quantizing_scorer);
     builder.build(output_filename);
+
     double elapsed_secs = (get_time_usecs() - tick) / 1000000;
-    spdlog::info("Index compressed in {} seconds", elapsed_secs);
+    spdlog::info("{} collection built in {} seconds", seq_type, elapsed_secs);
+
+    stats_line()("type", seq_type)("worker_threads", std::thread::hardware_concurrency())(
+        "construction_time", elapsed_secs
+    );
+
+    CollectionType coll(MemorySource::mapped_file(output_filename));
+    dump_stats(coll, seq_type, postings);
+    dump_index_specific_stats(coll, seq_type);
 
     if (check) {
         verify_collection<binary_freq_collection, CollectionType>(
@@ -115,7 +160,8 @@ void compress_index(
     std::string const& seq_type,
     std::optional<std::string> const& wand_data_filename,
     ScorerParams const& scorer_params,
-    std::optional<Size> quantization_bits
+    std::optional<Size> quantization_bits,
+    bool in_memory
 ) {
     std::optional<QuantizingScorer> quantizing_scorer{};
 
@@ -135,39 +181,16 @@ void compress_index(
         quantizing_scorer.emplace(std::move(scorer), quantizer);
     }
 
-    typename CollectionType::builder builder(input.num_docs(), params);
-    size_t postings = 0;
-    {
-        pisa::progress progress("Create index", input.size());
-
-        size_t term_id = 0;
-        for (auto const& plist: input) {
-            size_t size = plist.docs.size();
-            if (quantizing_scorer.has_value()) {
-                auto term_scorer = quantizing_scorer->term_scorer(term_id);
-                std::vector<uint64_t> quants;
-                for (size_t pos = 0; pos < size; ++pos) {
-                    uint64_t doc = *(plist.docs.begin() + pos);
-                    uint64_t freq = *(plist.freqs.begin() + pos);
-                    uint64_t quant_score = term_scorer(doc, freq);
-                    quants.push_back(quant_score);
-                }
-                assert(quants.size() == size);
-                uint64_t quants_sum =
-                    std::accumulate(quants.begin(), quants.begin() + quants.size(), uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), quants.begin(), quants_sum);
-            } else {
-                uint64_t freqs_sum =
-                    std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
-            }
-
-            progress.update(1);
-            postings += size;
-            term_id += 1;
-        }
+    if (!in_memory && output_filename.has_value()) {
+        compress_index_streaming<CollectionType>(
+            input, params, *output_filename, std::move(quantizing_scorer), check, seq_type
+        );
+        return;
     }
 
+    typename CollectionType::builder builder(input.num_docs(), params);
+    auto postings = add_posting_lists(input, builder, quantizing_scorer);
+
     CollectionType coll;
     builder.build(coll);
     double elapsed_secs = (get_time_usecs() - tick) / 1000000;
@@ -197,16 +220,48 @@ void compress(
     std::string const& output_filename,
     ScorerParams const& scorer_params,
     std::optional<Size> quantization_bits,
+    MixedEncodingOptions const& mixed_options,
     bool check,
     bool in_memory
 ) {
     binary_freq_collection input(input_basename.c_str());
     global_parameters params;
 
+    bool mixed_options_set = mixed_options.time_weight.has_value()
+        || mixed_options.decode_ns.has_value() || mixed_options.term_accesses.has_value();
+    if (mixed_options_set && index_encoding != MixedBlockCodec::name) {
+        throw std::invalid_argument(fmt::format(
+            "time weight, decoding times and query log are only supported by {}, not {}",
+            MixedBlockCodec::name,
+            index_encoding
+        ));
+    }
+
     auto block_codec = get_block_codec(index_encoding);
+    if (mixed_options.time_weight.has_value() || mixed_options.decode_ns.has_value()) {
+        auto decode_ns = MixedBlockCodec::default_decode_ns;
+        if (mixed_options.decode_ns.has_value()) {
+            if (mixed_options.decode_ns->size() != decode_ns.size()) {
+                throw std::invalid_argument(fmt::format(
+                    "expected {} decoding times, one for each candidate codec, but got {}",
+                    decode_ns.size(),
+                    mixed_options.decode_ns->size()
+                ));
+            }
+            std::copy(
+                mixed_options.decode_ns->begin(), mixed_options.decode_ns->end(), decode_ns.begin()
+            );
+        }
+        block_codec = std::make_shared<MixedBlockCodec>(
+            mixed_options.time_weight.value_or(MixedBlockCodec::default_time_weight), decode_ns
+        );
+    }
     if (block_codec != nullptr) {
         BlockIndexBuilder builder(std::move(block_codec), scorer_params);
         builder.check(check).in_memory(in_memory);
+        if (mixed_options.term_accesses.has_value()) {
+            builder.term_accesses(*mixed_options.term_accesses);
+        }
         std::optional<wand_data<wand_data_raw>> wdata{};
         if (quantization_bits.has_value()) {
             wdata.emplace(MemorySource::mapped_file(*wand_data_filename));
@@ -219,9 +274,910 @@ void compress(
     resolve_freq_index_type(index_encoding, [&](auto index_traits) {
         using Index = typename std::decay_t<decltype(index_traits)>::type;
         compress_index<Index, wand_data<wand_data_raw>>(
-            input, params, output_filename, check, index_encoding, wand_data_filename, scorer_params, quantization_bits
+            input,
+            params,
+            output_filename,
+            check,
+            index_encoding,
+            wand_data_filename,
+            scorer_params,
+            quantization_bits,
+            in_memory
         );
     });
 }
 
+namespace {
+
+    /**
+     * Wand data builder fed with posting lists in term order, hiding the type of the block-max
+     * data so that lists are encoded the same way for all of them.
+     */
+    class WandDataStreamBuilder {
+      public:
+        WandDataStreamBuilder() = default;
+        WandDataStreamBuilder(WandDataStreamBuilder const&) = delete;
+        WandDataStreamBuilder(WandDataStreamBuilder&&) = delete;
+        WandDataStreamBuilder& operator=(WandDataStreamBuilder const&) = delete;
+        WandDataStreamBuilder& operator=(WandDataStreamBuilder&&) = delete;
+        virtual ~WandDataStreamBuilder() = default;
+
+        [[nodiscard]] virtual auto compute_block_max_list(
+            std::size_t term_id, binary_freq_collection::sequence const& seq
+        ) const -> BlockMaxList = 0;
+        virtual void append_block_max_list(BlockMaxList list) = 0;
+        virtual void write(std::string const& output) = 0;
+    };
+
+    template <typename BlockWand>
+    class BasicWandDataStreamBuilder: public WandDataStreamBuilder {
+      public:
+        BasicWandDataStreamBuilder(
+            IndexStatistics const& statistics,
+            WandDataOptions const& options,
+            std::filesystem::path const& tmp_root
+        )
+            : m_builder(
+                statistics.document_sizes,
+                statistics.term_occurrence_counts,
+                statistics.term_posting_counts,
+                options.scorer_params,
+                options.block_size,
+                options.quantization_bits,
+                tmp_root
+            ) {}
+
+        [[nodiscard]] auto compute_block_max_list(
+            std::size_t term_id, binary_freq_collection::sequence const& seq
+        ) const -> BlockMaxList override {
+            return m_builder.compute_block_max_list(term_id, seq);
+        }
+
+        void append_block_max_list(BlockMaxList list) override {
+            m_builder.append_block_max_list(std::move(list));
+        }
+
+        void write(std::string const& output) override { m_builder.write(output); }
+
+      private:
+        typename wand_data<BlockWand>::stream_builder m_builder;
+    };
+
+    /**
+     * Returns the builder of the wand data of the index written to `output_filename`, or `nullptr`
+     * if no wand data are requested.
+     */
+    auto make_wand_data_stream_builder(
+        IndexStatistics const& statistics,
+        std::optional<WandDataOptions> const& wand_options,
+        std::string const& output_filename
+    ) -> std::unique_ptr<WandDataStreamBuilder> {
+        if (!wand_options.has_value()) {
+            return nullptr;
+        }
+        auto const& options = *wand_options;
+        auto tmp_root = tmp_root_for(output_filename);
+        if (options.compress) {
+            return std::make_unique<BasicWandDataStreamBuilder<wand_data_compressed<>>>(
+                statistics, options, tmp_root
+            );
+        }
+        if (options.range) {
+            return std::make_unique<BasicWandDataStreamBuilder<wand_data_range<128, 1024>>>(
+                statistics, options, tmp_root
+            );
+        }
+        return std::make_unique<BasicWandDataStreamBuilder<wand_data_raw>>(
+            statistics, options, tmp_root
+        );
+    }
+
+    /** Time spent in each stage of compressing posting lists given one at a time, in seconds. */
+    struct CompressListsTimes {
+        double reading = 0;
+        /** Summed over the threads encoding lists concurrently. */
+        std::atomic<double> encoding = 0;
+        /** Summed over the threads computing block-max scores concurrently. */
+        std::atomic<double> block_max = 0;
+        double appending = 0;
+        double index_writing = 0;
+        double wand_writing = 0;
+    };
+
+    auto as_sequence(invert::PostingList const& list) -> binary_freq_collection::sequence {
+        return binary_freq_collection::sequence{
+            {list.docs.data(), list.docs.data() + list.docs.size()},
+            {list.freqs.data(), list.freqs.data() + list.freqs.size()}
+        };
+    }
+
+    /** Passes through lists that are read already decoded. */
+    auto already_decoded(std::size_t, invert::PostingList const& list)
+        -> invert::PostingList const& {
+        return list;
+    }
+
+    /**
+     * Reads posting lists in term order with `next_list()`, decodes them with
+     * `decode(term_id, list)` and encodes them concurrently with `encode(term_id, seq)`, along
+     * with their block-max scores if `wand` is given, and appends them in term order with
+     * `append(encoded)`. Returns the number of postings.
+     */
+    template <typename NextList, typename Decode, typename Encode, typename Append>
+    auto encode_lists(
+        NextList&& next_list,
+        Decode&& decode,
+        std::size_t term_count,
+        WandDataStreamBuilder* wand,
+        Encode&& encode,
+        Append&& append,
+        CompressListsTimes& times
+    ) -> std::size_t {
+        auto elapsed_secs = [](double tick) { return (get_time_usecs() - tick) / 1000000; };
+
+        std::size_t postings = 0;
+        pisa::progress progress("Create index", term_count);
+        encode_posting_lists(
+            [&] {
+                double tick = get_time_usecs();
+                auto list = next_list();
+                times.reading += elapsed_secs(tick);
+                return list;
+            },
+            [&](std::size_t term_id, auto const& list) {
+                double tick = get_time_usecs();
+                auto const& postings = decode(term_id, list);
+                auto seq = as_sequence(postings);
+                auto encoded = std::make_pair(encode(term_id, seq), std::optional<BlockMaxList>{});
+                times.encoding.fetch_add(elapsed_secs(tick), std::memory_order_relaxed);
+                if (wand != nullptr) {
+                    tick = get_time_usecs();
+                    encoded.second = wand->compute_block_max_list(term_id, seq);
+                    times.block_max.fetch_add(elapsed_secs(tick), std::memory_order_relaxed);
+                }
+                return encoded;
+            },
+            [&](std::size_t, auto const& list, auto encoded) {
+                double tick = get_time_usecs();
+                append(encoded.first);
+                if (encoded.second.has_value()) {
+                    wand->append_block_max_list(std::move(*encoded.second));
+                }
+                times.appending += elapsed_secs(tick);
+                postings += posting_count(list);
+                progress.update(1);
+            }
+        );
+        return postings;
+    }
+
+    /**
+     * Compresses the posting lists read in term order with `next_list()`, and decoded with
+     * `decode(term_id, list)`, into an index of `num_docs` documents and `term_count` terms
+     * written to `output_filename`, along with their block-max scores if `wand` is given. Returns
+     * the number of postings.
+     */
+    template <typename NextList, typename Decode>
+    auto compress_lists(
+        NextList&& next_list,
+        Decode&& decode,
+        std::size_t num_docs,
+        std::size_t term_count,
+        std::string const& index_encoding,
+        std::string const& output_filename,
+        WandDataStreamBuilder* wand,
+        CompressListsTimes& times
+    ) -> std::size_t {
+        auto elapsed_secs = [](double tick) { return (get_time_usecs() - tick) / 1000000; };
+        auto tmp_root = tmp_root_for(output_filename);
+
+        std::size_t postings = 0;
+        if (auto block_codec = get_block_codec(index_encoding); block_codec != nullptr) {
+            index::block::StreamPostingAccumulator accumulator(
+                block_codec, num_docs, output_filename
+            );
+            postings = encode_lists(
+                next_list,
+                decode,
+                term_count,
+                wand,
+                [&](std::size_t, binary_freq_collection::sequence const& seq) {
+                    std::vector<std::uint8_t> encoded;
+                    index::block::write_posting_list(
+                        block_codec.get(),
+                        encoded,
+                        seq.docs.size(),
+                        seq.docs.begin(),
+                        seq.freqs.begin()
+                    );
+                    return encoded;
+                },
+                [&](auto const& encoded) { accumulator.append_posting_list(encoded); },
+                times
+            );
+            double tick = get_time_usecs();
+            accumulator.finish();
+            times.index_writing = elapsed_secs(tick);
+            index::block::report_codec_mix(*block_codec);
+        } else {
+            resolve_freq_index_type(index_encoding, [&](auto index_traits) {
+                using Index = typename std::decay_t<decltype(index_traits)>::type;
+                typename Index::stream_builder builder(num_docs, global_parameters{}, tmp_root);
+                postings = encode_lists(
+                    next_list,
+                    decode,
+                    term_count,
+                    wand,
+                    [&](std::size_t, binary_freq_collection::sequence const& seq) {
+                        uint64_t freqs_sum =
+                            std::accumulate(seq.freqs.begin(), seq.freqs.end(), uint64_t(0));
+                        return builder.encode_posting_list(
+                            seq.docs.size(), seq.docs.begin(), seq.freqs.begin(), freqs_sum
+                        );
+                    },
+                    [&](auto const& encoded) { builder.append_posting_list(encoded); },
+                    times
+                );
+                double tick = get_time_usecs();
+                builder.build(output_filename);
+                times.index_writing = elapsed_secs(tick);
+            });
+        }
+        return postings;
+    }
+
+    /** Writes the wand data built along with an index, if any. */
+    void write_wand_data(
+        WandDataStreamBuilder* wand,
+        std::optional<WandDataOptions> const& wand_options,
+        CompressListsTimes& times
+    ) {
+        if (wand != nullptr) {
+            double tick = get_time_usecs();
+            wand->write(wand_options->output);
+            times.wand_writing = (get_time_usecs() - tick) / 1000000;
+        }
+    }
+
+    /** The lists of a term in the merged indexes, along with their document offsets. */
+    struct MergedList {
+        struct Part {
+            std::size_t index;
+            std::uint32_t term_id;
+            std::uint32_t offset;
+        };
+        std::vector<Part> parts{};
+        std::size_t postings = 0;
+
+        [[nodiscard]] auto posting_count() const noexcept -> std::size_t { return postings; }
+    };
+
+    /**
+     * Number of blocks of merged lists copied from the inputs or encoded again, and of block-max
+     * lists copied from the wand data of the inputs or computed from the postings.
+     */
+    struct MergeCounts {
+        std::atomic<std::size_t> copied_blocks = 0;
+        std::atomic<std::size_t> encoded_blocks = 0;
+        std::atomic<std::size_t> copied_block_max_lists = 0;
+        std::atomic<std::size_t> computed_block_max_lists = 0;
+    };
+
+    /**
+     * Returns whether block-max scores built with `options` can be copied from the inputs of a
+     * merge built with the same options: the scores must not depend on the statistics of the
+     * collection, and are copied as they are, so they must be neither quantized nor compressed.
+     */
+    auto copies_block_max_scores(WandDataOptions const& options) -> bool {
+        return options.scorer_params.name == "quantized" && !options.compress && !options.range
+            && !options.quantization_bits.has_value();
+    }
+
+    /** Concatenates the block-max scores of the parts of a merged list. */
+    auto copy_block_max_list(
+        std::deque<wand_data<wand_data_raw>> const& wdata, MergedList const& list
+    ) -> BlockMaxList {
+        BlockMaxList merged{.postings = list.postings};
+        for (auto const& part: list.parts) {
+            auto const& source = wdata[part.index];
+            source.get_block_wand().append_blocks(part.term_id, part.offset, merged);
+            merged.max_score = std::max(merged.max_score, source.max_term_weight(part.term_id));
+        }
+        return merged;
+    }
+
+    template <typename Index>
+    auto decode_merged_list(std::deque<Index> const& indexes, MergedList const& list)
+        -> invert::PostingList {
+        invert::PostingList decoded;
+        decoded.docs.reserve(list.postings);
+        decoded.freqs.reserve(list.postings);
+        for (auto const& part: list.parts) {
+            auto const& index = indexes[part.index];
+            auto cursor = index[part.term_id];
+            for (; cursor.docid() < index.num_docs(); cursor.next()) {
+                decoded.docs.push_back(cursor.docid() + part.offset);
+                decoded.freqs.push_back(cursor.freq());
+            }
+        }
+        return decoded;
+    }
+
+    /**
+     * Merges the lists of `indexes` term by term, encoding them concurrently with
+     * `encode(term_id, list, decoded)`, along with their block-max scores if `wand` is given, and
+     * appends them in term order with `append(encoded)`. The block-max scores are copied from
+     * `block_max_sources` if given, and computed from the postings otherwise. The postings of the
+     * lists are passed as `decoded` only if `decode` is set or they are needed for the block-max
+     * scores. Returns the number of postings.
+     */
+    template <typename Index, typename Encode, typename Append>
+    auto merge_lists(
+        std::deque<Index> const& indexes,
+        std::vector<std::vector<std::uint32_t>> const& term_mappings,
+        IndexStatistics const& statistics,
+        WandDataStreamBuilder* wand,
+        std::deque<wand_data<wand_data_raw>> const* block_max_sources,
+        bool decode,
+        Encode&& encode,
+        Append&& append,
+        CompressListsTimes& times,
+        MergeCounts& counts
+    ) -> std::size_t {
+        auto elapsed_secs = [](double tick) { return (get_time_usecs() - tick) / 1000000; };
+        std::size_t term_count = statistics.term_posting_counts.size();
+
+        // Position of the next list to read in each index, whose terms are in merged order.
+        std::vector<std::uint32_t> positions(indexes.size(), 0);
+        std::size_t term_id = 0;
+        std::size_t postings = 0;
+        pisa::progress progress("Merge index", term_count);
+        encode_posting_lists(
+            [&]() -> std::optional<MergedList> {
+                if (term_id == term_count) {
+                    return std::nullopt;
+                }
+                double tick = get_time_usecs();
+                MergedList list{.postings = statistics.term_posting_counts[term_id]};
+                std::uint32_t offset = 0;
+                for (std::size_t idx = 0; idx < indexes.size(); ++idx) {
+                    auto& pos = positions[idx];
+                    if (pos < term_mappings[idx].size() && term_mappings[idx][pos] == term_id) {
+                        list.parts.push_back({idx, pos++, offset});
+                    }
+                    offset += indexes[idx].num_docs();
+                }
+                ++term_id;
+                times.reading += elapsed_secs(tick);
+                return list;
+            },
+            [&](std::size_t term_id, MergedList const& list) {
+                bool copy_block_max = wand != nullptr && block_max_sources != nullptr;
+                bool compute_block_max = wand != nullptr && block_max_sources == nullptr;
+                double tick = get_time_usecs();
+                std::optional<invert::PostingList> decoded;
+                if (decode || compute_block_max) {
+                    decoded = decode_merged_list(indexes, list);
+                }
+                auto encoded = std::make_pair(
+                    encode(term_id, list, decoded), std::optional<BlockMaxList>{}
+                );
+                times.encoding.fetch_add(elapsed_secs(tick), std::memory_order_relaxed);
+                tick = get_time_usecs();
+                if (copy_block_max) {
+                    encoded.second = copy_block_max_list(*block_max_sources, list);
+                    counts.copied_block_max_lists.fetch_add(1, std::memory_order_relaxed);
+                } else if (compute_block_max) {
+                    encoded.second = wand->compute_block_max_list(term_id, as_sequence(*decoded));
+                    counts.computed_block_max_lists.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (wand != nullptr) {
+                    times.block_max.fetch_add(elapsed_secs(tick), std::memory_order_relaxed);
+                }
+                return encoded;
+            },
+            [&](std::size_t, MergedList const& list, auto encoded) {
+                double tick = get_time_usecs();
+                append(encoded.first);
+                if (encoded.second.has_value()) {
+                    wand->append_block_max_list(std::move(*encoded.second));
+                }
+                times.appending += elapsed_secs(tick);
+                postings += list.postings;
+                progress.update(1);
+            }
+        );
+        return postings;
+    }
+
+    /** Posting list of the input of `transcode_index`, decoded only when it is encoded. */
+    struct TranscodedList {
+        std::uint32_t term_id;
+        std::size_t postings;
+
+        [[nodiscard]] auto posting_count() const noexcept -> std::size_t { return postings; }
+    };
+
+    /** Decodes the list of `term_id`, with its documents renumbered by `mapping` if given. */
+    template <typename Index>
+    auto decode_transcoded_list(
+        Index const& index,
+        std::uint32_t term_id,
+        std::optional<std::vector<std::uint32_t>> const& mapping
+    ) -> invert::PostingList {
+        auto cursor = index[term_id];
+        invert::PostingList decoded;
+        decoded.docs.reserve(cursor.size());
+        decoded.freqs.reserve(cursor.size());
+        if (!mapping.has_value()) {
+            for (; cursor.docid() < index.num_docs(); cursor.next()) {
+                decoded.docs.push_back(cursor.docid());
+                decoded.freqs.push_back(cursor.freq());
+            }
+            return decoded;
+        }
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> postings;
+        postings.reserve(cursor.size());
+        for (; cursor.docid() < index.num_docs(); cursor.next()) {
+            postings.emplace_back((*mapping)[cursor.docid()], cursor.freq());
+        }
+        std::sort(postings.begin(), postings.end());
+        for (auto [docid, freq]: postings) {
+            decoded.docs.push_back(docid);
+            decoded.freqs.push_back(freq);
+        }
+        return decoded;
+    }
+
+    void check_permutation(std::vector<std::uint32_t> const& mapping, std::size_t num_docs) {
+        if (mapping.size() != num_docs) {
+            throw std::invalid_argument(fmt::format(
+                "mapping of {} documents given for an index of {} documents",
+                mapping.size(),
+                num_docs
+            ));
+        }
+        std::vector<bool> mapped(num_docs, false);
+        for (auto docid: mapping) {
+            if (docid >= num_docs || mapped[docid]) {
+                throw std::invalid_argument(fmt::format(
+                    "mapping is not a permutation: document {} is out of range or mapped twice",
+                    docid
+                ));
+            }
+            mapped[docid] = true;
+        }
+    }
+
+    /**
+     * Returns the statistics of `index`, with the documents renumbered by `mapping` if given. They
+     * are read from its wand data, unless terms were dropped when building them, in which case
+     * the term statistics are counted from the posting lists.
+     */
+    template <typename Index>
+    auto transcoded_statistics(
+        Index const& index,
+        wand_data<wand_data_raw> const& wdata,
+        std::optional<std::vector<std::uint32_t>> const& mapping
+    ) -> IndexStatistics {
+        std::size_t term_count = index.size();
+        IndexStatistics statistics;
+        statistics.document_sizes.resize(wdata.num_docs());
+        for (std::uint32_t doc = 0; doc < wdata.num_docs(); ++doc) {
+            auto docid = mapping.has_value() ? (*mapping)[doc] : doc;
+            statistics.document_sizes[docid] = wdata.doc_len(doc);
+        }
+        statistics.term_posting_counts.reserve(term_count);
+        statistics.term_occurrence_counts.reserve(term_count);
+        if (wdata.num_terms() == term_count) {
+            for (std::uint32_t term = 0; term < term_count; ++term) {
+                statistics.term_posting_counts.push_back(wdata.term_posting_count(term));
+                statistics.term_occurrence_counts.push_back(wdata.term_occurrence_count(term));
+            }
+            return statistics;
+        }
+        // The terms of the wand data are numbered without the dropped terms.
+        spdlog::info(
+            "Wand data have {} of {} terms, counting term statistics from the index",
+            wdata.num_terms(),
+            term_count
+        );
+        for (std::uint32_t term = 0; term < term_count; ++term) {
+            auto cursor = index[term];
+            std::uint32_t occurrences = 0;
+            for (; cursor.docid() < index.num_docs(); cursor.next()) {
+                occurrences += cursor.freq();
+            }
+            statistics.term_posting_counts.push_back(cursor.size());
+            statistics.term_occurrence_counts.push_back(occurrences);
+        }
+        return statistics;
+    }
+
+    /**
+     * Logs the time and throughput in postings per second of each stage, and emits them as a
+     * stats line. The stages of `compress_lists` follow the ones given in `stages`.
+     */
+    void log_stage_times(
+        std::string const& index_encoding,
+        std::size_t postings,
+        std::vector<std::pair<std::string, double>> stages,
+        CompressListsTimes const& times,
+        bool with_wand_data,
+        double start
+    ) {
+        stages.emplace_back("encoding", times.encoding.load());
+        if (with_wand_data) {
+            stages.emplace_back("block_max", times.block_max.load());
+        }
+        stages.emplace_back("appending", times.appending);
+        stages.emplace_back("index_writing", times.index_writing);
+        if (with_wand_data) {
+            stages.emplace_back("wand_writing", times.wand_writing);
+        }
+        stages.emplace_back("construction", (get_time_usecs() - start) / 1000000);
+
+        // Times of concurrent stages are summed over threads, so their throughput is per thread.
+        auto throughput = [&](double secs) {
+            return secs > 0 ? static_cast<double>(postings) / secs : 0;
+        };
+        for (auto const& [stage, secs]: stages) {
+            spdlog::info("{}: {:.2f} s, {:.0f} postings/s", stage, secs, throughput(secs));
+        }
+        stats_line line;
+        line("type", index_encoding)("worker_threads", std::thread::hardware_concurrency())(
+            "postings", postings
+        );
+        for (auto const& [stage, secs]: stages) {
+            line(stage + "_time", secs)(stage + "_throughput", throughput(secs));
+        }
+    }
+
+    /**
+     * Logs the numbers of blocks and block-max lists copied from the inputs of a merge, and the
+     * share of copied blocks, and emits them as a stats line.
+     */
+    void log_merge_counts(std::string const& index_encoding, MergeCounts const& counts) {
+        auto share = [](std::size_t copied, std::size_t other) {
+            return copied + other > 0 ? static_cast<double>(copied) / (copied + other) : 0;
+        };
+        auto copied_blocks = counts.copied_blocks.load();
+        auto encoded_blocks = counts.encoded_blocks.load();
+        auto copied_lists = counts.copied_block_max_lists.load();
+        auto computed_lists = counts.computed_block_max_lists.load();
+        // Lists of other encodings than block encodings are always encoded again.
+        if (copied_blocks + encoded_blocks > 0) {
+            spdlog::info(
+                "Copied {} blocks and encoded {} blocks again ({:.2f}% copied)",
+                copied_blocks,
+                encoded_blocks,
+                100 * share(copied_blocks, encoded_blocks)
+            );
+        }
+        if (copied_lists + computed_lists > 0) {
+            spdlog::info(
+                "Copied the block-max scores of {} lists and computed those of {} lists",
+                copied_lists,
+                computed_lists
+            );
+        }
+        stats_line()("type", index_encoding)("copied_blocks", copied_blocks)(
+            "encoded_blocks", encoded_blocks
+        )("copied_blocks_ratio", share(copied_blocks, encoded_blocks))(
+            "copied_block_max_lists", copied_lists
+        )("computed_block_max_lists", computed_lists);
+    }
+
+}  // namespace
+
+void invert_and_compress(
+    std::string const& forward_index_basename,
+    std::string const& index_encoding,
+    std::string const& output_filename,
+    invert::InvertParams const& invert_params,
+    std::optional<WandDataOptions> const& wand_options
+) {
+    double start = get_time_usecs();
+    CompressListsTimes times;
+
+    auto tmp_root = tmp_root_for(output_filename);
+    TemporaryDirectory tmp(tmp_root);
+    auto batch_basename = (tmp.path() / "inverted").string();
+
+    double tick = get_time_usecs();
+    auto batches = invert::build_batches(forward_index_basename, batch_basename, invert_params);
+    double inversion_secs = (get_time_usecs() - tick) / 1000000;
+    spdlog::info(
+        "Inverted {} documents in {} batches", batches.document_sizes.size(), batches.count
+    );
+
+    IndexStatistics statistics{
+        .document_sizes = batches.document_sizes,
+        .term_posting_counts = batches.term_posting_counts,
+        .term_occurrence_counts = batches.term_occurrence_counts,
+    };
+    invert::BatchReader reader(batch_basename, batches);
+    auto wand = make_wand_data_stream_builder(statistics, wand_options, output_filename);
+    auto postings = compress_lists(
+        [&] { return reader.next(); },
+        already_decoded,
+        statistics.document_sizes.size(),
+        statistics.term_posting_counts.size(),
+        index_encoding,
+        output_filename,
+        wand.get(),
+        times
+    );
+    invert::remove_batches(batch_basename, batches.count);
+    write_wand_data(wand.get(), wand_options, times);
+
+    log_stage_times(
+        index_encoding,
+        postings,
+        {{"inversion", inversion_secs}, {"merging", times.reading}},
+        times,
+        wand_options.has_value(),
+        start
+    );
+}
+
+void compress_posting_lists(
+    std::function<std::optional<invert::PostingList>()> next_list,
+    IndexStatistics const& statistics,
+    std::string const& index_encoding,
+    std::string const& output_filename,
+    std::optional<WandDataOptions> const& wand_options
+) {
+    double start = get_time_usecs();
+    CompressListsTimes times;
+    auto wand = make_wand_data_stream_builder(statistics, wand_options, output_filename);
+    auto postings = compress_lists(
+        next_list,
+        already_decoded,
+        statistics.document_sizes.size(),
+        statistics.term_posting_counts.size(),
+        index_encoding,
+        output_filename,
+        wand.get(),
+        times
+    );
+    write_wand_data(wand.get(), wand_options, times);
+    log_stage_times(
+        index_encoding,
+        postings,
+        {{"reading", times.reading}},
+        times,
+        wand_options.has_value(),
+        start
+    );
+}
+
+void merge_posting_lists(
+    std::vector<std::string> const& index_filenames,
+    std::vector<std::vector<std::uint32_t>> const& term_mappings,
+    IndexStatistics const& statistics,
+    std::string const& index_encoding,
+    std::string const& output_filename,
+    std::optional<WandDataOptions> const& wand_options,
+    std::vector<std::string> const& input_wand_data
+) {
+    if (term_mappings.size() != index_filenames.size()) {
+        throw std::invalid_argument(fmt::format(
+            "{} term mappings given for {} indexes", term_mappings.size(), index_filenames.size()
+        ));
+    }
+    if (!input_wand_data.empty() && input_wand_data.size() != index_filenames.size()) {
+        throw std::invalid_argument(fmt::format(
+            "{} wand data given for {} indexes", input_wand_data.size(), index_filenames.size()
+        ));
+    }
+    double start = get_time_usecs();
+    auto elapsed_secs = [](double tick) { return (get_time_usecs() - tick) / 1000000; };
+    CompressListsTimes times;
+    MergeCounts counts;
+    std::size_t num_docs = statistics.document_sizes.size();
+
+    auto tmp_root = tmp_root_for(output_filename);
+    auto wand = make_wand_data_stream_builder(statistics, wand_options, output_filename);
+
+    // The blocks of the wand data are numbered by list, so they can only be copied if no terms
+    // were dropped when building the wand data of any index.
+    std::optional<std::deque<wand_data<wand_data_raw>>> block_max_sources;
+    if (wand_options.has_value() && copies_block_max_scores(*wand_options)
+        && !input_wand_data.empty()) {
+        block_max_sources.emplace();
+        for (std::size_t idx = 0; idx < input_wand_data.size(); ++idx) {
+            auto const& wdata = block_max_sources->emplace_back(
+                MemorySource::mapped_file(input_wand_data[idx])
+            );
+            if (wdata.num_terms() != term_mappings[idx].size()) {
+                spdlog::info(
+                    "Wand data {} have {} of {} terms, computing block-max scores instead",
+                    input_wand_data[idx],
+                    wdata.num_terms(),
+                    term_mappings[idx].size()
+                );
+                block_max_sources.reset();
+                break;
+            }
+        }
+    }
+    auto const* sources = block_max_sources.has_value() ? &*block_max_sources : nullptr;
+
+    auto check_num_docs = [&](auto const& indexes) {
+        std::size_t merged_docs = 0;
+        for (auto const& index: indexes) {
+            merged_docs += index.num_docs();
+        }
+        if (merged_docs != num_docs) {
+            throw std::invalid_argument(fmt::format(
+                "statistics of {} documents given for indexes of {} documents",
+                num_docs,
+                merged_docs
+            ));
+        }
+    };
+
+    std::size_t postings = 0;
+    if (auto block_codec = get_block_codec(index_encoding); block_codec != nullptr) {
+        std::deque<BlockInvertedIndex> indexes;
+        for (auto const& filename: index_filenames) {
+            indexes.emplace_back(MemorySource::mapped_file(filename), block_codec);
+        }
+        check_num_docs(indexes);
+        index::block::StreamPostingAccumulator accumulator(block_codec, num_docs, output_filename);
+        postings = merge_lists(
+            indexes,
+            term_mappings,
+            statistics,
+            wand.get(),
+            sources,
+            false,
+            [&](std::size_t, MergedList const& list, auto const&) {
+                index::block::PostingListConcatenator concatenator(block_codec.get());
+                for (auto const& part: list.parts) {
+                    concatenator.append(indexes[part.index][part.term_id], part.offset);
+                }
+                std::vector<std::uint8_t> encoded;
+                concatenator.finish(encoded);
+                counts.copied_blocks.fetch_add(
+                    concatenator.copied_blocks(), std::memory_order_relaxed
+                );
+                counts.encoded_blocks.fetch_add(
+                    concatenator.encoded_blocks(), std::memory_order_relaxed
+                );
+                return encoded;
+            },
+            [&](auto const& encoded) { accumulator.append_posting_list(encoded); },
+            times,
+            counts
+        );
+        double tick = get_time_usecs();
+        accumulator.finish();
+        times.index_writing = elapsed_secs(tick);
+        index::block::report_codec_mix(*block_codec);
+    } else {
+        resolve_freq_index_type(index_encoding, [&](auto index_traits) {
+            using Index = typename std::decay_t<decltype(index_traits)>::type;
+            std::deque<Index> indexes;
+            for (auto const& filename: index_filenames) {
+                indexes.emplace_back(MemorySource::mapped_file(filename));
+            }
+            check_num_docs(indexes);
+            typename Index::stream_builder builder(num_docs, global_parameters{}, tmp_root);
+            postings = merge_lists(
+                indexes,
+                term_mappings,
+                statistics,
+                wand.get(),
+                sources,
+                true,
+                [&](std::size_t, MergedList const&, auto const& decoded) {
+                    auto const& docs = decoded->docs;
+                    auto const& freqs = decoded->freqs;
+                    uint64_t freqs_sum = std::accumulate(freqs.begin(), freqs.end(), uint64_t(0));
+                    return builder.encode_posting_list(
+                        docs.size(), docs.begin(), freqs.begin(), freqs_sum
+                    );
+                },
+                [&](auto const& encoded) { builder.append_posting_list(encoded); },
+                times,
+                counts
+            );
+            double tick = get_time_usecs();
+            builder.build(output_filename);
+            times.index_writing = elapsed_secs(tick);
+        });
+    }
+
+    write_wand_data(wand.get(), wand_options, times);
+    log_stage_times(
+        index_encoding,
+        postings,
+        {{"reading", times.reading}},
+        times,
+        wand_options.has_value(),
+        start
+    );
+    log_merge_counts(index_encoding, counts);
+}
+
+void transcode_index(
+    std::string const& input_filename,
+    std::string const& input_encoding,
+    std::string const& output_filename,
+    std::string const& output_encoding,
+    TranscodeOptions const& options
+) {
+    double start = get_time_usecs();
+    CompressListsTimes times;
+    auto const& mapping = options.mapping;
+    std::size_t postings = 0;
+
+    auto source = MemorySource::mapped_file(input_filename);
+    run_for_index(input_encoding, std::move(source), [&](auto const& index) {
+        std::size_t num_docs = index.num_docs();
+        std::size_t term_count = index.size();
+        if (mapping.has_value()) {
+            check_permutation(*mapping, num_docs);
+        }
+
+        IndexStatistics statistics;
+        if (options.wand_options.has_value()) {
+            if (!options.input_wand_data.has_value()) {
+                throw std::invalid_argument("wand data of the input index are needed to build the "
+                                            "wand data of the output index");
+            }
+            wand_data<wand_data_raw> wdata(MemorySource::mapped_file(*options.input_wand_data));
+            if (wdata.num_docs() != num_docs) {
+                throw std::invalid_argument(fmt::format(
+                    "wand data of {} documents given for an index of {} documents",
+                    wdata.num_docs(),
+                    num_docs
+                ));
+            }
+            statistics = transcoded_statistics(index, wdata, mapping);
+        }
+        auto wand =
+            make_wand_data_stream_builder(statistics, options.wand_options, output_filename);
+
+        std::uint32_t term_id = 0;
+        postings = compress_lists(
+            [&]() -> std::optional<TranscodedList> {
+                if (term_id == term_count) {
+                    return std::nullopt;
+                }
+                auto list = TranscodedList{term_id, index[term_id].size()};
+                ++term_id;
+                return list;
+            },
+            [&](std::size_t, TranscodedList const& list) {
+                return decode_transcoded_list(index, list.term_id, mapping);
+            },
+            num_docs,
+            term_count,
+            output_encoding,
+            output_filename,
+            wand.get(),
+            times
+        );
+        write_wand_data(wand.get(), options.wand_options, times);
+
+        if (options.check) {
+            auto input_lists =
+                std::views::iota(std::uint32_t(0), static_cast<std::uint32_t>(term_count))
+                | std::views::transform([&](std::uint32_t term) {
+                      return decode_transcoded_list(index, term, mapping);
+                  });
+            run_for_index(
+                output_encoding,
+                MemorySource::mapped_file(output_filename),
+                [&](auto const& output) { verify_collection(input_lists, output); }
+            );
+        }
+    });
+
+    log_stage_times(output_encoding, postings, {}, times, options.wand_options.has_value(), start);
+}
+
 }  // namespace pisa
@@ -0,0 +1,71 @@
+#include "document_filter.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "bit_vector_builder.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+
+namespace pisa {
+
+DocumentFilter::DocumentFilter(MemorySource source) : m_source(std::move(source)) {
+    mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+}
+
+DocumentFilter::DocumentFilter(
+    std::uint32_t num_docs, std::vector<std::pair<std::uint32_t, std::uint32_t>> const& ranges
+) {
+    bit_vector_builder builder(num_docs);
+    for (auto [first, last]: ranges) {
+        if (first > last || last > num_docs) {
+            throw std::invalid_argument(fmt::format(
+                "invalid range of filtered documents [{}, {}) out of {}", first, last, num_docs
+            ));
+        }
+        for (auto docid = first; docid < last; ++docid) {
+            builder.set(docid, true);
+        }
+    }
+    bit_vector(&builder).swap(m_filtered);
+}
+
+void DocumentFilter::write(std::string const& path) {
+    mapper::freeze(*this, path.c_str());
+}
+
+auto DocumentFilter::count() const -> std::size_t {
+    std::size_t count = 0;
+    for (auto word: m_filtered.data()) {
+        count += broadword::popcount(word);
+    }
+    return count;
+}
+
+auto read_document_ranges(std::istream& is)
+    -> std::vector<std::pair<std::uint32_t, std::uint32_t>> {
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+    io::for_each_line(is, [&](std::string const& line) {
+        std::istringstream entry(line);
+        auto invalid = [&] {
+            return std::invalid_argument(fmt::format("invalid filter entry: {}", line));
+        };
+        std::uint32_t first = 0;
+        if (!(entry >> first)) {
+            throw invalid();
+        }
+        std::uint32_t last = first + 1;
+        if (!(entry >> std::ws).eof() && !(entry >> last)) {
+            throw invalid();
+        }
+        if (!(entry >> std::ws).eof()) {
+            throw invalid();
+        }
+        ranges.emplace_back(first, last);
+    });
+    return ranges;
+}
+
+}  // namespace pisa
@@ -1,12 +1,19 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
 #include <numeric>
-#include <sstream>
+#include <stdexcept>
 #include <vector>
 
 #include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
 
 #include "pisa/algorithm.hpp"
 #include "pisa/binary_collection.hpp"
+#include "pisa/binary_collection_writer.hpp"
 #include "pisa/invert.hpp"
 #include "pisa/memory_source.hpp"
 #include "pisa/payload_vector.hpp"
@@ -28,18 +35,144 @@ std::vector<T> concatenate(std::vector<std::vector<T>> const& containers) {
     return vec;
 }
 
-template <typename T>
-std::istream& read_sequence(std::istream& is, std::vector<T>& out) {
-    uint32_t length;
-    is.read(reinterpret_cast<char*>(&length), sizeof(length));
-    auto size = out.size();
-    out.resize(size + length);
-    is.read(reinterpret_cast<char*>(&out[size]), length * sizeof(T));
-    return is;
-}
-
 namespace pisa { namespace invert {
 
+    namespace {
+
+        /// Posting of a single term in a single document, before postings are sorted by term.
+        struct TermPosting {
+            std::uint32_t term;
+            std::uint32_t document;
+            std::uint32_t frequency;
+        };
+
+        /// Views strongly typed integers as the 32-bit integers they wrap.
+        template <typename T>
+        [[nodiscard]] auto as_integers(std::span<T const> values)
+            -> std::span<std::uint32_t const> {
+            static_assert(sizeof(T) == sizeof(std::uint32_t));
+            return {reinterpret_cast<std::uint32_t const*>(values.data()), values.size()};
+        }
+
+        /// Number of term bits sorted by each pass of the radix sort.
+        constexpr std::uint32_t radix_bits = 11;
+        constexpr std::size_t radix_buckets = std::size_t(1) << radix_bits;
+
+        /// Returns the bounds of `parts` contiguous chunks of nearly equal size covering
+        /// `[0, size)`, dropping the empty ones.
+        [[nodiscard]] auto chunk_bounds(std::size_t size, std::size_t parts)
+            -> std::vector<std::size_t> {
+            std::size_t chunk_size = std::max<std::size_t>((size + parts - 1) / parts, 1);
+            std::vector<std::size_t> bounds{0};
+            for (std::size_t pos = chunk_size; pos < size; pos += chunk_size) {
+                bounds.push_back(pos);
+            }
+            if (size > 0) {
+                bounds.push_back(size);
+            }
+            return bounds;
+        }
+
+        /// Maps each document to one posting for each of its distinct terms.
+        [[nodiscard]] auto map_to_term_postings(
+            DocumentRange documents,
+            Document_Id first_document_id,
+            std::uint32_t term_count,
+            std::vector<std::size_t> const& bounds
+        ) -> std::vector<TermPosting> {
+            std::vector<std::vector<TermPosting>> chunks(bounds.size() - 1);
+            tbb::parallel_for(std::size_t(0), chunks.size(), [&](std::size_t chunk) {
+                auto first = documents.begin() + bounds[chunk];
+                auto last = documents.begin() + bounds[chunk + 1];
+                chunks[chunk].reserve(std::accumulate(
+                    first, last, std::size_t(0), [](auto acc, auto const& terms) {
+                        return acc + terms.size();
+                    }
+                ));
+                std::vector<std::uint32_t> terms;
+                auto document = static_cast<std::uint32_t>(first_document_id.as_int())
+                    + static_cast<std::uint32_t>(bounds[chunk]);
+                for (auto it = first; it != last; ++it, ++document) {
+                    terms.clear();
+                    for (auto term: *it) {
+                        if (static_cast<std::uint32_t>(term.as_int()) >= term_count) {
+                            throw std::out_of_range(fmt::format(
+                                "Term {} in document {} is out of range for {} terms",
+                                term.as_int(),
+                                document,
+                                term_count
+                            ));
+                        }
+                        terms.push_back(static_cast<std::uint32_t>(term.as_int()));
+                    }
+                    std::sort(terms.begin(), terms.end());
+                    for (auto pos = terms.begin(); pos != terms.end();) {
+                        auto next = std::upper_bound(pos, terms.end(), *pos);
+                        chunks[chunk].push_back(TermPosting{
+                            *pos, document, static_cast<std::uint32_t>(std::distance(pos, next))
+                        });
+                        pos = next;
+                    }
+                }
+            });
+            std::size_t size = std::accumulate(
+                chunks.begin(), chunks.end(), std::size_t(0), [](auto acc, auto const& chunk) {
+                    return acc + chunk.size();
+                }
+            );
+            std::vector<TermPosting> postings;
+            postings.reserve(size);
+            for (auto& chunk: chunks) {
+                postings.insert(postings.end(), chunk.begin(), chunk.end());
+                chunk = {};
+            }
+            return postings;
+        }
+
+        /// Stable sort of postings by term, with a least-significant-digit radix sort.
+        ///
+        /// Each pass counts the digits of each chunk of postings in parallel, and then scatters
+        /// the chunks in parallel, each to positions following the ones of the same digit in the
+        /// preceding chunks, which keeps the postings of a term in document order.
+        void radix_sort_by_term(
+            std::vector<TermPosting>& postings, std::uint32_t term_count, std::size_t threads
+        ) {
+            if (term_count <= 1 || postings.empty()) {
+                return;
+            }
+            auto term_bits = static_cast<std::uint32_t>(std::bit_width(term_count - 1));
+            auto bounds = chunk_bounds(postings.size(), threads);
+            std::vector<std::array<std::size_t, radix_buckets>> positions(bounds.size() - 1);
+            std::vector<TermPosting> sorted(postings.size());
+            for (std::uint32_t shift = 0; shift < term_bits; shift += radix_bits) {
+                auto digit = [shift](TermPosting const& posting) {
+                    return (posting.term >> shift) & (radix_buckets - 1);
+                };
+                tbb::parallel_for(std::size_t(0), positions.size(), [&](std::size_t chunk) {
+                    positions[chunk].fill(0);
+                    for (auto pos = bounds[chunk]; pos < bounds[chunk + 1]; ++pos) {
+                        ++positions[chunk][digit(postings[pos])];
+                    }
+                });
+                std::size_t offset = 0;
+                for (std::size_t bucket = 0; bucket < radix_buckets; ++bucket) {
+                    for (auto& chunk_positions: positions) {
+                        auto count = chunk_positions[bucket];
+                        chunk_positions[bucket] = offset;
+                        offset += count;
+                    }
+                }
+                tbb::parallel_for(std::size_t(0), positions.size(), [&](std::size_t chunk) {
+                    for (auto pos = bounds[chunk]; pos < bounds[chunk + 1]; ++pos) {
+                        sorted[positions[chunk][digit(postings[pos])]++] = postings[pos];
+                    }
+                });
+                std::swap(postings, sorted);
+            }
+        }
+
+    }  // namespace
+
     auto map_to_postings(ForwardIndexSlice batch) -> std::vector<Posting> {
         auto docid = batch.document_ids.begin();
         std::vector<std::pair<Term_Id, Document_Id>> postings;
@@ -111,38 +244,146 @@ namespace pisa { namespace invert {
         return index;
     }
 
-    void
-    write(std::string const& basename, invert::Inverted_Index const& index, std::uint32_t term_count) {
-        std::ofstream dstream(basename + ".docs");
-        std::ofstream fstream(basename + ".freqs");
-        std::ofstream sstream(basename + ".sizes");
-        std::uint32_t count = index.document_sizes.size();
-        write_sequence(dstream, std::span<uint32_t const>(&count, 1));
+    auto invert_range_flat(
+        DocumentRange documents,
+        Document_Id first_document_id,
+        std::uint32_t term_count,
+        size_t threads
+    ) -> FlatInvertedIndex {
+        FlatInvertedIndex index;
+        index.document_sizes.resize(documents.size());
+        std::transform(
+            documents.begin(),
+            documents.end(),
+            index.document_sizes.begin(),
+            [](auto const& terms) { return terms.size(); }
+        );
+
+        auto postings = map_to_term_postings(
+            documents, first_document_id, term_count, chunk_bounds(documents.size(), threads)
+        );
+        radix_sort_by_term(postings, term_count, threads);
+
+        // The offset of each term is written at the position of the first posting of the term
+        // or of the next term with postings, so that every offset is written exactly once.
+        index.offsets.resize(std::size_t(term_count) + 1);
+        index.documents.resize(postings.size());
+        index.frequencies.resize(postings.size());
+        auto const* sorted = postings.data();
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, postings.size()),
+            [&](tbb::blocked_range<std::size_t> const& range) {
+                for (auto pos = range.begin(); pos != range.end(); ++pos) {
+                    std::uint32_t first_term = pos == 0 ? 0 : sorted[pos - 1].term + 1;
+                    for (auto term = first_term; term <= sorted[pos].term; ++term) {
+                        index.offsets[term] = pos;
+                    }
+                    index.documents[pos] = Document_Id(sorted[pos].document);
+                    index.frequencies[pos] = Frequency(sorted[pos].frequency);
+                }
+            }
+        );
+        std::uint32_t first_term = postings.empty() ? 0 : postings.back().term + 1;
+        std::fill(index.offsets.begin() + first_term, index.offsets.end(), postings.size());
+        return index;
+    }
+
+    void write(
+        std::string const& basename,
+        invert::Inverted_Index const& index,
+        std::uint32_t term_count,
+        BinaryCollectionFormat format
+    ) {
+        BinaryCollectionWriter dstream(basename + ".docs", format);
+        BinaryCollectionWriter fstream(basename + ".freqs", format);
+        BinaryCollectionWriter sstream(basename + ".sizes", format);
+        dstream.write(static_cast<std::uint32_t>(index.document_sizes.size()));
         for (auto term: ranges::views::iota(Term_Id(0), Term_Id(term_count))) {
             if (auto pos = index.documents.find(term); pos != index.documents.end()) {
                 auto const& documents = pos->second;
                 auto const& frequencies = index.frequencies.at(term);
-                write_sequence(dstream, std::span<Document_Id const>(documents));
-                write_sequence(fstream, std::span<Frequency const>(frequencies));
+                dstream.write(as_integers(std::span<Document_Id const>(documents)));
+                fstream.write(as_integers(std::span<Frequency const>(frequencies)));
             } else {
-                write_sequence(dstream, std::span<Document_Id const>());
-                write_sequence(fstream, std::span<Frequency const>());
+                dstream.write(std::span<std::uint32_t const>());
+                fstream.write(std::span<std::uint32_t const>());
             }
         }
-        write_sequence(sstream, std::span<uint32_t const>(index.document_sizes));
+        sstream.write(std::span<uint32_t const>(index.document_sizes));
+    }
+
+    void write(
+        std::string const& basename,
+        invert::FlatInvertedIndex const& index,
+        BinaryCollectionFormat format
+    ) {
+        BinaryCollectionWriter dstream(basename + ".docs", format);
+        BinaryCollectionWriter fstream(basename + ".freqs", format);
+        BinaryCollectionWriter sstream(basename + ".sizes", format);
+        dstream.write(static_cast<std::uint32_t>(index.document_sizes.size()));
+        auto documents = as_integers(std::span<Document_Id const>(index.documents));
+        auto frequencies = as_integers(std::span<Frequency const>(index.frequencies));
+        for (std::size_t term = 0; term + 1 < index.offsets.size(); ++term) {
+            auto first = index.offsets[term];
+            auto length = index.offsets[term + 1] - first;
+            dstream.write(documents.subspan(first, length));
+            fstream.write(frequencies.subspan(first, length));
+        }
+        sstream.write(std::span<uint32_t const>(index.document_sizes));
     }
 
-    [[nodiscard]] auto build_batches(
-        std::string const& input_basename, std::string const& output_basename, InvertParams const& params
-    ) -> uint32_t {
-        uint32_t batch = 0;
+    auto build_batches(
+        std::string const& input_basename, std::string const& output_basename, InvertParams params
+    ) -> Batches {
+        if (not params.term_count) {
+            auto source = MemorySource::mapped_file(fmt::format("{}.termlex", input_basename));
+            auto terms = Payload_Vector<>::from(source);
+            params.term_count = static_cast<std::uint32_t>(terms.size());
+        }
+        Batches batches;
+        batches.term_count = *params.term_count;
+        batches.term_posting_counts.resize(batches.term_count, 0);
+        batches.term_occurrence_counts.resize(batches.term_count, 0);
+
+        // Term offsets are the only part of a flat batch not proportional to its documents.
+        std::size_t flat_batch_bytes =
+            (std::size_t(batches.term_count) + 1) * sizeof(std::uint64_t);
+        if (params.memory_budget && *params.memory_budget <= flat_batch_bytes) {
+            throw std::invalid_argument(fmt::format(
+                "Memory budget of {} bytes is too small for {} terms",
+                *params.memory_budget,
+                batches.term_count
+            ));
+        }
+        auto add_frequencies = [&](Term_Id term, std::span<Frequency const> frequencies) {
+            batches.term_posting_counts[term.as_int()] += frequencies.size();
+            batches.term_occurrence_counts[term.as_int()] += std::accumulate(
+                frequencies.begin(),
+                frequencies.end(),
+                std::uint32_t(0),
+                [](auto acc, auto freq) { return acc + freq.as_int(); }
+            );
+        };
+
         binary_collection coll(input_basename.c_str());
         auto doc_iter = ++coll.begin();
         uint32_t documents_processed = 0;
         while (doc_iter != coll.end()) {
             std::vector<std::span<Term_Id const>> documents;
-            for (; doc_iter != coll.end() && documents.size() < params.batch_size; ++doc_iter) {
+            std::size_t batch_bytes = flat_batch_bytes;
+            for (; doc_iter != coll.end(); ++doc_iter) {
                 auto document_sequence = *doc_iter;
+                if (params.memory_budget) {
+                    auto document_bytes = flat_inversion_bytes_per_document
+                        + flat_inversion_bytes_per_occurrence * document_sequence.size();
+                    if (not documents.empty()
+                        && batch_bytes + document_bytes > *params.memory_budget) {
+                        break;
+                    }
+                    batch_bytes += document_bytes;
+                } else if (documents.size() >= params.batch_size) {
+                    break;
+                }
                 documents.emplace_back(
                     reinterpret_cast<Term_Id const*>(document_sequence.begin()),
                     document_sequence.size()
@@ -151,112 +392,138 @@ namespace pisa { namespace invert {
             spdlog::info(
                 "Inverting [{}, {})", documents_processed, documents_processed + documents.size()
             );
-            auto index =
-                invert_range(documents, Document_Id(documents_processed), params.num_threads);
-            write(fmt::format("{}.batch.{}", output_basename, batch), index, *params.term_count);
+            auto batch_basename = fmt::format("{}.batch.{}", output_basename, batches.count);
+            std::vector<std::uint32_t> document_sizes;
+            if (params.memory_budget) {
+                auto index = invert_range_flat(
+                    documents,
+                    Document_Id(documents_processed),
+                    batches.term_count,
+                    params.num_threads
+                );
+                write(batch_basename, index, params.collection_format);
+                std::span<Frequency const> frequencies(index.frequencies);
+                for (std::size_t term = 0; term < batches.term_count; ++term) {
+                    auto first = index.offsets[term];
+                    add_frequencies(
+                        Term_Id(term), frequencies.subspan(first, index.offsets[term + 1] - first)
+                    );
+                }
+                document_sizes = std::move(index.document_sizes);
+            } else {
+                auto index =
+                    invert_range(documents, Document_Id(documents_processed), params.num_threads);
+                write(batch_basename, index, batches.term_count, params.collection_format);
+                for (auto const& [term, frequencies]: index.frequencies) {
+                    add_frequencies(term, frequencies);
+                }
+                document_sizes = std::move(index.document_sizes);
+            }
+            batches.document_sizes.insert(
+                batches.document_sizes.end(), document_sizes.begin(), document_sizes.end()
+            );
             documents_processed += documents.size();
-            batch += 1;
+            batches.count += 1;
         }
-        return batch;
+        return batches;
     }
 
-    void merge_batches(std::string const& output_basename, uint32_t batch_count, uint32_t term_count) {
-        std::vector<binary_collection> doc_collections;
-        std::vector<binary_collection> freq_collections;
-        std::vector<uint32_t> document_sizes;
-        for (auto batch: ranges::views::iota(uint32_t(0), batch_count)) {
-            std::ostringstream batch_name_stream;
-            batch_name_stream << output_basename << ".batch." << batch;
-            doc_collections.emplace_back((batch_name_stream.str() + ".docs").c_str());
-            freq_collections.emplace_back((batch_name_stream.str() + ".freqs").c_str());
-            std::ifstream sizes_is(batch_name_stream.str() + ".sizes");
-            read_sequence(sizes_is, document_sizes);
+    BatchReader::BatchReader(std::string const& output_basename, Batches const& batches)
+        : m_term_count(batches.term_count) {
+        for (auto batch: ranges::views::iota(uint32_t(0), batches.count)) {
+            auto batch_basename = fmt::format("{}.batch.{}", output_basename, batch);
+            m_doc_collections.emplace_back((batch_basename + ".docs").c_str());
+            m_freq_collections.emplace_back((batch_basename + ".freqs").c_str());
         }
-
-        std::ofstream sos(output_basename + ".sizes");
-        write_sequence(sos, std::span<uint32_t const>(document_sizes));
-
-        std::vector<binary_collection::const_iterator> doc_iterators;
-        std::vector<binary_collection::const_iterator> freq_iterators;
         std::transform(
-            doc_collections.begin(),
-            doc_collections.end(),
-            std::back_inserter(doc_iterators),
+            m_doc_collections.begin(),
+            m_doc_collections.end(),
+            std::back_inserter(m_doc_iterators),
             [](auto const& coll) { return ++coll.begin(); }
         );
         std::transform(
-            freq_collections.begin(),
-            freq_collections.end(),
-            std::back_inserter(freq_iterators),
+            m_freq_collections.begin(),
+            m_freq_collections.end(),
+            std::back_inserter(m_freq_iterators),
             [](auto const& coll) { return coll.begin(); }
         );
+    }
 
-        std::ofstream dos(output_basename + ".docs");
-        std::ofstream fos(output_basename + ".freqs");
-        auto document_count = static_cast<uint32_t>(document_sizes.size());
-        write_sequence(dos, std::span<uint32_t const>(&document_count, 1));
-        size_t postings_count = 0;
-        for (auto term_id: ranges::views::iota(uint32_t(0), term_count)) {
-            std::vector<uint32_t> dlist;
-            for (auto& iter: doc_iterators) {
-                auto seq = *iter;
-                dlist.insert(dlist.end(), seq.begin(), seq.end());
-                ++iter;
-            }
-            std::vector<uint32_t> flist;
-            for (auto& iter: freq_iterators) {
-                auto seq = *iter;
-                flist.insert(flist.end(), seq.begin(), seq.end());
-                ++iter;
-            }
-            if (dlist.size() != flist.size()) {
-                auto msg = fmt::format(
-                    "Document and frequency lists must be equal length"
-                    "but are {} and {} (term {})",
-                    dlist.size(),
-                    flist.size(),
-                    term_id
-                );
-                spdlog::error(msg);
-                throw std::runtime_error(msg);
-            }
-            if (dlist.empty()) {
-                auto msg = fmt::format("Posting list must be non-empty (term {})", term_id);
-                spdlog::error(msg);
-                throw std::runtime_error(msg);
-            }
-            postings_count += dlist.size();
-            write_sequence(dos, std::span<uint32_t const>(dlist));
-            write_sequence(fos, std::span<uint32_t const>(flist));
+    auto BatchReader::next() -> std::optional<PostingList> {
+        if (m_term_id == m_term_count) {
+            return std::nullopt;
         }
-
-        spdlog::info("Number of terms: {}", term_count);
-        spdlog::info("Number of documents: {}", document_count);
-        spdlog::info("Number of postings: {}", postings_count);
+        PostingList list;
+        for (auto& iter: m_doc_iterators) {
+            auto seq = *iter;
+            list.docs.insert(list.docs.end(), seq.begin(), seq.end());
+            ++iter;
+        }
+        for (auto& iter: m_freq_iterators) {
+            auto seq = *iter;
+            list.freqs.insert(list.freqs.end(), seq.begin(), seq.end());
+            ++iter;
+        }
+        if (list.docs.size() != list.freqs.size()) {
+            auto msg = fmt::format(
+                "Document and frequency lists must be equal length"
+                "but are {} and {} (term {})",
+                list.docs.size(),
+                list.freqs.size(),
+                m_term_id
+            );
+            spdlog::error(msg);
+            throw std::runtime_error(msg);
+        }
+        if (list.docs.empty()) {
+            auto msg = fmt::format("Posting list must be non-empty (term {})", m_term_id);
+            spdlog::error(msg);
+            throw std::runtime_error(msg);
+        }
+        m_term_id += 1;
+        return list;
     }
 
-    void invert_forward_index(
-        std::string const& input_basename, std::string const& output_basename, InvertParams params
+    void merge_batches(
+        std::string const& output_basename, Batches const& batches, BinaryCollectionFormat format
     ) {
-        if (not params.term_count) {
-            auto source = MemorySource::mapped_file(fmt::format("{}.termlex", input_basename));
-            auto terms = Payload_Vector<>::from(source);
-            params.term_count = static_cast<std::uint32_t>(terms.size());
+        BinaryCollectionWriter sos(output_basename + ".sizes", format);
+        sos.write(std::span<uint32_t const>(batches.document_sizes));
+
+        BinaryCollectionWriter dos(output_basename + ".docs", format);
+        BinaryCollectionWriter fos(output_basename + ".freqs", format);
+        auto document_count = static_cast<uint32_t>(batches.document_sizes.size());
+        dos.write(document_count);
+        size_t postings_count = 0;
+        BatchReader reader(output_basename, batches);
+        while (auto list = reader.next()) {
+            postings_count += list->docs.size();
+            dos.write(std::span<uint32_t const>(list->docs));
+            fos.write(std::span<uint32_t const>(list->freqs));
         }
 
-        uint32_t batch_count = invert::build_batches(input_basename, output_basename, params);
-        invert::merge_batches(output_basename, batch_count, *params.term_count);
+        spdlog::info("Number of terms: {}", batches.term_count);
+        spdlog::info("Number of documents: {}", document_count);
+        spdlog::info("Number of postings: {}", postings_count);
+    }
 
+    void remove_batches(std::string const& output_basename, std::uint32_t batch_count) {
         for (auto batch: ranges::views::iota(uint32_t(0), batch_count)) {
-            std::ostringstream batch_name_stream;
-            batch_name_stream << output_basename << ".batch." << batch;
-            auto batch_basename = batch_name_stream.str();
+            auto batch_basename = fmt::format("{}.batch.{}", output_basename, batch);
             std::filesystem::remove(std::filesystem::path{batch_basename + ".docs"});
             std::filesystem::remove(std::filesystem::path{batch_basename + ".freqs"});
             std::filesystem::remove(std::filesystem::path{batch_basename + ".sizes"});
         }
     }
 
+    void invert_forward_index(
+        std::string const& input_basename, std::string const& output_basename, InvertParams params
+    ) {
+        auto batches = invert::build_batches(input_basename, output_basename, params);
+        invert::merge_batches(output_basename, batches, params.collection_format);
+        invert::remove_batches(output_basename, batches.count);
+    }
+
     Inverted_Index::Inverted_Index(Inverted_Index&, tbb::split) {}
     Inverted_Index::Inverted_Index(
         Documents documents, Frequencies frequencies, std::vector<std::uint32_t> document_sizes
@@ -0,0 +1,186 @@
+#include "merge_indexes.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "payload_vector.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+namespace pisa {
+
+auto merge_lexicons(std::deque<LexiconMap> const& lexicons, std::vector<std::string>& merged)
+    -> std::vector<std::vector<std::uint32_t>> {
+    std::vector<std::vector<std::uint32_t>> mappings(lexicons.size());
+    std::vector<std::uint32_t> positions(lexicons.size(), 0);
+    while (true) {
+        std::optional<std::string_view> term;
+        for (std::size_t idx = 0; idx < lexicons.size(); ++idx) {
+            if (positions[idx] < lexicons[idx].size()
+                && (!term.has_value() || lexicons[idx][positions[idx]] < *term)) {
+                term = lexicons[idx][positions[idx]];
+            }
+        }
+        if (!term.has_value()) {
+            return mappings;
+        }
+        auto term_id = static_cast<std::uint32_t>(merged.size());
+        merged.emplace_back(*term);
+        for (std::size_t idx = 0; idx < lexicons.size(); ++idx) {
+            if (positions[idx] < lexicons[idx].size()
+                && lexicons[idx][positions[idx]] == merged.back()) {
+                mappings[idx].push_back(term_id);
+                ++positions[idx];
+            }
+        }
+    }
+}
+
+void concatenate_lexicons(std::deque<LexiconMap> const& lexicons, std::string const& output) {
+    std::vector<std::string_view> titles;
+    for (auto const& lexicon: lexicons) {
+        for (std::uint32_t doc = 0; doc < lexicon.size(); ++doc) {
+            titles.push_back(lexicon[doc]);
+        }
+    }
+    encode_payload_vector(titles.begin(), titles.end()).to_file(output);
+}
+
+auto read_statistics(
+    std::string const& basename, std::string const& index_encoding, std::size_t term_count
+) -> IndexStatistics {
+    IndexStatistics statistics;
+    wand_data<wand_data_raw> wdata(MemorySource::mapped_file(basename + ".wand"));
+    for (std::size_t doc = 0; doc < wdata.num_docs(); ++doc) {
+        statistics.document_sizes.push_back(wdata.doc_len(doc));
+    }
+    if (wdata.num_terms() == term_count) {
+        for (std::size_t term = 0; term < term_count; ++term) {
+            statistics.term_posting_counts.push_back(wdata.term_posting_count(term));
+            statistics.term_occurrence_counts.push_back(wdata.term_occurrence_count(term));
+        }
+        return statistics;
+    }
+    // The terms dropped when building the wand data have no statistics, and the others are
+    // numbered without them, so the statistics are read from the posting lists instead.
+    spdlog::info(
+        "Wand data of {} have {} of {} terms, reading term statistics from the index",
+        basename,
+        wdata.num_terms(),
+        term_count
+    );
+    run_for_index(
+        index_encoding, MemorySource::mapped_file(basename + ".index"), [&](auto const& index) {
+            if (index.size() != term_count) {
+                throw std::invalid_argument(fmt::format(
+                    "index {} has {} terms but its lexicon has {}",
+                    basename,
+                    index.size(),
+                    term_count
+                ));
+            }
+            for (std::size_t term = 0; term < term_count; ++term) {
+                auto cursor = index[term];
+                std::uint32_t occurrences = 0;
+                for (; cursor.docid() < index.num_docs(); cursor.next()) {
+                    occurrences += cursor.freq();
+                }
+                statistics.term_posting_counts.push_back(cursor.size());
+                statistics.term_occurrence_counts.push_back(occurrences);
+            }
+        }
+    );
+    return statistics;
+}
+
+auto merge_statistics(
+    std::deque<IndexStatistics> const& statistics,
+    std::vector<std::vector<std::uint32_t>> const& term_mappings,
+    std::size_t term_count
+) -> IndexStatistics {
+    IndexStatistics merged;
+    merged.term_posting_counts.resize(term_count, 0);
+    merged.term_occurrence_counts.resize(term_count, 0);
+    for (std::size_t idx = 0; idx < statistics.size(); ++idx) {
+        auto const& index = statistics[idx];
+        if (index.term_posting_counts.size() != term_mappings[idx].size()) {
+            throw std::invalid_argument(fmt::format(
+                "statistics of {} terms given for a lexicon of {} terms",
+                index.term_posting_counts.size(),
+                term_mappings[idx].size()
+            ));
+        }
+        merged.document_sizes.insert(
+            merged.document_sizes.end(), index.document_sizes.begin(), index.document_sizes.end()
+        );
+        for (std::size_t term = 0; term < term_mappings[idx].size(); ++term) {
+            auto merged_term = term_mappings[idx][term];
+            merged.term_posting_counts[merged_term] += index.term_posting_counts[term];
+            merged.term_occurrence_counts[merged_term] += index.term_occurrence_counts[term];
+        }
+    }
+    return merged;
+}
+
+void merge_indexes(
+    std::vector<std::string> const& input_basenames,
+    std::string const& output_basename,
+    std::string const& index_encoding,
+    WandDataOptions wand_options
+) {
+    if (input_basenames.empty()) {
+        throw std::invalid_argument("no indexes to merge");
+    }
+    std::deque<LexiconMap> term_lexicons;
+    std::vector<std::string> index_filenames;
+    std::vector<std::string> wand_filenames;
+    for (auto const& basename: input_basenames) {
+        term_lexicons.emplace_back(basename + ".termlex");
+        index_filenames.push_back(basename + ".index");
+        wand_filenames.push_back(basename + ".wand");
+    }
+    std::vector<std::string> terms;
+    auto term_mappings = merge_lexicons(term_lexicons, terms);
+    encode_payload_vector(terms).to_file(output_basename + ".termlex");
+
+    std::deque<IndexStatistics> statistics;
+    for (std::size_t idx = 0; idx < input_basenames.size(); ++idx) {
+        statistics.push_back(
+            read_statistics(input_basenames[idx], index_encoding, term_mappings[idx].size())
+        );
+    }
+
+    auto has_documents = [](auto const& basename) {
+        return std::filesystem::exists(basename + ".doclex");
+    };
+    if (std::all_of(input_basenames.begin(), input_basenames.end(), has_documents)) {
+        std::deque<LexiconMap> document_lexicons;
+        for (auto const& basename: input_basenames) {
+            document_lexicons.emplace_back(basename + ".doclex");
+        }
+        concatenate_lexicons(document_lexicons, output_basename + ".doclex");
+    } else if (std::any_of(input_basenames.begin(), input_basenames.end(), has_documents)) {
+        spdlog::warn("Not all indexes have a document lexicon, no document lexicon written");
+    }
+
+    wand_options.output = output_basename + ".wand";
+    merge_posting_lists(
+        index_filenames,
+        term_mappings,
+        merge_statistics(statistics, term_mappings, terms.size()),
+        index_encoding,
+        output_basename + ".index",
+        wand_options,
+        wand_filenames
+    );
+}
+
+}  // namespace pisa
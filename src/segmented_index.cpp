@@ -0,0 +1,477 @@
+#include "segmented_index.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "merge_indexes.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+namespace pisa {
+
+namespace {
+
+    constexpr std::string_view manifest_header = "pisa-segments 1";
+
+    /**
+     * Holds a lock on a file, created if it does not exist, while in scope: an exclusive lock by
+     * default, or a shared one with `LOCK_SH`.
+     */
+    class FileLock {
+      public:
+        explicit FileLock(std::filesystem::path const& path, int operation = LOCK_EX)
+            : m_fd(::open(path.c_str(), O_RDWR | O_CREAT, 0644)) {
+            if (m_fd < 0) {
+                throw std::runtime_error(fmt::format("cannot open lock file {}", path.string()));
+            }
+            if (::flock(m_fd, operation) != 0) {
+                ::close(m_fd);
+                throw std::runtime_error(fmt::format("cannot lock {}", path.string()));
+            }
+        }
+        FileLock(FileLock const&) = delete;
+        FileLock(FileLock&&) = delete;
+        FileLock& operator=(FileLock const&) = delete;
+        FileLock& operator=(FileLock&&) = delete;
+        ~FileLock() {
+            ::flock(m_fd, LOCK_UN);
+            ::close(m_fd);
+        }
+
+      private:
+        int m_fd;
+    };
+
+    constexpr std::array<std::string_view, 5> segment_extensions{
+        ".index", ".wand", ".termlex", ".doclex", ".blockmax"
+    };
+
+    void remove_segment_files(std::filesystem::path const& manifest_path, std::string_view name) {
+        for (auto extension: segment_extensions) {
+            std::filesystem::remove(segment_path(manifest_path, name, extension));
+        }
+    }
+
+    /** Version of the layout of the block-max scores, which is part of their key. */
+    constexpr std::uint64_t block_max_format = 1;
+
+    /** 64-bit FNV-1a hash of a sequence of values. */
+    class Fnv1aHash {
+      public:
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void add(T const& value) {
+            add_bytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void add(std::vector<T> const& values) {
+            add(values.size());
+            add_bytes(values.data(), values.size() * sizeof(T));
+        }
+
+        void add(std::string_view value) {
+            add(value.size());
+            add_bytes(value.data(), value.size());
+        }
+
+        [[nodiscard]] auto hash() const -> std::uint64_t { return m_hash; }
+
+      private:
+        void add_bytes(void const* data, std::size_t size) {
+            auto const* bytes = static_cast<unsigned char const*>(data);
+            for (std::size_t pos = 0; pos < size; ++pos) {
+                m_hash = (m_hash ^ bytes[pos]) * 0x100000001b3ULL;
+            }
+        }
+
+        std::uint64_t m_hash = 0xcbf29ce484222325ULL;
+    };
+
+    void check_wand_options(WandDataOptions const& options) {
+        if (options.compress || options.range || options.quantization_bits.has_value()) {
+            throw std::invalid_argument(
+                "segments only support uncompressed wand data without quantization"
+            );
+        }
+    }
+
+}  // namespace
+
+auto segment_path(
+    std::filesystem::path const& manifest, std::string_view name, std::string_view extension
+) -> std::string {
+    return (manifest.parent_path() / fmt::format("{}{}", name, extension)).string();
+}
+
+SegmentManifest::SegmentManifest(std::string encoding) : m_encoding(std::move(encoding)) {}
+
+auto SegmentManifest::read(std::filesystem::path const& path) -> SegmentManifest {
+    std::ifstream is(io::resolve_path(path.string()));
+    auto invalid = [&](std::string_view reason) {
+        return std::runtime_error(
+            fmt::format("invalid segment manifest {}: {}", path.string(), reason)
+        );
+    };
+    std::string line;
+    if (!std::getline(is, line) || line != manifest_header) {
+        throw invalid("missing header");
+    }
+    std::string key;
+    std::string encoding;
+    std::uint64_t generation = 0;
+    if (!(is >> key >> encoding) || key != "encoding") {
+        throw invalid("missing encoding");
+    }
+    if (!(is >> key >> generation) || key != "generation") {
+        throw invalid("missing generation");
+    }
+    SegmentManifest manifest(std::move(encoding));
+    manifest.m_generation = generation;
+    while (is >> key) {
+        SegmentInfo segment;
+        if (key != "segment" || !(is >> segment.name >> segment.num_docs >> segment.level)) {
+            throw invalid("malformed segment");
+        }
+        manifest.m_segments.push_back(std::move(segment));
+    }
+    return manifest;
+}
+
+void SegmentManifest::write(std::filesystem::path const& path) const {
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path);
+        os.exceptions(std::ios::badbit | std::ios::failbit);
+        os << manifest_header << '\n';
+        os << "encoding " << m_encoding << '\n';
+        os << "generation " << m_generation << '\n';
+        for (auto const& segment: m_segments) {
+            os << "segment " << segment.name << ' ' << segment.num_docs << ' ' << segment.level
+               << '\n';
+        }
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+auto SegmentManifest::update(
+    std::filesystem::path const& path, std::function<void(SegmentManifest&)> const& update
+) -> SegmentManifest {
+    auto lock_path = path;
+    lock_path += ".lock";
+    FileLock lock(lock_path);
+    auto manifest = read(path);
+    update(manifest);
+    manifest.write(path);
+    return manifest;
+}
+
+void SegmentManifest::open_segments(
+    std::filesystem::path const& path, std::function<void(SegmentManifest const&)> const& open
+) {
+    auto lock_path = path;
+    lock_path += ".lock";
+    FileLock lock(lock_path, LOCK_SH);
+    open(read(path));
+}
+
+auto SegmentManifest::encoding() const noexcept -> std::string const& {
+    return m_encoding;
+}
+
+auto SegmentManifest::segments() const noexcept -> std::vector<SegmentInfo> const& {
+    return m_segments;
+}
+
+auto SegmentManifest::num_docs() const noexcept -> std::uint64_t {
+    return std::accumulate(
+        m_segments.begin(), m_segments.end(), std::uint64_t(0), [](auto acc, auto const& segment) {
+            return acc + segment.num_docs;
+        }
+    );
+}
+
+auto SegmentManifest::document_offsets() const -> std::vector<std::uint32_t> {
+    std::vector<std::uint32_t> offsets;
+    offsets.reserve(m_segments.size());
+    std::uint64_t offset = 0;
+    for (auto const& segment: m_segments) {
+        offsets.push_back(static_cast<std::uint32_t>(offset));
+        offset += segment.num_docs;
+    }
+    return offsets;
+}
+
+auto SegmentManifest::new_segment_name() -> std::string {
+    return fmt::format("segment-{}", m_generation++);
+}
+
+void SegmentManifest::append(SegmentInfo segment) {
+    m_segments.push_back(std::move(segment));
+}
+
+void SegmentManifest::replace(std::vector<std::string> const& names, SegmentInfo merged) {
+    auto first = std::find_if(m_segments.begin(), m_segments.end(), [&](auto const& segment) {
+        return !names.empty() && segment.name == names.front();
+    });
+    auto same_name = [](auto const& name, auto const& segment) { return name == segment.name; };
+    if (first == m_segments.end() || m_segments.end() - first < std::ssize(names)
+        || !std::equal(names.begin(), names.end(), first, same_name)) {
+        throw std::invalid_argument("merged segments are no longer consecutive segments");
+    }
+    auto pos = m_segments.erase(first, first + std::ssize(names));
+    m_segments.insert(pos, std::move(merged));
+}
+
+auto TieredMergePolicy::select(std::vector<SegmentInfo> const& segments) const
+    -> std::optional<std::pair<std::size_t, std::size_t>> {
+    if (fanout < 2) {
+        throw std::invalid_argument("merge fanout must be at least 2");
+    }
+    std::optional<std::pair<std::size_t, std::size_t>> selected;
+    std::uint32_t selected_level = 0;
+    std::size_t first = 0;
+    for (std::size_t pos = 1; pos <= segments.size(); ++pos) {
+        if (pos < segments.size() && segments[pos].level == segments[first].level) {
+            continue;
+        }
+        auto level = segments[first].level;
+        if (pos - first >= fanout && (!selected.has_value() || level < selected_level)) {
+            selected = std::make_pair(first, first + fanout);
+            selected_level = level;
+        }
+        first = pos;
+    }
+    return selected;
+}
+
+auto add_segment(
+    std::filesystem::path const& manifest_path,
+    std::string const& forward_index_basename,
+    invert::InvertParams const& invert_params,
+    WandDataOptions wand_options
+) -> SegmentInfo {
+    check_wand_options(wand_options);
+    std::string name;
+    auto manifest = SegmentManifest::update(manifest_path, [&](SegmentManifest& manifest) {
+        name = manifest.new_segment_name();
+    });
+    wand_options.output = segment_path(manifest_path, name, ".wand");
+    SegmentInfo segment{name};
+    try {
+        for (auto extension: {".termlex", ".doclex"}) {
+            std::filesystem::copy_file(
+                io::resolve_path(fmt::format("{}{}", forward_index_basename, extension)),
+                segment_path(manifest_path, name, extension),
+                std::filesystem::copy_options::overwrite_existing
+            );
+        }
+        invert_and_compress(
+            forward_index_basename,
+            manifest.encoding(),
+            segment_path(manifest_path, name, ".index"),
+            invert_params,
+            wand_options
+        );
+        wand_data<wand_data_raw> wdata(MemorySource::mapped_file(wand_options.output));
+        segment.num_docs = static_cast<std::uint32_t>(wdata.num_docs());
+        SegmentManifest::update(manifest_path, [&](SegmentManifest& manifest) {
+            manifest.append(segment);
+        });
+    } catch (...) {
+        remove_segment_files(manifest_path, name);
+        throw;
+    }
+    spdlog::info("Added segment {} with {} documents", segment.name, segment.num_docs);
+    return segment;
+}
+
+auto merge_segments(
+    std::filesystem::path const& manifest_path,
+    std::size_t first,
+    std::size_t last,
+    WandDataOptions wand_options
+) -> SegmentInfo {
+    check_wand_options(wand_options);
+    std::string name;
+    auto manifest = SegmentManifest::update(manifest_path, [&](SegmentManifest& manifest) {
+        name = manifest.new_segment_name();
+    });
+    if (first >= last || last > manifest.segments().size()) {
+        throw std::invalid_argument(fmt::format(
+            "invalid range of segments [{}, {}) out of {}", first, last, manifest.segments().size()
+        ));
+    }
+    std::vector<SegmentInfo> merged(
+        manifest.segments().begin() + first, manifest.segments().begin() + last
+    );
+    std::vector<std::string> names;
+    std::transform(merged.begin(), merged.end(), std::back_inserter(names), [](auto const& s) {
+        return s.name;
+    });
+
+    SegmentInfo segment{name, 0, 0};
+    for (auto const& input: merged) {
+        segment.num_docs += input.num_docs;
+        segment.level = std::max(segment.level, input.level + 1);
+    }
+    try {
+        std::vector<std::string> basenames;
+        for (auto const& input: merged) {
+            basenames.push_back(segment_path(manifest_path, input.name, ""));
+        }
+        merge_indexes(
+            basenames, segment_path(manifest_path, name, ""), manifest.encoding(), wand_options
+        );
+        SegmentManifest::update(manifest_path, [&](SegmentManifest& manifest) {
+            manifest.replace(names, segment);
+        });
+    } catch (...) {
+        remove_segment_files(manifest_path, name);
+        throw;
+    }
+    for (auto const& input: merged) {
+        remove_segment_files(manifest_path, input.name);
+    }
+    spdlog::info(
+        "Merged {} segments into segment {} with {} documents",
+        merged.size(),
+        segment.name,
+        segment.num_docs
+    );
+    return segment;
+}
+
+auto merge_segments(
+    std::filesystem::path const& manifest_path,
+    TieredMergePolicy const& policy,
+    WandDataOptions const& wand_options
+) -> std::size_t {
+    std::size_t merges = 0;
+    while (true) {
+        auto manifest = SegmentManifest::read(manifest_path);
+        auto selected = policy.select(manifest.segments());
+        if (!selected.has_value()) {
+            return merges;
+        }
+        merge_segments(manifest_path, selected->first, selected->second, wand_options);
+        ++merges;
+    }
+}
+
+SegmentWandData::SegmentWandData(MemorySource source) : m_segment(std::move(source)) {
+    m_num_docs = m_segment.num_docs();
+    m_avg_len = m_segment.avg_len();
+    m_collection_len = m_segment.collection_len();
+}
+
+void SegmentWandData::set_collection_statistics(
+    std::uint64_t num_docs,
+    std::uint64_t collection_len,
+    std::vector<std::uint32_t> term_occurrence_counts,
+    std::vector<std::uint32_t> term_posting_counts
+) {
+    m_num_docs = num_docs;
+    m_collection_len = collection_len;
+    m_avg_len = float(m_collection_len / double(m_num_docs));
+    m_term_occurrence_counts = std::move(term_occurrence_counts);
+    m_term_posting_counts = std::move(term_posting_counts);
+}
+
+auto SegmentWandData::block_max_key(ScorerParams const& scorer_params, BlockSize block_size) const
+    -> std::uint64_t {
+    Fnv1aHash hash;
+    hash.add(block_max_format);
+    hash.add(std::string_view(scorer_params.name));
+    hash.add(scorer_params.bm25_b);
+    hash.add(scorer_params.bm25_k1);
+    hash.add(scorer_params.pl2_c);
+    hash.add(scorer_params.qld_mu);
+    hash.add(block_size.index());
+    if (std::holds_alternative<FixedBlock>(block_size)) {
+        hash.add(std::get<FixedBlock>(block_size).size);
+    } else {
+        hash.add(std::get<VariableBlock>(block_size).lambda);
+    }
+    hash.add(m_num_docs);
+    hash.add(m_collection_len);
+    hash.add(m_term_occurrence_counts);
+    hash.add(m_term_posting_counts);
+    return hash.hash();
+}
+
+auto SegmentWandData::map_block_max_scores(std::string const& path, std::uint64_t key) -> bool {
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+    auto source = MemorySource::mapped_file(path);
+    // The key follows the flags written by `mapper::freeze`.
+    std::uint64_t stored_key = 0;
+    if (source.size() < sizeof(std::uint64_t) + sizeof(stored_key)) {
+        return false;
+    }
+    std::memcpy(&stored_key, source.data() + sizeof(std::uint64_t), sizeof(stored_key));
+    if (stored_key != key) {
+        return false;
+    }
+    mapper::map(m_scores, source.data());
+    m_scores_source = std::move(source);
+    return true;
+}
+
+void SegmentWandData::write_block_max_scores(std::string const& path, std::uint64_t key) {
+    m_scores.key = key;
+    // Concurrent readers may write the same scores, so each writes its own file first.
+    auto tmp_path = fmt::format("{}.{}.tmp", path, ::getpid());
+    mapper::freeze(m_scores, tmp_path.c_str());
+    std::filesystem::rename(tmp_path, path);
+}
+
+void SegmentWandData::set_block_max_scores(std::vector<BlockMaxList> lists) {
+    std::vector<std::uint64_t> blocks_start{0};
+    std::vector<float> max_term_weight;
+    std::vector<float> block_max_term_weight;
+    std::vector<std::uint32_t> block_docid;
+    float index_max_term_weight = 0;
+    for (auto const& list: lists) {
+        block_max_term_weight.insert(
+            block_max_term_weight.end(), list.scores.begin(), list.scores.end()
+        );
+        block_docid.insert(block_docid.end(), list.docids.begin(), list.docids.end());
+        blocks_start.push_back(block_docid.size());
+        max_term_weight.push_back(list.max_score);
+        index_max_term_weight = std::max(index_max_term_weight, list.max_score);
+    }
+    m_scores.blocks_start.steal(blocks_start);
+    m_scores.max_term_weight.steal(max_term_weight);
+    m_scores.block_max_term_weight.steal(block_max_term_weight);
+    m_scores.block_docid.steal(block_docid);
+    m_scores.index_max_term_weight = index_max_term_weight;
+    m_scores_source.reset();
+}
+
+auto lexicon_query(std::vector<std::string> const& terms, LexiconMap const& lexicon) -> Query {
+    std::vector<TermId> term_ids;
+    for (auto const& term: terms) {
+        if (auto term_id = lexicon.find(term); term_id.has_value()) {
+            term_ids.push_back(*term_id);
+        }
+    }
+    return Query(std::nullopt, term_ids);
+}
+
+}  // namespace pisa
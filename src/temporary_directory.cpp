@@ -49,4 +49,8 @@ void TemporaryDirectory::disable_cleanup() {
     cleanup_ = false;
 }
 
+auto tmp_root_for(std::filesystem::path const& output) -> std::filesystem::path {
+    return std::filesystem::absolute(output).parent_path();
+}
+
 };  // namespace pisa
@@ -3,15 +3,19 @@
 ENCODINGS=(
     block_interpolative
     block_maskedvbyte
+    block_mixed
     block_optpfor
     block_qmx
     block_simdbp
+    block_simdpfor
+    block_simdpfor256
     block_simple16
     block_simple8b
     block_streamvbyte
     block_varintg8iu
     block_varintgb
     ef
+    hybrid
     pefopt
     pefuniform
     single
@@ -0,0 +1,138 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_collection_writer.hpp"
+#include "binary_freq_collection.hpp"
+#include "temporary_directory.hpp"
+
+using namespace pisa;
+
+namespace {
+
+auto random_sequences(std::size_t count) -> std::vector<std::vector<std::uint32_t>> {
+    std::mt19937 rng(17);
+    std::vector<std::vector<std::uint32_t>> sequences(count);
+    for (std::size_t idx = 0; idx < count; ++idx) {
+        auto& sequence = sequences[idx];
+        sequence.resize(rng() % 100);
+        // Mixes small and full-width values, in sorted and arbitrary order.
+        std::uint32_t bound = idx % 3 == 0 ? std::numeric_limits<std::uint32_t>::max() : 1000;
+        for (auto& value: sequence) {
+            value = rng() % bound;
+        }
+        if (idx % 2 == 0) {
+            std::sort(sequence.begin(), sequence.end());
+        }
+    }
+    sequences.push_back({std::numeric_limits<std::uint32_t>::max(), 0});
+    sequences.push_back({0, std::numeric_limits<std::uint32_t>::max()});
+    return sequences;
+}
+
+auto to_vector(binary_collection::const_sequence const& sequence) -> std::vector<std::uint32_t> {
+    return std::vector<std::uint32_t>(sequence.begin(), sequence.end());
+}
+
+}  // namespace
+
+TEST_CASE("Write and read binary collection", "[binary_collection][unit]") {
+    auto format = GENERATE(BinaryCollectionFormat::Raw, BinaryCollectionFormat::VByte);
+    TemporaryDirectory tmpdir;
+    auto filename = (tmpdir.path() / "coll").string();
+    auto sequences = random_sequences(1000);
+    {
+        BinaryCollectionWriter writer(filename, format);
+        for (auto const& sequence: sequences) {
+            writer.write(std::span<std::uint32_t const>(sequence));
+        }
+    }
+
+    binary_collection collection(filename.c_str());
+    REQUIRE(collection.format() == format);
+    REQUIRE(collection.size() == sequences.size());
+
+    std::vector<binary_collection::const_sequence> read;
+    for (auto const& sequence: collection) {
+        read.push_back(sequence);
+    }
+    REQUIRE(read.size() == sequences.size());
+    for (std::size_t idx = 0; idx < sequences.size(); ++idx) {
+        REQUIRE(to_vector(read[idx]) == sequences[idx]);
+    }
+    REQUIRE_FALSE(std::filesystem::exists(filename + ".offsets.tmp"));
+}
+
+TEST_CASE("VByte binary collection is smaller than raw", "[binary_collection][unit]") {
+    TemporaryDirectory tmpdir;
+    auto raw = (tmpdir.path() / "raw").string();
+    auto vbyte = (tmpdir.path() / "vbyte").string();
+    {
+        BinaryCollectionWriter raw_writer(raw, BinaryCollectionFormat::Raw);
+        BinaryCollectionWriter vbyte_writer(vbyte, BinaryCollectionFormat::VByte);
+        std::vector<std::uint32_t> documents(1000);
+        for (std::size_t idx = 0; idx < documents.size(); ++idx) {
+            documents[idx] = 3 * idx;
+        }
+        for (int term = 0; term < 10; ++term) {
+            raw_writer.write(std::span<std::uint32_t const>(documents));
+            vbyte_writer.write(std::span<std::uint32_t const>(documents));
+        }
+    }
+    REQUIRE(3 * std::filesystem::file_size(vbyte) < std::filesystem::file_size(raw));
+}
+
+TEST_CASE("Empty VByte binary collection", "[binary_collection][unit]") {
+    TemporaryDirectory tmpdir;
+    auto filename = (tmpdir.path() / "coll").string();
+    BinaryCollectionWriter(filename, BinaryCollectionFormat::VByte).close();
+    binary_collection collection(filename.c_str());
+    REQUIRE(collection.format() == BinaryCollectionFormat::VByte);
+    REQUIRE(collection.size() == 0);
+    REQUIRE(collection.begin() == collection.end());
+}
+
+TEST_CASE("VByte binary collection cannot be modified", "[binary_collection][unit]") {
+    TemporaryDirectory tmpdir;
+    auto filename = (tmpdir.path() / "coll").string();
+    {
+        BinaryCollectionWriter writer(filename, BinaryCollectionFormat::VByte);
+        writer.write(1);
+    }
+    REQUIRE_THROWS_AS(writable_binary_collection(filename.c_str()), std::runtime_error);
+}
+
+TEST_CASE("Read frequency collection in mixed formats", "[binary_collection][unit]") {
+    auto docs_format = GENERATE(BinaryCollectionFormat::Raw, BinaryCollectionFormat::VByte);
+    auto freqs_format = GENERATE(BinaryCollectionFormat::Raw, BinaryCollectionFormat::VByte);
+    TemporaryDirectory tmpdir;
+    auto basename = (tmpdir.path() / "inv").string();
+    std::vector<std::vector<std::uint32_t>> documents{{0, 2, 4}, {1}, {0, 1, 2, 3, 4}};
+    std::vector<std::vector<std::uint32_t>> frequencies{{1, 3, 1}, {7}, {1, 1, 2, 1, 1}};
+    {
+        BinaryCollectionWriter docs(basename + ".docs", docs_format);
+        BinaryCollectionWriter freqs(basename + ".freqs", freqs_format);
+        docs.write(5);
+        for (std::size_t term = 0; term < documents.size(); ++term) {
+            docs.write(std::span<std::uint32_t const>(documents[term]));
+            freqs.write(std::span<std::uint32_t const>(frequencies[term]));
+        }
+    }
+    binary_freq_collection collection(basename.c_str());
+    REQUIRE(collection.num_docs() == 5);
+    REQUIRE(collection.size() == 3);
+    std::size_t term = 0;
+    for (auto const& list: collection) {
+        REQUIRE(to_vector(list.docs) == documents[term]);
+        REQUIRE(to_vector(list.freqs) == frequencies[term]);
+        ++term;
+    }
+    REQUIRE(term == 3);
+}
@@ -140,6 +140,8 @@ TEST_CASE("bit_vector_unary_enumerator") {
     }();
 
     pisa::bit_vector bitmap(v);
+    // Long enough to skip entire windows of `broadword::window_bits` bits.
+    std::size_t const max_skip = 2 * pisa::broadword::window_bits;
 
     std::vector<size_t> ones;
     for (size_t i = 0; i < v.size(); ++i) {
@@ -161,7 +163,7 @@ TEST_CASE("bit_vector_unary_enumerator") {
         pisa::bit_vector::unary_enumerator e(bitmap, 0);
 
         for (size_t r = 0; r < ones.size(); ++r) {
-            for (size_t k = 0; k < std::min(size_t(256), size_t(ones.size() - r)); ++k) {
+            for (size_t k = 0; k < std::min(max_skip, size_t(ones.size() - r)); ++k) {
                 pisa::bit_vector::unary_enumerator ee(e);
                 ee.skip(k);
                 uint64_t pos = ee.next();
@@ -175,7 +177,7 @@ TEST_CASE("bit_vector_unary_enumerator") {
         pisa::bit_vector::unary_enumerator e(bitmap, 0);
 
         for (size_t r = 0; r < ones.size(); ++r) {
-            for (size_t k = 0; k < std::min(size_t(256), size_t(ones.size() - r)); ++k) {
+            for (size_t k = 0; k < std::min(max_skip, size_t(ones.size() - r)); ++k) {
                 pisa::bit_vector::unary_enumerator ee(e);
                 uint64_t pos_skip = ee.skip_no_move(k);
                 uint64_t pos = ee.next();
@@ -191,7 +193,7 @@ TEST_CASE("bit_vector_unary_enumerator") {
 
         for (size_t pos = 0; pos < v.size(); ++pos) {
             uint64_t skip = 0;
-            for (size_t d = 0; d < std::min(size_t(256), size_t(v.size() - pos)); ++d) {
+            for (size_t d = 0; d < std::min(max_skip, size_t(v.size() - pos)); ++d) {
                 if (not v[pos + d]) {
                     pisa::bit_vector::unary_enumerator ee(bitmap, pos);
                     ee.skip0(skip);
@@ -212,6 +214,20 @@ TEST_CASE("bit_vector_unary_enumerator") {
     }
 }
 
+TEST_CASE("select_in_word") {
+    std::mt19937_64 gen(42);
+    for (int i = 0; i < 10'000; ++i) {
+        std::uint64_t word = gen() & gen();
+        std::uint64_t rank = 0;
+        for (std::uint64_t pos = 0; pos < 64; ++pos) {
+            if (((word >> pos) & 1U) != 0U) {
+                REQUIRE(pisa::broadword::select_in_word(word, rank) == pos);
+                ++rank;
+            }
+        }
+    }
+}
+
 TEST_CASE("bvb_reverse") {
     rc::check([](std::vector<bool> v) {
         pisa::bit_vector_builder bvb;
@@ -1,10 +1,18 @@
 #include "codec/block_codec.hpp"
 #include "codec/block_codec_registry.hpp"
+#include "codec/interpolative_coding.hpp"
+#include "codec/mixed.hpp"
+#include "codec/simdbp_wide.hpp"
+#include "codec/simdpfor.hpp"
+#include "util/cpu_features.hpp"
 #define CATCH_CONFIG_MAIN
 #include "catch2/catch.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
+#include <limits>
+#include <numeric>
 #include <rapidcheck.h>
 #include <type_traits>
 #include <vector>
@@ -35,6 +43,20 @@ void test_case(pisa::BlockCodec const* codec, std::vector<std::uint32_t> values,
         REQUIRE(encoded.size() == out - encoded.data());
     }
     REQUIRE(values == decoded);
+
+    // Decoding the values as document ID gaps must result in their prefix sum.
+    std::uint32_t base = 1000;
+    std::vector<uint32_t> expected_docids(values.size());
+    std::uint32_t docid = base - 1;
+    for (std::size_t pos = 0; pos < values.size(); ++pos) {
+        docid += values[pos] + 1;
+        expected_docids[pos] = docid;
+    }
+    std::vector<uint32_t> docids(values.size());
+    uint8_t const* docids_out =
+        codec->decode_docids(encoded.data(), docids.data(), sum_of_values, values.size(), base);
+    REQUIRE(docids_out == out);
+    REQUIRE(expected_docids == docids);
 }
 
 void test_block_codec(pisa::BlockCodec const* codec) {
@@ -62,7 +84,12 @@ TEST_CASE("Example test case", "[codec]") {
         "block_varintgb",
         "block_simple8b",
         "block_simple16",
-        "block_simdbp"
+        "block_simdbp",
+        "block_simdbp256",
+        "block_simdbp512",
+        "block_simdpfor",
+        "block_simdpfor256",
+        "block_mixed"
     );
     CAPTURE(codec_name);
     auto codec = pisa::get_block_codec(codec_name);
@@ -88,10 +115,151 @@ TEST_CASE("Property test", "[codec]") {
         "block_varintgb",
         "block_simple8b",
         "block_simple16",
-        "block_simdbp"
+        "block_simdbp",
+        "block_simdbp256",
+        "block_simdbp512",
+        "block_simdpfor",
+        "block_simdpfor256",
+        "block_mixed"
     );
     CAPTURE(codec_name);
     auto codec = pisa::get_block_codec(codec_name);
     std::size_t use_sum_of_values = GENERATE(true, false);
     test_block_codec(codec.get());
 }
+
+TEMPLATE_TEST_CASE(
+    "Wide SIMD-BP kernels of all supported SIMD levels",
+    "[codec]",
+    pisa::SimdBp256BlockCodec,
+    pisa::SimdBp512BlockCodec
+) {
+    auto level = GENERATE(from_range(pisa::supported_simd_levels()));
+    CAPTURE(pisa::to_string(level));
+    TestType codec(level);
+    REQUIRE(codec.simd_level() == std::min(level, TestType::max_simd_level));
+    test_block_codec(&codec);
+}
+
+TEMPLATE_TEST_CASE(
+    "SIMD-PFor kernels of all supported SIMD levels",
+    "[codec]",
+    pisa::SimdPFor128BlockCodec,
+    pisa::SimdPFor256BlockCodec
+) {
+    auto level = GENERATE(from_range(pisa::supported_simd_levels()));
+    CAPTURE(pisa::to_string(level));
+    TestType codec(level);
+    REQUIRE(codec.simd_level() == std::min(level, TestType::max_simd_level));
+    test_block_codec(&codec);
+}
+
+TEMPLATE_TEST_CASE(
+    "SIMD-PFor stores large values as exceptions",
+    "[codec]",
+    pisa::SimdPFor128BlockCodec,
+    pisa::SimdPFor256BlockCodec
+) {
+    TestType codec;
+    std::size_t block_size = codec.block_size();
+    std::uint32_t outlier = GENERATE(1U << 8, 1U << 20, std::numeric_limits<std::uint32_t>::max());
+    CAPTURE(outlier);
+    std::vector<std::uint32_t> values(block_size);
+    std::generate(values.begin(), values.end(), [value = 0U]() mutable {
+        value = (value * 1103515245 + 12345) % (1U << 31);
+        return (value >> 16) % 8;
+    });
+    for (std::size_t pos = 3; pos < block_size; pos += 29) {
+        values[pos] = outlier - static_cast<std::uint32_t>(pos);
+    }
+    std::uint32_t sum_of_values = std::accumulate(values.begin(), values.end(), 0U);
+    test_case(&codec, values, false);
+
+    // The large values do not widen the bit-packed block.
+    std::vector<std::uint8_t> encoded;
+    codec.encode(values.data(), sum_of_values, values.size(), encoded);
+    REQUIRE(encoded[0] <= 3);
+    REQUIRE(encoded[1] == (block_size - 3 + 28) / 29);
+}
+
+TEST_CASE("Interpolative decoding matches the recursive decoder", "[codec]") {
+    auto run_probability = GENERATE(0, 50, 90, 100);
+    auto universe = GENERATE(2U, 64U, 1U << 20);
+    CAPTURE(run_probability);
+    CAPTURE(universe);
+    srand(1729);
+    for (std::size_t n: {1, 2, 3, 4, 17, 127, 128, 511}) {
+        std::vector<std::uint32_t> values(n);
+        std::generate(values.begin(), values.end(), [&]() {
+            auto value = static_cast<std::uint32_t>(rand()) % universe;
+            return rand() % 100 < run_probability ? 0U : value;
+        });
+        std::partial_sum(values.begin(), values.end(), values.begin());
+        std::uint32_t high = values.back() + static_cast<std::uint32_t>(rand()) % 3;
+
+        std::vector<std::uint32_t> buf;
+        pisa::bit_writer bw(buf);
+        bw.write_interpolative(values.data(), n, 0, high);
+        auto const* encoded = reinterpret_cast<std::uint8_t const*>(buf.data());
+
+        std::vector<std::uint32_t> decoded(n);
+        pisa::bit_reader br(encoded);
+        br.read_interpolative(decoded.data(), n, 0, high);
+        std::vector<std::uint32_t> expected(n);
+        pisa::bit_reader recursive_br(encoded);
+        recursive_br.read_interpolative_recursive(expected.data(), n, 0, high);
+
+        REQUIRE(decoded == values);
+        REQUIRE(expected == values);
+        REQUIRE(br.position() == recursive_br.position());
+        REQUIRE(br.position() == bw.size());
+    }
+}
+
+TEST_CASE("Mixed codec chooses the codec of each block", "[codec]") {
+    std::vector<std::uint32_t> values(128);
+    std::generate(values.begin(), values.end(), [value = 0U]() mutable {
+        value = (value * 1103515245 + 12345) % (1U << 31);
+        return (value >> 16) % 64;
+    });
+    std::uint32_t sum_of_values = std::accumulate(values.begin(), values.end(), 0);
+
+    std::size_t smallest = std::numeric_limits<std::size_t>::max();
+    for (auto name: pisa::MixedBlockCodec::candidate_names) {
+        std::vector<std::uint8_t> encoded;
+        pisa::get_block_codec(name)->encode(values.data(), sum_of_values, values.size(), encoded);
+        smallest = std::min(smallest, encoded.size());
+    }
+
+    SECTION("Without time weight, the smallest encoding is chosen") {
+        pisa::MixedBlockCodec codec(0.0);
+        std::vector<std::uint8_t> encoded;
+        codec.encode(values.data(), sum_of_values, values.size(), encoded);
+        REQUIRE(encoded.size() == smallest + 1);
+        test_case(&codec, values, true);
+    }
+
+    SECTION("With a large time weight, the fastest codec is chosen") {
+        pisa::MixedBlockCodec codec(1000.0);
+        std::vector<std::uint8_t> encoded;
+        codec.encode(values.data(), sum_of_values, values.size(), encoded);
+        auto counts = codec.block_counts();
+        REQUIRE(counts[0] == 1);
+        REQUIRE(std::accumulate(counts.begin(), counts.end(), std::uint64_t{0}) == 1);
+        REQUIRE(pisa::MixedBlockCodec::candidate_names[0] == pisa::SimdBpBlockCodec::name);
+    }
+
+    SECTION("Decoding times can be given") {
+        auto decode_ns = pisa::MixedBlockCodec::default_decode_ns;
+        std::fill(decode_ns.begin(), decode_ns.end(), 100.0);
+        decode_ns.back() = 0.0;
+        pisa::MixedBlockCodec codec(1000.0, decode_ns);
+        std::vector<std::uint8_t> encoded;
+        codec.encode(values.data(), sum_of_values, values.size(), encoded);
+        REQUIRE(codec.block_counts().back() == 1);
+        test_case(&codec, values, true);
+
+        decode_ns.back() = -1.0;
+        REQUIRE_THROWS_AS(pisa::MixedBlockCodec(1.0, decode_ns), std::invalid_argument);
+    }
+}
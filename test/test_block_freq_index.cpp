@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <fstream>
+#include <iterator>
 #include <vector>
 
 #include <catch2/catch.hpp>
@@ -70,4 +72,46 @@ TEMPLATE_TEST_CASE(
     test_block_posting_accumulator<TestType>("block_simple8b");
     test_block_posting_accumulator<TestType>("block_simple16");
     test_block_posting_accumulator<TestType>("block_simdbp");
+    test_block_posting_accumulator<TestType>("block_simdbp256");
+    test_block_posting_accumulator<TestType>("block_simdbp512");
+    test_block_posting_accumulator<TestType>("block_simdpfor");
+    test_block_posting_accumulator<TestType>("block_simdpfor256");
+    test_block_posting_accumulator<TestType>("block_mixed");
+}
+
+TEMPLATE_TEST_CASE(
+    "block index of another format is rejected",
+    "[block][accumulator]",
+    pisa::index::block::InMemoryPostingAccumulator,
+    pisa::index::block::StreamPostingAccumulator
+) {
+    pisa::TemporaryDirectory tmpdir;
+    auto output_filename = (tmpdir.path() / "temp.bin").string();
+    auto block_codec = pisa::get_block_codec("block_varintgb");
+    {
+        TestType accumulator(block_codec, 10, output_filename);
+        std::vector<std::uint32_t> docs{1, 3, 7};
+        std::vector<std::uint32_t> freqs{1, 1, 2};
+        accumulator.accumulate_posting_list(docs.size(), docs.data(), freqs.data());
+        accumulator.finish();
+    }
+    std::ifstream is(output_filename, std::ios::binary);
+    std::vector<char> bytes(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>{});
+    REQUIRE_NOTHROW(pisa::BlockInvertedIndex(pisa::MemorySource::from_vector(bytes), block_codec));
+
+    SECTION("Without header, as written by older versions") {
+        auto header = bytes.begin() + sizeof(std::uint64_t);
+        bytes.erase(header, header + 2 * sizeof(std::uint32_t));
+        REQUIRE_THROWS_AS(
+            pisa::BlockInvertedIndex(pisa::MemorySource::from_vector(bytes), block_codec),
+            std::runtime_error
+        );
+    }
+    SECTION("With another version") {
+        bytes[sizeof(std::uint64_t) + sizeof(std::uint32_t)] += 1;
+        REQUIRE_THROWS_AS(
+            pisa::BlockInvertedIndex(pisa::MemorySource::from_vector(bytes), block_codec),
+            std::runtime_error
+        );
+    }
 }
@@ -9,16 +9,23 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <iterator>
+#include <numeric>
 #include <random>
 #include <vector>
 
+/**
+ * Checks the operations of a cursor over the given postings, whose blocks have the sizes in
+ * `block_sizes`, or the block size of the codec but the last one if `block_sizes` is empty.
+ */
 void test_block_posting_list_ops(
     pisa::BlockCodec const* codec,
     uint8_t const* data,
     uint64_t n,
     uint64_t universe,
     std::vector<std::uint32_t> const& docs,
-    std::vector<std::uint32_t> const& freqs
+    std::vector<std::uint32_t> const& freqs,
+    std::vector<std::uint32_t> block_sizes = {}
 ) {
     pisa::BlockInvertedIndexCursor<> cursor(codec, data, universe, 0);
     REQUIRE(n == cursor.size());
@@ -39,6 +46,44 @@ void test_block_posting_list_ops(
     cursor.reset();
     cursor.next_geq(universe);
     REQUIRE(universe == cursor.docid());
+
+    std::vector<std::uint32_t> block_docs, block_freqs;
+    cursor.reset();
+    for (auto block = cursor.current_block(); !block.empty();
+         cursor.next_block(), block = cursor.current_block()) {
+        block_docs.insert(block_docs.end(), block.docids.begin(), block.docids.end());
+        block_freqs.insert(block_freqs.end(), block.freqs.begin(), block.freqs.end());
+    }
+    REQUIRE(block_docs == docs);
+    REQUIRE(block_freqs == freqs);
+    REQUIRE(universe == cursor.docid());
+
+    // A block starts at the current position, wherever the cursor is within the block.
+    if (block_sizes.empty()) {
+        auto block_size = codec->block_size();
+        for (size_t start = 0; start < n; start += block_size) {
+            block_sizes.push_back(std::min<std::uint64_t>(block_size, n - start));
+        }
+    }
+    REQUIRE(cursor.num_blocks() == block_sizes.size());
+    std::vector<std::uint64_t> block_ends;
+    std::partial_sum(block_sizes.begin(), block_sizes.end(), std::back_inserter(block_ends));
+    for (size_t i = 0; i < n; i += 7) {
+        cursor.reset();
+        cursor.next_geq(docs[i]);
+        auto block = cursor.current_block();
+        auto block_end = *std::upper_bound(block_ends.begin(), block_ends.end(), i);
+        REQUIRE(block.size() == block_end - i);
+        REQUIRE(std::equal(block.docids.begin(), block.docids.end(), docs.begin() + i));
+        REQUIRE(std::equal(block.freqs.begin(), block.freqs.end(), freqs.begin() + i));
+    }
+    for (size_t i = 0; i < n; i += 7) {
+        cursor.reset();
+        cursor.move(i);
+        REQUIRE(cursor.position() == i);
+        MY_REQUIRE_EQUAL(docs[i], cursor.docid(), "i = " << i << " size = " << n);
+        MY_REQUIRE_EQUAL(freqs[i], cursor.freq(), "i = " << i << " size = " << n);
+    }
 }
 
 void random_posting_data(
@@ -104,7 +149,12 @@ TEST_CASE("block_posting_list") {
         "block_varintgb",
         "block_simple8b",
         "block_simple16",
-        "block_simdbp"
+        "block_simdbp",
+        "block_simdbp256",
+        "block_simdbp512",
+        "block_simdpfor",
+        "block_simdpfor256",
+        "block_mixed"
     );
     CAPTURE(codec_name);
     auto codec = pisa::get_block_codec(codec_name);
@@ -122,9 +172,136 @@ TEST_CASE("block_posting_list_reordering") {
         "block_varintgb",
         "block_simple8b",
         "block_simple16",
-        "block_simdbp"
+        "block_simdbp",
+        "block_simdbp256",
+        "block_simdbp512",
+        "block_simdpfor",
+        "block_simdpfor256",
+        "block_mixed"
     );
     CAPTURE(codec_name);
     auto codec = pisa::get_block_codec(codec_name);
     test_block_posting_list_reordering(codec);
 }
+
+TEST_CASE("block_posting_list with constant frequency blocks") {
+    auto codec_name = GENERATE("block_interpolative", "block_varintgb", "block_simdbp", "block_mixed");
+    CAPTURE(codec_name);
+    auto codec = pisa::get_block_codec(codec_name);
+    auto block_size = codec->block_size();
+    uint64_t universe = 20000;
+    uint64_t n = 5000;
+
+    std::vector<std::uint32_t> docs, freqs;
+    random_posting_data(n, universe, docs, freqs);
+    // Blocks alternate between all ones, another constant, and random frequencies.
+    for (size_t pos = 0; pos < n; ++pos) {
+        switch ((pos / block_size) % 3) {
+        case 0: freqs[pos] = 1; break;
+        case 1: freqs[pos] = 7; break;
+        default: break;
+        }
+    }
+    std::vector<uint8_t> data;
+    pisa::index::block::write_posting_list(codec.get(), data, n, &docs[0], &freqs[0]);
+    test_block_posting_list_ops(codec.get(), data.data(), n, universe, docs, freqs);
+
+    pisa::BlockInvertedIndexCursor<> cursor(codec.get(), data.data(), universe, 0);
+    std::vector<std::uint32_t> block_freqs;
+    for (auto const& block: cursor.get_blocks()) {
+        REQUIRE(block.constant_freqs == (block.index % 3 != 2 || block.size == 1));
+        if (block.constant_freqs) {
+            REQUIRE(block.end - block.freqs_begin == 1);
+        }
+        block.decode_freqs(block_freqs);
+        for (size_t pos = 0; pos < block.size; ++pos) {
+            REQUIRE(block_freqs[pos] + 1 == freqs[block.index * block_size + pos]);
+        }
+    }
+}
+
+TEST_CASE("block_posting_list concatenation") {
+    auto codec_name =
+        GENERATE("block_interpolative", "block_varintgb", "block_simdbp", "block_mixed");
+    CAPTURE(codec_name);
+    auto codec = pisa::get_block_codec(codec_name);
+    std::uint32_t block_size = codec->block_size();
+    // Sizes of the lists to concatenate: aligned to blocks, or ending with a partial block.
+    auto sizes = GENERATE_COPY(
+        std::vector<std::uint32_t>{3 * block_size, block_size, 2 * block_size + 5},
+        std::vector<std::uint32_t>{2 * block_size + 5, 3 * block_size, 7},
+        std::vector<std::uint32_t>{block_size - 3, 3, 2 * block_size, 1},
+        std::vector<std::uint32_t>{5, 7, 3 * block_size + 1, 9, block_size + 11}
+    );
+    CAPTURE(sizes);
+    uint64_t part_universe = 5000;
+
+    std::vector<std::uint32_t> docs, freqs;
+    std::vector<std::vector<uint8_t>> parts;
+    pisa::index::block::PostingListConcatenator concatenator(codec.get());
+    std::uint32_t offset = 0;
+    for (auto size: sizes) {
+        std::vector<std::uint32_t> part_docs, part_freqs;
+        random_posting_data(size, part_universe, part_docs, part_freqs);
+        auto& data = parts.emplace_back();
+        pisa::index::block::write_posting_list(
+            codec.get(), data, size, part_docs.data(), part_freqs.data()
+        );
+        concatenator.append(
+            pisa::BlockInvertedIndexCursor<>(codec.get(), data.data(), part_universe, 0), offset
+        );
+        for (auto doc: part_docs) {
+            docs.push_back(doc + offset);
+        }
+        freqs.insert(freqs.end(), part_freqs.begin(), part_freqs.end());
+        offset += part_universe;
+    }
+    std::vector<uint8_t> concatenated;
+    concatenator.finish(concatenated);
+
+    // Full blocks are copied, unless their documents must be encoded again from a new base, and
+    // the postings of partial blocks are encoded together until they fill a block, or until the
+    // next full block.
+    std::vector<std::uint32_t> block_sizes;
+    std::uint32_t copied_blocks = 0;
+    std::uint32_t pending = 0;
+    std::int64_t last_doc = -1;
+    std::size_t appended = 0;
+    for (std::size_t part = 0; part < sizes.size(); ++part) {
+        auto size = sizes[part];
+        if (size >= block_size && pending > 0) {
+            block_sizes.push_back(pending);
+            pending = 0;
+        }
+        if (size >= block_size) {
+            auto base = static_cast<std::int64_t>(part * part_universe) - 1;
+            copied_blocks += size / block_size - (last_doc == base ? 0 : 1);
+        }
+        appended += size;
+        last_doc = docs[appended - 1];
+        block_sizes.insert(block_sizes.end(), size / block_size, block_size);
+        pending += size % block_size;
+        if (pending >= block_size) {
+            block_sizes.push_back(block_size);
+            pending -= block_size;
+        }
+    }
+    if (pending > 0) {
+        block_sizes.push_back(pending);
+    }
+    test_block_posting_list_ops(
+        codec.get(), concatenated.data(), docs.size(), offset, docs, freqs, block_sizes
+    );
+    REQUIRE(concatenator.copied_blocks() == copied_blocks);
+    REQUIRE(concatenator.copied_blocks() + concatenator.encoded_blocks() == block_sizes.size());
+
+    if (std::all_of(block_sizes.begin(), block_sizes.end() - 1, [&](auto size) {
+            return size == block_size;
+        })) {
+        std::vector<uint8_t> expected;
+        pisa::index::block::write_posting_list(
+            codec.get(), expected, docs.size(), docs.data(), freqs.data()
+        );
+        REQUIRE(concatenated == expected);
+    }
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <stack>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #define _STRINGIZE_I(x) #x
@@ -21,3 +25,10 @@ inline std::vector<bool> random_bit_vector(size_t n = 10000, double density = 0.
     }
     return v;
 }
+
+/** Returns the contents of the file at `path`, e.g., to compare outputs byte for byte. */
+inline auto read_file(std::filesystem::path const& path) -> std::string
+{
+    std::ifstream is(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
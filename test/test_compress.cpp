@@ -1,19 +1,27 @@
 #define CATCH_CONFIG_MAIN
 #include "catch2/catch.hpp"
 
+#include <filesystem>
 #include <fstream>
 #include <memory>
+#include <numeric>
+#include <string>
 
 #include <fmt/format.h>
 
+#include "binary_freq_collection.hpp"
 #include "forward_index_builder.hpp"
+#include "index_types.hpp"
 #include "invert.hpp"
 #include "parser.hpp"
 #include "pisa/compress.hpp"
+#include "pisa/posting_list_pipeline.hpp"
 #include "pisa/scorer/scorer.hpp"
 #include "pisa/wand_data.hpp"
 #include "pisa_config.hpp"
+#include "reorder_docids.hpp"
 #include "temporary_directory.hpp"
+#include "test_common.hpp"
 #include "text_analyzer.hpp"
 #include "token_filter.hpp"
 #include "tokenizer.hpp"
@@ -45,6 +53,7 @@ TEST_CASE("Compress index", "[index][compress]") {
         "single",
         "pefuniform",
         "pefopt",
+        "hybrid",
         "block_optpfor",
         "block_varintg8iu",
         "block_streamvbyte",
@@ -54,7 +63,8 @@ TEST_CASE("Compress index", "[index][compress]") {
         "block_qmx",
         "block_simple8b",
         "block_simple16",
-        "block_simdbp"
+        "block_simdbp",
+        "block_mixed"
     );
     CAPTURE(encoding);
     bool in_memory = GENERATE(true, false);
@@ -67,6 +77,7 @@ TEST_CASE("Compress index", "[index][compress]") {
         (tmp.path() / encoding).string(),
         ScorerParams(""),  // no scorer
         std::nullopt,  // no quantization
+        pisa::MixedEncodingOptions{},
         true,  // check=true
         in_memory
     );
@@ -98,6 +109,7 @@ TEST_CASE("Compress quantized index", "[index][compress]") {
         "single",
         "pefuniform",
         "pefopt",
+        "hybrid",
         "block_optpfor",
         "block_varintg8iu",
         "block_streamvbyte",
@@ -107,7 +119,8 @@ TEST_CASE("Compress quantized index", "[index][compress]") {
         "block_qmx",
         "block_simple8b",
         "block_simple16",
-        "block_simdbp"
+        "block_simdbp",
+        "block_mixed"
     );
     CAPTURE(encoding);
     bool in_memory = GENERATE(true, false);
@@ -120,7 +133,275 @@ TEST_CASE("Compress quantized index", "[index][compress]") {
         (tmp.path() / encoding).string(),
         scorer_params,
         pisa::Size(8),
+        pisa::MixedEncodingOptions{},
         true,  // check=true
         in_memory
     );
 }
+
+TEST_CASE("Compress mixed index weighted by term accesses", "[index][compress]") {
+    pisa::TemporaryDirectory tmp;
+    build_index(tmp);
+
+    bool in_memory = GENERATE(true, false);
+    CAPTURE(in_memory);
+
+    pisa::MixedEncodingOptions options{
+        .time_weight = 2.0,
+        .term_accesses = std::vector<std::uint64_t>{0, 3, 1},
+    };
+    pisa::compress(
+        tmp.path() / "tiny.inv",
+        std::nullopt,  // no wand
+        "block_mixed",
+        (tmp.path() / "block_mixed").string(),
+        ScorerParams(""),  // no scorer
+        std::nullopt,  // no quantization
+        options,
+        true,  // check=true
+        in_memory
+    );
+
+    SECTION("Mixed options require block_mixed") {
+        REQUIRE_THROWS_AS(
+            pisa::compress(
+                tmp.path() / "tiny.inv",
+                std::nullopt,  // no wand
+                "block_simdbp",
+                (tmp.path() / "block_simdbp").string(),
+                ScorerParams(""),  // no scorer
+                std::nullopt,  // no quantization
+                options,
+                false,  // check=false
+                in_memory
+            ),
+            std::invalid_argument
+        );
+    }
+
+    SECTION("There must be one decoding time per candidate codec") {
+        options.decode_ns = std::vector<double>{1.0};
+        REQUIRE_THROWS_AS(
+            pisa::compress(
+                tmp.path() / "tiny.inv",
+                std::nullopt,  // no wand
+                "block_mixed",
+                (tmp.path() / "block_mixed").string(),
+                ScorerParams(""),  // no scorer
+                std::nullopt,  // no quantization
+                options,
+                false,  // check=false
+                in_memory
+            ),
+            std::invalid_argument
+        );
+    }
+}
+
+TEST_CASE("Posting lists encoded concurrently are appended in term order", "[index][compress]") {
+    pisa::TemporaryDirectory tmp;
+    build_index(tmp);
+    pisa::binary_freq_collection input((tmp.path() / "tiny.inv").c_str());
+    pisa::global_parameters params;
+
+    {
+        pisa::pefopt_index::builder builder(input.num_docs(), params);
+        for (auto const& plist: input) {
+            auto freqs_sum =
+                std::accumulate(plist.freqs.begin(), plist.freqs.end(), std::uint64_t(0));
+            builder.add_posting_list(
+                plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum
+            );
+        }
+        pisa::pefopt_index index;
+        builder.build(index);
+        pisa::mapper::freeze(index, (tmp.path() / "sequential").c_str());
+    }
+
+    pisa::PostingListPipelineParams pipeline_params{
+        .chunk_postings = GENERATE(std::size_t(1), std::size_t(100), std::size_t(1) << 20U),
+        .max_chunks = GENERATE(std::size_t(1), std::size_t(3), std::size_t(0)),
+    };
+    CAPTURE(pipeline_params.chunk_postings);
+    CAPTURE(pipeline_params.max_chunks);
+    {
+        pisa::pefopt_index::builder builder(input.num_docs(), params);
+        std::size_t next_term = 0;
+        pisa::encode_posting_lists(
+            input,
+            [&](std::size_t, auto const& plist) {
+                auto freqs_sum =
+                    std::accumulate(plist.freqs.begin(), plist.freqs.end(), std::uint64_t(0));
+                return builder.encode_posting_list(
+                    plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum
+                );
+            },
+            [&](std::size_t term_id, auto const&, auto const& encoded) {
+                REQUIRE(term_id == next_term++);
+                builder.append_posting_list(encoded);
+            },
+            pipeline_params
+        );
+        REQUIRE(next_term == input.size());
+        pisa::pefopt_index index;
+        builder.build(index);
+        pisa::mapper::freeze(index, (tmp.path() / "pipelined").c_str());
+    }
+
+    REQUIRE(read_file(tmp.path() / "pipelined") == read_file(tmp.path() / "sequential"));
+}
+
+TEST_CASE("Index inverted and compressed in a single pass", "[index][compress]") {
+    pisa::TemporaryDirectory tmp;
+    build_index(tmp);
+    auto fwd_path = (tmp.path() / "tiny.fwd").string();
+    auto inv_path = (tmp.path() / "tiny.inv").string();
+
+    std::string encoding = GENERATE("ef", "pefopt", "block_simdbp", "block_mixed");
+    CAPTURE(encoding);
+    bool range = GENERATE(false, true);
+    bool compress = GENERATE(false, true);
+    CAPTURE(range);
+    CAPTURE(compress);
+    auto scorer_params = ScorerParams("bm25");
+    std::optional<pisa::Size> quantization_bits =
+        compress ? std::optional(pisa::Size(8)) : std::nullopt;
+
+    pisa::compress(
+        inv_path,
+        std::nullopt,  // no wand
+        encoding,
+        (tmp.path() / "expected").string(),
+        ScorerParams(""),  // no scorer
+        std::nullopt,  // no quantization
+        pisa::MixedEncodingOptions{},
+        false,  // check=false
+        false  // in_memory=false
+    );
+    pisa::create_wand_data(
+        (tmp.path() / "expected.wand").string(),
+        inv_path,
+        pisa::FixedBlock(64),
+        scorer_params,
+        range,
+        compress,
+        quantization_bits,
+        std::unordered_set<std::size_t>()
+    );
+
+    pisa::invert::InvertParams params;
+    params.batch_size = GENERATE(std::size_t(1), std::size_t(3), std::size_t(100'000));
+    CAPTURE(params.batch_size);
+    pisa::invert_and_compress(
+        fwd_path,
+        encoding,
+        (tmp.path() / "fused").string(),
+        params,
+        pisa::WandDataOptions{
+            .output = (tmp.path() / "fused.wand").string(),
+            .block_size = pisa::FixedBlock(64),
+            .scorer_params = scorer_params,
+            .range = range,
+            .compress = compress,
+            .quantization_bits = quantization_bits,
+        }
+    );
+
+    REQUIRE(read_file(tmp.path() / "fused") == read_file(tmp.path() / "expected"));
+    REQUIRE(read_file(tmp.path() / "fused.wand") == read_file(tmp.path() / "expected.wand"));
+    // Temporary directories, with the batches in particular, are removed.
+    for (auto const& entry: std::filesystem::directory_iterator(tmp.path())) {
+        REQUIRE(entry.is_regular_file());
+    }
+}
+
+TEST_CASE("Index transcoded to another encoding", "[index][compress]") {
+    pisa::TemporaryDirectory tmp;
+    build_index(tmp);
+    auto inv_path = (tmp.path() / "tiny.inv").string();
+    auto input_path = (tmp.path() / "input").string();
+    auto expected_path = (tmp.path() / "expected").string();
+    auto output_path = (tmp.path() / "output").string();
+    auto scorer_params = ScorerParams("bm25");
+
+    auto compress_collection = [&](std::string const& basename,
+                                   std::string const& encoding,
+                                   std::string const& output,
+                                   std::unordered_set<std::size_t> const& terms_to_drop) {
+        pisa::compress(
+            basename,
+            std::nullopt,  // no wand
+            encoding,
+            output,
+            ScorerParams(""),  // no scorer
+            std::nullopt,  // no quantization
+            pisa::MixedEncodingOptions{},
+            false,  // check=false
+            false  // in_memory=false
+        );
+        pisa::create_wand_data(
+            output + ".wand",
+            basename,
+            pisa::FixedBlock(64),
+            scorer_params,
+            false,  // range=false
+            false,  // compress=false
+            std::nullopt,  // no quantization
+            terms_to_drop
+        );
+    };
+
+    std::string input_encoding = GENERATE("pefopt", "block_varintgb");
+    std::string output_encoding = GENERATE("ef", "block_simdbp");
+    bool reorder = GENERATE(false, true);
+    // Without the statistics of dropped terms, the statistics are counted from the input index.
+    bool drop_terms = GENERATE(false, true);
+    CAPTURE(input_encoding);
+    CAPTURE(output_encoding);
+    CAPTURE(reorder);
+    CAPTURE(drop_terms);
+    compress_collection(
+        inv_path,
+        input_encoding,
+        input_path,
+        drop_terms ? std::unordered_set<std::size_t>{0, 3} : std::unordered_set<std::size_t>{}
+    );
+
+    pisa::TranscodeOptions options{
+        .input_wand_data = input_path + ".wand",
+        .wand_options =
+            pisa::WandDataOptions{
+                .output = output_path + ".wand",
+                .block_size = pisa::FixedBlock(64),
+                .scorer_params = scorer_params,
+            },
+        .check = true,
+    };
+    auto expected_basename = inv_path;
+    if (reorder) {
+        pisa::binary_freq_collection collection(inv_path.c_str());
+        std::vector<std::uint32_t> mapping(collection.num_docs());
+        std::iota(mapping.rbegin(), mapping.rend(), 0U);
+        expected_basename = (tmp.path() / "reordered").string();
+        pisa::reorder_from_mapping(
+            collection,
+            pisa::binary_collection(fmt::format("{}.sizes", inv_path).c_str()),
+            pisa::ReorderOptions{.input_basename = inv_path, .output_basename = expected_basename},
+            mapping
+        );
+        options.mapping = mapping;
+    }
+    compress_collection(expected_basename, output_encoding, expected_path, {});
+
+    pisa::transcode_index(input_path, input_encoding, output_path, output_encoding, options);
+    REQUIRE(read_file(output_path) == read_file(expected_path));
+    REQUIRE(read_file(output_path + ".wand") == read_file(expected_path + ".wand"));
+
+    // Mappings that are not permutations are rejected.
+    auto num_docs = pisa::binary_freq_collection(inv_path.c_str()).num_docs();
+    options.mapping = std::vector<std::uint32_t>(num_docs, 0);
+    REQUIRE_THROWS_AS(
+        pisa::transcode_index(input_path, input_encoding, output_path, output_encoding, options),
+        std::invalid_argument
+    );
+}
@@ -0,0 +1,209 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/filtered_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "document_filter.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm/block_max_maxscore_query.hpp"
+#include "query/algorithm/block_max_wand_query.hpp"
+#include "query/algorithm/maxscore_query.hpp"
+#include "query/algorithm/ranked_or_query.hpp"
+#include "query/algorithm/wand_query.hpp"
+#include "query/query_parser.hpp"
+#include "scorer/scorer.hpp"
+#include "temporary_directory.hpp"
+#include "text_analyzer.hpp"
+#include "tokenizer.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+namespace {
+
+struct IndexData {
+    IndexData()
+        : collection(PISA_SOURCE_DIR "/test/test_data/test_collection"),
+          document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes"),
+          wdata(
+              document_sizes.begin()->begin(),
+              collection.num_docs(),
+              collection,
+              ScorerParams("bm25"),
+              BlockSize(FixedBlock(5)),
+              std::nullopt,
+              {}
+          ) {
+        single_index::builder builder(collection.num_docs(), global_parameters{});
+        for (auto const& plist: collection) {
+            auto freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+            builder.add_posting_list(
+                plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum
+            );
+        }
+        builder.build(index);
+
+        QueryParser parser(
+            TextAnalyzer(std::make_unique<WhitespaceTokenizer>()), std::make_unique<IntMap>()
+        );
+        std::ifstream qfile(PISA_SOURCE_DIR "/test/test_data/queries");
+        io::for_each_line(qfile, [&](std::string const& line) {
+            queries.push_back(parser.parse(line));
+        });
+    }
+
+    [[nodiscard]] static auto get() -> IndexData const& {
+        static IndexData data;
+        return data;
+    }
+
+    binary_freq_collection collection;
+    binary_collection document_sizes;
+    single_index index;
+    std::vector<Query> queries;
+    wand_data<wand_data_raw> wdata;
+};
+
+}  // namespace
+
+TEST_CASE("Document filter", "[filter][unit]") {
+    DocumentFilter filter(200, {{3, 4}, {10, 150}, {190, 200}});
+
+    REQUIRE(filter.size() == 200);
+    REQUIRE(filter.count() == 151);
+    REQUIRE_FALSE(filter.filtered(2));
+    REQUIRE(filter.filtered(3));
+    REQUIRE(filter.filtered(64));
+    REQUIRE_FALSE(filter.filtered(150));
+    REQUIRE(filter.filtered(199));
+    REQUIRE_FALSE(filter.filtered(200));
+
+    REQUIRE(filter.next_accepted(0) == 0);
+    REQUIRE(filter.next_accepted(3) == 4);
+    REQUIRE(filter.next_accepted(10) == 150);
+    REQUIRE(filter.next_accepted(127) == 150);
+    REQUIRE(filter.next_accepted(190) == 200);
+    REQUIRE(filter.next_accepted(250) == 250);
+
+    REQUIRE(DocumentFilter().next_accepted(5) == 5);
+    REQUIRE_FALSE(DocumentFilter().filtered(5));
+    REQUIRE_THROWS_AS(DocumentFilter(10, {{5, 11}}), std::invalid_argument);
+
+    SECTION("Write and map") {
+        TemporaryDirectory tmp;
+        auto path = (tmp.path() / "filter").string();
+        filter.write(path);
+        DocumentFilter mapped(MemorySource::mapped_file(path));
+        REQUIRE(mapped.size() == 200);
+        REQUIRE(mapped.count() == 151);
+        for (std::uint32_t docid = 0; docid < 200; ++docid) {
+            REQUIRE(mapped.filtered(docid) == filter.filtered(docid));
+        }
+    }
+
+    SECTION("Read ranges") {
+        std::istringstream is("1\n5 8\n 13  21 \n");
+        REQUIRE(
+            read_document_ranges(is)
+            == std::vector<std::pair<std::uint32_t, std::uint32_t>>{{1, 2}, {5, 8}, {13, 21}}
+        );
+        std::istringstream invalid_id("1\nfoo\n");
+        REQUIRE_THROWS_AS(read_document_ranges(invalid_id), std::invalid_argument);
+        std::istringstream invalid_range("1 2 3\n");
+        REQUIRE_THROWS_AS(read_document_ranges(invalid_range), std::invalid_argument);
+    }
+}
+
+TEMPLATE_TEST_CASE(
+    "Filtered documents never enter the top-k results",
+    "[filter][query][integration]",
+    wand_query,
+    maxscore_query,
+    block_max_wand_query,
+    block_max_maxscore_query,
+    ranked_or_query
+) {
+    auto const& data = IndexData::get();
+    auto num_docs = static_cast<std::uint32_t>(data.index.num_docs());
+    // Every third document, and a long run of documents spanning many posting blocks.
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges{{num_docs / 4, num_docs / 2}};
+    for (std::uint32_t docid = 0; docid < num_docs; docid += 3) {
+        ranges.emplace_back(docid, docid + 1);
+    }
+    DocumentFilter filter(num_docs, ranges);
+    auto scorer = scorer::from_params(ScorerParams("bm25"), data.wdata);
+
+    for (auto const& query: data.queries) {
+        topk_queue topk(10);
+        TestType algorithm(topk);
+        algorithm(
+            filter_cursors(
+                make_block_max_scored_cursors(data.index, data.wdata, *scorer, query), filter
+            ),
+            num_docs
+        );
+        topk.finalize();
+
+        // Exhaustive evaluation, with the filtered documents removed afterwards.
+        topk_queue all(num_docs);
+        ranked_or_query ranked_or(all);
+        ranked_or(make_scored_cursors(data.index, *scorer, query), num_docs);
+        all.finalize();
+        std::vector<float> expected;
+        for (auto const& [score, docid]: all.topk()) {
+            if (!filter.filtered(docid) && expected.size() < 10) {
+                expected.push_back(score);
+            }
+        }
+
+        REQUIRE(topk.topk().size() == expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE_FALSE(filter.filtered(topk.topk()[i].second));
+            REQUIRE(topk.topk()[i].first == Approx(expected[i]).epsilon(0.1));
+        }
+    }
+}
+
+TEST_CASE("Blocks of filtered documents have zero block-max scores", "[filter][unit]") {
+    auto const& data = IndexData::get();
+    auto num_docs = static_cast<std::uint32_t>(data.index.num_docs());
+    std::uint32_t first = num_docs / 4;
+    std::uint32_t last = num_docs / 2;
+    DocumentFilter filter(num_docs, {{first, last}});
+    auto scorer = scorer::from_params(ScorerParams("bm25"), data.wdata);
+
+    std::size_t zeroed = 0;
+    for (auto const& query: data.queries) {
+        auto filtered = filter_cursors(
+            make_block_max_scored_cursors(data.index, data.wdata, *scorer, query), filter
+        );
+        auto cursors = make_block_max_scored_cursors(data.index, data.wdata, *scorer, query);
+        for (std::size_t term = 0; term < cursors.size(); ++term) {
+            for (std::uint32_t docid = 0; docid < num_docs; docid += 7) {
+                CAPTURE(docid);
+                filtered[term].block_max_next_geq(docid);
+                cursors[term].block_max_next_geq(docid);
+                REQUIRE(filtered[term].block_max_docid() == cursors[term].block_max_docid());
+                // Past the end of a list, its last block has no document left either.
+                auto block_end = cursors[term].block_max_docid();
+                if ((docid >= first && block_end < last) || block_end < docid) {
+                    REQUIRE(filtered[term].block_max_score() == 0.0F);
+                    ++zeroed;
+                } else {
+                    REQUIRE(filtered[term].block_max_score() == cursors[term].block_max_score());
+                }
+            }
+        }
+    }
+    REQUIRE(zeroed > 0);
+}
@@ -3,20 +3,25 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <fstream>
 #include <numeric>
+#include <string>
 #include <vector>
 
 #include "test_generic_sequence.hpp"
 
+#include "bitvector_collection.hpp"
 #include "freq_index.hpp"
 #include "mappable/mapper.hpp"
 #include "memory_source.hpp"
 #include "mio/mmap.hpp"
+#include "sequence/hybrid_sequence.hpp"
 #include "sequence/indexed_sequence.hpp"
 #include "sequence/partitioned_sequence.hpp"
 #include "sequence/positive_sequence.hpp"
 #include "sequence/uniform_partitioned_sequence.hpp"
 #include "temporary_directory.hpp"
+#include "test_common.hpp"
 
 template <typename DocsSequence, typename FreqsSequence>
 void test_freq_index() {
@@ -28,6 +33,9 @@ void test_freq_index() {
     using collection_type = pisa::freq_index<DocsSequence, FreqsSequence>;
     typename collection_type::builder b(universe, params);
 
+    auto stream_path = (tmpdir.path() / "coll.stream.bin").string();
+    typename collection_type::stream_builder sb(universe, params, tmpdir.path());
+
     using vec_type = std::vector<uint64_t>;
     std::vector<std::pair<vec_type, vec_type>> posting_lists(30);
     for (auto& plist: posting_lists) {
@@ -39,6 +47,7 @@ void test_freq_index() {
         uint64_t freqs_sum = std::accumulate(plist.second.begin(), plist.second.end(), uint64_t(0));
 
         b.add_posting_list(n, plist.first.begin(), plist.second.begin(), freqs_sum);
+        sb.add_posting_list(n, plist.first.begin(), plist.second.begin(), freqs_sum);
     }
 
     {
@@ -46,6 +55,8 @@ void test_freq_index() {
         b.build(coll);
         pisa::mapper::freeze(coll, idx_path.c_str());
     }
+    sb.build(stream_path);
+    REQUIRE(read_file(stream_path) == read_file(idx_path));
 
     {
         collection_type coll(pisa::MemorySource::mapped_file(idx_path));
@@ -58,11 +69,24 @@ void test_freq_index() {
                 MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(), "i = " << i << " p = " << p);
             }
             REQUIRE(coll.num_docs() == doc_enum.docid());
+
+            vec_type block_docs;
+            vec_type block_freqs;
+            doc_enum.reset();
+            for (auto block = doc_enum.current_block(); !block.empty();
+                 doc_enum.next_block(), block = doc_enum.current_block()) {
+                block_docs.insert(block_docs.end(), block.docids.begin(), block.docids.end());
+                block_freqs.insert(block_freqs.end(), block.freqs.begin(), block.freqs.end());
+            }
+            REQUIRE(block_docs == plist.first);
+            REQUIRE(block_freqs == plist.second);
+            REQUIRE(coll.num_docs() == doc_enum.docid());
         }
     }
 }
 
 TEST_CASE("freq_index") {
+    using pisa::hybrid_sequence;
     using pisa::indexed_sequence;
     using pisa::partitioned_sequence;
     using pisa::positive_sequence;
@@ -72,7 +96,49 @@ TEST_CASE("freq_index") {
     test_freq_index<indexed_sequence, positive_sequence<>>();
 
     test_freq_index<partitioned_sequence<>, positive_sequence<partitioned_sequence<strict_sequence>>>();
+    test_freq_index<
+        partitioned_sequence<hybrid_sequence>,
+        positive_sequence<partitioned_sequence<strict_sequence>>>();
     test_freq_index<
         uniform_partitioned_sequence<>,
         positive_sequence<uniform_partitioned_sequence<strict_sequence>>>();
 }
+
+TEST_CASE("bitvector_collection stream_builder") {
+    pisa::TemporaryDirectory tmpdir;
+    auto expected_path = (tmpdir.path() / "expected").string();
+    auto stream_path = (tmpdir.path() / "stream").string();
+    std::uint64_t spill_bits = GENERATE(
+        std::uint64_t(1),
+        std::uint64_t(64),
+        std::uint64_t(100),
+        pisa::bitvector_collection::stream_builder::default_spill_bits
+    );
+    CAPTURE(spill_bits);
+
+    pisa::global_parameters params;
+    pisa::bitvector_collection::builder builder(params);
+    pisa::bitvector_collection::stream_builder stream_builder(
+        params, tmpdir.path() / "spilled", spill_bits
+    );
+    for (int idx = 0; idx < 100; ++idx) {
+        pisa::bit_vector_builder bvb;
+        auto len = rand() % 200;
+        for (int pos = 0; pos < len; ++pos) {
+            bvb.push_back(rand() % 2 == 0);
+        }
+        builder.append(bvb);
+        stream_builder.append(bvb);
+    }
+
+    pisa::bitvector_collection coll;
+    builder.build(coll);
+    pisa::mapper::freeze(coll, expected_path.c_str());
+    {
+        std::ofstream os(stream_path, std::ios::binary);
+        pisa::mapper::detail::freeze_visitor freezer(os, 0);
+        stream_builder.write(freezer, os);
+    }
+    REQUIRE(read_file(stream_path) == read_file(expected_path));
+    REQUIRE_FALSE(std::filesystem::exists(tmpdir.path() / "spilled"));
+}
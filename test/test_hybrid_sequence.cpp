@@ -0,0 +1,108 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "codec/compact_run_sequence.hpp"
+#include "sequence/hybrid_sequence.hpp"
+#include "sequence/partitioned_sequence.hpp"
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+// Returns a strictly increasing sequence made of runs of consecutive values, with random gaps
+// between them.
+std::vector<uint64_t> random_runs(uint64_t n, uint64_t max_run, uint64_t max_gap) {
+    srand(42);
+    std::vector<uint64_t> seq;
+    uint64_t value = rand() % max_gap;
+    while (seq.size() < n) {
+        uint64_t run = 1 + rand() % max_run;
+        for (uint64_t i = 0; i < run && seq.size() < n; ++i) {
+            seq.push_back(value++);
+        }
+        value += 1 + rand() % max_gap;
+    }
+    return seq;
+}
+
+TEST_CASE("compact_run_sequence") {
+    pisa::global_parameters params;
+
+    std::vector<uint64_t> short_seq;
+    short_seq.push_back(0);
+    test_sequence(pisa::compact_run_sequence(), params, 1, short_seq);
+    short_seq[0] = 1;
+    test_sequence(pisa::compact_run_sequence(), params, 2, short_seq);
+
+    for (uint64_t max_run: {1, 2, 10, 1000}) {
+        for (uint64_t max_gap: {1, 5, 100}) {
+            auto seq = random_runs(10000, max_run, max_gap);
+            test_sequence(pisa::compact_run_sequence(), params, seq.back() + 1, seq);
+            test_sequence(pisa::compact_run_sequence(), params, seq.back() + 20, seq);
+        }
+    }
+}
+
+TEST_CASE("hybrid_sequence") {
+    pisa::global_parameters params;
+    using pisa::hybrid_sequence;
+
+    std::vector<double> avg_gaps = {1.1, 1.9, 2.5, 3, 4, 5, 10};
+    for (auto avg_gap: avg_gaps) {
+        uint64_t n = 10000;
+        auto universe = uint64_t(n * avg_gap);
+        auto seq = random_sequence(universe, n, true);
+
+        test_sequence(hybrid_sequence(), params, universe, seq);
+        test_sequence(pisa::partitioned_sequence<hybrid_sequence>(), params, universe, seq);
+    }
+
+    for (uint64_t max_run: {10, 1000}) {
+        auto seq = random_runs(10000, max_run, 10);
+        uint64_t universe = seq.back() + 1;
+        test_sequence(hybrid_sequence(), params, universe, seq);
+        test_sequence(pisa::partitioned_sequence<hybrid_sequence>(), params, universe, seq);
+    }
+}
+
+TEST_CASE("hybrid_sequence chooses the smallest container") {
+    pisa::global_parameters params;
+    using pisa::hybrid_sequence;
+
+    auto encoded_type = [&](std::vector<uint64_t> const& seq) {
+        pisa::bit_vector_builder bvb;
+        uint64_t universe = seq.back() + 1;
+        hybrid_sequence::write(bvb, seq.begin(), universe, seq.size(), params);
+        bvb.append_bits(0, 64);
+        pisa::bit_vector bv(&bvb);
+        return hybrid_sequence::enumerator(bv, 0, universe, seq.size(), params).type();
+    };
+
+    std::vector<uint64_t> all_ones(1000);
+    std::iota(all_ones.begin(), all_ones.end(), 0);
+    REQUIRE(encoded_type(all_ones) == hybrid_sequence::all_ones);
+    REQUIRE(encoded_type(random_runs(10000, 1000, 10)) == hybrid_sequence::runs);
+    REQUIRE(encoded_type(random_sequence(20000, 10000, true)) == hybrid_sequence::ranked_bitvector);
+    REQUIRE(encoded_type(random_sequence(1000000, 1000, true)) == hybrid_sequence::elias_fano);
+}
+
+TEST_CASE("partitioned hybrid_sequence accounts for the run container") {
+    pisa::global_parameters params;
+    using pisa::hybrid_sequence;
+
+    auto encoded_size = [&]<typename Sequence>(Sequence, std::vector<uint64_t> const& seq) {
+        pisa::bit_vector_builder bvb;
+        Sequence::write(bvb, seq.begin(), seq.back() + 1, seq.size(), params);
+        return bvb.size();
+    };
+
+    // Long runs are encoded best with the run container, so partitioning must not split them into
+    // partitions encoded with the other containers.
+    for (uint64_t max_run: {100, 512, 1000}) {
+        auto seq = random_runs(100000, max_run, 64);
+        auto single = encoded_size(hybrid_sequence(), seq);
+        auto partitioned = encoded_size(pisa::partitioned_sequence<hybrid_sequence>(), seq);
+        CHECK(partitioned < single + single / 2);
+    }
+}
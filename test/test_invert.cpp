@@ -260,6 +260,79 @@ TEST_CASE("Invert a range of documents from a collection", "[invert][unit]") {
     REQUIRE(index.document_sizes == expected.document_sizes);
 }
 
+TEST_CASE("Invert a range of documents into flat arrays", "[invert][unit]") {
+    std::vector<std::vector<Term_Id>> collection = {
+        /* Doc 0 */ {2_t, 0_t, 3_t, 9_t, 0_t},
+        /* Doc 1 */ {5_t, 0_t, 3_t, 4_t, 2_t, 6_t, 7_t, 4_t, 5_t},
+        /* Doc 2 */ {5_t, 1_t, 8_t, 9_t, 8_t, 8_t},
+        /* Doc 3 */ {8_t, 5_t, 9_t},
+        /* Doc 4 */ {8_t, 6_t, 9_t, 6_t, 6_t, 5_t, 4_t, 3_t, 1_t, 0_t, 6_t}
+    };
+    std::vector<std::span<Term_Id const>> document_range;
+    std::transform(
+        collection.begin(), collection.end(), std::back_inserter(document_range), [](auto const& vec) {
+            return std::span<Term_Id const>(vec);
+        }
+    );
+
+    SECTION("Postings are the same as with hash maps") {
+        size_t threads = GENERATE(1, 2, 3, 7);
+        std::uint32_t term_count = GENERATE(10, 12);
+        auto index = invert::invert_range_flat(document_range, 10_d, term_count, threads);
+        auto expected = invert::invert_range(document_range, 10_d, 1);
+        REQUIRE(index.offsets.size() == term_count + 1);
+        REQUIRE(index.offsets.front() == 0);
+        REQUIRE(index.offsets.back() == index.documents.size());
+        REQUIRE(index.frequencies.size() == index.documents.size());
+        for (auto term: ranges::views::iota(std::uint32_t(0), term_count)) {
+            std::vector<Document_Id> documents(
+                index.documents.begin() + index.offsets[term],
+                index.documents.begin() + index.offsets[term + 1]
+            );
+            std::vector<Frequency> frequencies(
+                index.frequencies.begin() + index.offsets[term],
+                index.frequencies.begin() + index.offsets[term + 1]
+            );
+            auto pos = expected.documents.find(Term_Id(term));
+            if (pos == expected.documents.end()) {
+                REQUIRE(documents.empty());
+            } else {
+                REQUIRE(documents == pos->second);
+                REQUIRE(frequencies == expected.frequencies.at(Term_Id(term)));
+            }
+        }
+        REQUIRE(index.document_sizes == std::vector<std::uint32_t>{5, 9, 6, 3, 11});
+    }
+
+    SECTION("Postings are sorted with several radix passes") {
+        auto low = Term_Id(1 << 11);
+        auto high = Term_Id((1 << 12) + 1);
+        std::vector<std::vector<Term_Id>> large_collection = {
+            {high, 3_t, low, 3_t}, {low, high + 1}, {3_t, high}
+        };
+        std::vector<std::span<Term_Id const>> large_range(
+            large_collection.begin(), large_collection.end()
+        );
+        auto index = invert::invert_range_flat(large_range, 0_d, 1 << 13, 2);
+        REQUIRE(index.documents == std::vector<Document_Id>{0_d, 2_d, 0_d, 1_d, 0_d, 2_d, 1_d});
+        REQUIRE(index.frequencies == std::vector<Frequency>{2_f, 1_f, 1_f, 1_f, 1_f, 1_f, 1_f});
+        REQUIRE(index.offsets[3] == 0);
+        REQUIRE(index.offsets[4] == 2);
+        REQUIRE(index.offsets[low.as_int()] == 2);
+        REQUIRE(index.offsets[low.as_int() + 1] == 4);
+        REQUIRE(index.offsets[high.as_int()] == 4);
+        REQUIRE(index.offsets[high.as_int() + 1] == 6);
+        REQUIRE(index.offsets[high.as_int() + 2] == 7);
+        REQUIRE(index.offsets.back() == 7);
+    }
+
+    SECTION("Throws when a term is out of range") {
+        REQUIRE_THROWS_AS(
+            invert::invert_range_flat(document_range, 0_d, 9, 2), std::out_of_range
+        );
+    }
+}
+
 TEST_CASE("Invert collection", "[invert][unit]") {
     GIVEN("A binary collection") {
         pisa::TemporaryDirectory tmpdir;
@@ -269,6 +342,14 @@ TEST_CASE("Invert collection", "[invert][unit]") {
         params.batch_size = batch_size;
         params.num_threads = threads;
         bool with_lex = GENERATE(false, true);
+        // Budgets of one document at a time, of a few documents, and of the entire collection.
+        std::optional<std::size_t> memory_budget = GENERATE(
+            std::optional<std::size_t>{},
+            std::optional<std::size_t>{100},
+            std::optional<std::size_t>{600},
+            std::optional<std::size_t>{1'000'000}
+        );
+        params.memory_budget = memory_budget;
         auto collection_filename = (tmpdir.path() / "fwd").string();
         {
             std::vector<uint32_t> collection_data{
@@ -290,7 +371,11 @@ TEST_CASE("Invert collection", "[invert][unit]") {
                     .to_file((tmpdir.path() / "fwd.termlex").string());
             }
         }
-        WHEN("Run inverting with batch size " << batch_size << " and " << threads << " threads") {
+        WHEN(
+            "Run inverting with batch size " << batch_size << ", memory budget "
+                                              << memory_budget.value_or(0) << " and " << threads
+                                              << " threads"
+        ) {
             auto index_basename = (tmpdir.path() / "idx").string();
             if (not with_lex) {
                 params.term_count = 10;
@@ -353,3 +438,46 @@ TEST_CASE("Invert collection", "[invert][unit]") {
         }
     }
 }
+
+TEST_CASE("Invert collection to VByte binary collections", "[invert][unit]") {
+    pisa::TemporaryDirectory tmpdir;
+    auto collection_filename = (tmpdir.path() / "fwd").string();
+    {
+        std::vector<uint32_t> collection_data{
+            /* size */ 1,  /* count */ 5,
+            /* size */ 5,  /* Doc 0 */ 2, 0, 3, 9, 0,
+            /* size */ 9,  /* Doc 1 */ 5, 0, 3, 4, 2, 6, 7, 4, 5,
+            /* size */ 6,  /* Doc 2 */ 5, 1, 8, 9, 8, 8,
+            /* size */ 3,  /* Doc 3 */ 8, 5, 9,
+            /* size */ 11, /* Doc 4 */ 8, 6, 9, 6, 6, 5, 4, 3, 1, 0, 6
+        };
+        std::ofstream os(collection_filename);
+        os.write(
+            reinterpret_cast<char*>(collection_data.data()),
+            collection_data.size() * sizeof(uint32_t)
+        );
+    }
+    invert::InvertParams params;
+    params.batch_size = GENERATE(2, 5);
+    params.term_count = 10;
+    auto raw_basename = (tmpdir.path() / "raw").string();
+    invert::invert_forward_index(collection_filename, raw_basename, params);
+    params.collection_format = BinaryCollectionFormat::VByte;
+    auto vbyte_basename = (tmpdir.path() / "vbyte").string();
+    invert::invert_forward_index(collection_filename, vbyte_basename, params);
+
+    for (auto suffix: {".docs", ".freqs", ".sizes"}) {
+        binary_collection raw((raw_basename + suffix).c_str());
+        binary_collection vbyte((vbyte_basename + suffix).c_str());
+        REQUIRE(vbyte.format() == BinaryCollectionFormat::VByte);
+        REQUIRE(raw.size() == vbyte.size());
+        auto vbyte_it = vbyte.begin();
+        for (auto const& sequence: raw) {
+            REQUIRE(
+                std::vector<uint32_t>(sequence.begin(), sequence.end())
+                == std::vector<uint32_t>(vbyte_it->begin(), vbyte_it->end())
+            );
+            ++vbyte_it;
+        }
+    }
+}
@@ -0,0 +1,205 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "compress.hpp"
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "merge_indexes.hpp"
+#include "payload_vector.hpp"
+#include "pisa_config.hpp"
+#include "temporary_directory.hpp"
+#include "test_common.hpp"
+#include "util/inverted_index_utils.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+namespace {
+
+/**
+ * Writes the documents `[first, last)` of a collection as a collection of its own, along with the
+ * lexicon of its terms, which are named by their IDs in the whole collection.
+ */
+void write_shard(
+    binary_freq_collection const& collection,
+    std::vector<std::uint32_t> const& document_sizes,
+    std::string const& basename,
+    std::uint32_t first,
+    std::uint32_t last
+) {
+    std::ofstream docs(basename + ".docs", std::ios::binary);
+    std::ofstream freqs(basename + ".freqs", std::ios::binary);
+    std::ofstream sizes(basename + ".sizes", std::ios::binary);
+    std::uint32_t num_docs = last - first;
+    write_sequence(docs, std::span<std::uint32_t const>(&num_docs, 1));
+    write_sequence(sizes, std::span(document_sizes).subspan(first, num_docs));
+    std::vector<std::string> terms;
+    std::uint32_t term_id = 0;
+    for (auto const& seq: collection) {
+        std::vector<std::uint32_t> shard_docs;
+        std::vector<std::uint32_t> shard_freqs;
+        for (std::size_t pos = 0; pos < seq.docs.size(); ++pos) {
+            auto docid = *(seq.docs.begin() + pos);
+            if (docid >= first && docid < last) {
+                shard_docs.push_back(docid - first);
+                shard_freqs.push_back(*(seq.freqs.begin() + pos));
+            }
+        }
+        if (!shard_docs.empty()) {
+            write_sequence(docs, std::span(shard_docs));
+            write_sequence(freqs, std::span(shard_freqs));
+            terms.push_back(fmt::format("{:06}", term_id));
+        }
+        ++term_id;
+    }
+    encode_payload_vector(terms).to_file(basename + ".termlex");
+}
+
+void compress_with_wand_data(
+    std::string const& input_basename,
+    std::string const& output_basename,
+    std::string const& encoding,
+    WandDataOptions const& wand_options,
+    std::unordered_set<std::size_t> const& terms_to_drop
+) {
+    compress(
+        input_basename,
+        std::nullopt,  // no wand
+        encoding,
+        output_basename + ".index",
+        ScorerParams(""),  // no scorer
+        std::nullopt,  // no quantization
+        MixedEncodingOptions{},
+        false,  // check=false
+        false  // in_memory=false
+    );
+    create_wand_data(
+        output_basename + ".wand",
+        input_basename,
+        wand_options.block_size,
+        wand_options.scorer_params,
+        false,  // range=false
+        false,  // compress=false
+        std::nullopt,  // no quantization
+        terms_to_drop
+    );
+}
+
+}  // namespace
+
+TEST_CASE("Indexes merged into one", "[index][merge]") {
+    std::string encoding = GENERATE("ef", "pefuniform", "block_simdbp");
+    std::string scorer = GENERATE("bm25", "quantized");
+    bool drop_terms = GENERATE(false, true);
+    CAPTURE(encoding);
+    CAPTURE(scorer);
+    CAPTURE(drop_terms);
+    TemporaryDirectory tmp;
+    auto collection_basename = PISA_SOURCE_DIR "/test/test_data/test_collection";
+    binary_freq_collection collection(collection_basename);
+    binary_collection sizes_collection((std::string(collection_basename) + ".sizes").c_str());
+    auto sizes_sequence = *sizes_collection.begin();
+    std::vector<std::uint32_t> document_sizes(sizes_sequence.begin(), sizes_sequence.end());
+    WandDataOptions wand_options{
+        .output = "",
+        .block_size = FixedBlock(64),
+        .scorer_params = ScorerParams(scorer),
+    };
+
+    auto expected = (tmp.path() / "expected").string();
+    compress_with_wand_data(collection_basename, expected, encoding, wand_options, {});
+
+    // Shards of uneven sizes, so that the lists of most terms end with partial blocks.
+    auto num_docs = static_cast<std::uint32_t>(collection.num_docs());
+    std::vector<std::uint32_t> bounds{0, num_docs / 10, num_docs / 3, num_docs / 3 + 67, num_docs};
+    std::vector<std::string> shards;
+    for (std::size_t idx = 0; idx + 1 < bounds.size(); ++idx) {
+        auto shard = (tmp.path() / fmt::format("shard.{}", idx)).string();
+        write_shard(collection, document_sizes, shard, bounds[idx], bounds[idx + 1]);
+        // Dropped terms leave the terms of the wand data numbered differently from the lexicon.
+        std::unordered_set<std::size_t> terms_to_drop;
+        if (drop_terms && idx == 1) {
+            terms_to_drop = {0, 5};
+        }
+        compress_with_wand_data(shard, shard, encoding, wand_options, terms_to_drop);
+        shards.push_back(shard);
+    }
+
+    auto merged = (tmp.path() / "merged").string();
+    merge_indexes(shards, merged, encoding, wand_options);
+
+    LexiconMap terms(merged + ".termlex");
+    REQUIRE(terms.size() == collection.size());
+    for (std::uint32_t term = 0; term < terms.size(); ++term) {
+        REQUIRE(terms[term] == fmt::format("{:06}", term));
+    }
+
+    run_for_index(encoding, MemorySource::mapped_file(merged + ".index"), [&](auto const& index) {
+        REQUIRE(index.num_docs() == collection.num_docs());
+        REQUIRE(index.size() == collection.size());
+        std::uint32_t term = 0;
+        for (auto const& seq: collection) {
+            CAPTURE(term);
+            auto cursor = index[term++];
+            REQUIRE(cursor.size() == seq.docs.size());
+            std::vector<std::uint32_t> docs;
+            std::vector<std::uint32_t> freqs;
+            for (; cursor.docid() < index.num_docs(); cursor.next()) {
+                docs.push_back(cursor.docid());
+                freqs.push_back(cursor.freq());
+            }
+            REQUIRE(docs == std::vector<std::uint32_t>(seq.docs.begin(), seq.docs.end()));
+            REQUIRE(freqs == std::vector<std::uint32_t>(seq.freqs.begin(), seq.freqs.end()));
+        }
+    });
+
+    wand_data<wand_data_raw> merged_wdata(MemorySource::mapped_file(merged + ".wand"));
+    wand_data<wand_data_raw> expected_wdata(MemorySource::mapped_file(expected + ".wand"));
+    REQUIRE(merged_wdata.num_docs() == expected_wdata.num_docs());
+    REQUIRE(merged_wdata.num_terms() == expected_wdata.num_terms());
+    for (std::uint32_t doc = 0; doc < merged_wdata.num_docs(); ++doc) {
+        REQUIRE(merged_wdata.doc_len(doc) == expected_wdata.doc_len(doc));
+    }
+    for (std::uint32_t term = 0; term < merged_wdata.num_terms(); ++term) {
+        REQUIRE(merged_wdata.term_posting_count(term) == expected_wdata.term_posting_count(term));
+        REQUIRE(
+            merged_wdata.term_occurrence_count(term) == expected_wdata.term_occurrence_count(term)
+        );
+        REQUIRE(merged_wdata.max_term_weight(term) == expected_wdata.max_term_weight(term));
+    }
+
+    if (scorer == "quantized" && !drop_terms) {
+        // The block-max scores are copied from the shards, so their blocks end where the lists of
+        // the shards do, but they still bound the scores, which are the frequencies.
+        std::uint32_t term = 0;
+        for (auto const& seq: collection) {
+            CAPTURE(term);
+            auto blocks = merged_wdata.getenum(term++);
+            std::size_t unbounded = 0;
+            for (std::size_t pos = 0; pos < seq.docs.size(); ++pos) {
+                auto docid = *(seq.docs.begin() + pos);
+                blocks.next_geq(docid);
+                if (blocks.docid() < docid || blocks.score() < *(seq.freqs.begin() + pos)) {
+                    ++unbounded;
+                }
+            }
+            REQUIRE(unbounded == 0);
+        }
+    } else {
+        // The block-max scores are computed from the merged lists, with the merged statistics.
+        REQUIRE(read_file(merged + ".wand") == read_file(expected + ".wand"));
+    }
+}
@@ -6,9 +6,13 @@
 
 #include <catch2/catch.hpp>
 
+#include "accumulator/block_tracking_accumulator.hpp"
+#include "accumulator/integer_accumulator.hpp"
 #include "accumulator/lazy_accumulator.hpp"
 #include "accumulator/simple_accumulator.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/block_scored_cursor.hpp"
+#include "cursor/cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
 #include "io.hpp"
@@ -17,8 +21,11 @@
 #include "query/algorithm/block_max_ranked_and_query.hpp"
 #include "query/algorithm/block_max_wand_query.hpp"
 #include "query/algorithm/maxscore_query.hpp"
+#include "query/algorithm/or_block_query.hpp"
+#include "query/algorithm/or_query.hpp"
 #include "query/algorithm/range_query.hpp"
 #include "query/algorithm/ranked_and_query.hpp"
+#include "query/algorithm/ranked_or_block_query.hpp"
 #include "query/algorithm/ranked_or_query.hpp"
 #include "query/algorithm/ranked_or_taat_query.hpp"
 #include "query/algorithm/wand_query.hpp"
@@ -120,12 +127,14 @@ TEMPLATE_TEST_CASE(
     "[query][ranked][integration]",
     ranked_or_taat_query_acc<SimpleAccumulator>,
     ranked_or_taat_query_acc<LazyAccumulator<4>>,
+    ranked_or_taat_query_acc<BlockTrackingAccumulator<>>,
     wand_query,
     maxscore_query,
     block_max_wand_query,
     block_max_maxscore_query,
     range_query_128<ranked_or_taat_query_acc<SimpleAccumulator>>,
     range_query_128<ranked_or_taat_query_acc<LazyAccumulator<4>>>,
+    range_query_128<ranked_or_taat_query_acc<BlockTrackingAccumulator<>>>,
     range_query_128<wand_query>,
     range_query_128<maxscore_query>,
     range_query_128<block_max_wand_query>,
@@ -198,6 +207,114 @@ TEMPLATE_TEST_CASE("Ranked AND query test", "[query][ranked][integration]", bloc
     }
 }
 
+// NOLINTNEXTLINE(hicpp-explicit-conversions)
+TEMPLATE_TEST_CASE(
+    "Ranked OR TAAT query with integer accumulator",
+    "[query][ranked][integration]",
+    IntegerAccumulator<std::uint16_t>,
+    IntegerAccumulator<std::uint32_t>
+) {
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    // Quantized scorer returns frequencies as scores, which are integers as in a quantized index.
+    auto scorer = scorer::from_params(ScorerParams("quantized"), data->wdata);
+    TestType accumulator(data->index.num_docs());
+    topk_queue topk_1(10);
+    ranked_or_taat_query taat_q(topk_1);
+    topk_queue topk_2(10);
+    ranked_or_query or_q(topk_2);
+
+    for (auto const& q: data->queries) {
+        or_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+        taat_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs(), accumulator);
+        topk_1.finalize();
+        topk_2.finalize();
+        REQUIRE(topk_1.topk().size() == topk_2.topk().size());
+        for (size_t i = 0; i < topk_2.topk().size(); ++i) {
+            REQUIRE(topk_1.topk()[i].first == topk_2.topk()[i].first);
+        }
+        topk_1.clear();
+        topk_2.clear();
+    }
+}
+
+TEST_CASE("Integer accumulator saturates 16-bit scores", "[query][ranked][integration]") {
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", false, dropped_term_ids);
+    auto scorer = scorer::from_params(ScorerParams("quantized"), data->wdata);
+    IntegerAccumulator<std::uint16_t> accumulator(data->index.num_docs());
+    topk_queue topk_1(10);
+    ranked_or_taat_query taat_q(topk_1);
+    topk_queue topk_2(10);
+    ranked_or_query or_q(topk_2);
+
+    // A power of two keeps the weighted float scores exact, and the sums of only a few
+    // frequencies already exceed the maximum counter value.
+    float weight = 4096.0F;
+    float max_score = std::numeric_limits<std::uint16_t>::max();
+    std::size_t saturated = 0;
+    for (auto const& q: data->queries) {
+        std::vector<TermId> terms;
+        for (auto const& term: q.terms()) {
+            terms.push_back(term.id);
+        }
+        Query weighted(std::nullopt, terms, std::vector<float>(terms.size(), weight));
+        or_q(make_scored_cursors(data->index, *scorer, weighted, true), data->index.num_docs());
+        taat_q(
+            make_scored_cursors(data->index, *scorer, weighted, true),
+            data->index.num_docs(),
+            accumulator
+        );
+        topk_1.finalize();
+        topk_2.finalize();
+        REQUIRE(topk_1.topk().size() == topk_2.topk().size());
+        for (size_t i = 0; i < topk_2.topk().size(); ++i) {
+            REQUIRE(topk_1.topk()[i].first == std::min(topk_2.topk()[i].first, max_score));
+            if (topk_2.topk()[i].first > max_score) {
+                ++saturated;
+            }
+        }
+        topk_1.clear();
+        topk_2.clear();
+    }
+    REQUIRE(saturated > 0);
+}
+
+TEST_CASE("Block-at-a-time OR queries", "[query][ranked][integration]") {
+    for (auto quantized: {false, true}) {
+        for (auto&& s_name: {"bm25", "qld"}) {
+            std::unordered_set<size_t> dropped_term_ids;
+            auto data = IndexData<single_index>::get(s_name, quantized, dropped_term_ids);
+            topk_queue topk_1(10);
+            ranked_or_block_query block_q(topk_1);
+            topk_queue topk_2(10);
+            ranked_or_query or_q(topk_2);
+
+            auto scorer = scorer::from_params(ScorerParams(s_name), data->wdata);
+            for (auto const& q: data->queries) {
+                or_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+                block_q(make_block_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+                topk_1.finalize();
+                topk_2.finalize();
+                REQUIRE(topk_1.topk().size() == topk_2.topk().size());
+                // Both traverse the documents in order and add the scores of the terms in the
+                // same order, so they return the same documents with the same scores.
+                for (size_t i = 0; i < topk_2.topk().size(); ++i) {
+                    REQUIRE(topk_1.topk()[i].second == topk_2.topk()[i].second);
+                    REQUIRE(topk_1.topk()[i].first == Approx(topk_2.topk()[i].first));
+                }
+                topk_1.clear();
+                topk_2.clear();
+
+                REQUIRE(
+                    or_block_query<true>{}(make_cursors(data->index, q), data->index.num_docs())
+                    == or_query<true>{}(make_cursors(data->index, q), data->index.num_docs())
+                );
+            }
+        }
+    }
+}
+
 TEST_CASE("Top k") {
     for (auto&& s_name: {"bm25", "qld"}) {
         std::unordered_set<size_t> dropped_term_ids;
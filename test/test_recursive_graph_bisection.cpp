@@ -90,6 +90,8 @@ TEST_CASE("Reorder documents with BP") {
                 std::make_optional<std::size_t>(1),
                 std::make_optional<std::size_t>(2)
             );
+            auto collection_format =
+                GENERATE(BinaryCollectionFormat::Raw, BinaryCollectionFormat::VByte);
             int code = recursive_graph_bisection(
                 RecursiveGraphBisectionOptions{
                     .input_basename = inv_path,
@@ -103,6 +105,7 @@ TEST_CASE("Reorder documents with BP") {
                     .min_length = 0,
                     .compress_fwd = false,
                     .print_args = false,
+                    .collection_format = collection_format,
                 }
             );
             REQUIRE(code == 0);
@@ -0,0 +1,401 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binary_freq_collection.hpp"
+#include "compress.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "invert.hpp"
+#include "io.hpp"
+#include "memory_source.hpp"
+#include "payload_vector.hpp"
+#include "pisa_config.hpp"
+#include "query/algorithm/ranked_or_query.hpp"
+#include "query/ranked_query.hpp"
+#include "scorer/scorer.hpp"
+#include "segmented_index.hpp"
+#include "temporary_directory.hpp"
+#include "test_common.hpp"
+#include "topk_queue.hpp"
+#include "wand_data.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+namespace {
+
+/** Returns the term occurrences of each document of the collection. */
+auto forward_documents(binary_freq_collection const& collection)
+    -> std::vector<std::vector<std::uint32_t>> {
+    std::vector<std::vector<std::uint32_t>> documents(collection.num_docs());
+    std::uint32_t term_id = 0;
+    for (auto const& seq: collection) {
+        for (std::size_t pos = 0; pos < seq.docs.size(); ++pos) {
+            auto& document = documents[*(seq.docs.begin() + pos)];
+            document.insert(document.end(), *(seq.freqs.begin() + pos), term_id);
+        }
+        ++term_id;
+    }
+    return documents;
+}
+
+/**
+ * Writes the documents `[first, last)` as a forward index, along with its lexicons, as
+ * `parse_collection` does: terms are the original term IDs, and titles the original document IDs.
+ */
+void write_forward_index(
+    std::string const& basename,
+    std::vector<std::vector<std::uint32_t>> const& documents,
+    std::size_t first,
+    std::size_t last
+) {
+    std::set<std::string> terms;
+    for (auto doc = first; doc < last; ++doc) {
+        for (auto term: documents[doc]) {
+            terms.insert(std::to_string(term));
+        }
+    }
+    std::vector<std::string> term_lexicon;
+    std::unordered_map<std::uint32_t, std::uint32_t> term_ids;
+    for (auto const& term: terms) {
+        term_ids[std::stoul(term)] = static_cast<std::uint32_t>(term_lexicon.size());
+        term_lexicon.push_back(term);
+    }
+    encode_payload_vector(term_lexicon).to_file(basename + ".termlex");
+
+    std::vector<std::string> titles;
+    std::ofstream os(basename, std::ios::binary);
+    auto write = [&](std::uint32_t value) {
+        os.write(reinterpret_cast<char const*>(&value), sizeof(value));
+    };
+    write(1);
+    write(static_cast<std::uint32_t>(last - first));
+    for (auto doc = first; doc < last; ++doc) {
+        write(static_cast<std::uint32_t>(documents[doc].size()));
+        for (auto term: documents[doc]) {
+            write(term_ids[term]);
+        }
+        titles.push_back(std::to_string(doc));
+    }
+    encode_payload_vector(titles).to_file(basename + ".doclex");
+}
+
+auto read_queries() -> std::vector<std::vector<std::string>> {
+    std::vector<std::vector<std::string>> queries;
+    std::ifstream is(PISA_SOURCE_DIR "/test/test_data/queries");
+    io::for_each_line(is, [&](std::string const& line) {
+        std::istringstream terms(line);
+        queries.emplace_back(
+            std::istream_iterator<std::string>(terms), std::istream_iterator<std::string>()
+        );
+    });
+    return queries;
+}
+
+auto segments(std::vector<std::uint32_t> const& levels) -> std::vector<SegmentInfo> {
+    std::vector<SegmentInfo> segments;
+    for (auto level: levels) {
+        segments.push_back(SegmentInfo{fmt::format("segment-{}", segments.size()), 1, level});
+    }
+    return segments;
+}
+
+}  // namespace
+
+TEST_CASE("Segment manifest", "[segments][unit]") {
+    TemporaryDirectory tmp;
+    auto path = tmp.path() / "index.segments";
+
+    SegmentManifest manifest("block_simdbp");
+    auto first = manifest.new_segment_name();
+    auto second = manifest.new_segment_name();
+    auto third = manifest.new_segment_name();
+    REQUIRE(first != second);
+    manifest.append(SegmentInfo{first, 10, 0});
+    manifest.append(SegmentInfo{second, 20, 0});
+    manifest.append(SegmentInfo{third, 5, 1});
+    manifest.write(path);
+
+    SECTION("Read written manifest") {
+        auto read = SegmentManifest::read(path);
+        REQUIRE(read.encoding() == "block_simdbp");
+        REQUIRE(read.num_docs() == 35);
+        REQUIRE(read.document_offsets() == std::vector<std::uint32_t>{0, 10, 30});
+        REQUIRE(read.segments().size() == 3);
+        REQUIRE(read.segments()[2].name == third);
+        REQUIRE(read.segments()[2].num_docs == 5);
+        REQUIRE(read.segments()[2].level == 1);
+        auto name = read.new_segment_name();
+        REQUIRE(name != first);
+        REQUIRE(name != second);
+        REQUIRE(name != third);
+    }
+    SECTION("Replace merged segments") {
+        auto updated = SegmentManifest::update(path, [&](SegmentManifest& manifest) {
+            manifest.replace({first, second}, SegmentInfo{"merged", 30, 1});
+        });
+        REQUIRE(updated.segments().size() == 2);
+        REQUIRE(SegmentManifest::read(path).segments().front().name == "merged");
+        REQUIRE(SegmentManifest::read(path).document_offsets() == std::vector<std::uint32_t>{0, 30});
+        REQUIRE_THROWS_AS(
+            manifest.replace({first, third}, SegmentInfo{"merged", 15, 1}), std::invalid_argument
+        );
+        REQUIRE_THROWS_AS(
+            manifest.replace({"missing"}, SegmentInfo{"merged", 15, 1}), std::invalid_argument
+        );
+    }
+    SECTION("Merged segments are not replaced while segments are opened") {
+        std::atomic<bool> replaced = false;
+        std::thread merge;
+        SegmentManifest::open_segments(path, [&](SegmentManifest const& manifest) {
+            CHECK(manifest.segments().size() == 3);
+            merge = std::thread([&] {
+                SegmentManifest::update(path, [&](SegmentManifest& manifest) {
+                    manifest.replace({first, second}, SegmentInfo{"merged", 30, 1});
+                });
+                replaced = true;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            CHECK_FALSE(replaced);
+        });
+        merge.join();
+        REQUIRE(replaced);
+        REQUIRE(SegmentManifest::read(path).segments().size() == 2);
+    }
+    SECTION("Invalid manifest") {
+        std::ofstream(tmp.path() / "invalid") << "encoding block_simdbp\n";
+        REQUIRE_THROWS_AS(SegmentManifest::read(tmp.path() / "invalid"), std::runtime_error);
+        REQUIRE_THROWS_AS(SegmentManifest::read(tmp.path() / "missing"), io::NoSuchFile);
+    }
+}
+
+TEST_CASE("Tiered merge policy", "[segments][unit]") {
+    using Range = std::optional<std::pair<std::size_t, std::size_t>>;
+    TieredMergePolicy policy{3};
+    REQUIRE(policy.select(segments({})) == Range{});
+    REQUIRE(policy.select(segments({0, 0})) == Range{});
+    REQUIRE(policy.select(segments({0, 0, 0})) == Range{{0, 3}});
+    REQUIRE(policy.select(segments({0, 0, 0, 0, 0})) == Range{{0, 3}});
+    REQUIRE(policy.select(segments({2, 1, 1, 0, 0})) == Range{});
+    REQUIRE(policy.select(segments({1, 1, 1, 0, 0, 0})) == Range{{3, 6}});
+    REQUIRE(policy.select(segments({1, 1, 1, 0, 0})) == Range{{0, 3}});
+    REQUIRE(policy.select(segments({0, 0, 1, 0})) == Range{});
+    REQUIRE_THROWS_AS(TieredMergePolicy{1}.select(segments({0})), std::invalid_argument);
+}
+
+TEST_CASE("Segmented index", "[segments][integration]") {
+    std::string encoding = GENERATE("pefopt", "block_simdbp");
+    CAPTURE(encoding);
+    TemporaryDirectory tmp;
+    binary_freq_collection collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    auto documents = forward_documents(collection);
+    auto queries = read_queries();
+    WandDataOptions wand_options{
+        .output = "",
+        .block_size = FixedBlock(64),
+        .scorer_params = ScorerParams("bm25"),
+    };
+    invert::InvertParams params;
+
+    // Four segments of consecutive documents, each with the lexicon of its own terms.
+    auto manifest_path = tmp.path() / "index.segments";
+    SegmentManifest(encoding).write(manifest_path);
+    std::size_t segment_count = 4;
+    for (std::size_t idx = 0; idx < segment_count; ++idx) {
+        auto fwd = (tmp.path() / fmt::format("fwd.{}", idx)).string();
+        write_forward_index(
+            fwd,
+            documents,
+            idx * documents.size() / segment_count,
+            (idx + 1) * documents.size() / segment_count
+        );
+        add_segment(manifest_path, fwd, params, wand_options);
+    }
+    auto manifest = SegmentManifest::read(manifest_path);
+    REQUIRE(manifest.segments().size() == segment_count);
+    REQUIRE(manifest.num_docs() == collection.num_docs());
+
+    resolve_index_type(encoding, [&](auto index_traits) {
+        using Index = typename std::decay_t<decltype(index_traits)>::type;
+        using Segments = SegmentedIndex<Index>;
+
+        SECTION("Queries over all segments return the results of the index of all documents") {
+            auto algorithm = GENERATE(
+                std::string("wand"),
+                std::string("block_max_wand"),
+                std::string("maxscore"),
+                std::string("ranked_or_taat")
+            );
+            CAPTURE(algorithm);
+            Segments index(manifest_path, wand_options.scorer_params, wand_options.block_size);
+            REQUIRE(index.segments().size() == segment_count);
+            REQUIRE(index.num_docs() == collection.num_docs());
+            std::unordered_map<typename Segments::Segment const*, RankedQueryFunction> queries_of;
+            for (auto const& segment: index.segments()) {
+                queries_of[&segment] = ranked_query_functions(
+                    algorithm, segment.index, segment.wdata, *segment.scorer, false, nullptr
+                )();
+            }
+
+            auto fwd = (tmp.path() / "fwd").string();
+            write_forward_index(fwd, documents, 0, documents.size());
+            auto expected_wand_options = wand_options;
+            expected_wand_options.output = (tmp.path() / "expected.wand").string();
+            invert_and_compress(
+                fwd, encoding, (tmp.path() / "expected").string(), params, expected_wand_options
+            );
+            auto expected_index = open_index<Index>(
+                encoding, MemorySource::mapped_file(tmp.path() / "expected")
+            );
+            wand_data<wand_data_raw> expected_wdata(
+                MemorySource::mapped_file(expected_wand_options.output)
+            );
+            auto expected_scorer = scorer::from_params(wand_options.scorer_params, expected_wdata);
+            LexiconMap expected_terms(fwd + ".termlex");
+
+            for (auto const& terms: queries) {
+                topk_queue topk(10);
+                index.query(terms, topk, [&](auto const& segment, Query const& query, auto& topk) {
+                    queries_of.at(&segment)(query, topk);
+                });
+
+                topk_queue expected(10);
+                ranked_or_query ranked_or(expected);
+                ranked_or(
+                    make_scored_cursors(
+                        expected_index, *expected_scorer, lexicon_query(terms, expected_terms)
+                    ),
+                    expected_index.num_docs()
+                );
+                topk.finalize();
+                expected.finalize();
+                REQUIRE(topk.topk().size() == expected.topk().size());
+                for (std::size_t i = 0; i < topk.topk().size(); ++i) {
+                    REQUIRE(topk.topk()[i].first == Approx(expected.topk()[i].first));
+                }
+                for (auto const& [score, docid]: topk.topk()) {
+                    REQUIRE(index.document(docid) == std::to_string(docid));
+                }
+            }
+        }
+
+        SECTION("Merged segments are the index of all documents") {
+            REQUIRE(merge_segments(manifest_path, TieredMergePolicy{2}, wand_options) == 3);
+            manifest = SegmentManifest::read(manifest_path);
+            REQUIRE(manifest.segments().size() == 1);
+            REQUIRE(manifest.segments().front().level == 2);
+            REQUIRE(manifest.segments().front().num_docs == collection.num_docs());
+            for (std::size_t idx = 0; idx < segment_count; ++idx) {
+                auto name = fmt::format("segment-{}", idx);
+                REQUIRE_FALSE(std::filesystem::exists(segment_path(manifest_path, name, ".index")));
+            }
+
+            auto fwd = (tmp.path() / "fwd").string();
+            write_forward_index(fwd, documents, 0, documents.size());
+            auto expected_wand_options = wand_options;
+            expected_wand_options.output = (tmp.path() / "expected.wand").string();
+            invert_and_compress(
+                fwd, encoding, (tmp.path() / "expected").string(), params, expected_wand_options
+            );
+            auto const& name = manifest.segments().front().name;
+            // Block-encoded lists keep the full blocks of the segments, so only their postings
+            // are the same as those of the index of all documents.
+            auto merged_index = open_index<Index>(
+                encoding, MemorySource::mapped_file(segment_path(manifest_path, name, ".index"))
+            );
+            auto expected_index = open_index<Index>(
+                encoding, MemorySource::mapped_file(tmp.path() / "expected")
+            );
+            auto postings = [](auto const& index, std::size_t term) {
+                std::vector<std::pair<std::uint32_t, std::uint32_t>> postings;
+                for (auto cursor = index[term]; cursor.docid() < index.num_docs(); cursor.next()) {
+                    postings.emplace_back(cursor.docid(), cursor.freq());
+                }
+                return postings;
+            };
+            REQUIRE(merged_index.size() == expected_index.size());
+            for (std::size_t term = 0; term < expected_index.size(); ++term) {
+                REQUIRE(postings(merged_index, term) == postings(expected_index, term));
+            }
+            if (encoding.rfind("block_", 0) != 0) {
+                REQUIRE(
+                    read_file(segment_path(manifest_path, name, ".index"))
+                    == read_file(tmp.path() / "expected")
+                );
+            }
+            REQUIRE(
+                read_file(segment_path(manifest_path, name, ".wand"))
+                == read_file(tmp.path() / "expected.wand")
+            );
+            for (auto extension: {".termlex", ".doclex"}) {
+                REQUIRE(
+                    read_file(segment_path(manifest_path, name, extension))
+                    == read_file(fwd + extension)
+                );
+            }
+        }
+
+        SECTION("Block-max scores are only computed again when the statistics change") {
+            auto blockmax_path = [&](std::size_t idx) {
+                return segment_path(manifest_path, manifest.segments()[idx].name, ".blockmax");
+            };
+            auto write_times = [&]() {
+                std::vector<std::filesystem::file_time_type> times;
+                for (std::size_t idx = 0; idx < segment_count; ++idx) {
+                    times.push_back(std::filesystem::last_write_time(blockmax_path(idx)));
+                }
+                return times;
+            };
+            auto block_max_scores = [](auto const& wdata, std::size_t term) {
+                std::vector<std::pair<std::uint32_t, float>> blocks;
+                auto blocks_enum = wdata.getenum(term);
+                while (blocks.empty() || blocks.back().first != blocks_enum.docid()) {
+                    blocks.emplace_back(blocks_enum.docid(), blocks_enum.score());
+                    blocks_enum.next_geq(blocks_enum.docid() + 1);
+                }
+                return blocks;
+            };
+
+            Segments computed(manifest_path, wand_options.scorer_params, wand_options.block_size);
+            auto computed_times = write_times();
+            Segments mapped(manifest_path, wand_options.scorer_params, wand_options.block_size);
+            REQUIRE(write_times() == computed_times);
+            for (std::size_t idx = 0; idx < segment_count; ++idx) {
+                auto const& expected = computed.segments()[idx].wdata;
+                auto const& wdata = mapped.segments()[idx].wdata;
+                REQUIRE(wdata.index_max_term_weight() == expected.index_max_term_weight());
+                for (std::size_t term = 0; term < computed.segments()[idx].terms.size(); ++term) {
+                    REQUIRE(wdata.max_term_weight(term) == expected.max_term_weight(term));
+                    REQUIRE(block_max_scores(wdata, term) == block_max_scores(expected, term));
+                }
+            }
+
+            // Other blocks, or another scorer, make other scores.
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            Segments other_blocks(manifest_path, wand_options.scorer_params, FixedBlock(32));
+            auto other_times = write_times();
+            for (std::size_t idx = 0; idx < segment_count; ++idx) {
+                REQUIRE(other_times[idx] != computed_times[idx]);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            Segments other_scorer(manifest_path, ScorerParams("qld"), FixedBlock(32));
+            auto qld_times = write_times();
+            for (std::size_t idx = 0; idx < segment_count; ++idx) {
+                REQUIRE(qld_times[idx] != other_times[idx]);
+            }
+        }
+    });
+}
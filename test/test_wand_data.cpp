@@ -1,7 +1,14 @@
 #define CATCH_CONFIG_MAIN
 #include "catch2/catch.hpp"
 
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <span>
+#include <string>
+#include <vector>
 
 #include <oneapi/tbb/global_control.h>
 #include <range/v3/view/iota.hpp>
@@ -9,6 +16,9 @@
 
 #include "index_types.hpp"
 #include "pisa_config.hpp"
+#include "temporary_directory.hpp"
+#include "test_common.hpp"
+#include "util/inverted_index_utils.hpp"
 #include "wand_data.hpp"
 #include "wand_data_range.hpp"
 
@@ -121,3 +131,164 @@ TEST_CASE("wand_data_range") {
         }
     }
 }
+
+/**
+ * Writes a small collection at `basename`, whose postings are computed with integer arithmetic
+ * only, so that the wand data built from it can be compared with fixtures.
+ */
+void write_fixture_collection(std::string const& basename) {
+    std::uint32_t num_docs = 2000;
+    std::uint32_t num_terms = 40;
+    std::ofstream docs(basename + ".docs", std::ios::binary);
+    std::ofstream freqs(basename + ".freqs", std::ios::binary);
+    std::ofstream sizes(basename + ".sizes", std::ios::binary);
+    write_sequence(docs, std::span<std::uint32_t const>(&num_docs, 1));
+    for (std::uint32_t term = 0; term < num_terms; ++term) {
+        std::vector<std::uint32_t> term_docs;
+        std::vector<std::uint32_t> term_freqs;
+        for (std::uint32_t doc = 0; doc < num_docs; ++doc) {
+            if ((doc * 2654435761U + term * 40503U) % (term % 13 + 2) == 0) {
+                term_docs.push_back(doc);
+                term_freqs.push_back(1 + (doc + term) % (term % 7 + 1));
+            }
+        }
+        write_sequence(docs, std::span(term_docs));
+        write_sequence(freqs, std::span(term_freqs));
+    }
+    std::vector<std::uint32_t> doc_sizes(num_docs);
+    for (std::uint32_t doc = 0; doc < num_docs; ++doc) {
+        doc_sizes[doc] = 10 + doc % 37;
+    }
+    write_sequence(sizes, std::span(doc_sizes));
+}
+
+/** 64-bit FNV-1a hash of the bytes of the file at `path`. */
+auto checksum(std::string const& path) -> std::uint64_t {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (char byte: read_file(path)) {
+        hash = (hash ^ static_cast<std::uint8_t>(byte)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Checksums of the wand data built from the fixture collection by the sequential implementation
+ * that preceded the parallel one, indexed by: variable blocks, quantization, dropped terms.
+ *
+ * The scores are those of the `quantized` scorer, i.e., the frequencies, which are exact: the bytes
+ * of BM25 scores depend on the floating-point contraction chosen by the compiler.
+ */
+using Checksums = std::array<std::array<std::array<std::uint64_t, 2>, 2>, 2>;
+
+template <typename WandType>
+auto sequential_checksums() -> Checksums;
+
+template <>
+auto sequential_checksums<wand_data_raw>() -> Checksums {
+    return {{
+        {{
+            {0x2f8cf270b19b616dULL, 0xb9266dd57bb261f9ULL},
+            {0x88bc117912d34ba4ULL, 0x3dca4e329c6e3e8fULL},
+        }},
+        {{
+            {0xfb92bf0b6f2d2d20ULL, 0x72116267061b0d0bULL},
+            {0xe85dc4d034a0e063ULL, 0x6f19b99f402b58b0ULL},
+        }},
+    }};
+}
+
+template <>
+auto sequential_checksums<wand_data_compressed<>>() -> Checksums {
+    return {{
+        {{
+            {0, 0},
+            {0xdd45d7c2e4f9a98bULL, 0x28160b3d40ae0db2ULL},
+        }},
+        {{
+            {0, 0},
+            {0xf37cd0133469873dULL, 0x40e7285759d3e2bfULL},
+        }},
+    }};
+}
+
+template <>
+auto sequential_checksums<wand_data_range<64, 1024>>() -> Checksums {
+    return {{
+        {{
+            {0x5ee9e4352fb9942fULL, 0x086d2dce2ac38c18ULL},
+            {0xb8cc69bcf3123afdULL, 0x14d7f2711ff05ce6ULL},
+        }},
+        {{
+            {0x5ee9e4352fb9942fULL, 0x086d2dce2ac38c18ULL},
+            {0xb8cc69bcf3123afdULL, 0x14d7f2711ff05ce6ULL},
+        }},
+    }};
+}
+
+TEMPLATE_TEST_CASE(
+    "wand_data is identical to the one built by the sequential implementation",
+    "[wand_data]",
+    wand_data_raw,
+    wand_data_compressed<>,
+    (wand_data_range<64, 1024>)
+) {
+    tbb::global_control c(oneapi::tbb::global_control::max_allowed_parallelism, 4);
+    using WandType = wand_data<TestType>;
+
+    pisa::TemporaryDirectory collection_dir;
+    auto collection_path = (collection_dir.path() / "fixture").string();
+    write_fixture_collection(collection_path);
+    binary_freq_collection const collection(collection_path.c_str());
+    binary_collection document_sizes((collection_path + ".sizes").c_str());
+
+    bool variable_blocks = GENERATE(false, true);
+    bool quantized = GENERATE(false, true);
+    bool drop_terms = GENERATE(false, true);
+    if (std::is_same_v<TestType, wand_data_compressed<>> && !quantized) {
+        return;
+    }
+    CAPTURE(variable_blocks, quantized, drop_terms);
+    BlockSize block_size =
+        variable_blocks ? BlockSize(VariableBlock(12.0)) : BlockSize(FixedBlock(5));
+    std::optional<Size> quantization_bits =
+        quantized ? std::optional<Size>(Size(8)) : std::optional<Size>{};
+    std::unordered_set<size_t> dropped_term_ids;
+    if (drop_terms) {
+        dropped_term_ids = {0, 3, 4, 39};
+    }
+    auto expected = sequential_checksums<TestType>()[variable_blocks][quantized][drop_terms];
+
+    pisa::TemporaryDirectory tmpdir;
+    auto frozen_path = (tmpdir.path() / "frozen").string();
+    auto written_path = (tmpdir.path() / "written").string();
+    {
+        WandType wdata(
+            document_sizes.begin()->begin(),
+            collection.num_docs(),
+            collection,
+            ScorerParams("quantized"),
+            block_size,
+            quantization_bits,
+            dropped_term_ids
+        );
+        mapper::freeze(wdata, frozen_path.c_str());
+    }
+    WandType::write(
+        written_path,
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        ScorerParams("quantized"),
+        block_size,
+        quantization_bits,
+        dropped_term_ids,
+        tmpdir.path()
+    );
+
+    REQUIRE(checksum(frozen_path) == expected);
+    REQUIRE(checksum(written_path) == expected);
+    auto files = std::distance(
+        std::filesystem::directory_iterator(tmpdir.path()), std::filesystem::directory_iterator()
+    );
+    REQUIRE(files == 2);
+}
@@ -63,6 +63,21 @@ auto Analyzer::text_analyzer() const -> TextAnalyzer {
 const std::set<std::string> Analyzer::VALID_TOKENIZERS = {"whitespace", "english"};
 const std::set<std::string> Analyzer::VALID_TOKEN_FILTERS = {"lowercase", "porter2", "krovetz"};
 
+CollectionFormat::CollectionFormat(CLI::App* app) {
+    app->add_option("--collection-format", m_format, "Format of written binary collections")
+        ->capture_default_str()
+        ->check(CLI::IsMember(VALID_FORMATS));
+}
+
+auto CollectionFormat::collection_format() const -> BinaryCollectionFormat {
+    return ENUM_MAP.at(m_format);
+}
+
+const std::set<std::string> CollectionFormat::VALID_FORMATS = {"raw", "vbyte"};
+const std::map<std::string, BinaryCollectionFormat> CollectionFormat::ENUM_MAP = {
+    {"raw", BinaryCollectionFormat::Raw}, {"vbyte", BinaryCollectionFormat::VByte}
+};
+
 LogLevel::LogLevel(CLI::App* app) {
     app->add_option("-L,--log-level", m_level, "Log level")
         ->capture_default_str()
@@ -142,6 +157,16 @@ auto Thresholds::thresholds_option() -> CLI::Option* {
     return m_option;
 }
 
+Filter::Filter(CLI::App* app) {
+    app->add_option(
+        "--filter", m_filter_filename, "Document filter; filtered documents are never returned"
+    );
+}
+
+auto Filter::filter_file() const -> std::optional<std::string> const& {
+    return m_filter_filename;
+}
+
 Verbose::Verbose(CLI::App* app) {
     app->add_flag("-v,--verbose", m_verbose, "Print additional information");
 }
@@ -273,6 +298,96 @@ auto CreateWandData::quantization_bits() const -> std::optional<Size> {
     return std::nullopt;
 }
 
+InvertCompress::InvertCompress(CLI::App* app) : WandDataParams<ScorerMode::Optional>(app) {
+    app->add_option("-i,--input", m_input_basename, "Forward index basename")->required();
+    app->add_option("-o,--output", m_output, "Output inverted index")->required();
+    app->add_option("--term-count", m_term_count, "Number of distinct terms in the forward index");
+    needs_output(app->add_option("-w,--wand", m_wand_data_output, "Output WAND data filename"));
+}
+
+auto InvertCompress::input_basename() const -> std::string {
+    return m_input_basename;
+}
+
+auto InvertCompress::output() const -> std::string {
+    return m_output;
+}
+
+auto InvertCompress::term_count() const -> std::optional<std::uint32_t> {
+    return m_term_count;
+}
+
+auto InvertCompress::wand_data_options() const -> std::optional<WandDataOptions> {
+    if (!m_wand_data_output.has_value()) {
+        return std::nullopt;
+    }
+    auto options = WandDataParams::wand_data_options();
+    options.output = *m_wand_data_output;
+    return options;
+}
+
+Segments::Segments(CLI::App* app) : WandDataParams<ScorerMode::Required>(app) {
+    app->add_option("-m,--manifest", m_manifest, "Segment manifest")->required();
+}
+
+auto Segments::manifest() const -> std::string const& {
+    return m_manifest;
+}
+
+MergeIndexes::MergeIndexes(CLI::App* app) : WandDataParams<ScorerMode::Required>(app) {
+    app->add_option("-i,--inputs", m_input_basenames, "Index basenames, in document order")
+        ->required();
+    app->add_option("-o,--output", m_output_basename, "Basename of the merged index")->required();
+}
+
+auto MergeIndexes::input_basenames() const -> std::vector<std::string> const& {
+    return m_input_basenames;
+}
+
+auto MergeIndexes::output_basename() const -> std::string const& {
+    return m_output_basename;
+}
+
+TranscodeIndex::TranscodeIndex(CLI::App* app) : WandDataParams<ScorerMode::Optional>(app) {
+    app->add_option("-i,--input", m_input, "Input inverted index filename")->required();
+    app->add_option("--input-encoding", m_input_encoding, "Input index encoding")->required();
+    app->add_option("-o,--output", m_output, "Output inverted index filename")->required();
+    app->add_option(
+        "--mapping", m_mapping, "Renumber documents with this document order file (old new)"
+    );
+    auto* input_wand = app->add_option("-w,--wand", m_wand_data, "Input WAND data filename");
+    auto* wand =
+        app->add_option("--output-wand", m_wand_data_output, "Output WAND data filename");
+    wand->needs(input_wand);
+    needs_output(wand);
+    app->add_flag("--check", m_check, "Check the correctness of the output index");
+}
+
+auto TranscodeIndex::input_filename() const -> std::string const& {
+    return m_input;
+}
+
+auto TranscodeIndex::input_encoding() const -> std::string const& {
+    return m_input_encoding;
+}
+
+auto TranscodeIndex::output_filename() const -> std::string const& {
+    return m_output;
+}
+
+auto TranscodeIndex::mapping_file() const -> std::optional<std::string> const& {
+    return m_mapping;
+}
+
+auto TranscodeIndex::transcode_options() const -> TranscodeOptions {
+    TranscodeOptions options{.input_wand_data = m_wand_data, .check = m_check};
+    if (m_wand_data_output.has_value()) {
+        options.wand_options = wand_data_options();
+        options.wand_options->output = *m_wand_data_output;
+    }
+    return options;
+}
+
 /// Transform paths for `shard`.
 void CreateWandData::apply_shard(Shard_Id shard) {
     m_input_basename = expand_shard(m_input_basename, shard);
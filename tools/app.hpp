@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <optional>
@@ -15,6 +16,8 @@
 #include <spdlog/spdlog.h>
 #include <unordered_set>
 
+#include "binary_collection.hpp"
+#include "compress.hpp"
 #include "io.hpp"
 #include "pisa/query.hpp"
 #include "pisa/query/query_parser.hpp"
@@ -113,22 +116,31 @@ namespace arg {
             }
         }
 
-        [[nodiscard]] auto query_file() -> std::optional<std::reference_wrapper<std::string const>> {
+        [[nodiscard]] auto query_file() const
+            -> std::optional<std::reference_wrapper<std::string const>> {
             if (m_query_file) {
                 return m_query_file.value();
             }
             return std::nullopt;
         }
 
-        [[nodiscard]] auto queries() const -> std::vector<::pisa::Query> {
-            std::vector<::pisa::Query> qs;
+        /**
+         * Returns a parser mapping query tokens to term IDs according to the CLI arguments.
+         * Useful for reading queries incrementally instead of loading them with `queries()`.
+         */
+        [[nodiscard]] auto query_parser() const -> QueryParser {
             std::unique_ptr<TermMap> term_map = [this]() -> std::unique_ptr<TermMap> {
                 if (this->m_term_lexicon) {
                     return std::make_unique<LexiconMap>(*this->m_term_lexicon);
                 }
                 return std::make_unique<IntMap>();
             }();
-            QueryParser parser(text_analyzer(), std::move(term_map));
+            return QueryParser(text_analyzer(), std::move(term_map));
+        }
+
+        [[nodiscard]] auto queries() const -> std::vector<::pisa::Query> {
+            std::vector<::pisa::Query> qs;
+            QueryParser parser = query_parser();
             auto parse_query = [&qs, &parser](auto&& line) { qs.push_back(parser.parse(line)); };
             if (m_query_file) {
                 std::ifstream is(*m_query_file);
@@ -247,6 +259,81 @@ namespace arg {
         ScorerParams m_params;
     };
 
+    /**
+     * Parameters of WAND data built along with an index. With `ScorerMode::Optional`, the WAND
+     * data are optional as well, and `needs_output` ties the parameters to the output option.
+     */
+    template <ScorerMode Mode>
+    struct WandDataParams {
+        explicit WandDataParams(CLI::App* app) : m_params("") {
+            m_block_size_option = app->add_option(
+                "-b,--block-size", m_fixed_block_size, "Block size for fixed-length blocks"
+            );
+            m_block_size_option->capture_default_str();
+            m_lambda_option =
+                app->add_option("-l,--lambda", m_lambda, "Lambda parameter for variable blocks")
+                    ->excludes(m_block_size_option);
+            m_quantize_option = app->add_option(
+                "--quantize", m_quantization_bits, "Quantizes the scores using this many bits"
+            );
+            m_compress_option = app->add_flag("--compress", m_compress, "Compress additional data")
+                                    ->needs(m_quantize_option);
+            m_range_option = app->add_flag("--range", m_range, "Create docid-range based data")
+                                 ->excludes(m_block_size_option)
+                                 ->excludes(m_lambda_option);
+            m_scorer_option = add_scorer_options(app, *this, Mode);
+        }
+
+        /// Makes the parameters valid only along with `output`, which in turn needs a scorer.
+        void needs_output(CLI::Option* output) {
+            for (auto* option:
+                 {m_block_size_option,
+                  m_lambda_option,
+                  m_quantize_option,
+                  m_compress_option,
+                  m_range_option}) {
+                option->needs(output);
+            }
+            output->needs(m_scorer_option);
+            m_scorer_option->needs(output);
+        }
+
+        /// Options of the WAND data, with an empty output filename for the caller to set.
+        [[nodiscard]] auto wand_data_options() const -> WandDataOptions {
+            BlockSize block_size = m_lambda.has_value() ? BlockSize(VariableBlock(*m_lambda))
+                                                        : BlockSize(FixedBlock(m_fixed_block_size));
+            std::optional<Size> quantization_bits = std::nullopt;
+            if (m_quantization_bits.has_value()) {
+                quantization_bits = Size(*m_quantization_bits);
+            }
+            return WandDataOptions{
+                .output = "",
+                .block_size = block_size,
+                .scorer_params = m_params,
+                .range = m_range,
+                .compress = m_compress,
+                .quantization_bits = quantization_bits,
+            };
+        }
+
+        template <typename T>
+        friend CLI::Option* add_scorer_options(CLI::App* app, T& args, ScorerMode scorer_mode);
+
+      private:
+        std::uint64_t m_fixed_block_size = 64;
+        std::optional<float> m_lambda{};
+        ScorerParams m_params;
+        bool m_compress = false;
+        bool m_range = false;
+        std::optional<std::size_t> m_quantization_bits = std::nullopt;
+        CLI::Option* m_block_size_option = nullptr;
+        CLI::Option* m_lambda_option = nullptr;
+        CLI::Option* m_quantize_option = nullptr;
+        CLI::Option* m_compress_option = nullptr;
+        CLI::Option* m_range_option = nullptr;
+        CLI::Option* m_scorer_option = nullptr;
+    };
+
     struct Thresholds {
         explicit Thresholds(CLI::App* app);
         [[nodiscard]] auto thresholds_file() const -> std::optional<std::string> const&;
@@ -257,6 +344,14 @@ namespace arg {
         CLI::Option* m_option;
     };
 
+    struct Filter {
+        explicit Filter(CLI::App* app);
+        [[nodiscard]] auto filter_file() const -> std::optional<std::string> const&;
+
+      private:
+        std::optional<std::string> m_filter_filename;
+    };
+
     struct Verbose {
         explicit Verbose(CLI::App* app);
         [[nodiscard]] auto verbose() const -> bool;
@@ -288,6 +383,24 @@ namespace arg {
         std::size_t m_batch_size = Default;
     };
 
+    struct MemoryBudget {
+        explicit MemoryBudget(CLI::App* app) {
+            auto* option = app->add_option(
+                "--memory-budget",
+                m_memory_budget,
+                "Approximate memory for inverting a batch, e.g., 4GB; overrides --batch-size"
+            );
+            option->transform(CLI::AsSizeValue(false));
+        }
+
+        [[nodiscard]] auto memory_budget() const -> std::optional<std::size_t> {
+            return m_memory_budget;
+        }
+
+      private:
+        std::optional<std::size_t> m_memory_budget{};
+    };
+
     struct Invert {
         explicit Invert(CLI::App* app);
         [[nodiscard]] auto input_basename() const -> std::string;
@@ -327,6 +440,84 @@ namespace arg {
         bool m_check = false;
     };
 
+    /**
+     * Options of the `block_mixed` encoding. The query log weighting the posting lists is parsed
+     * with `--terms` and the text analysis options, as in the query tools.
+     */
+    struct MixedEncoding: public Analyzer {
+        explicit MixedEncoding(CLI::App* app) : Analyzer(app) {
+            auto* queries = app->add_option(
+                "-q,--queries", m_query_log, "Query log counting the queries accessing each term"
+            );
+            app->add_option("--terms", m_term_lexicon, "Term lexicon of the query log")
+                ->needs(queries);
+            app->add_option(
+                "--mixed-time-weight",
+                m_time_weight,
+                "Bits of space worth one nanosecond of decoding when choosing the codec of each "
+                "block with block_mixed"
+            );
+            app->add_option(
+                "--mixed-decode-ns",
+                m_decode_ns,
+                "Decoding time in nanoseconds per integer of each codec of block_mixed, in order: "
+                "simdbp, streamvbyte, optpfor, interpolative (e.g., measured with "
+                "perftest_block_codecs)"
+            );
+        }
+
+        /**
+         * Returns the options of the mixed encoding. If a query log is given, the number of
+         * queries accessing each term is counted.
+         *
+         * \throws std::runtime_error   Thrown if the query log cannot be opened.
+         */
+        [[nodiscard]] auto mixed_options() const -> MixedEncodingOptions {
+            MixedEncodingOptions options{m_time_weight, std::nullopt};
+            if (!m_decode_ns.empty()) {
+                options.decode_ns = m_decode_ns;
+            }
+            if (!m_query_log) {
+                return options;
+            }
+            std::ifstream is(*m_query_log);
+            if (!is.is_open()) {
+                throw std::runtime_error(fmt::format("cannot open query log: {}", *m_query_log));
+            }
+            std::unique_ptr<TermMap> term_map;
+            if (m_term_lexicon) {
+                term_map = std::make_unique<LexiconMap>(*m_term_lexicon);
+            } else {
+                term_map = std::make_unique<IntMap>();
+            }
+            QueryParser parser(text_analyzer(), std::move(term_map));
+            std::vector<std::uint64_t> accesses;
+            io::for_each_line(is, [&](auto&& line) {
+                auto query = parser.parse(line);
+                std::vector<TermId> term_ids;
+                for (auto const& term: query.terms()) {
+                    term_ids.push_back(term.id);
+                }
+                std::sort(term_ids.begin(), term_ids.end());
+                term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+                for (auto term_id: term_ids) {
+                    if (term_id >= accesses.size()) {
+                        accesses.resize(term_id + 1);
+                    }
+                    accesses[term_id] += 1;
+                }
+            });
+            options.term_accesses = std::move(accesses);
+            return options;
+        }
+
+      private:
+        std::optional<std::string> m_query_log{};
+        std::optional<std::string> m_term_lexicon{};
+        std::optional<double> m_time_weight{};
+        std::vector<double> m_decode_ns{};
+    };
+
     struct CreateWandData {
         explicit CreateWandData(CLI::App* app);
         [[nodiscard]] auto input_basename() const -> std::string;
@@ -357,6 +548,57 @@ namespace arg {
         std::optional<std::string> m_terms_to_drop_filename;
     };
 
+    struct InvertCompress: public WandDataParams<ScorerMode::Optional> {
+        explicit InvertCompress(CLI::App* app);
+        [[nodiscard]] auto input_basename() const -> std::string;
+        [[nodiscard]] auto output() const -> std::string;
+        [[nodiscard]] auto term_count() const -> std::optional<std::uint32_t>;
+        [[nodiscard]] auto wand_data_options() const -> std::optional<WandDataOptions>;
+
+      private:
+        std::string m_input_basename{};
+        std::string m_output{};
+        std::optional<std::uint32_t> m_term_count{};
+        std::optional<std::string> m_wand_data_output{};
+    };
+
+    struct Segments: public WandDataParams<ScorerMode::Required> {
+        explicit Segments(CLI::App* app);
+        [[nodiscard]] auto manifest() const -> std::string const&;
+
+      private:
+        std::string m_manifest{};
+    };
+
+    struct MergeIndexes: public WandDataParams<ScorerMode::Required> {
+        explicit MergeIndexes(CLI::App* app);
+        [[nodiscard]] auto input_basenames() const -> std::vector<std::string> const&;
+        [[nodiscard]] auto output_basename() const -> std::string const&;
+
+      private:
+        std::vector<std::string> m_input_basenames{};
+        std::string m_output_basename{};
+    };
+
+    struct TranscodeIndex: public WandDataParams<ScorerMode::Optional> {
+        explicit TranscodeIndex(CLI::App* app);
+        [[nodiscard]] auto input_filename() const -> std::string const&;
+        [[nodiscard]] auto input_encoding() const -> std::string const&;
+        [[nodiscard]] auto output_filename() const -> std::string const&;
+        [[nodiscard]] auto mapping_file() const -> std::optional<std::string> const&;
+        /** Options of `transcode_index`, without the mapping, which is read from its file. */
+        [[nodiscard]] auto transcode_options() const -> TranscodeOptions;
+
+      private:
+        std::string m_input{};
+        std::string m_input_encoding{};
+        std::string m_output{};
+        std::optional<std::string> m_mapping{};
+        std::optional<std::string> m_wand_data{};
+        std::optional<std::string> m_wand_data_output{};
+        bool m_check = false;
+    };
+
     struct ReorderDocuments {
         explicit ReorderDocuments(CLI::App* app);
         [[nodiscard]] auto input_basename() const -> std::string;
@@ -419,6 +661,21 @@ namespace arg {
         bool m_print_query_id = false;
     };
 
+    /**
+     * Format of the intermediate binary collections, either `raw` or `vbyte`, see
+     * `BinaryCollectionFormat`.
+     */
+    struct CollectionFormat {
+        static const std::set<std::string> VALID_FORMATS;
+        static const std::map<std::string, BinaryCollectionFormat> ENUM_MAP;
+
+        explicit CollectionFormat(CLI::App* app);
+        [[nodiscard]] auto collection_format() const -> BinaryCollectionFormat;
+
+      private:
+        std::string m_format = "raw";
+    };
+
     /**
      * Log level configuration.
      *
@@ -462,10 +719,43 @@ struct Args: public T... {
     }
 };
 
-using InvertArgs = Args<arg::Invert, arg::Threads, arg::BatchSize<100'000>, arg::LogLevel>;
-using ReorderDocuments = Args<arg::ReorderDocuments, arg::Threads, arg::LogLevel>;
-using CompressArgs = pisa::Args<arg::Compress, arg::Encoding, arg::Quantize, arg::LogLevel>;
-using CreateWandDataArgs = pisa::Args<arg::CreateWandData, arg::LogLevel>;
+using InvertArgs = Args<
+    arg::Invert,
+    arg::Threads,
+    arg::BatchSize<100'000>,
+    arg::MemoryBudget,
+    arg::CollectionFormat,
+    arg::LogLevel>;
+using ReorderDocuments =
+    Args<arg::ReorderDocuments, arg::Threads, arg::CollectionFormat, arg::LogLevel>;
+using CompressArgs = pisa::Args<
+    arg::Compress,
+    arg::Encoding,
+    arg::Quantize,
+    arg::MixedEncoding,
+    arg::Threads,
+    arg::LogLevel>;
+using CreateWandDataArgs = pisa::Args<arg::CreateWandData, arg::Threads, arg::LogLevel>;
+using InvertCompressArgs = pisa::Args<
+    arg::InvertCompress,
+    arg::Encoding,
+    arg::Threads,
+    arg::BatchSize<100'000>,
+    arg::MemoryBudget,
+    arg::CollectionFormat,
+    arg::LogLevel>;
+
+using SegmentArgs = pisa::Args<
+    arg::Segments,
+    arg::Threads,
+    arg::BatchSize<100'000>,
+    arg::MemoryBudget,
+    arg::CollectionFormat>;
+
+using MergeIndexesArgs =
+    pisa::Args<arg::MergeIndexes, arg::Encoding, arg::Threads, arg::LogLevel>;
+using TranscodeIndexArgs =
+    pisa::Args<arg::TranscodeIndex, arg::Encoding, arg::Threads, arg::LogLevel>;
 
 struct TailyStatsArgs
     : pisa::Args<arg::WandData<arg::WandMode::Required>, arg::Scorer, arg::LogLevel> {
@@ -1,5 +1,6 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
 
 #include "app.hpp"
 #include "compress.hpp"
@@ -11,6 +12,7 @@ int main(int argc, char** argv) {
     pisa::CompressArgs args(&app);
     CLI11_PARSE(app, argc, argv);
     spdlog::set_level(args.log_level());
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
     pisa::compress(
         args.input_basename(),
         args.wand_data_path(),
@@ -18,6 +20,7 @@ int main(int argc, char** argv) {
         args.output(),
         args.scorer_params(),
         args.quantization_bits(),
+        args.mixed_options(),
         args.check(),
         false
     );
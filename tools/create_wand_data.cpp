@@ -1,3 +1,5 @@
+#include <tbb/global_control.h>
+
 #include "app.hpp"
 #include "wand_data.hpp"
 
@@ -5,6 +7,7 @@ int main(int argc, const char** argv) {
     CLI::App app{"Creates additional data for query processing."};
     pisa::CreateWandDataArgs args(&app);
     CLI11_PARSE(app, argc, argv);
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
     pisa::create_wand_data(
         args.output(),
         args.input_basename(),
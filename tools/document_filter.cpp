@@ -0,0 +1,56 @@
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <CLI/CLI.hpp>
+#include <fmt/format.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "document_filter.hpp"
+
+using namespace pisa;
+
+int main(int argc, char** argv) {
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::optional<std::string> input_file;
+    std::string output_file;
+    std::uint32_t num_docs = 0;
+
+    pisa::App<pisa::arg::LogLevel> app{
+        "Builds a document filter excluding the listed documents from query results."
+    };
+    app.add_option(
+        "-i,--input",
+        input_file,
+        "File with a document ID or a range `first last` per line (default: stdin)"
+    );
+    app.add_option("-n,--num-docs", num_docs, "Number of documents in the index")->required();
+    app.add_option("-o,--output", output_file, "Output filter file")->required();
+    CLI11_PARSE(app, argc, argv);
+
+    spdlog::set_level(app.log_level());
+
+    try {
+        std::ifstream input_stream;
+        if (input_file.has_value()) {
+            input_stream.open(*input_file);
+            if (!input_stream.is_open()) {
+                throw std::runtime_error(fmt::format("cannot open input file {}", *input_file));
+            }
+        }
+        std::istream& input = input_file.has_value() ? input_stream : std::cin;
+        DocumentFilter filter(num_docs, read_document_ranges(input));
+        filter.write(output_file);
+        spdlog::info("Filtered {} out of {} documents", filter.count(), filter.size());
+        return 0;
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+}
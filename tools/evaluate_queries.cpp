@@ -1,3 +1,4 @@
+#include <fstream>
 #include <iostream>
 #include <optional>
 
@@ -10,24 +11,16 @@
 #include <range/v3/view/enumerate.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/enumerable_thread_specific.h>
 #include <tbb/global_control.h>
-#include <tbb/parallel_for.h>
+#include <tbb/parallel_pipeline.h>
 
-#include "accumulator/lazy_accumulator.hpp"
-#include "accumulator/simple_accumulator.hpp"
 #include "app.hpp"
-#include "cursor/block_max_scored_cursor.hpp"
-#include "cursor/max_scored_cursor.hpp"
-#include "cursor/scored_cursor.hpp"
+#include "document_filter.hpp"
 #include "index_types.hpp"
-#include "query/algorithm/block_max_maxscore_query.hpp"
-#include "query/algorithm/block_max_ranked_and_query.hpp"
-#include "query/algorithm/block_max_wand_query.hpp"
-#include "query/algorithm/maxscore_query.hpp"
-#include "query/algorithm/ranked_and_query.hpp"
-#include "query/algorithm/ranked_or_query.hpp"
-#include "query/algorithm/ranked_or_taat_query.hpp"
-#include "query/algorithm/wand_query.hpp"
+#include "memory_source.hpp"
+#include "query/query_parser.hpp"
+#include "query/ranked_query.hpp"
 #include "scorer/scorer.hpp"
 #include "wand_data.hpp"
 #include "wand_data_compressed.hpp"
@@ -40,7 +33,9 @@ template <typename IndexType, typename WandType>
 void evaluate_queries(
     IndexType const* index_ptr,
     const std::string& wand_data_filename,
-    const std::vector<Query>& queries,
+    std::istream* query_input,
+    QueryParser* query_parser,
+    std::size_t max_in_flight,
     const std::optional<std::string>& thresholds_filename,
     std::string const& type,
     std::string const& query_type,
@@ -49,137 +44,93 @@ void evaluate_queries(
     ScorerParams const& scorer_params,
     const bool weighted,
     std::string const& run_id,
-    std::string const& iteration
+    std::string const& iteration,
+    DocumentFilter const* filter
 ) {
     auto const& index = *index_ptr;
+    if (filter != nullptr && filter->size() > index.num_docs()) {
+        throw std::invalid_argument(fmt::format(
+            "Filter of {} documents for an index of {} documents", filter->size(), index.num_docs()
+        ));
+    }
     WandType const wdata(MemorySource::mapped_file(wand_data_filename));
 
     auto scorer = scorer::from_params(scorer_params, wdata);
-    std::function<std::vector<typename topk_queue::entry_type>(Query)> query_fun;
 
-    if (query_type == "wand") {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            wand_query wand_q(topk);
-            wand_q(make_max_scored_cursors(index, wdata, *scorer, query, weighted), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "block_max_wand") {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_wand_query block_max_wand_q(topk);
-            block_max_wand_q(
-                make_block_max_scored_cursors(index, wdata, *scorer, query, weighted),
-                index.num_docs()
-            );
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "block_max_maxscore") {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_maxscore_query block_max_maxscore_q(topk);
-            block_max_maxscore_q(
-                make_block_max_scored_cursors(index, wdata, *scorer, query, weighted),
-                index.num_docs()
-            );
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "block_max_ranked_and") {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_ranked_and_query block_max_ranked_and_q(topk);
-            block_max_ranked_and_q(
-                make_block_max_scored_cursors(index, wdata, *scorer, query, weighted),
-                index.num_docs()
-            );
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_and") {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            ranked_and_query ranked_and_q(topk);
-            ranked_and_q(make_scored_cursors(index, *scorer, query, weighted), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_or") {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            ranked_or_query ranked_or_q(topk);
-            ranked_or_q(make_scored_cursors(index, *scorer, query, weighted), index.num_docs());
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "maxscore") {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            maxscore_query maxscore_q(topk);
-            maxscore_q(
-                make_max_scored_cursors(index, wdata, *scorer, query, weighted), index.num_docs()
-            );
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_or_taat") {
-        query_fun = [&, accumulator = SimpleAccumulator(index.num_docs())](Query query) mutable {
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            ranked_or_taat_q(
-                make_scored_cursors(index, *scorer, query, weighted), index.num_docs(), accumulator
-            );
-            topk.finalize();
-            return topk.topk();
-        };
-    } else if (query_type == "ranked_or_taat_lazy") {
-        query_fun = [&, accumulator = LazyAccumulator<4>(index.num_docs())](Query query) mutable {
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            ranked_or_taat_q(
-                make_scored_cursors(index, *scorer, query, weighted), index.num_docs(), accumulator
-            );
+    using query_function_type =
+        std::function<std::vector<typename topk_queue::entry_type>(Query const&)>;
+
+    // Query functions own their top-k queue and (for TAAT) their accumulator. Rather than copying
+    // them into each task, every worker thread builds its own query function once, and then reuses
+    // it for all queries it processes. See `query_functions` below.
+    auto make_ranked_query_fun =
+        ranked_query_functions(query_type, index, wdata, *scorer, weighted, filter);
+    std::function<query_function_type()> make_query_fun = [&]() -> query_function_type {
+        return [topk = topk_queue(k), run = make_ranked_query_fun()](Query const& query) mutable {
+            topk.clear();
+            run(query, topk);
             topk.finalize();
             return topk.topk();
         };
-    } else {
-        spdlog::error("Unsupported query type: {}", query_type);
-    }
+    };
 
     auto source = std::make_shared<mio::mmap_source>(documents_filename.c_str());
     auto docmap = Payload_Vector<>::from(*source);
 
-    std::vector<std::vector<typename topk_queue::entry_type>> raw_results(queries.size());
+    // Queries flow through a three-stage pipeline: they are parsed one at a time in input order,
+    // processed in parallel, and printed in input order again. At most `max_in_flight` queries
+    // (along with their results) are held in memory at any time, and the results are written out
+    // while subsequent queries are still being processed.
+    struct QueryResults {
+        std::size_t idx = 0;
+        std::optional<Query> query{};
+        std::vector<typename topk_queue::entry_type> results{};
+    };
+
+    tbb::enumerable_thread_specific<query_function_type> query_functions(make_query_fun);
+    std::size_t num_queries = 0;
     auto start_batch = std::chrono::steady_clock::now();
-    tbb::parallel_for(size_t(0), queries.size(), [&, query_fun](size_t query_idx) {
-        raw_results[query_idx] = query_fun(queries[query_idx]);
-    });
+    tbb::parallel_pipeline(
+        max_in_flight,
+        tbb::make_filter<void, QueryResults>(
+            tbb::filter_mode::serial_in_order,
+            [&](tbb::flow_control& fc) -> QueryResults {
+                std::string line;
+                if (!std::getline(*query_input, line)) {
+                    fc.stop();
+                    return {};
+                }
+                return {num_queries++, query_parser->parse(line), {}};
+            }
+        ) & tbb::make_filter<QueryResults, QueryResults>(
+            tbb::filter_mode::parallel,
+            [&](QueryResults item) {
+                item.results = query_functions.local()(*item.query);
+                return item;
+            }
+        ) & tbb::make_filter<QueryResults, void>(
+            tbb::filter_mode::serial_in_order,
+            [&](QueryResults const& item) {
+                auto qid = item.query->id();
+                for (auto&& [rank, result]: enumerate(item.results)) {
+                    std::cout << fmt::format(
+                        "{} {} {} {} {} {}\n",
+                        qid.value_or(std::to_string(item.idx)),
+                        iteration,
+                        docmap[result.second],
+                        rank + 1,
+                        result.first,
+                        run_id
+                    );
+                }
+            }
+        )
+    );
     auto end_batch = std::chrono::steady_clock::now();
-
-    for (size_t query_idx = 0; query_idx < raw_results.size(); ++query_idx) {
-        auto results = raw_results[query_idx];
-        auto qid = queries[query_idx].id();
-        for (auto&& [rank, result]: enumerate(results)) {
-            std::cout << fmt::format(
-                "{} {} {} {} {} {}\n",
-                qid.value_or(std::to_string(query_idx)),
-                iteration,
-                docmap[result.second],
-                rank + 1,
-                result.first,
-                run_id
-            );
-        }
-    }
-    auto end_print = std::chrono::steady_clock::now();
     double batch_ms =
         std::chrono::duration_cast<std::chrono::milliseconds>(end_batch - start_batch).count();
-    double batch_with_print_ms =
-        std::chrono::duration_cast<std::chrono::milliseconds>(end_print - start_batch).count();
+    spdlog::info("Processed {} queries", num_queries);
     spdlog::info("Time taken to process queries: {}ms", batch_ms);
-    spdlog::info("Time taken to process queries with printing: {}ms", batch_with_print_ms);
 }
 
 using wand_raw_index = wand_data<wand_data_raw>;
@@ -192,6 +143,7 @@ int main(int argc, const char** argv) {
     std::string documents_file;
     std::string run_id = "R0";
     bool quantized = false;
+    std::size_t max_in_flight = 1024;
 
     App<arg::Index,
         arg::WandData<arg::WandMode::Required>,
@@ -199,12 +151,20 @@ int main(int argc, const char** argv) {
         arg::Algorithm,
         arg::Scorer,
         arg::Thresholds,
+        arg::Filter,
         arg::Threads,
         arg::LogLevel>
         app{"Retrieves query results in TREC format."};
     app.add_option("-r,--run", run_id, "Run identifier");
     app.add_option("--documents", documents_file, "Document lexicon")->required();
     app.add_flag("--quantized", quantized, "Quantized scores");
+    app.add_option(
+           "--max-in-flight",
+           max_in_flight,
+           "Maximum number of queries read but not yet printed; bounds memory usage"
+    )
+        ->capture_default_str()
+        ->check(CLI::PositiveNumber);
 
     CLI11_PARSE(app, argc, argv);
 
@@ -218,32 +178,55 @@ int main(int argc, const char** argv) {
 
     auto iteration = "Q0";
 
-    run_for_index(
-        app.index_encoding(), MemorySource::mapped_file(app.index_filename()), [&](auto index) {
-            using Index = std::decay_t<decltype(index)>;
-            auto params = std::make_tuple(
-                &index,
-                app.wand_data_path(),
-                app.queries(),
-                app.thresholds_file(),
-                app.index_encoding(),
-                app.algorithm(),
-                app.k(),
-                documents_file,
-                app.scorer_params(),
-                app.weighted(),
-                run_id,
-                iteration
-            );
-            if (app.is_wand_compressed()) {
-                if (quantized) {
-                    std::apply(evaluate_queries<Index, wand_uniform_index_quantized>, params);
+    auto query_parser = app.query_parser();
+    std::ifstream query_file;
+    if (auto path = app.query_file(); path) {
+        query_file.open(path->get());
+        if (!query_file.is_open()) {
+            spdlog::error("Cannot open queries file: {}", path->get());
+            return 1;
+        }
+    }
+    std::istream& query_input = query_file.is_open() ? query_file : std::cin;
+
+    try {
+        std::optional<DocumentFilter> filter;
+        if (auto const& path = app.filter_file(); path) {
+            filter.emplace(MemorySource::mapped_file(*path));
+        }
+        run_for_index(
+            app.index_encoding(), MemorySource::mapped_file(app.index_filename()), [&](auto index) {
+                using Index = std::decay_t<decltype(index)>;
+                auto params = std::make_tuple(
+                    &index,
+                    app.wand_data_path(),
+                    &query_input,
+                    &query_parser,
+                    max_in_flight,
+                    app.thresholds_file(),
+                    app.index_encoding(),
+                    app.algorithm(),
+                    app.k(),
+                    documents_file,
+                    app.scorer_params(),
+                    app.weighted(),
+                    run_id,
+                    iteration,
+                    filter ? &*filter : nullptr
+                );
+                if (app.is_wand_compressed()) {
+                    if (quantized) {
+                        std::apply(evaluate_queries<Index, wand_uniform_index_quantized>, params);
+                    } else {
+                        std::apply(evaluate_queries<Index, wand_uniform_index>, params);
+                    }
                 } else {
-                    std::apply(evaluate_queries<Index, wand_uniform_index>, params);
+                    std::apply(evaluate_queries<Index, wand_raw_index>, params);
                 }
-            } else {
-                std::apply(evaluate_queries<Index, wand_raw_index>, params);
             }
-        }
-    );
+        );
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
 }
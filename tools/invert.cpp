@@ -15,6 +15,8 @@ int main(int argc, char** argv) {
     try {
         pisa::invert::InvertParams params;
         params.batch_size = args.batch_size();
+        params.memory_budget = args.memory_budget();
+        params.collection_format = args.collection_format();
         params.num_threads = args.threads();
         params.term_count = args.term_count();
         pisa::invert::invert_forward_index(args.input_basename(), args.output_basename(), params);
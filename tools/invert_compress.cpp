@@ -0,0 +1,37 @@
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
+
+#include "app.hpp"
+#include "compress.hpp"
+#include "invert.hpp"
+
+int main(int argc, char** argv) {
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+    CLI::App app{"Inverts a forward index and compresses it in a single pass."};
+    pisa::InvertCompressArgs args(&app);
+    CLI11_PARSE(app, argc, argv);
+    spdlog::set_level(args.log_level());
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
+    spdlog::info("Number of worker threads: {}", args.threads());
+    try {
+        pisa::invert::InvertParams params;
+        params.batch_size = args.batch_size();
+        params.memory_budget = args.memory_budget();
+        params.collection_format = args.collection_format();
+        params.num_threads = args.threads();
+        params.term_count = args.term_count();
+        pisa::invert_and_compress(
+            args.input_basename(),
+            args.index_encoding(),
+            args.output(),
+            params,
+            args.wand_data_options()
+        );
+        return 0;
+    } catch (pisa::io::NoSuchFile const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+}
@@ -0,0 +1,30 @@
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
+
+#include "app.hpp"
+#include "merge_indexes.hpp"
+
+int main(int argc, char** argv) {
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+    CLI::App app{"Merges indexes over consecutive ranges of documents into a single index."};
+    pisa::MergeIndexesArgs args(&app);
+    CLI11_PARSE(app, argc, argv);
+    spdlog::set_level(args.log_level());
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
+    spdlog::info("Number of worker threads: {}", args.threads());
+    try {
+        pisa::merge_indexes(
+            args.input_basenames(),
+            args.output_basename(),
+            args.index_encoding(),
+            args.wand_data_options()
+        );
+        return 0;
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+}
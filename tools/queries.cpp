@@ -3,6 +3,7 @@
 #include <numeric>
 #include <optional>
 #include <string>
+#include <unordered_set>
 
 #include <CLI/CLI.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -12,25 +13,15 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
-#include "accumulator/lazy_accumulator.hpp"
-#include "accumulator/simple_accumulator.hpp"
 #include "app.hpp"
-#include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/cursor.hpp"
-#include "cursor/max_scored_cursor.hpp"
-#include "cursor/scored_cursor.hpp"
+#include "document_filter.hpp"
 #include "index_types.hpp"
 #include "memory_source.hpp"
 #include "query/algorithm/and_query.hpp"
-#include "query/algorithm/block_max_maxscore_query.hpp"
-#include "query/algorithm/block_max_ranked_and_query.hpp"
-#include "query/algorithm/block_max_wand_query.hpp"
-#include "query/algorithm/maxscore_query.hpp"
+#include "query/algorithm/or_block_query.hpp"
 #include "query/algorithm/or_query.hpp"
-#include "query/algorithm/ranked_and_query.hpp"
-#include "query/algorithm/ranked_or_query.hpp"
-#include "query/algorithm/ranked_or_taat_query.hpp"
-#include "query/algorithm/wand_query.hpp"
+#include "query/ranked_query.hpp"
 #include "scorer/scorer.hpp"
 #include "timer.hpp"
 #include "topk_queue.hpp"
@@ -126,6 +117,11 @@ void op_perftest(
     }
 }
 
+/** Query types that do not skip the documents excluded by a filter. */
+std::unordered_set<std::string> const unfiltered_query_types{
+    "and", "or", "or_freq", "or_block", "or_block_freq", "ranked_or_block"
+};
+
 template <typename IndexType, typename WandType>
 void perftest(
     IndexType const* index_ptr,
@@ -138,9 +134,15 @@ void perftest(
     const ScorerParams& scorer_params,
     const bool weighted,
     bool extract,
-    bool safe
+    bool safe,
+    DocumentFilter const* filter
 ) {
     auto const& index = *index_ptr;
+    if (filter != nullptr && filter->size() > index.num_docs()) {
+        throw std::invalid_argument(fmt::format(
+            "Filter of {} documents for an index of {} documents", filter->size(), index.num_docs()
+        ));
+    }
 
     spdlog::info("Warming up posting lists");
     std::unordered_set<TermId> warmed_up;
@@ -184,6 +186,11 @@ void perftest(
 
     for (auto&& t: query_types) {
         spdlog::info("Query type: {}", t);
+        if (filter != nullptr && unfiltered_query_types.contains(t)) {
+            throw std::invalid_argument(
+                fmt::format("query type {} does not support document filters", t)
+            );
+        }
         std::function<uint64_t(Query, Score)> query_fun;
         if (t == "and") {
             query_fun = [&](Query query, Score) {
@@ -200,96 +207,21 @@ void perftest(
                 or_query<true> or_q;
                 return or_q(make_cursors(index, query), index.num_docs());
             };
-        } else if (t == "wand" && wand_data_filename) {
-            query_fun = [&](Query query, Score threshold) {
-                topk_queue topk(k, threshold);
-                wand_query wand_q(topk);
-                wand_q(
-                    make_max_scored_cursors(index, wdata, *scorer, query, weighted), index.num_docs()
-                );
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query, Score threshold) {
-                topk_queue topk(k, threshold);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query, weighted),
-                    index.num_docs()
-                );
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Score threshold) {
-                topk_queue topk(k, threshold);
-                block_max_maxscore_query block_max_maxscore_q(topk);
-                block_max_maxscore_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query, weighted),
-                    index.num_docs()
-                );
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Score threshold) {
-                topk_queue topk(k, threshold);
-                ranked_and_query ranked_and_q(topk);
-                ranked_and_q(make_scored_cursors(index, *scorer, query, weighted), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Score threshold) {
-                topk_queue topk(k, threshold);
-                block_max_ranked_and_query block_max_ranked_and_q(topk);
-                block_max_ranked_and_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query, weighted),
-                    index.num_docs()
-                );
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or" && wand_data_filename) {
-            query_fun = [&](Query query, Score threshold) {
-                topk_queue topk(k, threshold);
-                ranked_or_query ranked_or_q(topk);
-                ranked_or_q(make_scored_cursors(index, *scorer, query, weighted), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Score threshold) {
-                topk_queue topk(k, threshold);
-                maxscore_query maxscore_q(topk);
-                maxscore_q(
-                    make_max_scored_cursors(index, wdata, *scorer, query, weighted), index.num_docs()
-                );
-                topk.finalize();
-                return topk.topk().size();
+        } else if (t == "or_block") {
+            query_fun = [&](Query query, Score) {
+                or_block_query<false> or_q;
+                return or_q(make_cursors(index, query), index.num_docs());
             };
-        } else if (t == "ranked_or_taat" && wand_data_filename) {
-            SimpleAccumulator accumulator(index.num_docs());
-            topk_queue topk(k);
-            query_fun = [&, topk, accumulator](Query query, Score threshold) mutable {
-                ranked_or_taat_query ranked_or_taat_q(topk);
-                topk.clear(threshold);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query, weighted), index.num_docs(), accumulator
-                );
-                topk.finalize();
-                return topk.topk().size();
+        } else if (t == "or_block_freq") {
+            query_fun = [&](Query query, Score) {
+                or_block_query<true> or_q;
+                return or_q(make_cursors(index, query), index.num_docs());
             };
-        } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
-            LazyAccumulator<4> accumulator(index.num_docs());
-            topk_queue topk(k);
-            query_fun = [&, topk, accumulator](Query query, Score threshold) mutable {
-                ranked_or_taat_query ranked_or_taat_q(topk);
+        } else if (wand_data_filename) {
+            auto run = ranked_query_functions(t, index, wdata, *scorer, weighted, filter)();
+            query_fun = [topk = topk_queue(k), run](Query query, Score threshold) mutable {
                 topk.clear(threshold);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query, weighted), index.num_docs(), accumulator
-                );
+                run(query, topk);
                 topk.finalize();
                 return topk.topk().size();
             };
@@ -320,6 +252,7 @@ int main(int argc, const char** argv) {
         arg::Algorithm,
         arg::Scorer,
         arg::Thresholds,
+        arg::Filter,
         arg::LogLevel>
         app{"Benchmarks queries on a given index."};
     app.add_flag("--quantized", quantized, "Quantized scores");
@@ -334,31 +267,41 @@ int main(int argc, const char** argv) {
         std::cout << "qid\tusec\n";
     }
 
-    run_for_index(
-        app.index_encoding(), MemorySource::mapped_file(app.index_filename()), [&](auto index) {
-            using Index = std::decay_t<decltype(index)>;
-            auto params = std::make_tuple(
-                &index,
-                app.wand_data_path(),
-                app.queries(),
-                app.thresholds_file(),
-                app.index_encoding(),
-                app.algorithm(),
-                app.k(),
-                app.scorer_params(),
-                app.weighted(),
-                extract,
-                safe
-            );
-            if (app.is_wand_compressed()) {
-                if (quantized) {
-                    std::apply(perftest<Index, wand_uniform_index_quantized>, params);
+    try {
+        std::optional<DocumentFilter> filter;
+        if (auto const& path = app.filter_file(); path) {
+            filter.emplace(MemorySource::mapped_file(*path));
+        }
+        run_for_index(
+            app.index_encoding(), MemorySource::mapped_file(app.index_filename()), [&](auto index) {
+                using Index = std::decay_t<decltype(index)>;
+                auto params = std::make_tuple(
+                    &index,
+                    app.wand_data_path(),
+                    app.queries(),
+                    app.thresholds_file(),
+                    app.index_encoding(),
+                    app.algorithm(),
+                    app.k(),
+                    app.scorer_params(),
+                    app.weighted(),
+                    extract,
+                    safe,
+                    filter ? &*filter : nullptr
+                );
+                if (app.is_wand_compressed()) {
+                    if (quantized) {
+                        std::apply(perftest<Index, wand_uniform_index_quantized>, params);
+                    } else {
+                        std::apply(perftest<Index, wand_uniform_index>, params);
+                    }
                 } else {
-                    std::apply(perftest<Index, wand_uniform_index>, params);
+                    std::apply(perftest<Index, wand_raw_index>, params);
                 }
-            } else {
-                std::apply(perftest<Index, wand_raw_index>, params);
             }
-        }
-    );
+        );
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
 }
@@ -24,6 +24,7 @@ auto reorder_docids(ReorderDocuments const& args) -> int {
                     .min_length = args.min_length(),
                     .compress_fwd = not args.nogb(),
                     .print_args = args.print(),
+                    .collection_format = args.collection_format(),
                 }
             );
         }
@@ -31,7 +32,8 @@ auto reorder_docids(ReorderDocuments const& args) -> int {
             .input_basename = args.input_basename(),
             .output_basename = *args.output_basename(),
             .document_lexicon = args.document_lexicon(),
-            .reordered_document_lexicon = args.reordered_document_lexicon()
+            .reordered_document_lexicon = args.reordered_document_lexicon(),
+            .collection_format = args.collection_format()
         };
         if (args.random()) {
             return reorder_random(options, args.seed());
@@ -0,0 +1,173 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
+
+#include "app.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "query/ranked_query.hpp"
+#include "segmented_index.hpp"
+#include "string.hpp"
+#include "text_analyzer.hpp"
+
+using namespace pisa;
+
+template <typename Index>
+void query_segments(
+    std::string const& manifest,
+    std::istream& query_input,
+    TextAnalyzer const& analyzer,
+    std::string const& algorithm,
+    std::size_t k,
+    ScorerParams const& scorer_params,
+    BlockSize block_size,
+    std::string const& run_id
+) {
+    using Segments = SegmentedIndex<Index>;
+    using Segment = typename Segments::Segment;
+    Segments index(manifest, scorer_params, block_size);
+
+    std::unordered_map<Segment const*, RankedQueryFunction> segment_queries;
+    for (auto const& segment: index.segments()) {
+        segment_queries[&segment] = ranked_query_functions(
+            algorithm, segment.index, segment.wdata, *segment.scorer, false, nullptr
+        )();
+    }
+    auto run = [&](Segment const& segment, Query const& query, topk_queue& topk) {
+        segment_queries.at(&segment)(query, topk);
+    };
+
+    std::size_t num_queries = 0;
+    topk_queue topk(k);
+    io::for_each_line(query_input, [&](std::string const& line) {
+        auto [qid, raw_query] = split_at_colon(line);
+        std::vector<std::string> terms;
+        for (auto token: *analyzer.analyze(raw_query)) {
+            terms.push_back(std::move(token));
+        }
+        auto query_id = qid.has_value() ? std::string(*qid) : std::to_string(num_queries);
+        topk.clear();
+        index.query(terms, topk, run);
+        topk.finalize();
+        for (std::size_t rank = 0; rank < topk.topk().size(); ++rank) {
+            auto const& [score, docid] = topk.topk()[rank];
+            std::cout << fmt::format(
+                "{} {} {} {} {} {}\n",
+                query_id,
+                "Q0",
+                index.document(docid),
+                rank + 1,
+                score,
+                run_id
+            );
+        }
+        ++num_queries;
+    });
+    spdlog::info("Processed {} queries over {} segments", num_queries, index.segments().size());
+}
+
+int main(int argc, char** argv) {
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::string manifest;
+    std::string encoding;
+    std::string input_basename;
+    std::size_t fanout = 10;
+    bool force = false;
+    std::string query_file;
+    std::size_t k = 10;
+    std::string run_id = "R0";
+
+    pisa::App<pisa::arg::LogLevel> app{"Builds, merges, and queries segmented indexes."};
+    app.require_subcommand(1);
+    auto* create = app.add_subcommand("create", "Creates an index without segments.");
+    create->add_option("-m,--manifest", manifest, "Segment manifest")->required();
+    create->add_option("-e,--encoding", encoding, "Index encoding")->required();
+    create->add_flag("--force", force, "Overwrite an existing manifest");
+    auto* add = app.add_subcommand("add", "Inverts a forward index into a new segment.");
+    SegmentArgs add_args(add);
+    add->add_option("-i,--input", input_basename, "Forward index basename")->required();
+    auto* merge = app.add_subcommand(
+        "merge", "Merges segments of the same level until fewer than fanout are left in each level."
+    );
+    SegmentArgs merge_args(merge);
+    merge->add_option("--fanout", fanout, "Number of segments merged together")
+        ->capture_default_str()
+        ->check(CLI::Range(std::size_t(2), std::numeric_limits<std::size_t>::max()));
+    auto* query = app.add_subcommand("query", "Retrieves query results in TREC format.");
+    pisa::Args<arg::Segments, arg::Analyzer, arg::Algorithm> query_args(query);
+    query->add_option("-q,--queries", query_file, "Path to file with queries")->required();
+    query->add_option("-k", k, "The number of top results to return")->capture_default_str();
+    query->add_option("-r,--run", run_id, "Run identifier");
+    CLI11_PARSE(app, argc, argv);
+
+    spdlog::set_level(app.log_level());
+
+    try {
+        if (create->parsed()) {
+            if (std::filesystem::exists(manifest) && !force) {
+                throw std::runtime_error(fmt::format(
+                    "manifest {} already exists; use --force to overwrite it", manifest
+                ));
+            }
+            SegmentManifest(encoding).write(manifest);
+        }
+        if (add->parsed()) {
+            tbb::global_control control(
+                tbb::global_control::max_allowed_parallelism, add_args.threads() + 1
+            );
+            invert::InvertParams params;
+            params.batch_size = add_args.batch_size();
+            params.memory_budget = add_args.memory_budget();
+            params.collection_format = add_args.collection_format();
+            params.num_threads = add_args.threads();
+            add_segment(add_args.manifest(), input_basename, params, add_args.wand_data_options());
+        }
+        if (merge->parsed()) {
+            tbb::global_control control(
+                tbb::global_control::max_allowed_parallelism, merge_args.threads() + 1
+            );
+            auto merges = merge_segments(
+                merge_args.manifest(), TieredMergePolicy{fanout}, merge_args.wand_data_options()
+            );
+            spdlog::info("Performed {} merges", merges);
+        }
+        if (query->parsed()) {
+            std::ifstream query_input(query_file);
+            if (!query_input.is_open()) {
+                throw std::runtime_error(fmt::format("cannot open queries file {}", query_file));
+            }
+            auto analyzer = query_args.text_analyzer();
+            auto wand_options = query_args.wand_data_options();
+            auto index_encoding = SegmentManifest::read(query_args.manifest()).encoding();
+            resolve_index_type(index_encoding, [&](auto index_traits) {
+                using Index = typename std::decay_t<decltype(index_traits)>::type;
+                query_segments<Index>(
+                    query_args.manifest(),
+                    query_input,
+                    analyzer,
+                    query_args.algorithm(),
+                    k,
+                    wand_options.scorer_params,
+                    wand_options.block_size,
+                    run_id
+                );
+            });
+        }
+        return 0;
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+}
@@ -82,6 +82,8 @@ int main(int argc, char** argv) {
 
             InvertParams params;
             params.batch_size = invert_args.batch_size();
+            params.memory_budget = invert_args.memory_budget();
+            params.collection_format = invert_args.collection_format();
             params.num_threads = invert_args.threads();
 
             for (auto shard: resolve_shards(invert_args.input_basename())) {
@@ -106,6 +108,9 @@ int main(int argc, char** argv) {
             return 0;
         }
         if (compress->parsed()) {
+            tbb::global_control control(
+                tbb::global_control::max_allowed_parallelism, compress_args.threads() + 1
+            );
             auto shards = resolve_shards(compress_args.input_basename(), ".docs");
             spdlog::info("Processing {} shards", shards.size());
             for (auto shard: shards) {
@@ -118,6 +123,7 @@ int main(int argc, char** argv) {
                     shard_args.output(),
                     shard_args.scorer_params(),
                     shard_args.quantization_bits(),
+                    shard_args.mixed_options(),
                     shard_args.check(),
                     false
                 );
@@ -125,6 +131,9 @@ int main(int argc, char** argv) {
             return 0;
         }
         if (wand->parsed()) {
+            tbb::global_control control(
+                tbb::global_control::max_allowed_parallelism, wand_args.threads() + 1
+            );
             auto shards = resolve_shards(wand_args.input_basename(), ".docs");
             spdlog::info("Processing {} shards", shards.size());
             for (auto shard: shards) {
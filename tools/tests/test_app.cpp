@@ -551,6 +551,39 @@ TEST_CASE("Batch size", "[cli]") {
     }
 }
 
+TEST_CASE("Memory budget", "[cli]") {
+    CLI::App app("Memory budget test");
+    pisa::Args<pisa::arg::MemoryBudget> args(&app);
+    SECTION("Default") {
+        parse(app, {});
+        REQUIRE_FALSE(args.memory_budget().has_value());
+    }
+    SECTION("Bytes") {
+        parse(app, {"--memory-budget", "1000"});
+        REQUIRE(args.memory_budget() == 1000);
+    }
+    SECTION("With unit") {
+        parse(app, {"--memory-budget", "2GB"});
+        REQUIRE(args.memory_budget() == std::size_t(2) << 30U);
+    }
+}
+
+TEST_CASE("Collection format", "[cli]") {
+    CLI::App app("Collection format test");
+    pisa::Args<pisa::arg::CollectionFormat> args(&app);
+    SECTION("Default") {
+        parse(app, {});
+        REQUIRE(args.collection_format() == pisa::BinaryCollectionFormat::Raw);
+    }
+    SECTION("VByte") {
+        parse(app, {"--collection-format", "vbyte"});
+        REQUIRE(args.collection_format() == pisa::BinaryCollectionFormat::VByte);
+    }
+    SECTION("Throws with unknown format") {
+        REQUIRE_THROWS(parse(app, {"--collection-format", "gzip"}));
+    }
+}
+
 TEST_CASE("Invert", "[cli]") {
     CLI::App app("Invert test");
     pisa::Args<pisa::arg::Invert> args(&app);
@@ -708,6 +741,165 @@ TEST_CASE("CreateWandData", "[cli]") {
     }
 }
 
+TEST_CASE("InvertCompress", "[cli]") {
+    CLI::App app("InvertCompress test");
+    pisa::Args<pisa::arg::InvertCompress> args(&app);
+    SECTION("Throws without arguments") {
+        REQUIRE_THROWS(parse(app, {}));
+    }
+    SECTION("Throws with wand data but no scorer") {
+        REQUIRE_THROWS(parse(app, {"-i", "INPUT", "-o", "OUTPUT", "--wand", "WAND"}));
+    }
+    SECTION("Throws with block size but no wand data") {
+        REQUIRE_THROWS(parse(app, {"-i", "INPUT", "-o", "OUTPUT", "--block-size", "10"}));
+    }
+    SECTION("Without wand data") {
+        parse(app, {"-i", "INPUT", "-o", "OUTPUT", "--term-count", "123"});
+        REQUIRE(args.input_basename() == "INPUT");
+        REQUIRE(args.output() == "OUTPUT");
+        REQUIRE(args.term_count() == 123);
+        REQUIRE_FALSE(args.wand_data_options().has_value());
+    }
+    SECTION("With wand data and default block size") {
+        parse(app, {"-i", "INPUT", "-o", "OUTPUT", "--wand", "WAND", "--scorer", "SCORER"});
+        auto options = args.wand_data_options();
+        REQUIRE(options.has_value());
+        REQUIRE(options->output == "WAND");
+        REQUIRE(options->scorer_params.name == "SCORER");
+        REQUIRE(std::get<pisa::FixedBlock>(options->block_size).size == 64);
+        REQUIRE_FALSE(options->range);
+        REQUIRE_FALSE(options->compress);
+        REQUIRE_FALSE(options->quantization_bits.has_value());
+    }
+    SECTION("With compressed wand data") {
+        parse(
+            app,
+            {"-i",
+             "INPUT",
+             "-o",
+             "OUTPUT",
+             "--wand",
+             "WAND",
+             "--scorer",
+             "SCORER",
+             "--lambda",
+             "0.5",
+             "--compress",
+             "--quantize",
+             "8"}
+        );
+        auto options = args.wand_data_options();
+        REQUIRE(options.has_value());
+        REQUIRE(std::get<pisa::VariableBlock>(options->block_size).lambda == 0.5);
+        REQUIRE(options->compress);
+        REQUIRE(options->quantization_bits == std::optional<pisa::Size>(8));
+    }
+    SECTION("With range wand data") {
+        parse(app, {"-i", "INPUT", "-o", "OUTPUT", "--wand", "WAND", "--scorer", "SCORER", "--range"});
+        auto options = args.wand_data_options();
+        REQUIRE(options.has_value());
+        REQUIRE(options->range);
+    }
+}
+
+TEST_CASE("MergeIndexes", "[cli]") {
+    CLI::App app("MergeIndexes test");
+    pisa::Args<pisa::arg::MergeIndexes> args(&app);
+    SECTION("Throws without scorer") {
+        REQUIRE_THROWS(parse(app, {"-i", "A", "B", "-o", "OUTPUT"}));
+    }
+    SECTION("Inputs in order with default block size") {
+        parse(app, {"-i", "A", "B", "C", "-o", "OUTPUT", "--scorer", "SCORER"});
+        REQUIRE(args.input_basenames() == std::vector<std::string>{"A", "B", "C"});
+        REQUIRE(args.output_basename() == "OUTPUT");
+        auto options = args.wand_data_options();
+        REQUIRE(options.scorer_params.name == "SCORER");
+        REQUIRE(std::get<pisa::FixedBlock>(options.block_size).size == 64);
+        REQUIRE_FALSE(options.compress);
+        REQUIRE_FALSE(options.quantization_bits.has_value());
+    }
+    SECTION("Compressed wand data") {
+        parse(
+            app,
+            {"-i", "A", "-o", "OUTPUT", "--scorer", "SCORER", "--compress", "--quantize", "8"}
+        );
+        auto options = args.wand_data_options();
+        REQUIRE(options.compress);
+        REQUIRE(options.quantization_bits == std::optional<pisa::Size>(8));
+    }
+}
+
+TEST_CASE("TranscodeIndex", "[cli]") {
+    CLI::App app("TranscodeIndex test");
+    pisa::Args<pisa::arg::TranscodeIndex> args(&app);
+    SECTION("Throws without input encoding") {
+        REQUIRE_THROWS(parse(app, {"-i", "INPUT", "-o", "OUTPUT"}));
+    }
+    SECTION("Throws with output wand data but no input wand data") {
+        REQUIRE_THROWS(parse(
+            app,
+            {"-i",
+             "INPUT",
+             "--input-encoding",
+             "ENCODING",
+             "-o",
+             "OUTPUT",
+             "--output-wand",
+             "WAND",
+             "--scorer",
+             "SCORER"}
+        ));
+    }
+    SECTION("Without wand data") {
+        parse(
+            app,
+            {"-i",
+             "INPUT",
+             "--input-encoding",
+             "ENCODING",
+             "-o",
+             "OUTPUT",
+             "--mapping",
+             "MAPPING",
+             "--check"}
+        );
+        REQUIRE(args.input_filename() == "INPUT");
+        REQUIRE(args.input_encoding() == "ENCODING");
+        REQUIRE(args.output_filename() == "OUTPUT");
+        REQUIRE(args.mapping_file() == std::optional<std::string>("MAPPING"));
+        auto options = args.transcode_options();
+        REQUIRE(options.check);
+        REQUIRE_FALSE(options.mapping.has_value());
+        REQUIRE_FALSE(options.wand_options.has_value());
+    }
+    SECTION("With wand data") {
+        parse(
+            app,
+            {"-i",
+             "INPUT",
+             "--input-encoding",
+             "ENCODING",
+             "-o",
+             "OUTPUT",
+             "--wand",
+             "INPUT_WAND",
+             "--output-wand",
+             "WAND",
+             "--scorer",
+             "SCORER",
+             "--block-size",
+             "32"}
+        );
+        auto options = args.transcode_options();
+        REQUIRE_FALSE(options.check);
+        REQUIRE(options.input_wand_data == std::optional<std::string>("INPUT_WAND"));
+        REQUIRE(options.wand_options.has_value());
+        REQUIRE(options.wand_options->output == "WAND");
+        REQUIRE(options.wand_options->scorer_params.name == "SCORER");
+        REQUIRE(std::get<pisa::FixedBlock>(options.wand_options->block_size).size == 32);
+    }
+}
+
 TEST_CASE("ReorderDocuments", "[cli]") {
     CLI::App app("ReorderDocuments test");
     pisa::Args<pisa::arg::ReorderDocuments> args(&app);
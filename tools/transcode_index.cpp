@@ -0,0 +1,36 @@
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
+
+#include "app.hpp"
+#include "compress.hpp"
+#include "reorder_docids.hpp"
+
+int main(int argc, char** argv) {
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+    CLI::App app{"Encodes an index again with another encoding."};
+    pisa::TranscodeIndexArgs args(&app);
+    CLI11_PARSE(app, argc, argv);
+    spdlog::set_level(args.log_level());
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
+    spdlog::info("Number of worker threads: {}", args.threads());
+    try {
+        auto options = args.transcode_options();
+        if (args.mapping_file().has_value()) {
+            options.mapping = pisa::read_mapping(*args.mapping_file());
+        }
+        pisa::transcode_index(
+            args.input_filename(),
+            args.input_encoding(),
+            args.output_filename(),
+            args.index_encoding(),
+            options
+        );
+        return 0;
+    } catch (std::exception const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+}